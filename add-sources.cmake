@@ -31,6 +31,7 @@ set(DOCUMENT_FILES
 set(EXPORTERS_FILES
     ${LOMSE_SRC_DIR}/exporters/lomse_ldp_exporter.cpp
     ${LOMSE_SRC_DIR}/exporters/lomse_lmd_exporter.cpp
+    ${LOMSE_SRC_DIR}/exporters/lomse_midi_exporter.cpp
     ${LOMSE_SRC_DIR}/exporters/lomse_mnx_exporter.cpp
     ${LOMSE_SRC_DIR}/exporters/lomse_mxl_exporter.cpp
 )
@@ -111,6 +112,7 @@ set(GRAPHIC_MODEL_FILES
     ${LOMSE_SRC_DIR}/graphic_model/engravers/lomse_wedge_engraver.cpp
 
     ${LOMSE_SRC_DIR}/graphic_model/layouters/lomse_aux_shapes_aligner.cpp
+    ${LOMSE_SRC_DIR}/graphic_model/layouters/lomse_background_layouter.cpp
     ${LOMSE_SRC_DIR}/graphic_model/layouters/lomse_blocks_container_layouter.cpp
     ${LOMSE_SRC_DIR}/graphic_model/layouters/lomse_document_layouter.cpp
     ${LOMSE_SRC_DIR}/graphic_model/layouters/lomse_inlines_container_layouter.cpp
@@ -208,6 +210,7 @@ set(RENDER_FILES
     ${LOMSE_SRC_DIR}/render/lomse_font_storage.cpp
     ${LOMSE_SRC_DIR}/render/lomse_renderer.cpp
     ${LOMSE_SRC_DIR}/render/lomse_svg_drawer.cpp
+    ${LOMSE_SRC_DIR}/render/lomse_tile_cache.cpp
 )
 
 set(SOUND_FILES
@@ -61,6 +61,24 @@ Lomse does not impose any restriction about how to generate sounds other than lo
     
 @attention As playback is a real-time task, your code must return quickly. If it needs to do some significant amount of work then you must schedule this work asynchronously, for example by posting a windows message, or you should use a separate thread. Your application should not retain control for much time as this would result in freezing lomse playback thread.
 
+Alternatively, your class can override method MidiServerBase::events(). Lomse will then send, in a single call, all the sound events that take place at the same time (e.g. all notes in a chord), packed in a SoundEventBatch object. Each batch carries the real time at which the events must sound. By invoking ScorePlayer::set_sound_lookahead() the batches are sent ahead of time, with the timestamp in the future, so that a synthesizer thread can schedule the events with sample accuracy. Visual tracking events are not affected: they are posted when the sounds are due. When playback is paused or stopped, Lomse invokes MidiServerBase::all_sounds_off(), and your server must then discard all scheduled events not yet played; on resume, the events for the notes not played are sent again. Class QueuedMidiServer implements this model: it stores the received batches in a lock-free queue from which your synthesizer thread can pull them. On all_sounds_off() the queue is flushed and the consumer receives a batch containing a single BatchedMidiEvent::k_all_sounds_off event, meaning that it must silence all sounds and drop the events already scheduled:
+
+@code
+    QueuedMidiServer* pMidi = new QueuedMidiServer();
+    ScorePlayer* pPlayer = pLomse->create_score_player(pMidi);
+    pPlayer->set_sound_lookahead(20000);      //20 ms
+
+    //in your synthesizer thread
+    SoundEventBatch batch;
+    while (pMidi->get_queue().pop(batch))
+    {
+        if (batch.events[0].type == BatchedMidiEvent::k_all_sounds_off)
+            silence_and_clear_schedule();
+        else
+            schedule(batch.timestamp, batch.events);
+    }
+@endcode
+
 
 
 @section page-sound-generation-play-score How to play an score
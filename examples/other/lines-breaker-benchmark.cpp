@@ -0,0 +1,122 @@
+// lines-breaker-benchmark.cpp
+//
+// Benchmark for the optimal lines breaker algorithm: time for deciding the line
+// breaks of scores from 100 to 10,000 measures, with and without the bounded
+// lookahead optimization.
+// Feel free to use this example code in any way you see fit (Public Domain)
+//
+// Usage:
+// - build:
+//      g++ -std=c++11 -O2 lines-breaker-benchmark.cpp -o lines-breaker-benchmark \
+//        `pkg-config --cflags liblomse` `pkg-config --libs liblomse` -lstdc++
+// - run:
+//      ./lines-breaker-benchmark
+//
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+using namespace std;
+
+#include <lomse_injectors.h>
+#include <lomse_score_layouter.h>
+#include <lomse_graphical_model.h>
+#include <lomse_gm_basic.h>
+#include <lomse_internal_model.h>
+#include <private/lomse_document_p.h>
+using namespace lomse;
+
+//---------------------------------------------------------------------------------------
+// helper, for accessing protected members
+class BenchmarkScoreLayouter : public ScoreLayouter
+{
+public:
+    BenchmarkScoreLayouter(ImoContentObj* pImo, GraphicModel* pGModel,
+                           LibraryScope& libraryScope)
+        : ScoreLayouter(pImo, nullptr, pGModel, libraryScope)
+    {
+    }
+
+    void prepare_page(GmoBox* pBox)
+    {
+        page_initializations(pBox);
+        move_cursor_to_top_left_corner();
+    }
+    SpacingAlgorithm* get_spacing_algorithm() { return m_pSpAlgorithm; }
+    void delete_all() { delete_not_used_objects(); }
+};
+
+//---------------------------------------------------------------------------------------
+string create_score(int numMeasures)
+{
+    static const char* measures[] = {
+        "(n c4 q)(n e4 q)",
+        "(n c4 e)(n d4 e)(n e4 e)(n f4 e)",
+        "(n g4 h)",
+        "(n c4 s)(n d4 s)(n e4 s)(n f4 s)(n g4 s)(n a4 s)(n b4 s)(n c5 s)",
+        "(n c4 q.)(n d4 e)",
+    };
+    stringstream ss;
+    ss << "(score (vers 2.0)(instrument (musicData (clef G)(time 2 4)";
+    for (int i=0; i < numMeasures; ++i)
+        ss << measures[(i * 7) % 5] << "(barline)";
+    ss << ")))";
+    return ss.str();
+}
+
+//---------------------------------------------------------------------------------------
+double decide_breaks(BenchmarkScoreLayouter& scoreLyt, LibraryScope& libraryScope,
+                     bool fLookahead, int* numPenalties, int* numSystems)
+{
+    std::vector<int> breaks;
+    LinesBreakerOptimal breaker(&scoreLyt, libraryScope,
+                                scoreLyt.get_spacing_algorithm(), breaks);
+    breaker.use_bounded_lookahead(fLookahead);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    breaker.decide_line_breaks();
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+    *numPenalties = breaker.get_num_penalties_computed();
+    *numSystems = int(breaks.size());
+    return elapsed.count();
+}
+
+//---------------------------------------------------------------------------------------
+int main()
+{
+    LibraryScope libraryScope(cout);
+
+    cout << "measures  systems   penalties   time (ms)   penalties   time (ms)" << endl;
+    cout << "                    lookahead   lookahead   all lines   all lines" << endl;
+
+    int sizes[] = { 100, 300, 1000, 3000, 10000 };
+    for (int numMeasures : sizes)
+    {
+        Document doc(libraryScope);
+        doc.from_string( create_score(numMeasures) );
+        ImoScore* pScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        GraphicModel gmodel( doc.get_im_root() );
+        BenchmarkScoreLayouter scoreLyt(pScore, &gmodel, libraryScope);
+        scoreLyt.prepare_to_start_layout();     //columns creation and spacing
+        GmoBoxScorePage pageBox(pScore);
+        pageBox.set_origin(1500.0f, 2000.0f);
+        pageBox.set_width(18000.0f);
+        pageBox.set_height(25700.0f);
+        scoreLyt.prepare_page(&pageBox);
+
+        int numPenalties, numSystems, numAllPenalties;
+        double time = decide_breaks(scoreLyt, libraryScope, true, &numPenalties,
+                                    &numSystems);
+        double timeAll = decide_breaks(scoreLyt, libraryScope, false, &numAllPenalties,
+                                       &numSystems);
+
+        cout << setw(8) << numMeasures << setw(9) << numSystems
+             << setw(12) << numPenalties << setw(12) << fixed << setprecision(2) << time
+             << setw(12) << numAllPenalties << setw(12) << timeAll << endl;
+
+        scoreLyt.delete_all();
+    }
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+// score-cursor-benchmark.cpp
+//
+// Benchmark for ScoreCursor repositioning: time for jumping to random measures,
+// timepos and staffobjs in a piano score (two instruments, 2 staves) of up to
+// 2,000 measures.
+// Feel free to use this example code in any way you see fit (Public Domain)
+//
+// Usage:
+// - build:
+//      g++ -std=c++11 -O2 score-cursor-benchmark.cpp -o score-cursor-benchmark \
+//        `pkg-config --cflags liblomse` `pkg-config --libs liblomse` -lstdc++
+// - run:
+//      ./score-cursor-benchmark
+//
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <chrono>
+using namespace std;
+
+#include <lomse_injectors.h>
+#include <lomse_document_cursor.h>
+#include <lomse_internal_model.h>
+#include <lomse_staffobjs_table.h>
+#include <private/lomse_document_p.h>
+using namespace lomse;
+
+//---------------------------------------------------------------------------------------
+string create_score(int numMeasures)
+{
+    stringstream ss;
+    ss << "(score (vers 2.0)(instrument (musicData (clef G)(time 2 4)";
+    for (int i=0; i < numMeasures; ++i)
+        ss << "(n c4 e)(n d4 e)(n e4 e)(n f4 e)(barline)";
+    ss << "))(instrument (musicData (clef F4)(time 2 4)";
+    for (int i=0; i < numMeasures; ++i)
+        ss << "(n c3 q)(n g3 q)(barline)";
+    ss << ")))";
+    return ss.str();
+}
+
+//---------------------------------------------------------------------------------------
+void run_benchmark(LibraryScope& libraryScope, int numMeasures)
+{
+    Document doc(libraryScope);
+    doc.from_string( create_score(numMeasures) );
+    ImoScore* pScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+    ScoreCursor cursor(&doc, pScore);
+
+    //targets: pseudo-random measures, timepos and notes
+    const int numJumps = 1000;
+    vector<int> measures;
+    vector<ImoId> ids;
+    ColStaffObjs* pTable = pScore->get_staffobjs_table();
+    for (int i=0; i < numJumps; ++i)
+    {
+        measures.push_back( (i * 7919) % numMeasures );
+        int iEntry = (i * 104729) % pTable->num_entries();
+        ids.push_back( pTable->get_entry(iEntry)->element_id() );
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i=0; i < numJumps; ++i)
+        cursor.to_measure(measures[i], i % 2, 0);
+    chrono::duration<double, milli> timeMeasure = chrono::steady_clock::now() - start;
+
+    start = chrono::steady_clock::now();
+    for (int i=0; i < numJumps; ++i)
+        cursor.to_time(i % 2, 0, TimeUnits(measures[(i + 1) % numJumps]) * 128.0);
+    chrono::duration<double, milli> timeTime = chrono::steady_clock::now() - start;
+
+    start = chrono::steady_clock::now();
+    for (int i=0; i < numJumps; ++i)
+        cursor.point_to(ids[i]);
+    chrono::duration<double, milli> timePointTo = chrono::steady_clock::now() - start;
+
+    cout << setw(10) << numMeasures << setw(10) << pTable->num_entries()
+         << setw(14) << fixed << setprecision(3) << timeMeasure.count()
+         << setw(14) << timeTime.count() << setw(14) << timePointTo.count() << endl;
+}
+
+//---------------------------------------------------------------------------------------
+int main()
+{
+    LibraryScope libraryScope(cout);
+
+    cout << "1000 jumps. Times in ms" << endl;
+    cout << "  measures   entries    to_measure       to_time      point_to" << endl;
+
+    int sizes[] = { 50, 200, 1000, 2000 };
+    for (int numMeasures : sizes)
+        run_benchmark(libraryScope, numMeasures);
+
+    return 0;
+}
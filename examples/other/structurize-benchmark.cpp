@@ -0,0 +1,91 @@
+// structurize-benchmark.cpp
+//
+// Benchmark for updating the score structures after an edition: time for a full
+// structurize (ImoScore::end_of_changes()) and for a structurize scoped to the
+// modified instrument and measure, in a score with four instruments (2 staves)
+// of up to 2,000 measures.
+// Feel free to use this example code in any way you see fit (Public Domain)
+//
+// Usage:
+// - build:
+//      g++ -std=c++11 -O2 structurize-benchmark.cpp -o structurize-benchmark \
+//        `pkg-config --cflags liblomse` `pkg-config --libs liblomse` -lstdc++
+// - run:
+//      ./structurize-benchmark
+//
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+using namespace std;
+
+#include <lomse_injectors.h>
+#include <lomse_internal_model.h>
+#include <lomse_im_note.h>
+#include <lomse_staffobjs_table.h>
+#include <private/lomse_document_p.h>
+using namespace lomse;
+
+//---------------------------------------------------------------------------------------
+string create_score(int numMeasures)
+{
+    stringstream ss;
+    ss << "(score (vers 2.0)";
+    for (int k=0; k < 4; ++k)
+    {
+        ss << "(instrument (staves 2)(musicData (clef G p1)(clef F4 p2)(key D)(time 4 4)";
+        for (int i=0; i < numMeasures; ++i)
+        {
+            ss << "(n c4 q v1 p1)(n +e4 q v1)(n g4 q v1)(n c5 q v1)"
+               << "(n c3 h v2 p2)(n g3 h v2 p2)(barline)";
+        }
+        ss << "))";
+    }
+    ss << ")";
+    return ss.str();
+}
+
+//---------------------------------------------------------------------------------------
+void run_benchmark(LibraryScope& libraryScope, int numMeasures)
+{
+    Document doc(libraryScope);
+    doc.from_string( create_score(numMeasures) );
+    ImoScore* pScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+
+    //edit: change the pitch of a note in the middle of the second instrument
+    int measure = numMeasures / 2;
+    ImoMusicData* pMD = pScore->get_instrument(1)->get_musicdata();
+    ImoNote* pNote = static_cast<ImoNote*>( pMD->get_child(4 + 7 * measure) );
+    pNote->set_notated_pitch(k_step_E, k_octave_4, k_no_accidentals);
+
+    const int numReps = 5;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i=0; i < numReps; ++i)
+        pScore->end_of_changes();
+    chrono::duration<double, milli> timeFull = chrono::steady_clock::now() - start;
+
+    start = chrono::steady_clock::now();
+    for (int i=0; i < numReps; ++i)
+        pScore->end_of_changes(1, measure, measure);
+    chrono::duration<double, milli> timeScoped = chrono::steady_clock::now() - start;
+
+    cout << setw(10) << numMeasures
+         << setw(10) << pScore->get_staffobjs_table()->num_entries()
+         << setw(14) << fixed << setprecision(3) << timeFull.count() / numReps
+         << setw(14) << timeScoped.count() / numReps << endl;
+}
+
+//---------------------------------------------------------------------------------------
+int main()
+{
+    LibraryScope libraryScope(cout);
+
+    cout << "Times in ms" << endl;
+    cout << "  measures   entries          full        scoped" << endl;
+
+    int sizes[] = { 50, 200, 1000, 2000 };
+    for (int numMeasures : sizes)
+        run_benchmark(libraryScope, numMeasures);
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+// vertical-profile-benchmark.cpp
+//
+// Benchmark for the VerticalProfile: time for adding the shapes of dense piano
+// (2 staves) and orchestral (24 staves) systems to the profile, and for placing
+// auxiliary notations (queries followed by an update, as engravers do).
+// Feel free to use this example code in any way you see fit (Public Domain)
+//
+// Usage:
+// - build:
+//      g++ -std=c++11 -O2 vertical-profile-benchmark.cpp -o vertical-profile-benchmark \
+//        `pkg-config --cflags liblomse` `pkg-config --libs liblomse` -lstdc++
+// - run:
+//      ./vertical-profile-benchmark
+//
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+using namespace std;
+
+#include <lomse_vertical_profile.h>
+#include <lomse_shapes.h>
+using namespace lomse;
+
+//---------------------------------------------------------------------------------------
+// Creates the shapes for a system with numStaves staves and numNotes noteheads,
+// stems and accidentals per staff
+void create_shapes(int numStaves, int numNotes, LUnits xStart, LUnits xEnd,
+                   vector< vector<GmoShapeRectangle*> >& shapes)
+{
+    shapes.resize(numStaves);
+    LUnits space = (xEnd - xStart - 1000.0f) / LUnits(numNotes);
+    for (int iStaff=0; iStaff < numStaves; ++iStaff)
+    {
+        LUnits yStaff = 2000.0f + 2000.0f * LUnits(iStaff);
+        for (int i=0; i < numNotes; ++i)
+        {
+            LUnits x = xStart + 500.0f + space * LUnits(i);
+            LUnits y = yStaff + LUnits((i * 7 + iStaff * 3) % 19) * 50.0f - 400.0f;
+
+            //notehead
+            GmoShapeRectangle* pShape = new GmoShapeRectangle(nullptr);
+            pShape->set_origin(x, y);
+            pShape->set_width(space * 0.4f);
+            pShape->set_height(180.0f);
+            shapes[iStaff].push_back(pShape);
+
+            //stem
+            pShape = new GmoShapeRectangle(nullptr);
+            pShape->set_origin(x + space * 0.4f, y - 700.0f);
+            pShape->set_width(12.0f);
+            pShape->set_height(700.0f);
+            shapes[iStaff].push_back(pShape);
+
+            //accidental, for some notes
+            if (i % 3 == 0)
+            {
+                pShape = new GmoShapeRectangle(nullptr);
+                pShape->set_origin(x - space * 0.3f, y - 100.0f);
+                pShape->set_width(space * 0.25f);
+                pShape->set_height(380.0f);
+                shapes[iStaff].push_back(pShape);
+            }
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void delete_shapes(vector< vector<GmoShapeRectangle*> >& shapes)
+{
+    for (auto& row : shapes)
+        for (GmoShapeRectangle* pShape : row)
+            delete pShape;
+    shapes.clear();
+}
+
+//---------------------------------------------------------------------------------------
+void run_benchmark(const string& name, int numStaves, int numNotes)
+{
+    LUnits xStart = 1500.0f;
+    LUnits xEnd = 19500.0f;
+    vector< vector<GmoShapeRectangle*> > shapes;
+    create_shapes(numStaves, numNotes, xStart, xEnd, shapes);
+
+    VerticalProfile vp(xStart, xEnd, numStaves);
+    for (int iStaff=0; iStaff < numStaves; ++iStaff)
+        vp.initialize(iStaff, 2000.0f * LUnits(iStaff + 1),
+                      2000.0f * LUnits(iStaff + 1) + 400.0f);
+
+    //add notes
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int iStaff=0; iStaff < numStaves; ++iStaff)
+        for (GmoShapeRectangle* pShape : shapes[iStaff])
+            vp.update(pShape, iStaff);
+    chrono::duration<double, milli> timeNotes = chrono::steady_clock::now() - start;
+
+    //place aux notations (dynamics, slurs, lyrics): query and then add the shape
+    vector<GmoShapeRectangle*> auxShapes;
+    LUnits space = (xEnd - xStart - 1000.0f) / LUnits(numNotes);
+    start = chrono::steady_clock::now();
+    for (int iStaff=0; iStaff < numStaves; ++iStaff)
+    {
+        for (int i=0; i < numNotes; ++i)
+        {
+            LUnits xLeft = xStart + 500.0f + space * LUnits(i);
+            LUnits xRight = min(xLeft + space * LUnits(1 + i % 8), xEnd);
+            LUnits y = vp.get_max_for(xLeft, xRight, iStaff).first + 200.0f;
+            GmoShapeRectangle* pShape = new GmoShapeRectangle(nullptr);
+            pShape->set_origin(xLeft, y);
+            pShape->set_width(xRight - xLeft);
+            pShape->set_height(300.0f);
+            vp.update(pShape, iStaff);
+            auxShapes.push_back(pShape);
+        }
+    }
+    chrono::duration<double, milli> timeAux = chrono::steady_clock::now() - start;
+
+    //staves distance
+    start = chrono::steady_clock::now();
+    LUnits distance = 0.0f;
+    for (int iStaff=1; iStaff < numStaves; ++iStaff)
+        distance += vp.get_staves_distance(iStaff);
+    chrono::duration<double, milli> timeDistance = chrono::steady_clock::now() - start;
+
+    cout << setw(12) << name << setw(8) << numStaves << setw(8) << numNotes
+         << setw(12) << fixed << setprecision(3) << timeNotes.count()
+         << setw(12) << timeAux.count() << setw(12) << timeDistance.count() << endl;
+
+    for (GmoShapeRectangle* pShape : auxShapes)
+        delete pShape;
+    delete_shapes(shapes);
+}
+
+//---------------------------------------------------------------------------------------
+int main()
+{
+    cout << "      system  staves   notes  notes (ms)    aux (ms)   dist (ms)" << endl;
+
+    int sizes[] = { 50, 200, 1000, 4000 };
+    for (int numNotes : sizes)
+        run_benchmark("piano", 2, numNotes);
+    for (int numNotes : sizes)
+        run_benchmark("orchestral", 24, numNotes);
+
+    return 0;
+}
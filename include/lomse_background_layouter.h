@@ -0,0 +1,90 @@
+//---------------------------------------------------------------------------------------
+// This file is part of the Lomse library.
+// Copyright (c) 2010-present, Lomse Developers
+//
+// Licensed under the MIT license.
+//
+// See LICENSE and NOTICE.md files in the root directory of this source tree.
+//---------------------------------------------------------------------------------------
+
+#ifndef __LOMSE_BACKGROUND_LAYOUTER_H__        //to avoid nested includes
+#define __LOMSE_BACKGROUND_LAYOUTER_H__
+
+#include "lomse_build_options.h"
+
+#if (LOMSE_ENABLE_THREADS == 1)
+
+#include "lomse_events.h"
+
+#include <thread>
+#include <atomic>
+#include <memory>
+
+
+namespace lomse
+{
+
+//forward declarations
+class GraphicModel;
+class Interactor;
+
+
+//---------------------------------------------------------------------------------------
+// BackgroundLayouter: lays out, in a worker thread, the pending pages of a graphic
+//  model with a suspended layout (see GraphicModel::set_pending_layout()).
+//
+//  Pages are created one by one. After each page, an EventPagesAvailable event is
+//  sent to the observers of the Interactor, so that the new page can be displayed.
+//  The graphic model serializes the access to its pages: while a page is being
+//  created, the GUI thread waits for accessing or drawing pages.
+//
+//  Cancellation is cooperative: the worker thread stops after finishing the page
+//  being laid out. The graphic model is then left as a lazy model.
+//
+//  An EventPagesAvailable handler, executed in the worker thread, can delete the
+//  graphic model and, thus, this layouter. In that case the thread is detached and
+//  it finishes without accessing the layouter nor the graphic model. The state that
+//  the thread reads after notifying the observers is shared with it.
+class BackgroundLayouter
+{
+protected:
+    struct ThreadState
+    {
+        std::atomic<std::thread::id> workerId;
+        std::atomic<bool> fCancel;
+        std::atomic<bool> fRunning;
+
+        ThreadState() : workerId(std::thread::id()), fCancel(false), fRunning(false) {}
+    };
+    typedef std::shared_ptr<ThreadState> SpThreadState;
+
+    GraphicModel* m_pGModel;        //not owned
+    Interactor* m_pInteractor;      //not owned. For notifying events
+    WpInteractor m_wpInteractor;
+    std::thread* m_pThread;
+    SpThreadState m_pState;
+
+public:
+    BackgroundLayouter(GraphicModel* pGModel, Interactor* pInteractor);
+    ~BackgroundLayouter();
+
+    void start();
+    void cancel();
+    void wait();
+
+    //information
+    inline bool is_running() { return m_pState->fRunning; }
+    bool is_worker_thread();
+
+protected:
+    void thread_main(SpThreadState pState);
+    void notify_pages_available(bool fFinished);
+    void join();
+};
+
+
+}   //namespace lomse
+
+#endif   //LOMSE_ENABLE_THREADS == 1
+
+#endif    // __LOMSE_BACKGROUND_LAYOUTER_H__
@@ -50,6 +50,7 @@ private:
 //    TextMeter*      m_pTextMeter;
     Calligrapher*   m_pCalligrapher;
     int             m_numPaths;
+    bool            m_fDefaultAttr;     //next path starts with default attributes
     RenderingBuffer m_rbuf;
     unsigned char*  m_pBuf;         //the memory for the bitmap. Owned by user app.
     unsigned        m_bufWidth;
@@ -153,6 +154,7 @@ public:
     void stroke(Color color) override;
     void stroke_none() override;
     void stroke_width(double w) override;
+    void reset_path_attributes() override { m_fDefaultAttr = true; }
     void gradient_color(Color c1, Color c2, double start, double stop) override;
     void gradient_color(Color c1, double start, double stop) override;
     void fill_linear_gradient(LUnits x1, LUnits y1, LUnits x2, LUnits y2) override;
@@ -243,6 +245,9 @@ public:
     unsigned get_rendering_buffer_width() const { return m_bufWidth; };
     unsigned get_rendering_buffer_height() const { return m_bufHeight; };
 
+    //The view area, as RenderingBuffer
+    RenderingBuffer& get_view_area_buffer() { return m_rbuf; };
+
 
 protected:
     void push_attr();
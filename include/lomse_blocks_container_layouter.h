@@ -42,6 +42,7 @@ class ContentLayouter : public Layouter
 {
 protected:
     ImoContent* m_pContent;
+    ImoContentObj* m_pSuspendedItem;    //lazy layout: item whose layout is suspended
 
 public:
     ContentLayouter(ImoContentObj* pItem, Layouter* pParent,
@@ -53,6 +54,13 @@ public:
     void layout_in_box() override;
     void create_main_box(GmoBox* pParentBox, UPoint pos, LUnits width, LUnits height) override;
 
+    //for lazy layout: only scores in main content can be suspended
+    bool must_suspend_layout() override;
+    void resume_layout();
+
+protected:
+    void layout_items_from(TreeNode<ImoObj>::children_iterator it);
+
 };
 
 //----------------------------------------------------------------------------------
@@ -20,6 +20,7 @@
 
 #include <sstream>
 #include <list>
+#include <vector>
 
 ///@cond INTERNALS
 namespace lomse
@@ -27,10 +28,13 @@ namespace lomse
 ///@endcond
 
 //forward declarations
+class ColStaffObjs;
 class Document;
 class SelectionSet;
 class DocCommandExecuter;
 class OverlappedNoteRest;
+class DocModel;
+class ScoreCheckpoint;
 
 //---------------------------------------------------------------------------------------
 //edition modes
@@ -100,7 +104,9 @@ public:
     /// This enum describes the available undo policies for commands
     enum ECmdUndoPolicy {
         k_undo_policy_full_checkpoint=0,    ///< Undo based on a full checkpoint
-        k_undo_policy_partial_checkpoint,   ///< Undo based on a partial checkpoint
+        k_undo_policy_partial_checkpoint,   ///< Undo based on a partial checkpoint. The
+                                            ///< command only modifies the music data of
+                                            ///< the instrument pointed by the cursor
         k_undo_policy_specific,             ///< Undo implemented by the command
         k_undo_policy_replay_from_start,    ///< Undo based on replaying commands
     };
@@ -264,18 +270,16 @@ public:
     DocCommand*         pCmd;           ///< ptr. to executed command object.
     DocCursorState      cursorState;    ///< Cursor state before executing the command.
     SelectionState      selState;       ///< SelectionSet before executing the command.
+    ScoreCheckpoint*    pCheckpoint;    ///< Copy of the data to modify, or nullptr.
 
 public:
     /// Constructor
     UndoElement(DocCommand* cmd, DocCursorState state, SelectionState sel)
-        : pCmd(cmd), cursorState(state), selState(sel)
+        : pCmd(cmd), cursorState(state), selState(sel), pCheckpoint(nullptr)
     {
     }
     ///destructor
-    ~UndoElement()
-    {
-        delete pCmd;
-    }
+    ~UndoElement();
 };
 
 
@@ -297,6 +301,18 @@ private:
     UndoStack   m_stack;                    //stack of executed commands
     std::string m_error;
 
+    //full checkpoints: copies of the document taken every m_checkpointInterval
+    //commands. Undo restores the nearest one and only replays the commands after it
+    struct Checkpoint
+    {
+        size_t      numCmds;                //commands in the stack when copied
+        DocModel*   pModel;
+    };
+    std::vector<Checkpoint> m_checkpoints;
+    size_t      m_checkpointInterval = 20;
+    size_t      m_maxCheckpoints = 10;
+    size_t      m_maxScoreCheckpoints = 16; //only the last commands keep a score copy
+
 public:
     /// Constructor
     DocCommandExecuter(Document* target);
@@ -334,6 +350,23 @@ public:
     /// Returns the number of undo/redo elements in the undo/redo stack.
     virtual size_t undo_stack_size() { return m_stack.size(); }
 
+    //undo checkpoints
+    /** Sets the number of commands between full copies of the document (checkpoints).
+        Undo restores the nearest checkpoint and only re-executes the commands after it.
+        Value 0 disables checkpoints, so that undo replays all commands from the start.
+        Default value is 20. */
+    void set_checkpoint_interval(size_t numCmds) { m_checkpointInterval = numCmds; }
+    /** Sets the maximum number of full checkpoints to keep. When exceeded, the oldest
+        checkpoint is discarded. Default value is 10. */
+    void set_max_checkpoints(size_t maxCheckpoints);
+    /** Commands with policy k_undo_policy_partial_checkpoint save a copy of the
+        music data they modify before executing, so that undo just restores the copy.
+        This method sets how many commands, at the top of the undo stack, keep their
+        copy. Value 0 disables partial checkpoints. Default value is 16. */
+    void set_max_score_checkpoints(size_t maxCheckpoints);
+    /// Returns the number of full checkpoints currently saved.
+    inline size_t get_num_checkpoints() { return m_checkpoints.size(); }
+
 protected:
     friend class DocCmdComposite;
     void update_cursor(DocCursor* pCursor, DocCommand* pCmd);
@@ -342,6 +375,11 @@ protected:
     void replay_until(UndoElement* pUE, DocCursor* pCursor, SelectionSet* pSelection);
     void replay_command(UndoElement* pUE, DocCursor* pCursor, SelectionSet* pSelection);
 
+    void save_score_checkpoint(UndoElement* pUE, DocCursor* pCursor);
+    void trim_score_checkpoints();
+    void save_checkpoint_if_needed();
+    void discard_invalid_checkpoints();
+
 };
 
 //---------------------------------------------------------------------------------------
@@ -421,6 +459,8 @@ public:
 protected:
     void update_selection(SelectionSet* pSelection) override;
     void log_command(ostream &logger) override;
+    bool update_staffobjs_table(ImoScore* pScore, ImoNote* pBaseNote,
+                                ImoNote* pNewNote);
 
 };
 
@@ -489,7 +529,7 @@ public:
     virtual ~CmdAddNoteRest() {};
 
     int get_cursor_update_policy() override { return k_refresh; }
-    int get_undo_policy() override { return k_undo_policy_replay_from_start; }
+    int get_undo_policy() override { return k_undo_policy_partial_checkpoint; }
     int get_selection_update_policy() override { return k_sel_command_specific; }
 
     ///@cond INTERNALS
@@ -528,6 +568,7 @@ protected:
     void update_selection(SelectionSet* pSelection) override;
     void clear_temporary_objects();
     void add_go_fwd_if_needed();
+    bool replace_overlapped_noterest();
 
     //overrides and mandatory virtual methods
     void set_command_name();
@@ -703,7 +744,7 @@ public:
     virtual ~CmdBreakBeam() {};
 
     int get_cursor_update_policy() override { return k_do_nothing; }
-    int get_undo_policy() override { return k_undo_policy_replay_from_start; }
+    int get_undo_policy() override { return k_undo_policy_partial_checkpoint; }
     int get_selection_update_policy() override { return k_sel_do_nothing; }
 
     ///@cond INTERNALS
@@ -1531,13 +1572,16 @@ public:
     virtual ~CmdDeleteStaffObj() {};
 
     int get_cursor_update_policy() override { return k_update_after_deletion; }
-    int get_undo_policy() override { return k_undo_policy_replay_from_start; }
+    int get_undo_policy() override { return k_undo_policy_partial_checkpoint; }
     int get_selection_update_policy() override { return k_sel_do_nothing; }
 
     ///@cond INTERNALS
     int set_target(Document* pDoc, DocCursor* pCursor, SelectionSet* pSelection) override;
     int perform_action(Document* pDoc, DocCursor* pCursor) override;
     ///@endcond
+
+protected:
+    bool is_removable_from_table(ColStaffObjs* pTable, ImoStaffObj* pImo);
 };
 
 //---------------------------------------------------------------------------------------
@@ -1686,7 +1730,7 @@ public:
     virtual ~CmdInsertManyStaffObjs() {};
 
     int get_cursor_update_policy() override { return k_refresh; }
-    int get_undo_policy() override { return k_undo_policy_replay_from_start; }
+    int get_undo_policy() override { return k_undo_policy_partial_checkpoint; }
     int get_selection_update_policy() override { return k_sel_do_nothing; }
 
     ///@cond INTERNALS
@@ -1747,7 +1791,7 @@ public:
     virtual ~CmdInsertStaffObj() {};
 
     int get_cursor_update_policy() override { return k_refresh; }
-    int get_undo_policy() override { return k_undo_policy_replay_from_start; }
+    int get_undo_policy() override { return k_undo_policy_partial_checkpoint; }
     int get_selection_update_policy() override { return k_sel_do_nothing; }
 
     ///@cond INTERNALS
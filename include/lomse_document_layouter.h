@@ -41,6 +41,11 @@ protected:
     //for unit tests: need to access ScoreLayouter.
     Layouter* m_pScoreLayouter;
 
+    //for lazy layout
+    int m_pageLimit;            //max number of pages to create. 0 for no limit
+    bool m_fSuspended;          //layout suspended: more pages pending
+    bool m_fKeepModel;          //graphic model already delivered: do not replace it
+
 public:
     DocLayouter(Document* pDoc, LibraryScope& libraryScope, int constrains=0,
                 LUnits width=0.0f);
@@ -49,6 +54,14 @@ public:
     void layout_document();
     void layout_empty_document();
 
+    //lazy layout
+    bool layout_first_pages(int numPages);
+    bool layout_more_pages(int iPage);
+    inline bool is_layout_suspended() { return m_fSuspended; }
+    int get_estimated_num_pages();
+    float get_layout_progress();
+    bool must_suspend_layout() override;
+
     //implementation of virtual methods in Layouter base class
     void layout_in_box() override {}
     void create_main_box(GmoBox* UNUSED(pParentBox), UPoint UNUSED(pos),
@@ -63,6 +76,7 @@ protected:
     int layout_content();
     void fix_document_size();
     void delete_last_trial();
+    void discard_suspended_layout();
 
     GmoBoxDocPage* create_document_page();
     void assign_paper_size_to(GmoBox* pBox);
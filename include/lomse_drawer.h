@@ -113,6 +113,14 @@ struct RenderOptions
     bool read_only_mode;
     int highlighted_voice;          //0 for none
 
+    //culling: boxes and shapes not intersecting the clip rectangle are not drawn
+    bool clip_flag;
+    URect clip_rect;                //visible area, in page coordinates
+
+    //statistics: boxes and shapes drawn and skipped since last counters reset
+    int num_drawn;
+    int num_culled;
+
 
     RenderOptions()
         : draw_anchor_objects(false)
@@ -138,6 +146,10 @@ struct RenderOptions
         , draw_voices_coloured(false)
         , read_only_mode(true)
         , highlighted_voice(0)                  //0=none, 1..n= voice 1..n
+        , clip_flag(false)
+        , clip_rect(0.0f, 0.0f, 0.0f, 0.0f)
+        , num_drawn(0)
+        , num_culled(0)
     {
         boxes.reset();
 
@@ -168,6 +180,35 @@ struct RenderOptions
         return boxes[type];
     }
 
+    void set_clip_rect(const URect& rect)
+    {
+        clip_rect = rect;
+        clip_flag = true;
+    }
+
+    void remove_clip_rect()
+    {
+        clip_flag = false;
+    }
+
+    void reset_draw_counters()
+    {
+        num_drawn = 0;
+        num_culled = 0;
+    }
+
+    //returns true if an object with the given bounds is visible and must be drawn.
+    //Objects of zero width or height (i.e. lines) are not culled when on the
+    //clip rectangle border.
+    bool is_visible(const URect& bounds) const
+    {
+        return !clip_flag
+               || (bounds.left() <= clip_rect.right()
+                   && bounds.right() >= clip_rect.left()
+                   && bounds.top() <= clip_rect.bottom()
+                   && bounds.bottom() >= clip_rect.top());
+    }
+
 
 };
 
@@ -504,6 +545,14 @@ public:
         line to stroke current open path. */
     virtual void stroke_width(double w) = 0;
 
+    /** Discard the attributes defined for previous paths, so that next path starts
+        with default attributes (black fill, no stroke, stroke width 1.0) instead
+        of inheriting the attributes of the previous path. Lomse invokes this
+        method before drawing each shape, so that the rendering of a shape does
+        not depend on the shapes drawn before it. The default implementation does
+        nothing, for drawers that do not inherit attributes between paths.  */
+    virtual void reset_path_attributes() {}
+
     /** Define a linear gradient that can be used in current open path.  */
     virtual void gradient_color(Color c1, Color c2, double start, double stop) = 0;
 
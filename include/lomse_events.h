@@ -96,6 +96,8 @@ enum EEventType
         //EventEndOfPlayback
         k_end_of_playback_event,        ///< Playback ended.
 
+    //EventPagesAvailable
+        k_pages_available_event,        ///< Background layout: new pages laid out
 
 };
 
@@ -141,6 +143,7 @@ public:
     inline bool is_tracking_event() { return m_type == k_tracking_event; }
     inline bool is_update_viewport_event() { return m_type == k_update_viewport_event; }
     inline bool is_end_of_playback_event() { return m_type == k_end_of_playback_event; }
+    inline bool is_pages_available_event() { return m_type == k_pages_available_event; }
     //@}
 
 protected:
@@ -305,6 +308,74 @@ public:
 typedef std::shared_ptr<EventPaint>  SpEventPaint;
 
 
+//---------------------------------------------------------------------------------------
+// EventPagesAvailable
+/** An event to inform user application about the progress of a background layout
+    (see Interactor::enable_background_layout()). It is generated each time a new
+    page has been laid out and, therefore, it can be displayed.
+
+    The event is generated in the layout thread. As the pages not yet laid out are
+    displayed as blank pages, your application should just schedule a repaint
+    of the view, e.g. by invoking Interactor::force_redraw() from the GUI thread.
+
+    AWARE: When Lomse is built without the events thread (the default, see build
+    option LOMSE_ENABLE_EVENTS_THREAD), your handler is executed in the layout
+    thread, not in the GUI thread, and the layout of next page is not started until
+    the handler returns. Therefore, the handler must return quickly, must not
+    access GUI objects that are not thread safe, and must not wait for the GUI
+    thread when the GUI thread could be waiting for the layout (e.g. in
+    GraphicModel::get_num_pages()), as this would cause a deadlock.
+
+    For receiving these events you will have to register a handler at the
+    Interactor:
+    @code
+    spInteractor->add_event_handler(k_pages_available_event, this, wrapper_on_pages);
+    @endcode
+*/
+class EventPagesAvailable : public EventInfo
+{
+protected:
+    WpInteractor m_wpInteractor;
+    int m_numPages;
+    float m_progress;
+    bool m_fFinished;
+
+public:
+    /// Constructor
+    EventPagesAvailable(WpInteractor wpInteractor, int numPages, float progress,
+                        bool fFinished)
+        : EventInfo(k_pages_available_event)
+        , m_wpInteractor(wpInteractor)
+        , m_numPages(numPages)
+        , m_progress(progress)
+        , m_fFinished(fFinished)
+    {
+    }
+    /// Destructor
+    virtual ~EventPagesAvailable() {}
+
+    /** Returns a weak pointer to the Interactor object managing the
+        View in which the event is generated. */
+    inline WpInteractor get_interactor() { return m_wpInteractor; }
+
+    /** Returns the number of pages already laid out. */
+    inline int get_num_pages() { return m_numPages; }
+
+    /** Returns the fraction (0.0 to 1.0) of the document already laid out. */
+    inline float get_progress() { return m_progress; }
+
+    /** Returns @true when the layout is finished, that is, when all pages are
+        available. */
+    inline bool is_layout_finished() { return m_fFinished; }
+};
+
+/** A shared pointer for an EventPagesAvailable.
+    @ingroup typedefs
+    @#include <lomse_events.h>
+*/
+typedef std::shared_ptr<EventPagesAvailable>  SpEventPagesAvailable;
+
+
 //---------------------------------------------------------------------------------------
 /** Base class for all events representing a user mouse action that
     has been interpreted by Lomse as a command to change the Document or the GUI.
@@ -1117,6 +1188,17 @@ public:
         m_items.push_back( make_pair(k_move_tempo_line, -1) );
         m_timepos = timepos;
     }
+    //append the sub-events of a later event for the same score
+    void append_items(EventVisualTracking* pEvent)
+    {
+        std::list< pair<int, ImoId> >::const_iterator it;
+        for (it = pEvent->m_items.begin(); it != pEvent->m_items.end(); ++it)
+        {
+            m_items.push_back(*it);
+            if (it->first == k_move_tempo_line)
+                m_timepos = pEvent->m_timepos;
+        }
+    }
 ///@endcond
 };
 
@@ -14,11 +14,42 @@
 #include "lomse_injectors.h"
 #include "lomse_events.h"
 
-//TODO: For now, direct invocation without enqueuing the event in the thread.
-#define LOMSE_DIRECT_INVOCATION     1       //1=do not use events thread
+//By default, direct invocation without enqueuing the event in the thread. The events
+//thread is enabled with build option LOMSE_ENABLE_EVENTS_THREAD
+#ifndef LOMSE_DIRECT_INVOCATION
+    #if (LOMSE_ENABLE_EVENTS_THREAD == 1)
+        #define LOMSE_DIRECT_INVOCATION     0
+    #else
+        #define LOMSE_DIRECT_INVOCATION     1       //1=do not use events thread
+    #endif
+#endif
+
+//the events thread requires threads support
+#if (LOMSE_ENABLE_THREADS == 0)
+    #undef LOMSE_DIRECT_INVOCATION
+    #define LOMSE_DIRECT_INVOCATION     1
+#endif
+
+
+namespace lomse
+{
+
+//---------------------------------------------------------------------------------------
+// Policies for merging pending events before dispatching them
+enum ECoalescingPolicy
+{
+    k_coalesce_none = 0,        //dispatch all events (default)
+    k_coalesce_ui_updates,      //for the same observer, keep only the newest pending
+                                //viewport and update-UI event, and merge the pending
+                                //tracking events into one
+};
+
+}   //namespace lomse
 
 
 #if (LOMSE_DIRECT_INVOCATION == 1)
+#include <atomic>
+
 namespace lomse
 {
 
@@ -28,22 +59,42 @@ namespace lomse
 //  This class is a singleton maintained in Lomse LibraryScope object
 class EventsDispatcher
 {
+protected:
+    //events are posted from several threads (playback, layout and user application)
+    std::atomic<long> m_numDispatched;
+
 public:
-    EventsDispatcher() {}
+    EventsDispatcher() : m_numDispatched(0L) {}
 
     inline void start_events_loop() {}
     inline void stop_events_loop() {}
 
     inline void post_event(Observer* pObserver, SpEventInfo pEvent)
     {
+        ++m_numDispatched;
         pObserver->notify(pEvent);
     }
+
+    //options. Events are never queued in direct invocation mode
+    inline void set_coalescing_policy(int UNUSED(policy)) {}
+    inline int get_coalescing_policy() { return k_coalesce_none; }
+
+    //statistics. Latencies are in microseconds
+    inline size_t get_queue_depth() { return 0; }
+    inline size_t get_max_queue_depth() { return 0; }
+    inline long get_num_dispatched() { return m_numDispatched; }
+    inline long get_num_coalesced() { return 0L; }
+    inline double get_mean_latency() { return 0.0; }
+    inline double get_max_latency() { return 0.0; }
+    inline void reset_statistics() { m_numDispatched = 0L; }
 };
 
 #else
 #include <thread>
 #include <mutex>
-#include <queue>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
 
 namespace lomse
 {
@@ -55,36 +106,75 @@ namespace lomse
 typedef std::thread EventsThread;
 typedef std::mutex QueueMutex;
 typedef std::unique_lock<std::mutex> QueueLock;
+typedef std::chrono::steady_clock::time_point EventsTimePoint;
 
+//---------------------------------------------------------------------------------------
+// An event waiting in the dispatcher queue
+struct QueuedEvent
+{
+    SpEventInfo pEvent;
+    Observer* pObserver;
+    EventsTimePoint posted;     //when the event was first enqueued
+
+    QueuedEvent(SpEventInfo event, Observer* observer, EventsTimePoint time)
+        : pEvent(event), pObserver(observer), posted(time)
+    {
+    }
+};
 
 
 //=======================================================================================
 // EventsDispatcher
 //  Class to manage the event-dispatch loop.
 //  This class is a singleton maintained in Lomse LibraryScope object
+//
+//  The events thread blocks on a condition variable while the queue is empty. It is
+//  woken up by post_event() and then dispatches, in one batch, all pending events.
 class EventsDispatcher
 {
 protected:
     EventsThread* m_pThread = nullptr;        //execution thread
-    QueueMutex m_mutex;             //to control queue access
-    bool m_fStopLoop = false;
-    std::queue< std::pair<SpEventInfo, Observer*> > m_events;
+    QueueMutex m_mutex;             //to control queue and statistics access
+    std::condition_variable m_wakeUp;
+    bool m_fStopLoop = false;       //protected by m_mutex
+    std::deque<QueuedEvent> m_events;
+    int m_coalescing = k_coalesce_none;
+
+    //statistics
+    size_t m_maxQueueDepth = 0;
+    long m_numDispatched = 0L;
+    long m_numCoalesced = 0L;
+    double m_totalLatency = 0.0;    //microseconds
+    double m_maxLatency = 0.0;      //microseconds
 
 public:
     EventsDispatcher() {}
-;
+    ~EventsDispatcher();
 
     void start_events_loop();
     void stop_events_loop();
 
     void post_event(Observer* pObserver, SpEventInfo pEvent);
 
+    //options
+    void set_coalescing_policy(int policy);
+    int get_coalescing_policy();
+
+    //statistics. Latencies (time from posting to dispatch) are in microseconds
+    size_t get_queue_depth();
+    size_t get_max_queue_depth();
+    long get_num_dispatched();
+    long get_num_coalesced();
+    double get_mean_latency();
+    double get_max_latency();
+    void reset_statistics();
+
 protected:
-    inline bool stop_event_received() { return m_fStopLoop; }
     void run_events_loop();
     void thread_main();
-    inline bool pending_events() { return !m_events.empty(); }
-    void dispatch_next_event();
+    void dispatch_events(std::deque<QueuedEvent>& events);
+    bool coalesce_event(Observer* pObserver, SpEventInfo pEvent);
+    bool is_coalescable(SpEventInfo pEvent);
 
 };
 #endif
@@ -12,11 +12,16 @@
 
 #include "lomse_basic.h"
 
+#include <atomic>
+#include <mutex>
+#include <vector>
+
 namespace lomse
 {
 
 //forward declarations
 class LibraryScope;
+class FontStorage;
 
 
 //---------------------------------------------------------------------------------------
@@ -892,6 +897,40 @@ enum EGlyphIndex
 
 };
 
+//---------------------------------------------------------------------------------------
+// GlyphMetrics: the metrics of a music glyph for a font size, in logical units and
+// relative to the glyph origin (left side of the baseline)
+struct GlyphMetrics
+{
+    URect bounds;       //bounding box
+    LUnits advance;     //horizontal advance
+
+    GlyphMetrics() : advance(0.0f) {}
+};
+
+//---------------------------------------------------------------------------------------
+// GlyphMetricsTable: the metrics of all music glyphs for a font size. Entries are
+// computed on first use and never modified after being marked as valid, so valid
+// entries can be read without locks.
+struct GlyphMetricsTable
+{
+    struct Entry
+    {
+        GlyphMetrics metrics;
+        std::atomic<bool> fValid;
+
+        Entry() : fValid(false) {}
+    };
+
+    double fontHeight;
+    double scale;
+    Entry* entries;
+    GlyphMetricsTable* pNext;
+
+    GlyphMetricsTable(double height, double scaling, int numGlyphs);
+    ~GlyphMetricsTable();
+};
+
 //---------------------------------------------------------------------------------------
 // Encapsulate access to glyphs table. A singleton with library scope
 class MusicGlyphs
@@ -900,16 +939,32 @@ protected:
     LibraryScope* m_pLibScope;
     const GlyphData* m_glyphs;
 
+    //glyph metrics, for current music font
+    std::atomic<GlyphMetricsTable*> m_pMetrics;     //list of tables, one per font size
+    std::vector<GlyphMetricsTable*> m_allMetrics;   //owned. All tables in the list
+    FontStorage* m_pMeasurer;                       //only for measuring glyphs
+    std::mutex m_metricsMutex;
+
 public:
     MusicGlyphs(LibraryScope* pLibScope);
-    ~MusicGlyphs() {}
+    ~MusicGlyphs();
 
     void update();
 
+    //metrics. Thread safe; lock-free for already measured glyphs. The returned
+    //metrics are valid until the music font is changed
+    const GlyphMetrics& get_glyph_metrics(int iGlyph, double fontHeight);
+    static int num_glyphs();
+    int get_num_metrics_tables();
+
     inline unsigned int glyph_code(int iGlyph) { return (*(m_glyphs+iGlyph)).GlyphChar; }
     inline std::string glyph_name(int iGlyph) { return (*(m_glyphs+iGlyph)).GlyphName; }
     inline LUnits glyph_offset(int UNUSED(iGlyph)) { return 0.0f; }
     inline const GlyphData& get_glyph_data(int iGlyph) { return *(m_glyphs+iGlyph); }
+
+protected:
+    GlyphMetricsTable* find_metrics_table(double fontHeight, double scale);
+    const GlyphMetrics& measure_glyph(int iGlyph, double fontHeight, double scale);
 };
 
 
@@ -368,6 +368,7 @@ public:
 
 protected:
     void propagate_dirty();
+    void invalidate_page_index();
 
 };
 
@@ -504,6 +505,10 @@ protected:
     LUnits m_uLeftMargin;
     LUnits m_uRightMargin;
 
+    //bounds of the box, its shapes and its child boxes. Empty if not yet computed.
+    //Used for skipping invisible boxes when drawing.
+    URect m_contentBounds;
+
     GmoBox(int objtype, ImoObj* pCreatorImo);
     ~GmoBox() override;
 
@@ -564,6 +569,8 @@ public:
 
     //drawing
     virtual void on_draw(Drawer* pDrawer, RenderOptions& opt);
+    URect compute_content_bounds();
+    inline URect get_content_bounds() { return m_contentBounds; }
 
     //hit testing
     GmoBox* find_inner_box_at(LUnits x, LUnits y);
@@ -578,13 +585,14 @@ public:
     ///@endcond
 
 protected:
-    void delete_boxes();
+    void delete_boxes(int iFirst=0);
     void delete_shapes();
     void draw_border(Drawer* pDrawer, RenderOptions& opt);
     bool must_draw_bounds(RenderOptions& opt);
     Color get_box_color();
     virtual void draw_box_bounds(Drawer* pDrawer, double xorg, double yorg, Color& color);
     void draw_shapes(Drawer* pDrawer, RenderOptions& opt);
+    bool is_culled(RenderOptions& opt);
     void add_shapes_to_tables_in(GmoBoxDocPage* pPage);
 
     friend class StaffObjShapeCursor;
@@ -649,6 +657,7 @@ public:
     //doc pages
     GmoBoxDocPage* add_new_page();
     GmoBoxDocPage* get_page(int i);     //i = 0..n-1
+    void delete_pages_from(int iPage);
     inline int get_num_pages() { return get_num_boxes(); }
     inline GmoBoxDocPage* get_last_page() { return m_pLastPage; }
     int get_page_number(GmoBoxDocPage* pBoxPage);
@@ -670,7 +679,25 @@ class GmoBoxDocPage : public GmoBox
 {
 protected:
     int m_numPage;      //1..n
-    std::list<GmoShape*> m_allShapes;		//contained shapes, ordered by layer and creation order
+    std::map<int, std::vector<GmoShape*> > m_layers;   //contained shapes, by layer and
+                                                        //creation order
+    std::vector<GmoShape*> m_allShapes;     //contained shapes, ordered by layer and
+                                            //creation order. Built with spatial index
+
+    //spatial index: uniform grid over the bounds of all shapes. Shapes in each cell
+    //are stored as indexes to m_allShapes, in increasing order (packed in a single
+    //vector: shapes in cell i are in range [m_cellStart[i], m_cellStart[i+1]) )
+    bool m_fIndexValid;
+    int m_gridCols;
+    int m_gridRows;
+    LUnits m_gridLeft;
+    LUnits m_gridTop;
+    LUnits m_gridRight;
+    LUnits m_gridBottom;
+    LUnits m_cellWidth;
+    LUnits m_cellHeight;
+    std::vector<int> m_cellStart;
+    std::vector<int> m_cellShapes;
 
 public:
     ///@cond INTERNALS
@@ -700,10 +727,20 @@ public:
     void select_objects_in_rectangle(SelectionSet* selection, const URect& selRect,
                                      unsigned flags=0);
 
+    //spatial index for hit testing and selection. It is automatically rebuilt when
+    //required. Moving a shape or box (set_origin(), shift_origin()) or adding shapes
+    //to the tables invalidates it.
+    void build_spatial_index();
+    inline void invalidate_spatial_index() { m_fIndexValid = false; }
+    inline int get_num_shapes_in_page() { ensure_spatial_index(); return int(m_allShapes.size()); }
+
     ///@endcond
 
 protected:
     void draw_page_background(Drawer* pDrawer, RenderOptions& opt);
+    inline void ensure_spatial_index() { if (!m_fIndexValid) build_spatial_index(); }
+    void get_cells_range(const URect& rect, int* pCol1, int* pRow1, int* pCol2,
+                         int* pRow2);
 };
 
 //---------------------------------------------------------------------------------------
@@ -45,11 +45,13 @@ class Interactor;
 class MeasureHighlight;
 class OverlaysGenerator;
 class PlaybackHighlight;
+struct RasterTile;
 class SelectionHighlight;
 class SelectionRectangle;
 class SelectionSet;
 class SvgDrawer;
 class TempoLine;
+class TileCache;
 class TimeGrid;
 class VisualEffect;
 
@@ -152,6 +154,8 @@ protected:
     BitmapDrawer* m_pPrintDrawer;     //owned by GraphicView
     RenderOptions m_options;
     OverlaysGenerator* m_pOverlaysGenerator;
+    TileCache* m_pTileCache = nullptr;          //owned. nullptr when disabled
+    BitmapDrawer* m_pTileDrawer = nullptr;      //owned. For rendering tiles
 
     //renderization parameters
     double m_expand;
@@ -444,12 +448,31 @@ public:
     ///@{
 
     void render_as_svg(SvgDrawer& drawer, int page);
+    void render_as_svg(SvgDrawer& drawer, int page, const URect& region);
 
     void set_svg_canvas_width(Pixels x);
 
     ///@}    //Support for svg rendering
 
 
+    /// @name Raster cache for scrolling
+    ///@{
+    void enable_tile_cache(bool value, size_t maxMemory);
+    void invalidate_tile_cache();
+    void invalidate_tile_cache(int iPage, const URect& area);
+    inline TileCache* get_tile_cache() { return m_pTileCache; }
+
+    ///@}    //Raster cache
+
+
+    /// @name Statistics about last drawing of the graphic model
+    ///@{
+    inline int get_num_drawn_objects() { return m_options.num_drawn; }
+    inline int get_num_culled_objects() { return m_options.num_culled; }
+
+    ///@}    //Statistics
+
+
     //info
     AreaInfo* get_info_for_point(Pixels x, Pixels y);
 
@@ -465,6 +488,8 @@ protected:
     void draw_graphic_model();
     void draw_time_grid();
     void generate_paths();
+    void draw_graphic_model_using_tiles(BitmapDrawer* pDrawer);
+    void render_tile(RasterTile* pTile);
     virtual void collect_page_bounds() = 0;
     void draw_visible_pages(int minPage, int maxPage);
     URect get_page_bounds(int iPage);
@@ -14,6 +14,8 @@
 #include <list>
 #include <ostream>
 #include <map>
+#include <mutex>
+#include <atomic>
 using namespace std;
 
 #include "lomse_basic.h"
@@ -47,8 +49,11 @@ struct RenderOptions;
 class GmoLayer;
 class SelectionSet;
 class Control;
+class DocLayouter;
 class ScoreStub;
 class GmMeasuresTable;
+class BackgroundLayouter;
+class Interactor;
 
 
 //---------------------------------------------------------------------------------------
@@ -164,7 +169,8 @@ class GraphicModel
 protected:
     GmoBoxDocument* m_root;
     long m_modelId;
-    bool m_modified;
+    std::atomic<bool> m_modified;
+    std::atomic<long> m_numChanges;     //times the model has been marked as modified
     map<ImoId, GmoBox*> m_imoToBox;
     map<ImoId, GmoShape*> m_imoToMainShape;
     map< pair<ImoId, ShapeId>, GmoShape*> m_imoToSecondaryShape;
@@ -172,12 +178,22 @@ protected:
     map<ImoId, ScoreStub*> m_scores;
     AreaInfo m_areaInfo;
 
+    //lazy layout
+    DocLayouter* m_pLayouter;   //owned. Layouter for the pages not yet laid out
+    bool m_fLayingOut;          //creating pages. Avoid reentrant layout
+    bool m_fLazyLayout;         //the model was built by a lazy layout
+
+    //background layout
+    BackgroundLayouter* m_pBackground;  //owned. Thread creating the pending pages
+    std::recursive_mutex m_ownMutex;    //used when no shared mutex is provided
+    std::recursive_mutex& m_mutex;      //serializes pages creation and pages access
+
 public:
 
     ///@cond INTERNALS
     //excluded from public API. Only for internal use.
 
-    GraphicModel(ImoDocument* pCreator);
+    GraphicModel(ImoDocument* pCreator, std::recursive_mutex* pSharedMutex=nullptr);
     virtual ~GraphicModel();
 
     ///@endcond
@@ -189,10 +205,36 @@ public:
 
     /** Returns the number of pages of the rendered document. This value can also be
         obtained by invoking Interactor::get_num_pages().
+        When the document is laid out lazily (see Interactor::enable_lazy_layout()),
+        this method lays out all pending pages.
     */
     int get_num_pages();
 
+    /** Returns @false when the document is laid out lazily or in background and
+        some pages have not yet been created.
+    */
+    bool is_layout_finished();
+
+    /** Returns the number of pages already created. It is the real number of pages
+        when the layout is finished.
+    */
+    int get_num_laid_out_pages();
+
+    /** Returns an estimation of the number of pages of the rendered document,
+        without laying out the pending pages. It is the real number of pages when
+        the layout is finished.
+    */
+    int get_estimated_num_pages();
+
+    /** When the document is laid out lazily, this method lays out all pending pages.
+        When it is laid out in background, this method waits until all pages are
+        laid out.
+    */
+    void finish_layout();
+
     /** Returns the number of systems in the rendered score.
+        When the layout is not finished (see is_layout_finished()), only the systems
+        in the pages already laid out are counted.
         @param scoreId The Id of the score to which the request is referring.
     */
     int get_num_systems(ImoId scoreId);
@@ -206,6 +248,8 @@ public:
         manages the table with the graphical information about the measures in
         the score and provides information such as the number of measures in the
         score, or their coordinates.
+        When the layout is not finished (see is_layout_finished()), the table only
+        contains the measures in the pages already laid out.
         @param scoreId The Id of the score to which the request is referring.
     */
     GmMeasuresTable* get_measures_table(ImoId scoreId);
@@ -223,6 +267,9 @@ public:
     inline GmoBoxDocument* get_root() { return m_root; }
 
     /** Returns the GmoBoxDocPage for the given page number.
+        When the document is laid out lazily, pending pages up to page @c i are laid
+        out. When it is laid out in background, pending pages are not laid out.
+        Returns @nullptr if the page does not exist or it is not yet laid out.
         @param i The number of the page (0..n-1) for which the GmoBoxDocPage is requested.
     */
     GmoBoxDocPage* get_page(int i);
@@ -236,12 +283,19 @@ public:
         system. Therefore, this method will return the second system not the one
         containing the barline.
 
+        When the document is laid out lazily, pending pages are laid out until the
+        system is found. When it is laid out in background, only the pages already
+        laid out are searched.
+
         @param scoreId The Id of the score to which the request is referring.
         @param timepos The time position (absolute time units) for the requested system.
     */
     GmoBoxSystem* get_system_for(ImoId scoreId, TimeUnits timepos);
 
     /** Returns pointer to the GmoBoxSystem for the given system number.
+        As for get_system_for(), when the document is laid out lazily pending pages
+        are laid out until the system is found, and when it is laid out in
+        background only the pages already laid out are searched.
         @param iSystem The number of the system (0..n-1) for which the GmoBoxSystem is
             requested.
         @param scoreId The Id of the score to which the request is referring.
@@ -270,6 +324,9 @@ public:
 
     //access to shapes and boxes related to an ImoObj
     /// @name Access to shapes and boxes related to an ImoObj
+    /// When the document is laid out lazily, pending pages are laid out until the
+    /// requested object is found. When it is laid out in background, only the pages
+    /// already laid out are searched.
     //@{
 
     /** Returns pointer to the GmoShape generated by an ImoObj.
@@ -340,9 +397,14 @@ public:
     ///@cond INTERNALS
     //excluded from public API. Only for internal use.
 
-    inline void set_modified(bool value) { m_modified = value; }
+    inline void set_modified(bool value) {
+        m_modified = value;
+        if (value)
+            ++m_numChanges;
+    }
     inline bool is_modified() { return m_modified; }
     inline long get_model_id() { return m_modelId; }
+    inline long get_num_changes() { return m_numChanges; }
 
     //drawing
     void draw_page(int iPage, UPoint& origin, Drawer* pDrawer, RenderOptions& opt);
@@ -360,7 +422,20 @@ public:
     void store_in_map_imo_shape(ImoObj* pImo, GmoShape* pShape);
     void add_to_map_imo_to_box(GmoBox* child);
     void add_to_map_ref_to_box(GmoBox* pBox);
-    void build_main_boxes_table();
+    void build_main_boxes_table(int iFirstPage=0);
+
+    //lazy layout
+    void delete_pages_from(int iPage);
+    void set_pending_layout(DocLayouter* pLayouter);
+    void layout_up_to_page(int iPage);
+    URect get_page_bounds(int iPage);
+    float get_layout_progress();
+
+    //background layout
+    void start_background_layout(Interactor* pInteractor);
+    bool is_background_layout_running();
+    void cancel_background_layout();
+    bool layout_next_page();
 
     //access to objects/information
     GmoObj* get_box_for_control(GmoRef gref);
@@ -374,6 +449,9 @@ public:
 
 protected:
     ScoreStub* get_stub_for(ImoId scoreId);
+    GmoBoxScorePage* get_score_page_for(ImoId scoreId, TimeUnits timepos);
+    void draw_placeholder_page(int iPage, Drawer* pDrawer);
+    bool layout_one_more_page();
 
 };
 
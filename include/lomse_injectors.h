@@ -18,6 +18,7 @@
 
 
 #include <iostream>
+#include <mutex>
 
 namespace lomse
 {
@@ -91,6 +92,7 @@ protected:
     std::string m_sMusicFontPath;
     std::string m_sFontsPath;
     MusicGlyphs* m_pMusicGlyphs;
+    std::recursive_mutex m_layoutMutex;     //serializes layout and rendering
 
     //options
     bool m_fReplaceLocalMetronome;
@@ -128,6 +130,13 @@ public:
     EventsDispatcher* get_events_dispatcher();
     FontSelector* get_font_selector();
 
+    /** Mutex for serializing the layout and rendering of all documents. FontStorage
+        and TextMeter objects are shared by all documents and are not thread safe.
+        Therefore, when background layout is enabled, the layout thread of each
+        document and the rendering must not use them at the same time.
+    */
+    inline std::recursive_mutex& get_layout_mutex() { return m_layoutMutex; }
+
     //callbacks
     void post_event(SpEventInfo pEvent);
     void post_request(Request* pRequest);
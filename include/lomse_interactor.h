@@ -160,6 +160,8 @@ protected:
     WpDocument      m_wpDoc;
     View*           m_pView;
     GraphicModel*   m_pGraphicModel;
+    bool            m_fLazyLayout;          //create pages only when needed
+    bool            m_fBackgroundLayout;    //create pages in a worker thread
     Task*           m_pTask;
     DocCursor*      m_pCursor;
     SelectionSet*   m_pSelections;
@@ -549,6 +551,100 @@ public:
     */
     void set_view_background(Color color);
 
+    /** Enable or disable a cache of rendered tiles (squares of 256x256 pixels) for
+        the View. When enabled, changing the viewport (e.g. scrolling, panning or
+        auto-scroll during playback) does not render again the already rendered
+        parts of the document; they are just copied from the cache onto the rendering
+        buffer. This saves much time but requires additional memory. Therefore, the
+        maximum memory to use can be specified. When this limit is reached, the least
+        recently used tiles are discarded.
+
+        The cache is automatically invalidated when the document is modified, when
+        the rendering options change or when the pages are moved or resized. With lazy
+        or background layout, the tiles of pages laid out after rendering them are
+        also discarded. By default, the cache is disabled.
+
+        @param value @TRUE for enabling the cache or @FALSE for disabling it and
+            releasing the memory used by the tiles.
+        @param maxMemory Maximum memory, in bytes, to use for the tiles. Default
+            value is 64 MB.
+    */
+    void enable_tile_cache(bool value, size_t maxMemory = 64 * 1024 * 1024);
+
+    /** Discard all tiles in the cache, forcing to render again the document. It is
+        not normally needed, as the cache is automatically invalidated when required.
+    */
+    void invalidate_tile_cache();
+
+    /** Discard the tiles in the cache containing part of the given area of a page.
+        @param iPage The page (0..num_pages - 1).
+        @param area The page area, in logical units (cents of a millimeter) relative
+            to page origin.
+    */
+    void invalidate_tile_cache(int iPage, const URect& area);
+
+    /** Returns the number of tiles taken from the cache since the cache was enabled
+        or since last invocation of reset_tile_cache_statistics().
+    */
+    long get_tile_cache_hits();
+
+    /** Returns the number of tiles not found in the cache and, thus, rendered since
+        the cache was enabled or since last invocation of reset_tile_cache_statistics().
+    */
+    long get_tile_cache_misses();
+
+    /** Returns the memory, in bytes, currently used by the tiles in the cache.
+    */
+    size_t get_tile_cache_memory();
+
+    /** Reset the tile cache hits and misses counters.
+    */
+    void reset_tile_cache_statistics();
+
+    /** Enable or disable lazy layout for paged views (e.g. VerticalBookView). When
+        enabled, the document is laid out only up to the first page, so that it can
+        be displayed quickly, and the remaining pages are created when they are needed
+        for rendering or when requested (e.g. by invoking get_num_pages()). Until all
+        pages are created, the size of the View is based on an estimation of the
+        number of pages. Only scores in the main content of the document are laid
+        out lazily. By default, lazy layout is disabled.
+
+        AWARE: The pending pages are discarded before executing an edition command,
+        as the graphic model will be created again after it. If the document is
+        modified directly, without commands, the pending pages must be created
+        before modifying the document, by invoking GraphicModel::finish_layout().
+
+        @param value @TRUE for enabling lazy layout. The setting will take effect
+            the next time the graphic model is created.
+    */
+    void enable_lazy_layout(bool value);
+
+    /** Enable or disable background layout for paged views (e.g. VerticalBookView).
+        When enabled, the first page is laid out as in lazy layout and the remaining
+        pages are laid out in a worker thread. Each time a new page is available,
+        an EventPagesAvailable event is sent to the handlers registered at this
+        Interactor, so that the View can be repainted. Pages not yet laid out are
+        displayed as blank pages. Methods that need the full graphic model (e.g.
+        get_num_pages()) wait until the layout is finished. By default, background
+        layout is disabled. It requires threads support; otherwise lazy layout is
+        used.
+
+        AWARE: A background layout is cancelled before executing an edition command
+        and a new one is started after it. If the document is modified directly,
+        without commands, the background layout must be finished before modifying
+        the document, by invoking GraphicModel::finish_layout().
+
+        AWARE: The event handlers for EventPagesAvailable events are executed in
+        the layout thread when handlers are directly invoked (see EventPagesAvailable).
+        Fonts are shared by all documents. Therefore, the layout threads and the
+        rendering of all documents are serialized by the LibraryScope layout mutex
+        (see LibraryScope::get_layout_mutex()).
+
+        @param value @TRUE for enabling background layout. The setting will take
+            effect the next time the graphic model is created.
+    */
+    void enable_background_layout(bool value);
+
         //@}    //interface to GraphicView. Rendering
 
 
@@ -1230,6 +1326,19 @@ public:
     */
     void render_as_svg(std::ostream& svg, int page=0);
 
+    /** Request Lomse to render as SVG stream a rectangular region of a document page.
+        Only the objects visible in the region are exported, and the SVG viewBox is
+        the region.
+
+        @param svg The std::ostream in which SVG code will be written.
+        @param page The page to render (0..num_pages - 1). See render_as_svg().
+        @param region The area of the page to render, in logical units (cents of a
+            millimeter) relative to page origin.
+
+        See @subpage page-render-svg
+    */
+    void render_as_svg(std::ostream& svg, int page, const URect& region);
+
     /** Lomse normally layouts the score to fit in the page width specified in
         the document. But when
         View type <i>k_view_free_flow</i> is selected, it is necessary specify the
@@ -1674,6 +1783,19 @@ public:
     */
     inline double* get_elapsed_times() { return &m_elapsedTimes[0]; }
 
+    /** Returns the number of graphic objects (boxes and shapes) drawn in last
+        rendering of the graphic model. Objects out of the visible area are not drawn.
+        See get_num_culled_objects().
+    */
+    int get_num_drawn_objects();
+
+    /** Returns the number of graphic objects (boxes and shapes) skipped in last
+        rendering of the graphic model because they were out of the visible area.
+        A skipped box is counted as one object, without counting the objects it
+        contains.
+    */
+    int get_num_culled_objects();
+
     //@}    //for performance measurements
 
 
@@ -1817,6 +1939,8 @@ protected:
     bool discard_visual_tracking_event_if_not_valid(ImoId scoreId);
     bool is_valid_play_score_event(SpEventPlayCtrl pEvent);
     void update_caret_and_view();
+    void discard_pending_layout();
+    bool page_exists(int page);
     void redraw_caret();
     void send_update_UI_event(EEventType type);
     double get_elapsed_time_since(ptime startTime) const;
@@ -62,6 +62,7 @@ public:
         k_layout_not_finished = 0,
         k_layout_success,
         k_layout_failed_auto_scale,        //auto-scaling applied. Need to re-layout
+        k_layout_suspended,                //lazy layout: pages limit reached
     };
 
     virtual void layout_in_box() = 0;
@@ -75,6 +76,7 @@ public:
         m_pParentLayouter->save_score_layouter(pLayouter);
     }
     inline void set_constrains(int constrains) { m_constrains = constrains; }
+    virtual bool must_suspend_layout() { return false; }
 
     inline GraphicModel* get_graphic_model() { return m_pGModel; }
     inline LibraryScope& get_library_scope() { return m_libraryScope; }
@@ -85,12 +87,16 @@ public:
     inline GmoBox* get_item_main_box() { return m_pItemMainBox; }
 
     inline bool must_add_shapes_to_model() { return m_fAddShapesToModel; }
+    inline ImoContentObj* get_item() { return m_pItem; }
 
 protected:
     virtual GmoBox* start_new_page();
 
     Layouter* create_layouter(ImoContentObj* pItem, int constrains=0);
     int layout_item(ImoContentObj* pItem, GmoBox* pParentBox, int constrains);
+    int continue_item_layout(GmoBox* pParentBox);
+    int resume_item_layout();
+    int finish_item_layout();
 
     void set_cursor_and_available_space();
 
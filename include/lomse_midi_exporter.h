@@ -0,0 +1,158 @@
+//---------------------------------------------------------------------------------------
+// This file is part of the Lomse library.
+// Copyright (c) 2010-present, Lomse Developers
+//
+// Licensed under the MIT license.
+//
+// See LICENSE and NOTICE.md files in the root directory of this source tree.
+//---------------------------------------------------------------------------------------
+
+#ifndef __LOMSE_MIDI_EXPORTER_H__        //to avoid nested includes
+#define __LOMSE_MIDI_EXPORTER_H__
+
+#include "lomse_basic.h"
+#include "lomse_injectors.h"
+#include "lomse_internal_model.h"
+
+#include <ostream>
+#include <vector>
+#include <map>
+
+///@cond INTERNALS
+namespace lomse
+{
+///@endcond
+
+//forward declarations
+class SoundEventsTable;
+class MidiTrackWriter;
+
+
+//---------------------------------------------------------------------------------------
+/** %MidiExporter is responsible for generating a Standard MIDI File (SMF), format 1,
+    for an score. The file is generated directly from the score SoundEventsTable, so
+    it contains the same events that ScorePlayer would send to the MidiServerBase
+    during playback, but the generation does not require real time and is
+    much faster.
+
+    Repetitions, volta brackets, D.C., D.S., Fine and Coda jumps are expanded, and
+    transposition is applied. Tempo is taken from the tempo marks for playback
+    (i.e. MusicXML <sound tempo="...">) found in the score. When the score does not
+    specify tempo, the default tempo is used. Example:
+
+    @code
+        ofstream file(path + "score.mid", ios::out | ios::binary);
+        if (file.good())
+        {
+            MidiExporter exporter(m_libraryScope);
+            exporter.set_default_tempo(90.0f);
+            exporter.set_metronome_track(true);
+            ImoScore* pScore = ...
+            exporter.export_score(pScore, file);
+            file.close();
+        }
+    @endcode
+
+*/
+class MidiExporter
+{
+protected:
+    LibraryScope& m_libraryScope;
+    int m_division = 480;           //ticks per quarter note
+    float m_defaultTempo = 60.0f;   //quarter notes per minute, when not in the score
+    bool m_fForceTempo = false;     //ignore tempo marks and use m_defaultTempo
+    bool m_fExpandJumps = true;     //expand repetitions and other jumps
+
+    //metronome track
+    bool m_fMetronome = false;
+    int m_mtrChannel = 9;
+    int m_mtrTone1 = 60;            //first beat of each measure
+    int m_mtrTone2 = 77;            //other beats
+
+    //temporary data used while exporting a score
+    SoundEventsTable* m_pTable = nullptr;
+    std::map<long, float> m_tempos;         //score time (TU) -> tempo (quarters/minute)
+    std::map<long, std::pair<long, long> > m_rhythms;  //score time (TU) ->
+                                                       //  (measure, beat) duration (TU)
+    std::map<int, MidiTrackWriter*> m_tracks;   //channel -> track
+
+public:
+    /** Constructor */
+    MidiExporter(LibraryScope& libScope);
+    /** Destructor */
+    virtual ~MidiExporter();
+
+    /// @name Main methods for generating the MIDI file
+    //@{
+
+    /** Generates a Standard MIDI File for the score, and writes it to the stream,
+        that must be open in binary mode. Returns @false if the score has no sound
+        events or if there is a write error.
+    */
+    bool export_score(ImoScore* pScore, std::ostream& out);
+
+    /** Generates a Standard MIDI File for the score, and writes it to the stream,
+        that must be open in binary mode. Returns @false if the score has no sound
+        events or if there is a write error.
+    */
+    bool export_score(AScore score, std::ostream& out);
+
+    //@}
+
+    /// @name Generation options
+    //@{
+
+    /** Set the time resolution of the MIDI file, in ticks per quarter note. Default
+        value is 480.  */
+    inline void set_ticks_per_quarter(int ticks) { m_division = max(1, min(ticks, 0x7FFF)); }
+
+    /** Set the tempo, in quarter notes per minute, to use until the first tempo mark
+        is found in the score. Default value is 60.  */
+    inline void set_default_tempo(float bpm) { if (bpm > 0.0f) m_defaultTempo = bpm; }
+
+    /** Force a constant tempo, in quarter notes per minute, ignoring the tempo
+        marks in the score.  */
+    inline void set_tempo(float bpm) {
+        set_default_tempo(bpm);
+        m_fForceTempo = true;
+    }
+
+    /** Enable or disable the expansion of repetitions and other jumps. When disabled,
+        the score is exported as written, in a single pass. Default: enabled.  */
+    inline void set_expand_jumps(bool value) { m_fExpandJumps = value; }
+
+    /** Add, or not, a track with metronome clicks.
+        @param value @true for adding the metronome track.
+        @param channel Midi channel (0..15) to use for metronome clicks.
+            Default value is channel 9, normally used for percussion.
+        @param tone1 Pitch to use for the first metronome click in each measure.
+        @param tone2 Pitch to use for all other metronome clicks in each measure.
+    */
+    inline void set_metronome_track(bool value, int channel=9, int tone1=60,
+                                    int tone2=77)
+    {
+        m_fMetronome = value;
+        m_mtrChannel = channel;
+        m_mtrTone1 = tone1;
+        m_mtrTone2 = tone2;
+    }
+
+    //@}
+
+protected:
+    void collect_tempo_marks(ImoScore* pScore);
+    void collect_rhythm_changes();
+    float tempo_at(long time);
+    void generate_tracks(MidiTrackWriter* pConductor, MidiTrackWriter* pMetronome);
+    void add_metronome_clicks(MidiTrackWriter* pTrack, long startTime, long endTime,
+                              long offset);
+    MidiTrackWriter* get_track(int channel);
+    long to_ticks(long time);
+    void delete_tracks();
+
+};
+
+
+}   //namespace lomse
+
+#endif    //__LOMSE_MIDI_EXPORTER_H__
@@ -111,7 +111,9 @@ public:
 
 
 //---------------------------------------------------------------------------------------
-//auxiliary class SoundEvent describes a sound event
+//auxiliary class SoundEvent describes a sound event.
+//Events are stored by value in the SoundEventsTable. Keep it small: Measure is placed
+//before the pointers union to avoid padding.
 class SoundEvent
 {
 public:
@@ -124,8 +126,8 @@ public:
         , NotePitch(midiPitch)
         , NoteStep(nStep)
         , Volume(nVolume)
-        , pSO(pStaffObj)
         , Measure(nMeasure)
+        , pSO(pStaffObj)
     {
     }
     SoundEvent(TimeUnits rTime, int nEventType, JumpEntry* pJumpEntry, int nMeasure)
@@ -135,11 +137,10 @@ public:
         , NotePitch(0)
         , NoteStep(0)
         , Volume(0)
-        , pJump(pJumpEntry)
         , Measure(nMeasure)
+        , pJump(pJumpEntry)
     {
     }
-    ~SoundEvent() {}
 
     enum
     {
@@ -171,11 +172,11 @@ public:
         int     Volume;         //k_note_xxx: for notes
         int     NumPulses;      //k_rhythm_change: implied number of beats per measure
     };
+    int         Measure;        //measure number containing this staffobj
     union {
         ImoStaffObj*    pSO;        //staffobj who originated the event (for visual highlight)
         JumpEntry*      pJump;      //jump entry, for playback jumps
     };
-    int             Measure;    //measure number containing this staffobj
 
 };
 
@@ -186,8 +187,11 @@ class SoundEventsTable
 protected:
     ImoScore* m_pScore;
     int m_numMeasures;
-    std::vector<SoundEvent*> m_events;
+    std::vector<SoundEvent> m_events;
     std::vector<int> m_measures;
+    std::vector<long> m_times;          //DeltaTime for each event, for binary search
+    std::vector<int> m_seekMeasures;    //first event at or after start of each measure
+    std::vector<int> m_rhythms;         //index to each k_rhythm_change event
     std::vector<int> m_channels;
     std::vector<int> m_semitones;       //transposition for each staff
     std::vector<JumpEntry*> m_jumps;
@@ -204,11 +208,21 @@ public:
     void create_table();
 
     inline int num_events() { return int(m_events.size()); }
-    std::vector<SoundEvent*>& get_events() { return m_events; }
+    std::vector<SoundEvent>& get_events() { return m_events; }
+    inline SoundEvent& get_event(int i) { return m_events[i]; }
     std::vector<int>& get_channels() { return m_channels; }
     inline int get_first_event_for_measure(int nMeasure) { return m_measures[nMeasure]; }
     inline int get_last_event() { return int(m_events.size()) - 1; }
     inline int get_num_measures() { return m_numMeasures; }
+
+    //seek. All methods return -1 when there are no events to play after the requested
+    //position
+    int find_event_for_measure(int nMeasure);
+    int find_event_for_timepos(TimeUnits timepos);
+    int find_event_for_beat(int nMeasure, int nBeat);
+
+    //memory used by the table, in bytes
+    size_t memory_footprint();
     inline TimeUnits get_anacrusis_missing_time() { return m_rAnacrusisMissingTime; }
     inline TimeUnits get_anacrusis_extra_time() { return m_rAnacrusisExtraTime; }
 
@@ -233,6 +247,8 @@ protected:
     void close_table();
     void sort_by_time();
     void create_measures_table();
+    void create_seek_index();
+    int find_rhythm_change_at(long time);
     void save_transposition_information(StaffObjsCursor& cursor, int iInstr, ImoTranspose* pTrp);
     void add_jumps_if_volta_bracket(StaffObjsCursor& cursor, ImoBarline* pBar,
                                     int measure);
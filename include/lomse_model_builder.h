@@ -17,6 +17,7 @@
 #include <ostream>
 #include <map>
 #include <list>
+#include <string>
 #include <vector>
 #include <array>
 
@@ -48,10 +49,18 @@ public:
 
     ImoDocument* build_model(ImoDocument* pImoDoc);
     void structurize(ImoObj* pImo);
+    void structurize(ImoScore* pScore, int iInstr, int firstMeasure, int lastMeasure);
 
     ImoDocument* fix_cloned_model(ImoDocument* pImoDoc);
     void fix_model(ImoObj* pImo);
 
+    //debug
+    bool check_structurize(ImoScore* pScore);
+
+protected:
+    void find_dirty_measures(ImoScore* pScore, int iInstr, int* pFirst, int* pLast);
+    std::string dump_structure_info(ImoScore* pScore);
+
 };
 
 //---------------------------------------------------------------------------------------
@@ -69,6 +78,7 @@ public:
     virtual ~PitchAssigner() {}
 
     void assign_pitch(ImoScore* pScore);
+    void assign_pitch(ImoScore* pScore, int iInstr, int firstMeasure, int lastMeasure);
 
 protected:
     void reset_accidentals(ImoKeySignature* pKey, int idx);
@@ -148,9 +158,12 @@ public:
     virtual ~MeasuresTableBuilder() {}
 
 	void build(ImoScore* pScore);
+	void build(ImoScore* pScore, int instr);
 
 protected:
 
+    void build_tables(ImoScore* pScore, int instr);
+
     void start_measures_table_for(int iInstr, ImoInstrument* pInstr,
                                   ColStaffObjsEntry* pStartEntry);
     void finish_current_measure(int iInstr, ColStaffObjsEntry* pEndEntry=nullptr);
@@ -13,7 +13,6 @@
 #include "lomse_basic.h"
 
 #include <vector>
-#include <list>
 
 namespace lomse
 {
@@ -41,10 +40,12 @@ protected:
         int line;
         int posOnStaff;
         int type;
+        size_t iChordStart;     //index to first note in same line (chord notes)
+        size_t iChordEnd;       //index to last note in same line (chord notes)
 
         NoterestData(ImoNoteRest* pImo, GmoShape* pS, int pos)
             : pNR(pImo), pShape(pS), line(0), posOnStaff(pos)
-            , type(k_nrdata_unknown) {}
+            , type(k_nrdata_unknown), iChordStart(0), iChordEnd(0) {}
 
         //helper
         inline bool is_rest() { return type == k_nrdata_rest; }
@@ -94,6 +95,9 @@ protected:
         k_overlap_unison,       //Overlap. Unison
     };
 
+    bool find_first_collision(size_t* pI, size_t* pJ);
+    void compute_chord_ranges();
+
     void fix_two_rests_overlap(size_t i, size_t j);
     void fix_note_and_rest_overlap(size_t i, size_t j);
     void fix_chord_and_rest_overlap(size_t i, size_t j);
@@ -113,17 +117,17 @@ protected:
     void move_notehead(GmoShapeNote* pShapeNote, LUnits xShift);
     void move_accidental_to_left(GmoShapeNote* pShapeNote, LUnits xShift);
 
-    void insert_note_in_list(std::list<GmoShapeNote*>& notes, GmoShapeNote* pNoteShape);
-    void layout_accidentals(std::list<GmoShapeNote*>& notes);
+    void insert_note_in_list(std::vector<GmoShapeNote*>& notes, GmoShapeNote* pNoteShape);
+    void layout_accidentals(std::vector<GmoShapeNote*>& notes);
     void shift_accidental_if_conflict_with_previous(GmoShapeNote* pCurAcc,
-                                      std::list<GmoShapeNote*>& notes,
-                                      std::list<GmoShapeNote*>::reverse_iterator& itCur);
+                                                    std::vector<GmoShapeNote*>& notes,
+                                                    size_t iCur);
     void shift_acc_if_confict_with_shape(GmoShapeNote* pCurAcc, GmoShape* pShape);
     LUnits check_if_overlap(GmoShape* pShape, GmoShape* pNewShape);
 
 
-    size_t find_start_of_chord(size_t i);
-    size_t find_end_of_chord(size_t i);
+    inline size_t find_start_of_chord(size_t i) { return m_notes[i]->iChordStart; }
+    inline size_t find_end_of_chord(size_t i) { return m_notes[i]->iChordEnd; }
     std::pair<size_t, int> find_chord_note_that_overlap_with(size_t i, size_t iStart, size_t iEnd);
     int check_if_noteheads_overlap(size_t i, size_t j);
 
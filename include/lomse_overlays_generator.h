@@ -16,6 +16,7 @@
 
 //other
 #include <iostream>
+#include <map>
 using namespace std;
 
 
@@ -33,6 +34,11 @@ class GmoObj;
 // OverlaysGenerator:
 //  responsible for generating all visual sprites and overlaying them onto the
 //  rendering buffer
+//
+//  Only the damaged area is updated: the old and new bounds of modified effects,
+//  plus the bounds of any other effect overlapping them. Before drawing the effects,
+//  the clean pixels under them are saved, so that they can be restored when the
+//  effects are modified.
 class OverlaysGenerator
 {
 protected:
@@ -41,12 +47,15 @@ protected:
     list<VisualEffect*> m_effects;      //managed visual effects
     RenderingBuffer m_canvasBuffer;    //the rendering buffer
     RenderingBuffer m_savedBuffer;      //clean copy of rendering buffer
-    bool m_fBackgroundDirty;            //overlays already applied to rendering buffer
+    VRect m_savedArea;                  //valid area in m_savedBuffer
     bool m_fFullRectangle;              //damaged rectangle is all screen
     int8u* m_pSaveBytes;                //the real buffer for the clean copy
-    URect m_damagedRect;
+    URect m_damagedRect;                //damaged area since last get_damaged_rectangle()
     URect m_prevDamagedRect;
+    URect m_pendingDamage;              //bounds of removed effects, not yet restored
+    std::map<VisualEffect*, URect> m_drawnBounds;   //effects drawn on rendering buffer
     GmoObj* m_pHandlersOwner;           //object owning current defined handlers
+    size_t m_bytesCopied;               //statistics: bytes saved and restored
 
 public:
     OverlaysGenerator(GraphicView* view, LibraryScope& libraryScope);
@@ -65,9 +74,19 @@ public:
     inline void set_handlers_owner(GmoObj* pGmo) { m_pHandlersOwner = pGmo; }
     inline GmoObj* get_handlers_owner() { return m_pHandlersOwner; }
 
+    //statistics
+    inline size_t get_num_bytes_copied() { return m_bytesCopied; }
+    inline void reset_statistics() { m_bytesCopied = 0; }
+
 protected:
-    void save_rendering_buffer();
-    void expand_damaged_rectangle();
+    void update_effects(VisualEffect* pModified, BitmapDrawer* pDrawer);
+    void allocate_saved_buffer();
+    void save_area(const VRect& area);
+    void restore_area(const VRect& area);
+    void copy_area(RenderingBuffer& src, RenderingBuffer& dest, Pixels left,
+                   Pixels right, Pixels y);
+    VRect to_canvas_pixels(const URect& rect, BitmapDrawer* pDrawer);
+    URect expand_bounds(const URect& bounds);
 
 
 };
@@ -208,6 +208,10 @@ public:
         //invoked when a non-middle barline is found
     void finish_measure(int iInstr, GmoShapeBarline* pBarlineShape);
 
+    //support for lazy layout
+    float get_layout_progress();
+    void delete_not_laid_out_objects();
+
     //support for debugging and unit tests
     void dump_column_data(int iCol, ostream& outStream=glogger.get_stream());
     void delete_not_used_objects();
@@ -447,10 +451,24 @@ public:
 
     void decide_line_breaks() override;
 
+    //settings. Bounded lookahead is enabled by default
+    inline void use_bounded_lookahead(bool value) { m_fBoundedLookahead = value; }
+
     //support for debug and tests
     void dump_entries(ostream& outStream=glogger.get_stream());
+    inline int get_num_penalties_computed() { return m_numPenalties; }
 
 protected:
+    //bounded lookahead: when line {ci,...,cj-1} is too wide, its penalty is offered
+    //to all entries after entry j, up to next forced break
+    struct OverflowOffer
+    {
+        float prevPenalty;
+        float newPenalty;
+        int predecessor;        //entry i
+        int system;
+    };
+
     struct Entry
     {
         float penalty;          //total penalty for the score
@@ -460,9 +478,19 @@ protected:
     std::vector<Entry> m_entries;
     int m_numCols;
     bool m_fJustifyLastLine;
+    bool m_fBoundedLookahead;
+    int m_numPenalties;
+
+    std::vector<int> m_breakEntry;      //next entry after a forced break
+    std::vector< std::vector<OverflowOffer> > m_pendingOffers;  //by first entry
+    OverflowOffer m_bestOffer;
+    bool m_fBestOffer;
 
     void initialize_entries_table();
+    void initialize_lookahead_data();
     void compute_optimal_break_sequence();
+    void add_overflow_offer(int j, const OverflowOffer& offer);
+    void apply_overflow_offers(int iEntry);
     void retrieve_breaks_sequence();
 
 };
@@ -17,8 +17,13 @@
 
 
 #include <vector>
+#include <deque>
+#include <memory>
 #include <thread>
+#include <mutex>
+#include <chrono>
 #include <condition_variable>
+#include <atomic>
 
 ///@cond INTERNALS
 namespace lomse
@@ -34,6 +39,7 @@ class Interactor;
 class LibraryScope;
 class PlayerGui;
 class Metronome;
+class EventVisualTracking;
 
 //some constants for greater code legibility
 #define k_no_visual_tracking    false
@@ -48,6 +54,58 @@ typedef std::thread SoundThread;
 typedef std::condition_variable SoundFlag;
 
 
+//---------------------------------------------------------------------------------------
+/** A sound event in a SoundEventBatch. Field meaning depends on the event type:
+    - k_note_on, k_note_off: @c data1 is the MIDI pitch and @c data2 the volume.
+    - k_voice_change, k_program_change: @c data1 is the MIDI program number.
+    - k_all_sounds_off: no data. All sounding notes must be muted and all events
+      scheduled for a later time must be discarded.
+*/
+struct BatchedMidiEvent
+{
+    enum
+    {
+        k_note_on = 0,      ///< Note on, for score parts and metronome
+        k_note_off,         ///< Note off, for score parts and metronome
+        k_voice_change,     ///< Program change for score parts
+        k_program_change,   ///< Program change for metronome
+        k_all_sounds_off,   ///< Mute all and discard scheduled events (see SoundEventQueue)
+    };
+
+    int type;           ///< Event type
+    int channel;        ///< MIDI channel (0..15)
+    int data1;          ///< MIDI pitch or program number
+    int data2;          ///< Volume (0..127)
+};
+
+//---------------------------------------------------------------------------------------
+/** %SoundEventBatch contains all the sound events that ScorePlayer generates for the
+    same instant, in the order in which the per-event methods of MidiServerBase would
+    have been invoked. See MidiServerBase::events().
+*/
+class SoundEventBatch
+{
+public:
+    /** Real time (steady clock) at which events must sound. When a lookahead is set
+        with ScorePlayer::set_sound_lookahead(), batches are delivered ahead of time
+        and this is a time in the future when the batch is delivered.  */
+    std::chrono::steady_clock::time_point timestamp;
+
+    /** Playback time, in milliseconds from the start of the score at current tempo */
+    double playbackTime = 0.0;
+
+    /** The sound events */
+    std::vector<BatchedMidiEvent> events;
+
+    inline void add(int type, int channel, int data1, int data2) {
+        events.push_back( {type, channel, data1, data2} );
+    }
+    inline bool empty() const { return events.empty(); }
+    inline size_t size() const { return events.size(); }
+    inline void clear() { events.clear(); }
+};
+
+
 //---------------------------------------------------------------------------------------
 /** Class %MidiServerBase is a base class defining the interface for any class
     that would like to process the requests from ScorePlayer to generate
@@ -116,9 +174,200 @@ public:
         methods.
     */
     virtual void all_sounds_off() {}
+
+    /** Receives, in one call, all the sound events for the same instant, e.g. all
+        notes in a chord. The default implementation just invokes the per-event
+        methods: note_on(), note_off(), voice_change() and program_change(). Override
+        it for processing all the events with a single lock of your synthesizer, or
+        for passing them to a synthesizer thread (see QueuedMidiServer).
+
+        Each batch carries the timestamp at which its events must sound. By default
+        batches are delivered when their events are due but, when a lookahead is set
+        (see ScorePlayer::set_sound_lookahead()), they are delivered ahead of time so
+        that a synthesizer can place the events with sample accuracy. In this case,
+        all_sounds_off() must also discard the events already received but scheduled
+        for a later time.
+    */
+    virtual void events(const SoundEventBatch& batch);
 };
 
 
+//---------------------------------------------------------------------------------------
+/** %SoundEventQueue is a lock-free, fixed capacity, single-producer/single-consumer
+    queue of SoundEventBatch objects. It is intended for passing sound events from
+    the ScorePlayer thread (producer) to a synthesizer thread (consumer) without
+    locks. Batches storage is reused so that, once capacity is reached, no memory
+    allocations take place.
+*/
+class SoundEventQueue
+{
+protected:
+    std::vector<SoundEventBatch> m_slots;
+    std::atomic<size_t> m_head;     //next slot to read. Only modified by consumer
+    std::atomic<size_t> m_tail;     //next slot to write. Only modified by producer
+    std::atomic<long> m_numDropped;
+    std::atomic<size_t> m_flushTail;    //batches before this slot are to be discarded
+    std::atomic<bool> m_fFlush;         //flush requested by producer
+    SoundEventBatch m_allSoundsOff;     //batch returned when flushing
+
+public:
+    /** Constructor. @param capacity Maximum number of batches in the queue.  */
+    SoundEventQueue(size_t capacity=256);
+
+    /** Producer: enqueues a copy of the batch. Returns @false, and the batch is
+        dropped, if the queue is full.  */
+    bool push(const SoundEventBatch& batch);
+
+    /** Producer: requests to discard all batches in the queue. The consumer will
+        not receive them. Instead, next pop() returns a batch with a single
+        BatchedMidiEvent::k_all_sounds_off event, so that the consumer also mutes
+        all notes and discards the events already popped but not yet played.
+
+        AWARE: if the consumer is inside a pop() when the flush is requested, that
+        pop() can still return one batch, queued before or after the request. Next
+        pop() returns the k_all_sounds_off batch and all other batches queued
+        before the request are discarded. */
+    void request_flush();
+
+    /** Consumer: moves the oldest batch to @c batch. Returns @false if the queue
+        is empty.  */
+    bool pop(SoundEventBatch& batch);
+
+    /** Consumer: returns a pointer to the oldest batch, without removing it, or
+        @nullptr if the queue is empty. Useful for checking its timestamp before
+        deciding to pop it.  */
+    const SoundEventBatch* peek();
+
+    /** Number of batches in the queue. Approximate when the other thread is
+        operating on the queue.  */
+    size_t size();
+    inline size_t capacity() { return m_slots.size() - 1; }
+    inline bool empty() { return size() == 0; }
+
+    /** Number of batches discarded because the queue was full  */
+    inline long get_num_dropped() { return m_numDropped.load(); }
+};
+
+
+//---------------------------------------------------------------------------------------
+/** %QueuedMidiServer is a MidiServerBase that does not generate sounds but enqueues
+    all the received sound events in a SoundEventQueue, so that a synthesizer thread
+    can pull them ahead of time and schedule them by their timestamps. Example:
+
+    @code
+        QueuedMidiServer* pMidi = new QueuedMidiServer();
+        ScorePlayer* pPlayer = pLomse->create_score_player(pMidi);
+        pPlayer->set_sound_lookahead(20000);      //20 ms
+
+        //in the synthesizer thread
+        SoundEventBatch batch;
+        while (pMidi->get_queue().pop(batch))
+            schedule(batch.timestamp, batch.events);
+    @endcode
+
+    'All sounds off' requests flush the queue (see SoundEventQueue::request_flush()).
+    Your synthesizer thread will receive a batch with a single
+    BatchedMidiEvent::k_all_sounds_off event, and must then mute all notes and
+    discard the events pending to be played.
+*/
+class QueuedMidiServer : public MidiServerBase
+{
+protected:
+    SoundEventQueue m_queue;
+
+public:
+    QueuedMidiServer(size_t capacity=256) : m_queue(capacity) {}
+    virtual ~QueuedMidiServer() {}
+
+    void events(const SoundEventBatch& batch) override { m_queue.push(batch); }
+
+    void program_change(int channel, int instr) override;
+    void voice_change(int channel, int instr) override;
+    void note_on(int channel, int pitch, int volume) override;
+    void note_off(int channel, int pitch, int volume) override;
+    void all_sounds_off() override { m_queue.request_flush(); }
+
+    inline SoundEventQueue& get_queue() { return m_queue; }
+
+protected:
+    void push_event(int type, int channel, int data1, int data2);
+};
+
+
+//---------------------------------------------------------------------------------------
+/** Timing accuracy statistics for a playback. Deviations are the difference between
+    the real time at which each event was played and its scheduled time, in
+    microseconds. Positive values mean that the event was played late.
+*/
+struct PlaybackTimingStats
+{
+    long numEvents = 0L;            ///< Number of timed events
+    double meanJitter = 0.0;        ///< Mean of the absolute deviations
+    double maxJitter = 0.0;         ///< Maximum absolute deviation
+    double lastDeviation = 0.0;     ///< Deviation for the last event (the drift)
+};
+
+
+///@cond INTERNALS
+//---------------------------------------------------------------------------------------
+// PlaybackScheduler: helper for ScorePlayer, responsible for waiting until the
+// real time at which next event must be played.
+//
+// Playback time (milliseconds from the start of the score, at current tempo) is
+// mapped to absolute steady_clock deadlines, referred to the time playback started.
+// Therefore, timing errors do not accumulate. Waits are done with sleep_until()
+// followed by an optional short busy-wait (spin) for sub-millisecond accuracy.
+// Waits are interrupted when playback is paused or stopped.
+class PlaybackScheduler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+protected:
+    Clock::time_point   m_origin;       //real time for playback time 0
+    Clock::time_point   m_pauseStart;   //real time at which pause started
+    double              m_pauseTime;    //playback time at which pause started
+    Clock::duration     m_spin;         //busy-wait time before each deadline
+    std::mutex          m_mutex;
+    SoundFlag           m_wakeUp;       //to interrupt waits on pause/resume/stop
+    bool                m_fPaused;
+    bool                m_fStop;
+    PlaybackTimingStats m_stats;
+    double              m_totalJitter;
+
+public:
+    PlaybackScheduler();
+
+    //control
+    void start(double time);
+    void rebase(double oldTime, double newTime);
+    bool wait_until(double time, bool* pPaused=nullptr);
+    bool wait_while_paused();
+    bool is_paused();
+    double get_pause_time();
+    void pause();
+    void resume();
+    void request_stop();
+    void reset();
+
+    //options
+    void set_spin_time(long microseconds);
+    long get_spin_time();
+
+    //statistics
+    PlaybackTimingStats get_statistics();
+
+    //real time for a playback time
+    Clock::time_point get_deadline(double time);
+
+protected:
+    Clock::time_point to_deadline(double time);
+    void wait_for_resume(std::unique_lock<std::mutex>& lock);
+    void add_deviation(Clock::time_point deadline, Clock::time_point now);
+};
+///@endcond
+
+
 //---------------------------------------------------------------------------------------
 /** %ScorePlayer class is responsible for managing score playback.
     It provides the necessary methods for controlling all playback (start, stop, pause,
@@ -163,7 +412,19 @@ protected:
     bool                m_fFinalEventSent;      //to avoid duplicating final event
     ImoScore*           m_pScore;       //score to play
     SoundEventsTable*   m_pTable;
-    SoundFlag           m_canPlay;      //playback is not paused
+    PlaybackScheduler   m_scheduler;    //real time control: waits, pause, stats
+    SoundEventBatch     m_batch;        //sound events pending to be sent
+    long                m_lookahead;    //microseconds, for sending sound events early
+
+    //when sound events are sent ahead of time (lookahead):
+    struct PendingTrackingEvent         //visual tracking event waiting for its time
+    {
+        double time;
+        std::shared_ptr<EventVisualTracking> event;
+        Interactor* pInteractor;
+    };
+    std::deque<PendingTrackingEvent> m_pendingTracking;
+    std::deque<SoundEventBatch> m_sentBatches;     //sent but not yet due
 
     //metronome: MIDI parameters
     int m_MtrChannel;
@@ -317,6 +578,37 @@ public:
     */
     inline bool is_playing() { return m_fPlaying; }
 
+    /** Returns timing accuracy statistics for the current or last playback. They
+        are reset each time a new playback starts.
+    */
+    inline PlaybackTimingStats get_timing_statistics() {
+        return m_scheduler.get_statistics();
+    }
+
+    /** Set the time (microseconds) to busy-wait before each event, after sleeping,
+        for achieving sub-millisecond timing accuracy at the cost of some CPU usage.
+        Default value is 0 (no busy-wait).
+    */
+    inline void set_timing_spin(long microseconds) {
+        m_scheduler.set_spin_time(microseconds);
+    }
+
+    /** Set the lookahead (microseconds) for sending sound events ahead of time.
+        The batches sent to MidiServerBase::events() are delivered this amount
+        of time before their events are due, and their timestamp is the time at
+        which events must sound, so that a synthesizer buffering audio can schedule
+        them accurately. Visual tracking events are retained so that they are
+        posted when the sound is due. On pause and stop, all_sounds_off() is
+        invoked from the playback thread, and events sent ahead of time are sent
+        again when resuming. Only use a lookahead with a MIDI server that schedules
+        the events by their timestamp (e.g. QueuedMidiServer). It must be set
+        before starting playback. Default value is 0 (events are delivered when
+        due).
+    */
+    inline void set_sound_lookahead(long microseconds) {
+        m_lookahead = max(0L, microseconds);
+    }
+
 
 ///@cond INTERNALS
 //excluded from public API. Only for internal use.
@@ -337,6 +629,24 @@ protected:
     void end_of_playback_housekeeping(bool fVisualTracking, Interactor* pInteractor);
     void set_new_beat_information(SoundEvent* pEvent);
 
+    //sound events are accumulated and sent in batches, when time advances
+    inline void add_sound_event(int type, int channel, int data1, int data2) {
+        m_batch.add(type, channel, data1, data2);
+    }
+    void start_playback_clock(double time);
+    void flush_sound_events();
+    bool wait_until(double time);
+    bool wait_for(double time);
+    bool wait_while_paused();
+    bool pause_sounds_sent_ahead();
+    void finish_sounds_sent_ahead();
+    void rebase(double oldTime, double newTime);
+    void post_tracking_event(std::shared_ptr<EventVisualTracking> pEvent,
+                             Interactor* pInteractor);
+    void send_tracking_event(std::shared_ptr<EventVisualTracking> pEvent,
+                             Interactor* pInteractor);
+    inline double lookahead_time() { return double(m_lookahead) / 1000.0; }
+
     //helper, for do_play()
     //-----------------------------------------------------------------------------------
     int m_beatType;     //beat definition to use, from EBeatDuration: k_beat_specified,
@@ -363,6 +673,11 @@ protected:
         return long( float(deltaTime) * m_conversionFactor );
     }
 
+    //helper, to convert TimeUnits to playback time without rounding, for scheduling
+    inline double time_units_to_playback_time(long deltaTime) {
+        return double(deltaTime) * double(m_conversionFactor);
+    }
+
 
 };
 
@@ -36,6 +36,7 @@ protected:
     FontStorage* m_pFontStorage;
     LibraryScope& m_libraryScope;
     double m_fontHeight;
+    int m_iGlyph;       //index in glyphs table
 
 public:
     virtual ~GmoShapeGlyph() {}
@@ -522,8 +523,10 @@ protected:
     LUnits m_unusedSpaceTop;
     LUnits m_unusedSpaceBottom;
 
+    int m_iSegmentGlyph;
     unsigned int m_segmentGlyph;
     unsigned int m_segmentCount;
+    int m_iArrowGlyph;
     unsigned int m_arrowGlyph;
     LUnits m_xInitialAdvance;
     LUnits m_yInitialAdvance;
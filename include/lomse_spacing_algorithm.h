@@ -104,6 +104,13 @@ public:
     virtual bool is_better_option(float prevPenalty, float newPenalty, float nextPenalty,
                                   int i, int j) = 0;
 
+    ///Optional, for speeding up the lines break algorithm. Return true when columns
+    ///{ci, ..., cj} do not fit in system iSystem and no line {ci, ..., ck}, k > j,
+    ///will fit either, so that the penalty for all these lines is the same.
+    virtual bool is_line_too_wide(int UNUSED(iSystem), int UNUSED(i), int UNUSED(j)) {
+        return false;
+    }
+
     ///Finally, if justification is required this method will be invoked
     virtual void justify_system(int iFirstCol, int iLastCol, LUnits uSpaceIncrement) = 0;
 
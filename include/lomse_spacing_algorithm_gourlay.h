@@ -16,6 +16,8 @@
 #include "lomse_time.h"
 #include "lomse_timegrid_table.h"
 
+#include "agg_array.h"      //block_allocator
+
 namespace lomse
 {
 
@@ -49,9 +51,16 @@ class GmoShapeNote;
 // SpAlgGourlay
 // Spacing algorithm based on Gourlay's method
 //
+// TimeSlice, ColumnDataGourlay and ShapeData objects are allocated in an arena owned
+// by this object, so that they are contiguous in memory and released in a single
+// operation when the layout finishes.
+//
 class SpAlgGourlay : public SpAlgColumn
 {
 protected:
+    enum { k_arena_block_size = 16384, k_arena_alignment = 16, };
+    agg::block_allocator m_arena;                //memory for slices, columns and shapes data
+
     std::list<TimeSlice*> m_slices;              //list of TimeSlices
     std::vector<ColumnDataGourlay*> m_columns;   //columns
     std::vector<ShapeData*> m_shapes;            //data associated to each staff object
@@ -85,6 +94,14 @@ protected:
     float  m_dmin;      //min note duration for which fixed spacing will be used
     float  m_Fopt;      //Optimum force (user defined and dependent on personal taste)
 
+    //lines break algorithm: accumulated data for last line {ci, ..., cj} evaluated
+    int     m_iLineFirstCol;
+    int     m_iLineLastCol;
+    float   m_lineSlope;
+    LUnits  m_lineFixed;
+    LUnits  m_lineMinWidth;
+    bool    m_fNegativeMinWidths;   //some column has negative minimum width
+
 public:
     SpAlgGourlay(LibraryScope& libraryScope, ScoreMeter* pScoreMeter,
                  ScoreLayouter* pScoreLyt, ImoScore* pScore,
@@ -101,6 +118,7 @@ public:
     float determine_penalty_for_line(int iSystem, int i, int j) override;
     bool is_better_option(float prevPenalty, float newPenalty, float nextPenalty,
                           int i, int j) override;
+    bool is_line_too_wide(int iSystem, int i, int j) override;
 
     //information about a column
     bool is_empty_column(int iCol) override;
@@ -143,6 +161,11 @@ protected:
     ShapeData* save_info_for_shape(GmoShape* pShape, int iInstr, int iStaff);
     bool determine_if_new_slice_needed(ColStaffObjsEntry* pCurEntry, TimeUnits curTime,
                                        int curType, ImoStaffObj* pSO);
+    void accumulate_line_data(int iFirstCol, int iLastCol);
+    LUnits determine_line_width(int iSystem);
+    inline void* arena_allocate(size_t size) {
+        return m_arena.allocate(unsigned(size), k_arena_alignment);
+    }
 
 };
 
@@ -158,6 +181,16 @@ public:
     std::vector<TimeSlice*> m_orderedSlices;  //slices ordered by pre-stretching force fi
     std::list<FullMeasureRestData*> m_rests;  //data for full-measure rests in this column
 
+    //copy of the slices data used when applying forces, in m_orderedSlices order, so
+    //that force and extent computations are tight loops over contiguous arrays
+    std::vector<float>  m_sliceFi;      //pre-stretching force fi
+    std::vector<float>  m_sliceC;       //spring constant c
+    std::vector<LUnits> m_sliceRods;    //pre-stretching extent (total rods)
+    std::vector<LUnits> m_sliceLeft;    //fixed space at start
+    std::vector<LUnits> m_sliceWidth;   //extent after applying force
+    LUnits  m_sumRods;          //sum of all slices pre-stretching extent
+    LUnits  m_sumLeft;          //sum of all slices fixed space
+
     float   m_slope;            //slope of approximated sff() for this column
     float   m_minFi;            //minimum force at which this column reacts
     LUnits  m_xFixed;           //fixed spacing for this column
@@ -230,6 +263,7 @@ public:
     void dump(std::ostream& outStream, bool fOrdered=false);
 
 protected:
+    void load_slices_data();
 
 };
 
@@ -12,6 +12,7 @@
 
 #include <stddef.h>
 #include <list>
+#include <vector>
 using namespace std;
 
 namespace lomse
@@ -73,14 +74,14 @@ template <typename T>
 class UndoableStack
 {
 protected:
-    std::list<T> m_list;
-    std::list<T> m_history;
+    std::vector<T> m_list;
+    std::vector<T> m_history;
 
 public:
     UndoableStack() {}
 
     virtual ~UndoableStack() {
-        typename std::list<T>::iterator it;
+        typename std::vector<T>::iterator it;
         for (it=m_list.begin(); it != m_list.end(); ++it)
             delete *it;
         m_list.clear();
@@ -121,15 +122,12 @@ public:
     }
 
     const T get_item(int i) {
-        typename std::list<T>::iterator it;
-        for (it=m_list.begin(); it != m_list.end() && i > 0; ++it)
-            --i;
-        return (it != m_list.end() ? *it : nullptr);
+        return (i >= 0 && size_t(i) < m_list.size() ? m_list[i] : nullptr);
     }
 
 protected:
     void remove_history() {
-        typename std::list<T>::iterator it;
+        typename std::vector<T>::iterator it;
         for (it = m_history.begin(); it != m_history.end(); ++it)
             delete *it;
         m_history.clear();
@@ -17,6 +17,7 @@
 #include <vector>
 #include <ostream>
 #include <map>
+#include <unordered_map>
 
 namespace lomse
 {
@@ -48,6 +49,8 @@ protected:
     int                 m_line;
     int                 m_staff;
     ImoStaffObj*        m_pImo;
+    int                 m_index;    //index of this entry in ColStaffObjs
+    int                 m_order;    //definition order, for sorting entries at same time
 
     ColStaffObjsEntry*  m_pNext;    //next entry in the collection
     ColStaffObjsEntry*  m_pPrev;    //prev. entry in the collection
@@ -59,6 +62,8 @@ public:
         , m_line(line)
         , m_staff(staff)
         , m_pImo(pImo)
+        , m_index(-1)
+        , m_order(0)
         , m_pNext(nullptr)
         , m_pPrev(nullptr)
     {
@@ -74,6 +79,7 @@ public:
     inline ImoStaffObj* imo_object() const { return m_pImo; }
     inline long element_id() { return m_pImo->get_id(); }
     inline TimeUnits duration() const { return m_pImo->get_duration(); }
+    inline int get_table_index() const { return m_index; }
 
     //debug
     std::string dump(bool fWithIds=true);
@@ -88,19 +94,32 @@ protected:
     friend class ColStaffObjs;
     inline void set_next(ColStaffObjsEntry* pEntry) { m_pNext = pEntry; }
     inline void set_prev(ColStaffObjsEntry* pEntry) { m_pPrev = pEntry; }
+    inline void set_index(int index) { m_index = index; }
+    inline void set_order(int order) { m_order = order; }
+    inline void set_imo_object(ImoStaffObj* pImo) {
+        m_pImo = pImo;
+        m_pImo->set_colstaffobjs_entry(this);
+    }
+    inline int get_order() const { return m_order; }
 
 
 };
 
 
 //---------------------------------------------------------------------------------------
-// ColStaffObjs: encapsulates the staff objects collection for a score
+// ColStaffObjs: encapsulates the staff objects collection for a score.
+// Entries are stored, in order, in a vector and are also linked as a doubly linked
+// list. An index staffobj -> entry provides direct access to the entry for an
+// staffobj. For objects with several entries (e.g. time signatures) the index points
+// to the first one.
+// As entries are ordered by timepos, entries for a timepos are found by binary search.
+// And, for each instrument, the barlines, key and time signatures entries are also
+// indexed, for finding the measure, the key and the time signature for an entry.
 //---------------------------------------------------------------------------------------
 class ColStaffObjs
 {
 protected:
     int m_numLines;
-    int m_numEntries;
     TimeUnits m_rMissingTime;
     TimeUnits m_rAnacrusisExtraTime;    //extra anacrusis time introduced by grace notes
     TimeUnits m_minNoteDuration;
@@ -109,16 +128,21 @@ protected:
     int m_numEighth;
     int m_num16th;
     int m_divisions = 480;
+    int m_nextOrder = 0;
 
-    ColStaffObjsEntry* m_pFirst;
-    ColStaffObjsEntry* m_pLast;
+    std::vector<ColStaffObjsEntry*> m_entries;
+    std::vector<int> m_firstLine;   //first line used by each instrument
+    std::unordered_map<ImoStaffObj*, ColStaffObjsEntry*> m_index;
+    std::vector< std::vector<ColStaffObjsEntry*> > m_barlines;         //per instrument
+    std::vector< std::vector<ColStaffObjsEntry*> > m_timeSignatures;   //per instrument
+    std::vector< std::vector<ColStaffObjsEntry*> > m_keySignatures;    //per instrument
 
 public:
     ColStaffObjs();
     ~ColStaffObjs();
 
     //table info
-    inline int num_entries() const { return m_numEntries; }
+    inline int num_entries() const { return int(m_entries.size()); }
     inline int num_lines() const { return m_numLines; }
     inline bool is_anacrusis_start() const { return is_greater_time(m_rMissingTime, 0.0); }
     inline TimeUnits anacrusis_missing_time() const { return m_rMissingTime; }
@@ -130,10 +154,18 @@ public:
     inline int num_16th_noterests() const { return m_num16th; }
     inline int get_divisions() const { return m_divisions; }
 
-    //table management
+    //table management. Entries can be added or removed for updating the table
+    //after an edition, without rebuilding it. The caller is responsible for
+    //updating staffobjs time and other table info
     ColStaffObjsEntry* add_entry(int measure, int instr, int voice, int staff,
                                  ImoStaffObj* pImo);
+    ColStaffObjsEntry* insert_entry_after(ColStaffObjsEntry* pPrev, int measure,
+                                          int instr, int line, int staff,
+                                          ImoStaffObj* pImo);
     void delete_entry_for(ImoStaffObj* pSO);
+    void replace_entry_for(ImoStaffObj* pOld, ImoStaffObj* pNew);
+    void count_noterest(ImoNoteRest* pNR);
+    void discount_noterest(ImoNoteRest* pNR);
 
     //iterator related
     class iterator
@@ -198,11 +230,19 @@ public:
             }
     };
 
-	inline iterator begin() { return iterator(m_pFirst); }
+	inline iterator begin() { return iterator(front()); }
 	inline iterator end() { return iterator(nullptr); }
-    inline ColStaffObjsEntry* back() { return m_pLast; }
-    inline ColStaffObjsEntry* front() { return m_pFirst; }
+    inline ColStaffObjsEntry* back() { return m_entries.empty() ? nullptr : m_entries.back(); }
+    inline ColStaffObjsEntry* front() { return m_entries.empty() ? nullptr : m_entries.front(); }
     inline iterator find(ImoStaffObj* pSO) { return iterator(find_entry_for(pSO)); }
+    inline ColStaffObjsEntry* get_entry(int i) { return m_entries[i]; }
+
+    //search
+    ColStaffObjsEntry* get_first_entry_not_before(TimeUnits timepos);
+    ColStaffObjsEntry* get_barline_for_measure(int instr, int measure);
+    ColStaffObjsEntry* get_prev_barline(int instr, ColStaffObjsEntry* pEntry);
+    ColStaffObjsEntry* get_prev_time_signature(int instr, ColStaffObjsEntry* pEntry);
+    ColStaffObjsEntry* get_prev_key_signature(int instr, ColStaffObjsEntry* pEntry);
 
     //debug
     std::string dump(bool fWithIds=true);
@@ -220,11 +260,29 @@ protected:
     void sort_table();
     static bool is_lower_entry(ColStaffObjsEntry* b, ColStaffObjsEntry* a);
     inline void set_min_note(TimeUnits duration) { m_minNoteDuration = duration; }
-    void count_noterest(ImoNoteRest* pNR);
     inline void set_divisions(int div) { m_divisions = div; }
+    inline void reset_noterests_count() {
+        m_numHalf = m_numQuarter = m_numEighth = m_num16th = 0;
+    }
+    inline void add_first_line(int line) { m_firstLine.push_back(line); }
+    inline int num_instruments() const { return int(m_firstLine.size()); }
+    inline int first_line_for(int instr) const {
+        return (instr < num_instruments() ? m_firstLine[instr] : m_numLines);
+    }
 
+    ColStaffObjsEntry* append_entry(int measure, int instr, int line, int staff,
+                                    ImoStaffObj* pImo);
     void add_entry_to_list(ColStaffObjsEntry* pEntry);
+    void sort_entries_at_same_time(size_t iStart, size_t iEnd, size_t iFirstToInsert);
+    void sort_instrument_entries_at_same_time(size_t iStart, size_t iEnd, int instr);
+    void replace_instrument_entries(int instr, size_t iFirstNew);
+    void rebuild_links_and_indexes();
+    void insert_entry_at(size_t i, ColStaffObjsEntry* pEntry);
+    void renumber_entries(size_t i);
+    std::vector<ColStaffObjsEntry*>* get_instr_index_for(ColStaffObjsEntry* pEntry);
     ColStaffObjsEntry* find_entry_for(ImoStaffObj* pSO);
+    static ColStaffObjsEntry* find_prev_in(std::vector<ColStaffObjsEntry*>& entries,
+                                           ColStaffObjsEntry* pEntry);
 
 };
 
@@ -251,6 +309,7 @@ public:
 
     int get_line_assigned_to(int nVoice, int nStaff);
     void new_instrument();
+    void start_instrument_at(int line);
     inline int get_number_of_lines() { return m_lastDefinedLine; }
 
 private:
@@ -273,6 +332,7 @@ public:
     virtual ~ColStaffObjsBuilder() {}
 
     ColStaffObjs* build(ImoScore* pScore);
+    bool rebuild_instrument(ImoScore* pScore, int iInstr);
 
 protected:
     ColStaffObjsBuilderEngine* create_builder_engine(ImoScore* pScore);
@@ -309,6 +369,7 @@ public:
     ColStaffObjsBuilderEngine& operator= (ColStaffObjsBuilderEngine&&) = delete;
 
     ColStaffObjs* do_build();
+    bool do_rebuild_instrument(ColStaffObjs* pColStaffObjs, int iInstr);
 
     //debug
     std::string dump_divisions_data() const;
@@ -334,6 +395,7 @@ protected:
     void fix_negative_playback_times();
     void compute_arpeggiated_chords_playback_time();
     void compute_divisions();
+    void collect_table_info();
 
     static void save_arpeggiated_note(ImoNote* pNote, bool fBottomUp,
                                       list<ImoNote*>& chordNotes);
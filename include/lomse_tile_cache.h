@@ -0,0 +1,130 @@
+//---------------------------------------------------------------------------------------
+// This file is part of the Lomse library.
+// Copyright (c) 2010-present, Lomse Developers
+//
+// Licensed under the MIT license.
+//
+// See LICENSE and NOTICE.md files in the root directory of this source tree.
+//---------------------------------------------------------------------------------------
+
+#ifndef __LOMSE_TILE_CACHE_H__
+#define __LOMSE_TILE_CACHE_H__
+
+#include "lomse_basic.h"
+#include "lomse_injectors.h"
+#include "lomse_agg_types.h"        //RenderingBuffer
+
+//other
+#include <list>
+#include <map>
+#include <tuple>
+#include <vector>
+#include <string>
+
+
+namespace lomse
+{
+
+//forward declarations
+class GraphicModel;
+struct RenderOptions;
+
+
+//---------------------------------------------------------------------------------------
+// RasterTile: a rendered square area of the view, at a given scale
+struct RasterTile
+{
+    double scale;
+    int col;
+    int row;
+    URect bounds;                       //rendered area, in view logical units
+    std::vector<unsigned char> pixels;  //the bitmap
+    RenderingBuffer rbuf;               //for accessing the bitmap
+
+    RasterTile(double s, int c, int r)
+        : scale(s), col(c), row(r), bounds(0.0f, 0.0f, 0.0f, 0.0f)
+    {
+    }
+};
+
+
+//---------------------------------------------------------------------------------------
+// TileCache: a cache of rendered tiles of the graphic model, used by GraphicView for
+//  not re-rendering the graphic model when the viewport changes.
+//
+//  Tiles are squares of k_tile_size pixels aligned on a grid whose origin is the view
+//  origin (viewport 0,0), so that they are valid for any viewport position. Tiles are
+//  identified by scale, column and row. The least recently used tiles are discarded
+//  when the memory used by tiles exceeds the limit.
+//
+//  All tiles are discarded when the graphic model is replaced or modified, when the
+//  rendering options change or when the pages are moved or resized. When new pages
+//  are laid out without modifying the document (lazy or background layout), only
+//  the tiles rendered on the area of these pages are discarded.
+class TileCache
+{
+public:
+    //Tiles are rendered with an additional column and row, not copied to the view,
+    //as the renderer never paints the last column and row of the bitmap
+    enum {
+        k_tile_size = 256,
+        k_tile_bitmap_size = k_tile_size + 1,
+    };
+
+protected:
+    typedef std::tuple<double, int, int> TileKey;        //scale, column, row
+    typedef std::list<RasterTile*> TilesList;            //most recently used first
+
+    LibraryScope& m_libraryScope;
+    int m_bytesPerPixel;
+    size_t m_maxMemory;
+    size_t m_usedMemory = 0;
+    TilesList m_tiles;
+    std::map<TileKey, TilesList::iterator> m_index;
+
+    //for detecting when tiles are no longer valid
+    long m_modelId = -1L;
+    long m_modelChanges = -1L;
+    std::string m_options;
+    std::list<URect> m_pageBounds;
+    int m_numLaidOutPages = 0;
+
+    //statistics
+    long m_numHits = 0L;
+    long m_numMisses = 0L;
+
+public:
+    TileCache(LibraryScope& libraryScope, size_t maxMemory);
+    ~TileCache();
+
+    //operations
+    void validate(GraphicModel* pGModel, RenderOptions& opt,
+                  const std::list<URect>& pageBounds);
+    RasterTile* find_tile(double scale, int col, int row);
+    RasterTile* create_tile(double scale, int col, int row);
+    void copy_tile_to(RasterTile* pTile, RenderingBuffer& dest, int xDest, int yDest);
+    void invalidate();
+    void invalidate(const URect& area);
+
+    //settings
+    void set_max_memory(size_t bytes);
+    inline size_t get_max_memory() { return m_maxMemory; }
+
+    //statistics
+    inline long get_num_hits() { return m_numHits; }
+    inline long get_num_misses() { return m_numMisses; }
+    inline int get_num_tiles() { return int(m_tiles.size()); }
+    inline size_t get_memory_used() { return m_usedMemory; }
+    inline void reset_statistics() { m_numHits = 0L; m_numMisses = 0L; }
+
+protected:
+    void delete_tile(TilesList::iterator it);
+    void enforce_memory_limit();
+    std::string options_signature(RenderOptions& opt);
+
+};
+
+
+}   //namespace lomse
+
+#endif      //__LOMSE_TILE_CACHE_H__
@@ -13,7 +13,6 @@
 #include "lomse_basic.h"
 
 #include <vector>
-#include <list>
 
 namespace lomse
 {
@@ -42,7 +41,7 @@ public:
 };
 
 //to simplify writing code
-typedef std::list<VProfilePoint>::iterator  PointsIterator;
+typedef std::vector<VProfilePoint>::iterator  PointsIterator;
 
 //---------------------------------------------------------------------------------------
 /**	VerticalProfile is responsible for maintaining and managing the information about
@@ -50,7 +49,10 @@ typedef std::list<VProfilePoint>::iterator  PointsIterator;
 	system is being engraved.
 
 	The profile is, basically, two vectors per staff containing, respectively, the shapes
-	that define the max. and min. vertical positions along the x axis.
+	that define the max. and min. vertical positions along the x axis. Each vector is
+	a skyline: points are sorted by x position and each point defines the profile
+	value from its x position to the x position of next point. Points are located by
+	binary search, and range queries scan only the contiguous points in the range.
 
 	Wen no shape occupies the space, the profile assigns to this space as max and min
 	values an upper and lower value of ten time the staff height. This is, the profile
@@ -72,7 +74,7 @@ protected:
 	std::vector<LUnits> m_yStaffTop;        //top line position for each staff
 	std::vector<LUnits> m_yStaffBottom;     //bottom line position for each staff
 
-    typedef std::list<VProfilePoint> PointsRow;  //data for a profile change, for one staff
+    typedef std::vector<VProfilePoint> PointsRow;  //profile changes, sorted by x, for one staff
 	std::vector<PointsRow*> m_xMax;         //ptrs. to max x pos vector for each staff
 	std::vector<PointsRow*> m_xMin;         //ptrs. to min x pos vector for each staff
 
@@ -108,18 +110,18 @@ public:
     std::string dump_min(int idxStaff);
 
 protected:
-    void update_profile(std::list<VProfilePoint>* pPoints, LUnits yPos, bool fMax,
+    void update_profile(PointsRow* pPoints, LUnits yPos, bool fMax,
                         LUnits xLeft, LUnits xRight, GmoShape* pShape);
-    PointsIterator locate_insertion_point(std::list<VProfilePoint>* pPoints, LUnits xLeft);
-    void update_point(std::list<VProfilePoint>* pPointsMin, LUnits xPos,
-                      LUnits yPos, GmoShape* pShape, PointsIterator itNext);
+    PointsIterator locate_insertion_point(PointsRow* pPoints, LUnits xPos);
+    bool update_point(PointsRow* pPoints, LUnits xPos, LUnits yPos, GmoShape* pShape,
+                      size_t iNext);
 
 
     void update_shape(GmoShape* pShape, int idxStaff);
 
     //debug
     GmoShape* dbg_generate_shape(bool fMax, int idxStaff);
-    std::string dump(std::list<VProfilePoint>* pPoints);
+    std::string dump(PointsRow* pPoints);
 
 };
 
@@ -35,6 +35,8 @@
 #include "lomse_document.h"
 
 #include <sstream>
+#include <atomic>
+#include <mutex>
 
 ///@cond INTERNALS
 namespace lomse
@@ -62,6 +64,7 @@ class ImoButton;
 class ImoParagraph;
 class ImoTextItem;
 class RelObjCloner;
+class ScoreCheckpoint;
 
 
 //---------------------------------------------------------------------------------------
@@ -98,6 +101,8 @@ protected:
     RelObjCloner*   m_pRelObjCloner = nullptr;  //helper to clone ImoRelObj nodes
     unsigned int    m_flags = k_dirty;
     long            m_imRef = -1L;               //this model unique id number
+    std::atomic<long> m_stylesEpoch{0L};        //incremented when a style is modified
+    std::mutex      m_stylesMutex;              //for resolving styles properties
 
 
     DocModel(Document* pDoc);
@@ -150,6 +155,16 @@ public:
     inline bool is_valid_model(long imRef) const { return m_imRef == imRef; }
     inline long get_model_ref() const { return m_imRef; }
 
+    //styles. Styles properties, own or inherited, are resolved on first access
+    //after any style of the document has been modified
+    inline long get_styles_epoch() const { return m_stylesEpoch.load(); }
+    inline void on_style_modified() { ++m_stylesEpoch; }
+    inline std::mutex& get_styles_mutex() { return m_stylesMutex; }
+
+    //partial checkpoints, for undo
+    ScoreCheckpoint* create_score_checkpoint(ImoObj* pImo);
+    bool restore_score_checkpoint(ScoreCheckpoint* pCheckpoint);
+
 
 protected:
     DocModel& clone(const DocModel& a);
@@ -158,6 +173,39 @@ protected:
 };
 
 
+//------------------------------------------------------------------------------------
+/** %ScoreCheckpoint is a backup copy of one score of a DocModel, or of the part of it
+    that is going to be modified (e.g. the ImoMusicData of one instrument), for
+    undoing commands that only modify that part without having to copy the whole
+    document. The not copied part of the document is shared with the live model:
+    restoring the checkpoint only replaces the copied subtree.
+
+    The copy is anchored to a private DocModel, that only contains the ids and xml ids
+    of the copied objects, and it also saves the IdAssigner counter when the copy was
+    taken.
+*/
+class ScoreCheckpoint
+{
+protected:
+    friend class DocModel;
+    DocModel*   m_pModel = nullptr;         //private model for the copy. Owned
+    ImoObj*     m_pCopy = nullptr;          //the copy. Owned
+    ImoId       m_copiedId = k_no_imoid;    //id of the copied object
+    ImoId       m_idCounter = k_no_imoid;
+
+    ScoreCheckpoint() {}
+
+public:
+    ~ScoreCheckpoint();
+    ScoreCheckpoint(const ScoreCheckpoint&) = delete;
+    ScoreCheckpoint& operator= (const ScoreCheckpoint&) = delete;
+    ScoreCheckpoint(ScoreCheckpoint&&) = delete;
+    ScoreCheckpoint& operator= (ScoreCheckpoint&&) = delete;
+
+    inline ImoId get_copied_id() const { return m_copiedId; }
+};
+
+
 //------------------------------------------------------------------------------------
 /** The %Document class is a facade object that contains, basically, the @IM, a model
     similar to the DOM in HTML. By accessing and modifying this internal model you
@@ -43,6 +43,7 @@ typedef int TIntAttribute;
 #include <vector>
 #include <map>
 #include <sstream>
+#include <atomic>
 using namespace std;
 
 ///@cond INTERNALS
@@ -1513,6 +1514,7 @@ public:
     void set_dirty(bool value);
     inline bool are_children_dirty() { return (m_flags & k_children_dirty) != 0; }
     void set_children_dirty(bool value);
+    void clear_dirty_flags();
 
     //edition flags
     inline bool is_edit_terminal() { return (m_flags & k_edit_terminal) != 0; }
@@ -1947,6 +1949,46 @@ protected:
         k_modified_font_weight =    0x00000008,
     };
 
+    //resolved properties (own or inherited from parent styles) for fast access.
+    //They are rebuilt on first access after any style of the document has been
+    //modified. A property has always the same type, so each property uses a single
+    //8 bytes slot (about 350 bytes per style). String values, only used for fonts,
+    //are pointers to the value stored in the style that defines them, so that the
+    //returned references are not invalidated when other styles are modified.
+    struct ResolvedValue
+    {
+        unsigned char defined = 0;      //k_resolved_xxx flag of the value type
+        unsigned char iString = 0;      //index in strings, for string values
+        union
+        {
+            LUnits lunitsValue;
+            float floatValue;
+            int intValue;
+            unsigned char colorValue[4];    //r, g, b, a
+        };
+
+        ResolvedValue() : intValue(0) {}
+    };
+    struct ResolvedProps
+    {
+        std::atomic<long> epoch;                //document styles epoch when resolved
+        std::vector<ResolvedValue> values;      //one per property
+        std::vector<const string*> strings;     //values of string properties
+
+        ResolvedProps() : epoch(-1L) {}
+        //copies are not valid, as the copied style could be anchored to another model
+        ResolvedProps(const ResolvedProps&) : epoch(-1L) {}
+        ResolvedProps& operator= (const ResolvedProps&) { epoch = -1L; return *this; }
+    };
+    ResolvedProps m_resolved;
+    enum {
+        k_resolved_lunits = 0x01,
+        k_resolved_float =  0x02,
+        k_resolved_string = 0x04,
+        k_resolved_int =    0x08,
+        k_resolved_color =  0x10,
+    };
+
     friend class ImFactory;
     ImoStyle() : ImoSimpleObj(k_imo_style), m_name(), m_idParent(k_no_imoid) {}
 
@@ -2027,6 +2069,8 @@ public:
 
         //table
         k_table_col_width,
+
+        k_num_style_properties,     //AWARE: must be the last one
     };
 
     //general
@@ -2165,6 +2209,11 @@ protected:
     int get_int_property(int prop);
     Color get_color_property(int prop);
 
+    void resolve_properties();
+    void resolve_properties(long epoch);
+    long get_styles_epoch();
+    void on_style_modified();
+
 };
 
 //---------------------------------------------------------------------------------------
@@ -6115,6 +6164,13 @@ public:
         that will invoke this method on all scores. */
     void end_of_changes();
 
+    /** Faster alternative to end_of_changes() when the changes only modified the
+        music data of instrument @c iInstr in measures [firstMeasure, lastMeasure].
+        When @c firstMeasure is negative the modified measures are derived from the
+        dirty flags, and when @c lastMeasure is negative the range goes up to the
+        end of the score. */
+    void end_of_changes(int iInstr, int firstMeasure=-1, int lastMeasure=-1);
+
 
 protected:
     ImoScore& clone(const ImoScore& a);
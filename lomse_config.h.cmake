@@ -82,6 +82,10 @@
 // Enable threads (requires pthreads). If not enabled, ScorePlayer will not be included
 #define LOMSE_ENABLE_THREADS    @LOMSE_ENABLE_THREADS@
 
+// Dispatch events from a dedicated thread (requires threads). If not enabled, event
+// handlers are invoked directly
+#define LOMSE_ENABLE_EVENTS_THREAD    @LOMSE_ENABLE_EVENTS_THREAD@
+
 
 #endif  // __LOMSE_CONFIG_H__
 
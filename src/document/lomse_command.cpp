@@ -22,6 +22,7 @@
 #include "lomse_score_meter.h"
 #include "lomse_im_algorithms.h"
 #include "lomse_staffobjs_table.h"      //class ScoreAlgorithms
+#include "lomse_im_measures_table.h"
 #include "lomse_ldp_exporter.h"
 #include "lomse_internal_model.h"
 #include "lomse_score_algorithms.h"
@@ -219,6 +220,16 @@ void DocCmdComposite::update_selection(SelectionSet* pSelection,
 }
 
 
+//=======================================================================================
+// UndoElement
+//=======================================================================================
+UndoElement::~UndoElement()
+{
+    delete pCmd;
+    delete pCheckpoint;
+}
+
+
 //=======================================================================================
 // DocCommandExecuter
 //=======================================================================================
@@ -231,6 +242,31 @@ DocCommandExecuter::DocCommandExecuter(Document* target)
 DocCommandExecuter::~DocCommandExecuter()
 {
     delete m_pModelStart;
+    for (Checkpoint& checkpoint : m_checkpoints)
+        delete checkpoint.pModel;
+}
+
+//---------------------------------------------------------------------------------------
+void DocCommandExecuter::set_max_checkpoints(size_t maxCheckpoints)
+{
+    m_maxCheckpoints = maxCheckpoints;
+    while (m_checkpoints.size() > m_maxCheckpoints)
+    {
+        delete m_checkpoints.front().pModel;
+        m_checkpoints.erase(m_checkpoints.begin());
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void DocCommandExecuter::set_max_score_checkpoints(size_t maxCheckpoints)
+{
+    m_maxScoreCheckpoints = maxCheckpoints;
+    for (size_t i=0; i + m_maxScoreCheckpoints < m_stack.size(); ++i)
+    {
+        UndoElement* pUE = m_stack.get_item(int(i));
+        delete pUE->pCheckpoint;
+        pUE->pCheckpoint = nullptr;
+    }
 }
 
 //---------------------------------------------------------------------------------------
@@ -256,6 +292,9 @@ int DocCommandExecuter::execute(DocCursor* pCursor, DocCommand* pCmd,
         if (pCmd->get_cursor_update_policy() == DocCommand::k_refresh)
             pCmd->set_final_cursor_pos( pCursor->get_pointee_id() );
 
+        if (pUE)
+            save_score_checkpoint(pUE, pCursor);
+
         result = pCmd->perform_action(m_pDoc, pCursor);
         m_error = pCmd->get_error();
         if ( result == k_success && pCmd->is_reversible())
@@ -263,6 +302,8 @@ int DocCommandExecuter::execute(DocCursor* pCursor, DocCommand* pCmd,
             //by design, all commands that modify the document are reversible and must
             //support undo/redo
             m_stack.push( pUE );
+            trim_score_checkpoints();
+            save_checkpoint_if_needed();
             update_cursor(pCursor, pCmd);
             update_selection(pSelection, pCmd);
             m_pDoc->set_modified();
@@ -375,14 +416,28 @@ void DocCommandExecuter::undo(DocCursor* pCursor, SelectionSet* pSelection)
     if (pUE)
     {
         DocCommand* cmd = pUE->pCmd;
-        if (cmd->get_undo_policy() == DocCommand::k_undo_policy_replay_from_start)
-            replay_until(pUE, pCursor, pSelection);
-        else
+        int policy = cmd->get_undo_policy();
+        if (policy == DocCommand::k_undo_policy_specific)
         {
             cmd->undo_action(m_pDoc, pCursor);
             pCursor->restore_state( pUE->cursorState );
             pSelection->restore_state( pUE->selState );
         }
+        else if (pUE->pCheckpoint
+                 && m_pDoc->get_doc_model()->restore_score_checkpoint(pUE->pCheckpoint))
+        {
+            pCursor->restore_state( pUE->cursorState );
+            pSelection->restore_state( pUE->selState );
+        }
+        else
+            replay_until(pUE, pCursor, pSelection);
+
+        //the score copy is no longer valid. It will be taken again if the command
+        //is re-done
+        delete pUE->pCheckpoint;
+        pUE->pCheckpoint = nullptr;
+
+        discard_invalid_checkpoints();
         m_pDoc->set_dirty();
     }
 }
@@ -391,25 +446,106 @@ void DocCommandExecuter::undo(DocCursor* pCursor, SelectionSet* pSelection)
 void DocCommandExecuter::replay_until(UndoElement* pUE, DocCursor* pCursor,
                                       SelectionSet* pSelection)
 {
-    //restore initial model
-    m_pDoc->replace_model(m_pModelStart);
-    m_pModelStart = LOMSE_NEW DocModel(*m_pModelStart);
+    //AWARE: pUE is no longer in the stack. Therefore, the commands to replay are all
+    //the commands in the stack after the nearest checkpoint
 
-    //re-play all commands until the desired one
-    for (size_t i=0; i < m_stack.size(); ++i)
+    //restore the nearest checkpoint or, if none, the initial model
+    size_t iStart = 0;
+    DocModel** ppModel = &m_pModelStart;
+    for (auto it = m_checkpoints.rbegin(); it != m_checkpoints.rend(); ++it)
     {
-        UndoElement* pUEi = m_stack.get_item(i);
-        if (pUEi == pUE)
+        if (it->numCmds <= m_stack.size())
+        {
+            iStart = it->numCmds;
+            ppModel = &(it->pModel);
             break;
-
-        replay_command(pUEi, pCursor, pSelection);
+        }
     }
+    m_pDoc->replace_model(*ppModel);
+    *ppModel = LOMSE_NEW DocModel(**ppModel);
+
+    //re-play the commands after the checkpoint
+    for (size_t i=iStart; i < m_stack.size(); ++i)
+        replay_command(m_stack.get_item(int(i)), pCursor, pSelection);
 
     //restore selection and cursor state
     pCursor->restore_state( pUE->cursorState );
     pSelection->restore_state( pUE->selState );
 }
 
+//---------------------------------------------------------------------------------------
+void DocCommandExecuter::save_score_checkpoint(UndoElement* pUE, DocCursor* pCursor)
+{
+    //Commands with policy k_undo_policy_partial_checkpoint only modify the music
+    //data of the instrument pointed by the cursor. Therefore, only the music data is
+    //copied before executing the command. The rest of the document is not copied.
+
+    if (m_maxScoreCheckpoints == 0
+        || pUE->pCmd->get_undo_policy() != DocCommand::k_undo_policy_partial_checkpoint
+        || !pCursor->is_inside_terminal_node())
+    {
+        return;
+    }
+
+    ImoObj* pImo = pCursor->get_parent_object();
+    if (pImo && pImo->is_score())
+    {
+        ImoScore* pScore = static_cast<ImoScore*>(pImo);
+        ScoreCursor* pSC = static_cast<ScoreCursor*>( pCursor->get_inner_cursor() );
+        ImoInstrument* pInstr = pScore->get_instrument( pSC->instrument() );
+        ImoMusicData* pMD = (pInstr ? pInstr->get_musicdata() : nullptr);
+        if (pMD && pMD->get_id() != k_no_imoid)
+            pImo = pMD;
+
+        DocModel* pModel = m_pDoc->get_doc_model();
+        pUE->pCheckpoint = pModel->create_score_checkpoint(pImo);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void DocCommandExecuter::trim_score_checkpoints()
+{
+    //only the last m_maxScoreCheckpoints commands keep their score copy
+
+    if (m_stack.size() > m_maxScoreCheckpoints)
+    {
+        UndoElement* pUE = m_stack.get_item(int(m_stack.size() - m_maxScoreCheckpoints - 1));
+        delete pUE->pCheckpoint;
+        pUE->pCheckpoint = nullptr;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void DocCommandExecuter::save_checkpoint_if_needed()
+{
+    if (m_checkpointInterval == 0 || m_maxCheckpoints == 0)
+        return;
+
+    size_t numCmds = m_stack.size();
+    size_t last = (m_checkpoints.empty() ? 0 : m_checkpoints.back().numCmds);
+    if (numCmds >= last + m_checkpointInterval)
+    {
+        m_checkpoints.push_back({numCmds, m_pDoc->create_model_copy()});
+        if (m_checkpoints.size() > m_maxCheckpoints)
+        {
+            delete m_checkpoints.front().pModel;
+            m_checkpoints.erase(m_checkpoints.begin());
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void DocCommandExecuter::discard_invalid_checkpoints()
+{
+    //checkpoints taken after the current top of the stack are no longer valid
+
+    while (!m_checkpoints.empty() && m_checkpoints.back().numCmds > m_stack.size())
+    {
+        delete m_checkpoints.back().pModel;
+        m_checkpoints.pop_back();
+    }
+}
+
 //---------------------------------------------------------------------------------------
 void DocCommandExecuter::replay_command(UndoElement* pUE, DocCursor* pCursor,
                                         SelectionSet* pSelection)
@@ -432,8 +568,11 @@ void DocCommandExecuter::redo(DocCursor* pCursor, SelectionSet* pSelection)
     {
         pCursor->restore_state( pUE->cursorState );
         pSelection->restore_state( pUE->selState );
+        save_score_checkpoint(pUE, pCursor);
         DocCommand* cmd = pUE->pCmd;
         cmd->perform_action(m_pDoc, pCursor);
+        trim_score_checkpoints();
+        save_checkpoint_if_needed();
 
         update_cursor(pCursor, cmd);
         update_selection(pSelection, cmd);
@@ -541,12 +680,76 @@ int CmdAddChordNote::perform_action(Document* pDoc, DocCursor* pCursor)
     //create or update the chord
     ImoTreeAlgoritms::add_note_to_chord(pBaseNote, pNewNote, pDoc);
 
-    //force to rebuild ColStaffObjs table
-    pScore->end_of_changes();
+    //update the ColStaffObjs table or, when not possible, force to rebuild it. Only
+    //the measure containing the chord has been modified
+    if (!update_staffobjs_table(pScore, pBaseNote, pNewNote))
+    {
+        ColStaffObjs* pTable = pScore->get_staffobjs_table();
+        ColStaffObjsEntry* pEntry = (pTable ? *(pTable->find(pBaseNote)) : nullptr);
+        if (pEntry)
+            pScore->end_of_changes(pEntry->num_instrument(), pEntry->measure(),
+                                   pEntry->measure());
+        else
+            pScore->end_of_changes();
+    }
 
     return k_success;
 }
 
+//---------------------------------------------------------------------------------------
+bool CmdAddChordNote::update_staffobjs_table(ImoScore* pScore, ImoNote* pBaseNote,
+                                             ImoNote* pNewNote)
+{
+    //The new note is inserted in the table just after the base note. This is only
+    //valid when the new note does not change the timepos of any other staffobj nor
+    //the playback info computed when building the table (grace notes and arpeggios).
+    //Returns false if the table must be rebuilt
+
+    ColStaffObjs* pTable = pScore->get_staffobjs_table();
+    ColStaffObjsEntry* pBaseEntry = (pTable ? *(pTable->find(pBaseNote)) : nullptr);
+    if (!pBaseEntry || pBaseNote->is_grace_note()
+        || pNewNote->get_voice() != pBaseNote->get_voice()
+        || pNewNote->get_staff() != pBaseNote->get_staff()
+        || !is_equal_time(pNewNote->get_duration(), pBaseNote->get_duration())
+        || !is_equal_time(pBaseNote->get_playback_time(), pBaseNote->get_time())
+        || !is_equal_time(pBaseNote->get_playback_duration(), pBaseNote->get_duration())
+        || is_greater_time(pTable->anacrusis_extra_time(), 0.0))
+    {
+        return false;
+    }
+
+    //the base note must be the previous end of chord, so that the new note is the
+    //last one in the chord. And all notes in the chord must have the same duration,
+    //so that the chord end note advances the time by the same amount
+    ImoChord* pChord = pBaseNote->get_chord();
+    auto& notes = pChord->get_related_objects();
+    if (notes.size() < 2 || (++notes.rbegin())->first != pBaseNote)
+        return false;
+
+    for (auto& item : notes)
+    {
+        ImoNote* pNote = static_cast<ImoNote*>( item.first );
+        if (pNote->get_arpeggio()
+            || !is_equal_time(pNote->get_duration(), pNewNote->get_duration()))
+        {
+            return false;
+        }
+    }
+
+    pNewNote->set_time( pBaseNote->get_time() );
+    pNewNote->reset_playback_duration();
+    pTable->insert_entry_after(pBaseEntry, pBaseEntry->measure(),
+                               pBaseEntry->num_instrument(), pBaseEntry->line(),
+                               pBaseEntry->staff(), pNewNote);
+    pTable->count_noterest(pNewNote);
+
+    //the other tables are not affected but notes pitch must be computed
+    PitchAssigner tuner;
+    tuner.assign_pitch(pScore, pBaseEntry->num_instrument(), pBaseEntry->measure(),
+                       pBaseEntry->measure());
+    return true;
+}
+
 //---------------------------------------------------------------------------------------
 void CmdAddChordNote::update_selection(SelectionSet* pSelection)
 {
@@ -612,9 +815,17 @@ int CmdAddNoteRest::perform_action(Document* pDoc, DocCursor* pCursor)
     m_finalSrc = m_source;
 
     get_data_about_insertion_point();
+    int measure = m_pSC->measure();
     get_data_about_noterest_to_insert();
     find_and_classify_overlapped_noterests();
     determine_insertion_point();
+    if (replace_overlapped_noterest())
+    {
+        clear_temporary_objects();
+        update_cursor();
+        return k_success;
+    }
+
     if (!m_overlaps.empty())
     {
         reduce_duration_of_overlapped_at_end();
@@ -631,8 +842,9 @@ int CmdAddNoteRest::perform_action(Document* pDoc, DocCursor* pCursor)
 
     clear_temporary_objects();
 
-    //rebuild ColStaffObjs table, as there are objects added/removed
-    m_pScore->end_of_changes();
+    //rebuild ColStaffObjs table, as there are objects added/removed. Overlapped
+    //noterests could be in next measures
+    m_pScore->end_of_changes(m_instr, measure, -1);
     update_cursor();
 
     return k_success;
@@ -821,6 +1033,68 @@ void CmdAddNoteRest::add_new_note_to_existing_beam_if_necessary()
     }
 }
 
+//---------------------------------------------------------------------------------------
+bool CmdAddNoteRest::replace_overlapped_noterest()
+{
+    //When the new noterest just replaces a noterest with the same timepos, duration,
+    //voice and staff, no other staffobj changes its timepos, and the table entry for
+    //the replaced noterest is reused for the new one instead of rebuilding the table.
+    //Same note type, dots and time modification are required, so that the noterests
+    //count, divisions and min note duration do not change. Beamed noterests are
+    //excluded, as the beam must be reorganized. Returns false, and nothing is
+    //changed, when this is not possible
+
+    ColStaffObjs* pTable = m_pScore->get_staffobjs_table();
+    if (!pTable || m_overlaps.size() != 1 || m_overlaps.front()->type != k_overlap_full
+        || is_greater_time(pTable->anacrusis_extra_time(), 0.0))
+    {
+        return false;
+    }
+
+    ImoNoteRest* pOldNR = m_overlaps.front()->pNR;
+    ColStaffObjsEntry* pEntry = *(pTable->find(pOldNR));
+    if (!pEntry || pOldNR->is_grace_note() || pOldNR->is_beamed()
+        || (pOldNR->is_note() && static_cast<ImoNote*>(pOldNR)->is_in_chord())
+        || pOldNR->get_voice() != m_pNewNR->get_voice()
+        || pOldNR->get_staff() != m_pNewNR->get_staff()
+        || pOldNR->get_note_type() != m_pNewNR->get_note_type()
+        || pOldNR->get_dots() != m_pNewNR->get_dots()
+        || pOldNR->get_time_modifier_top() != m_pNewNR->get_time_modifier_top()
+        || pOldNR->get_time_modifier_bottom() != m_pNewNR->get_time_modifier_bottom()
+        || !is_equal_time(pOldNR->get_time(), m_insertionTime)
+        || !is_equal_time(pOldNR->get_duration(), m_newDuration)
+        || !is_equal_time(pOldNR->get_playback_time(), pOldNR->get_time())
+        || !is_equal_time(pOldNR->get_playback_duration(), pOldNR->get_duration()))
+    {
+        return false;
+    }
+
+    //insert the new content just after the replaced noterest
+    stringstream errormsg;
+    m_insertedObjs = m_pInstr->insert_staff_objects_at(m_pAt, m_finalSrc, errormsg);
+    int measure = pEntry->measure();
+    ImoStaffObj* pNewSO = (m_insertedObjs.size() == 1 ? m_insertedObjs.front() : nullptr);
+    if (!pNewSO || !pNewSO->is_note_rest() || pNewSO->is_grace_note()
+        || (pNewSO->is_note() && static_cast<ImoNote*>(pNewSO)->is_in_chord()))
+    {
+        //unexpected content. Remove the replaced noterest and rebuild the table
+        ImoTreeAlgoritms::remove_staffobj(m_pDoc, pOldNR);
+        m_pScore->end_of_changes(m_instr, measure, -1);
+        return true;
+    }
+
+    ImoNoteRest* pNewNR = static_cast<ImoNoteRest*>(pNewSO);
+    pNewNR->set_time( pOldNR->get_time() );
+    pNewNR->reset_playback_duration();
+    pTable->replace_entry_for(pOldNR, pNewNR);
+    ImoTreeAlgoritms::remove_staffobj(m_pDoc, pOldNR);
+
+    //the other tables are not affected but notes pitch must be computed
+    PitchAssigner tuner;
+    tuner.assign_pitch(m_pScore, m_instr, measure, measure);
+    return true;
+}
+
 //---------------------------------------------------------------------------------------
 void CmdAddNoteRest::update_selection(SelectionSet* pSelection)
 {
@@ -1386,18 +1660,28 @@ int CmdChangeDots::set_target(Document* UNUSED(pDoc), DocCursor* UNUSED(pCursor)
 //---------------------------------------------------------------------------------------
 int CmdChangeDots::perform_action(Document* pDoc, DocCursor* pCursor)
 {
+    ImoInstrument* pInstr = nullptr;
+    bool fOneInstrument = true;
     list<ImoId>::iterator it;
     for (it = m_noteRests.begin(); it != m_noteRests.end(); ++it)
     {
         ImoNoteRest* pNR = static_cast<ImoNoteRest*>( pDoc->get_pointer_to_imo(*it) );
         pNR->set_dots(m_dots);
         pNR->set_dirty(true);
+
+        if (pInstr == nullptr)
+            pInstr = pNR->get_instrument();
+        fOneInstrument &= (pInstr == pNR->get_instrument());
     }
 
     //rebuild StaffObjs collection, as duration of some objects have changed and this
-    //affects to timepos of objects after them
+    //affects to timepos of objects after them. When all noterests are in the same
+    //instrument, the modified measures are those with dirty noterests
     ImoScore* pScore = static_cast<ImoScore*>( pCursor->get_parent_object() );
-    pScore->end_of_changes();
+    if (pInstr && fOneInstrument)
+        pScore->end_of_changes( pScore->get_instr_number_for(pInstr) );
+    else
+        pScore->end_of_changes();
 
     return k_success;
 }
@@ -1973,6 +2257,27 @@ int CmdDeleteStaffObj::perform_action(Document* pDoc, DocCursor* pCursor)
         if (m_name == "")
             set_command_name("Delete ", pImo);
 
+        //get data about the modified measure. When deleting a barline, the measure
+        //is merged with the next one
+        ImoScore* pScore = static_cast<ImoScore*>( pCursor->get_parent_object() );
+        ColStaffObjs* pTable = pScore->get_staffobjs_table();
+        ColStaffObjsEntry* pEntry = (pTable ? *(pTable->find(pImo)) : nullptr);
+        int iInstr = (pEntry ? pEntry->num_instrument() : -1);
+        int measure = (pEntry ? pEntry->measure() : 0);
+        bool fKey = pImo->is_key_signature();
+
+        //when possible, the entry is just removed from the table
+        bool fRemoveEntry = is_removable_from_table(pTable, pImo);
+        bool fMeasureStart = false;
+        if (fRemoveEntry)
+        {
+            ImMeasuresTable* pMeasures = pImo->get_instrument()->get_measures_table();
+            ImMeasuresTableEntry* pMeasure =
+                (pMeasures ? pMeasures->get_measure(measure) : nullptr);
+            fMeasureStart = (!pMeasure || pMeasure->get_start_entry() == pEntry);
+            pTable->discount_noterest( static_cast<ImoNoteRest*>(pImo) );
+        }
+
         //get and save relations
         vector<ImoId> relIds;
         ImoRelations* pRels = pImo->get_relations();
@@ -2005,15 +2310,69 @@ int CmdDeleteStaffObj::perform_action(Document* pDoc, DocCursor* pCursor)
             }
         }
 
-        //rebuild StaffObjs collection
-        ImoScore* pScore = static_cast<ImoScore*>( pCursor->get_parent_object() );
-        pScore->end_of_changes();
+        //rebuild StaffObjs collection. Only the measure containing the object has
+        //been modified, but a key signature affects all following measures
+        if (fRemoveEntry)
+        {
+            //the entry was removed when deleting the object. A measure can not
+            //point to it
+            if (fMeasureStart)
+            {
+                MeasuresTableBuilder measures;
+                measures.build(pScore, iInstr);
+            }
+            PitchAssigner tuner;
+            tuner.assign_pitch(pScore, iInstr, measure, measure);
+        }
+        else if (iInstr >= 0)
+            pScore->end_of_changes(iInstr, measure, (fKey ? -1 : measure));
+        else
+            pScore->end_of_changes();
 
         return k_success;
     }
     return k_failure;
 }
 
+//---------------------------------------------------------------------------------------
+bool CmdDeleteStaffObj::is_removable_from_table(ColStaffObjs* pTable, ImoStaffObj* pImo)
+{
+    //The entry for the deleted staffobj can be just removed from the table when no
+    //other staffobj changes its timepos nor the playback info computed when building
+    //the table (grace notes and arpeggios). This is the case for a note in a chord
+    //when all the notes in the chord have the same duration: the note that advances
+    //the time advances it by the same amount. As the remaining notes have the same
+    //type, dots and time modification, divisions and min note duration do not change
+
+    if (!pTable || !pImo->is_note() || pImo->is_grace_note()
+        || is_greater_time(pTable->anacrusis_extra_time(), 0.0))
+    {
+        return false;
+    }
+
+    ImoNote* pNote = static_cast<ImoNote*>(pImo);
+    if (!pNote->is_in_chord() || !*(pTable->find(pNote)))
+        return false;
+
+    auto& notes = pNote->get_chord()->get_related_objects();
+    for (auto& item : notes)
+    {
+        ImoNote* pN = static_cast<ImoNote*>( item.first );
+        if (pN->get_arpeggio()
+            || pN->get_note_type() != pNote->get_note_type()
+            || pN->get_dots() != pNote->get_dots()
+            || pN->get_time_modifier_top() != pNote->get_time_modifier_top()
+            || pN->get_time_modifier_bottom() != pNote->get_time_modifier_bottom()
+            || !is_equal_time(pN->get_duration(), pNote->get_duration())
+            || !is_equal_time(pN->get_playback_time(), pN->get_time())
+            || !is_equal_time(pN->get_playback_duration(), pN->get_duration()))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 
 //=======================================================================================
 // CmdInsert implementation
@@ -2165,7 +2524,9 @@ int CmdInsertManyStaffObjs::perform_action(Document* pDoc, DocCursor* pCursor)
         list<ImoStaffObj*> objects = pInstr->insert_staff_objects_at(pAt, m_source, errormsg);
         if (objects.size() > 0)
         {
-            pScore->end_of_changes();        //update ColStaffObjs table
+            //update ColStaffObjs table. Inserted objects could include barlines and
+            //key signatures, affecting all following measures
+            pScore->end_of_changes(pSC->instrument(), pSC->measure(), -1);
             m_lastInsertedId = objects.back()->get_id();
             objects.clear();
             return k_success;
@@ -2238,8 +2599,16 @@ int CmdInsertStaffObj::perform_action(Document* pDoc, DocCursor* pCursor)
                 m_source = source.str();
             }
 
-            //update ColStaffObjs table
-            pScore->end_of_changes();
+            //update ColStaffObjs table. Only the measure at insertion point has been
+            //modified, but a barline splits it and a key signature affects all
+            //following measures
+            int measure = pState->measure();
+            int lastMeasure = measure;
+            if (pImo->is_barline())
+                lastMeasure = measure + 1;
+            else if (pImo->is_key_signature())
+                lastMeasure = -1;
+            pScore->end_of_changes(pState->instrument(), measure, lastMeasure);
 
             //assign name to this command
             if (m_name == "")
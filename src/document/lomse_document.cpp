@@ -191,8 +191,10 @@ DocModel& DocModel::clone(const DocModel& a)
     //copy xml strings from old IdAssigner
     m_pIdAssigner->copy_strings_from(a.m_pIdAssigner);
 
-    //use the maximum found id to instantiate idCounter
-    m_pIdAssigner->set_counter( v.max_id() );
+    //use the maximum found id to instantiate idCounter. AWARE: ids of deleted objects
+    //could be higher. They are not reused, so that replaying commands on the copy
+    //assigns the same ids than in the original
+    m_pIdAssigner->set_counter( max(v.max_id(), a.m_pIdAssigner->m_idCounter) );
 
     //build ColStaffObjs and ImMeasureTable
     //TODO: for speed, instead of running everything, only ColStaffObjs and ImMeasureTable
@@ -297,6 +299,80 @@ void DocModel::on_removed_from_model(ImoObj* pImo)
     m_pIdAssigner->remove(pImo);
 }
 
+//---------------------------------------------------------------------------------------
+ScoreCheckpoint* DocModel::create_score_checkpoint(ImoObj* pImo)
+{
+    //pImo is the score or the part of it to copy. It must have an id
+
+    ScoreCheckpoint* pCheckpoint = LOMSE_NEW ScoreCheckpoint();
+    pCheckpoint->m_copiedId = pImo->get_id();
+    pCheckpoint->m_idCounter = m_pIdAssigner->m_idCounter;
+    pCheckpoint->m_pCopy = ImFactory::clone(pImo);
+
+    //anchor the copy to a private model, so that it can be deleted without
+    //affecting this model
+    DocModel* pModel = LOMSE_NEW DocModel(m_pDoc);
+    pCheckpoint->m_pModel = pModel;
+    FixModelVisitor v(pModel, pModel->m_pIdAssigner);
+    pCheckpoint->m_pCopy->accept_visitor(v);
+
+    //save xml ids
+    for (auto& it : pModel->m_pIdAssigner->m_idToImo)
+    {
+        string xmlId = m_pIdAssigner->get_xml_id_for(it.first);
+        if (!xmlId.empty())
+            pModel->m_pIdAssigner->set_xml_id_for(it.first, xmlId);
+    }
+
+    return pCheckpoint;
+}
+
+//---------------------------------------------------------------------------------------
+bool DocModel::restore_score_checkpoint(ScoreCheckpoint* pCheckpoint)
+{
+    //Replaces the copied object by the copy saved in the checkpoint. The copy is
+    //transferred to this model and, therefore, the checkpoint can not be restored again.
+
+    ImoObj* pOld = get_pointer_to_imo( pCheckpoint->m_copiedId );
+    ImoObj* pCopy = pCheckpoint->m_pCopy;
+    if (pOld == nullptr || pCopy == nullptr || pOld->get_obj_type() != pCopy->get_obj_type())
+        return false;
+
+    ImoObj* pScore = pOld;
+    while (pScore && !pScore->is_score())
+        pScore = pScore->get_parent_imo();
+    if (pScore == pOld)
+        pScore = pCopy;
+
+    pCheckpoint->m_pCopy = nullptr;
+    m_pImoDoc->replace_node(pOld, pCopy);
+    delete pOld;        //this also removes its ids from the IdAssigner
+
+    //add ptr to this DocModel in ImoObjs and restore the ids
+    FixModelVisitor v(this, m_pIdAssigner);
+    pCopy->accept_visitor(v);
+    m_pIdAssigner->copy_strings_from( pCheckpoint->m_pModel->m_pIdAssigner );
+    m_pIdAssigner->set_counter( pCheckpoint->m_idCounter );
+
+    //build ColStaffObjs and ImMeasureTable
+    ModelBuilder builder;
+    builder.fix_model(pScore);
+
+    add_unique_model_ref();
+    return true;
+}
+
+
+//=======================================================================================
+// ScoreCheckpoint implementation
+//=======================================================================================
+ScoreCheckpoint::~ScoreCheckpoint()
+{
+    //AWARE: the copy must be deleted before its model
+    delete m_pCopy;
+    delete m_pModel;
+}
+
 
 
 //=======================================================================================
@@ -1170,9 +1170,8 @@ void ScoreCursor::to_time(int iInstr, int iStaff, TimeUnits rTargetTime)
     m_currentState.instrument(iInstr);
     m_currentState.staff(iStaff);
 
-    //optimization: avoid search from start if current time lower than target time
-    if (!p_there_is_iter_object() || is_greater_time(p_iter_object_time(), rTargetTime))
-        m_it = m_pColStaffObjs->begin();
+    //binary search for first entry at target time, then search instrument
+    m_it = ColStaffObjsIterator( m_pColStaffObjs->get_first_entry_not_before(rTargetTime) );
 
     p_forward_to_instr_with_time_not_lower_than(rTargetTime);
 
@@ -1225,39 +1224,18 @@ void ScoreCursor::to_measure(int measure, int instr, int staff)
         return;
     }
 
-    m_startOfBarTimepos = 0.0;
-    m_curBeatDuration = k_duration_quarter;
-
-    m_it = m_pColStaffObjs->begin();
-    while (p_there_is_iter_object())
-    {
-        if (p_iter_object_instrument() == m_currentState.instrument())
-        {
-            if (p_iter_object()->is_barline())
-            {
-                m_startOfBarTimepos = p_iter_object_time();
-                if (p_iter_object_measure() == measure - 1)
-                {
-                    m_currentState.time( p_iter_object_time() );
-                    p_update_pointed_object();
-                    to_next_staffobj(true);
-                    return;
-                }
-            }
-            if (p_iter_object()->is_time_signature())
-            {
-                ImoTimeSignature* pTS =
-                        static_cast<ImoTimeSignature*>( p_iter_object() );
-                m_curBeatDuration = pTS->get_beat_duration();
-            }
-        }
-        p_move_iterator_to_next();
-    }
+    //the barline at end of previous measure is the start of the measure
+    ColStaffObjsEntry* pBarline =
+        m_pColStaffObjs->get_barline_for_measure(m_currentState.instrument(),
+                                                 measure - 1);
+    m_it = ColStaffObjsIterator(pBarline);
+    p_find_start_of_measure_and_time_signature(pBarline);
 
     if (p_there_is_iter_object())
     {
         m_currentState.time( p_iter_object_time() );
         p_update_pointed_object();
+        to_next_staffobj(true);
     }
     else
     {
@@ -1429,13 +1407,11 @@ void ScoreCursor::p_move_iterator_to_next()
 //---------------------------------------------------------------------------------------
 void ScoreCursor::p_move_iterator_to(ImoId id)
 {
-    if (id <= k_no_imoid)
-        m_it = m_pColStaffObjs->end();
+    ImoObj* pImo = (id > k_no_imoid ? m_pDoc->get_pointer_to_imo(id) : nullptr);
+    if (pImo && pImo->is_staffobj())
+        m_it = m_pColStaffObjs->find( static_cast<ImoStaffObj*>(pImo) );
     else
-    {
-        m_it = m_pColStaffObjs->begin();
-        for (; m_it != m_pColStaffObjs->end() && (*m_it)->element_id() != id; ++m_it);
-    }
+        m_it = m_pColStaffObjs->end();
 }
 
 //---------------------------------------------------------------------------------------
@@ -1817,35 +1793,35 @@ void ScoreCursor::p_determine_total_duration()
 //---------------------------------------------------------------------------------------
 void ScoreCursor::p_find_start_of_measure_and_time_signature()
 {
-    bool fBarlineFound = false;
-    bool fTimeFound = false;
+    if (p_there_is_iter_object())
+        p_find_start_of_measure_and_time_signature(*m_it);
+    else
+    {
+        m_startOfBarTimepos = 0.0;
+        m_curBeatDuration = k_duration_quarter;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void ScoreCursor::p_find_start_of_measure_and_time_signature(ColStaffObjsEntry* pEntry)
+{
+    //find last barline and last time signature in current instrument before pEntry.
+    //If pEntry is nullptr, before end of table
+
     m_startOfBarTimepos = 0.0;
     m_curBeatDuration = k_duration_quarter;
+    int instr = m_currentState.instrument();
 
-    ColStaffObjsIterator itSave = m_it;
-    p_move_iterator_to_prev();
-    while (p_there_is_iter_object())
+    ColStaffObjsEntry* pBarline = m_pColStaffObjs->get_prev_barline(instr, pEntry);
+    if (pBarline)
+        m_startOfBarTimepos = pBarline->time();
+
+    ColStaffObjsEntry* pTime = m_pColStaffObjs->get_prev_time_signature(instr, pEntry);
+    if (pTime)
     {
-        if (p_iter_object_instrument() == m_currentState.instrument())
-        {
-            if (!fBarlineFound && p_iter_object()->is_barline())
-            {
-                m_startOfBarTimepos = p_iter_object_time();
-                fBarlineFound = true;
-            }
-            if (!fTimeFound && p_iter_object()->is_time_signature())
-            {
-                ImoTimeSignature* pTS =
-                        static_cast<ImoTimeSignature*>( p_iter_object() );
-                m_curBeatDuration = pTS->get_beat_duration();
-                fTimeFound = true;
-            }
-        }
-        if (fBarlineFound && fTimeFound)
-            break;
-        p_move_iterator_to_prev();
+        ImoTimeSignature* pTS = static_cast<ImoTimeSignature*>( pTime->imo_object() );
+        m_curBeatDuration = pTS->get_beat_duration();
     }
-    m_it = itSave;
 }
 
 
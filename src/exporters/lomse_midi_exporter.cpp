@@ -0,0 +1,452 @@
+//---------------------------------------------------------------------------------------
+// This file is part of the Lomse library.
+// Copyright (c) 2010-present, Lomse Developers
+//
+// Licensed under the MIT license.
+//
+// See LICENSE and NOTICE.md files in the root directory of this source tree.
+//---------------------------------------------------------------------------------------
+
+#include "lomse_midi_exporter.h"
+
+#include "lomse_internal_model.h"
+#include "lomse_midi_table.h"
+#include "lomse_staffobjs_cursor.h"
+#include "lomse_im_attributes.h"
+#include "lomse_logger.h"
+
+#include <algorithm>
+#include <cmath>        //round
+using namespace std;
+
+namespace lomse
+{
+
+//=======================================================================================
+// MidiTrackWriter: helper class to accumulate the events for a track and to encode
+// them in SMF format
+//=======================================================================================
+class MidiTrackWriter
+{
+protected:
+    struct MidiEvent
+    {
+        long tick;
+        std::vector<unsigned char> data;
+    };
+    std::vector<MidiEvent> m_events;
+
+public:
+    MidiTrackWriter() {}
+
+    //channel events
+    inline void program_change(long tick, int channel, int program) {
+        add_event(tick, { byte(0xC0 | (channel & 0x0F)), byte(program) });
+    }
+    inline void note_on(long tick, int channel, int pitch, int volume) {
+        add_event(tick, { byte(0x90 | (channel & 0x0F)), byte(pitch), byte(volume) });
+    }
+    inline void note_off(long tick, int channel, int pitch) {
+        add_event(tick, { byte(0x80 | (channel & 0x0F)), byte(pitch), 64 });
+    }
+
+    //meta events
+    void set_tempo(long tick, float bpm)
+    {
+        long usecs = long( round(60000000.0 / double(bpm)) );
+        add_event(tick, { 0xFF, 0x51, 0x03, byte(usecs >> 16), byte(usecs >> 8),
+                          byte(usecs) });
+    }
+
+    void time_signature(long tick, int top, int denominator, int clocksPerClick)
+    {
+        int log2Den = 0;
+        while ((1 << log2Den) < denominator)
+            ++log2Den;
+        if ((1 << log2Den) != denominator)
+            return;     //not representable
+
+        add_event(tick, { 0xFF, 0x58, 0x04, byte(top), byte(log2Den),
+                          byte(clocksPerClick), 8 });
+    }
+
+    void track_name(const std::string& name)
+    {
+        std::vector<unsigned char> data = { 0xFF, 0x03 };
+        append_variable_length(data, long(name.size()));
+        data.insert(data.end(), name.begin(), name.end());
+        m_events.push_back( {0L, data} );
+    }
+
+    void write(std::ostream& out)
+    {
+        //events are stored in time order, except for the metronome clicks, in
+        //which a click off could be after next event in other segment. Stable
+        //sort to preserve the order of events at the same time.
+        std::stable_sort(m_events.begin(), m_events.end(),
+                         [](const MidiEvent& a, const MidiEvent& b)
+                         { return a.tick < b.tick; });
+
+        std::vector<unsigned char> data;
+        long prevTick = 0L;
+        for (auto& ev : m_events)
+        {
+            append_variable_length(data, ev.tick - prevTick);
+            data.insert(data.end(), ev.data.begin(), ev.data.end());
+            prevTick = ev.tick;
+        }
+        data.insert(data.end(), { 0x00, 0xFF, 0x2F, 0x00 });    //end of track
+
+        out.write("MTrk", 4);
+        write_32(out, long(data.size()));
+        out.write(reinterpret_cast<const char*>(&data[0]), streamsize(data.size()));
+    }
+
+    static void write_32(std::ostream& out, long value)
+    {
+        char bytes[4] = { char(value >> 24), char(value >> 16), char(value >> 8),
+                          char(value) };
+        out.write(bytes, 4);
+    }
+
+    static void write_16(std::ostream& out, int value)
+    {
+        char bytes[2] = { char(value >> 8), char(value) };
+        out.write(bytes, 2);
+    }
+
+protected:
+    static inline unsigned char byte(long value) {
+        return static_cast<unsigned char>(value & 0xFF);
+    }
+
+    inline void add_event(long tick, std::initializer_list<unsigned char> data) {
+        m_events.push_back( {tick, std::vector<unsigned char>(data)} );
+    }
+
+    static void append_variable_length(std::vector<unsigned char>& data, long value)
+    {
+        unsigned char buffer[5];
+        int n = 0;
+        buffer[n++] = byte(value & 0x7F);
+        while ((value >>= 7) > 0)
+            buffer[n++] = byte((value & 0x7F) | 0x80);
+        while (n > 0)
+            data.push_back(buffer[--n]);
+    }
+};
+
+
+//=======================================================================================
+// MidiExporter implementation
+//=======================================================================================
+MidiExporter::MidiExporter(LibraryScope& libScope)
+    : m_libraryScope(libScope)
+{
+}
+
+//---------------------------------------------------------------------------------------
+MidiExporter::~MidiExporter()
+{
+    delete_tracks();
+}
+
+//---------------------------------------------------------------------------------------
+void MidiExporter::delete_tracks()
+{
+    for (auto it : m_tracks)
+        delete it.second;
+    m_tracks.clear();
+}
+
+//---------------------------------------------------------------------------------------
+bool MidiExporter::export_score(AScore score, std::ostream& out)
+{
+    if (score.is_valid())
+        return export_score(score.internal_object(), out);
+
+    return false;
+}
+
+//---------------------------------------------------------------------------------------
+bool MidiExporter::export_score(ImoScore* pScore, std::ostream& out)
+{
+    if (!pScore)
+        return false;
+
+    m_pTable = pScore->get_midi_table();
+    if (m_pTable->num_events() == 0)
+        return false;
+
+    delete_tracks();
+    collect_tempo_marks(pScore);
+    collect_rhythm_changes();
+
+    MidiTrackWriter conductor;
+    MidiTrackWriter metronome;
+    generate_tracks(&conductor, (m_fMetronome ? &metronome : nullptr));
+
+    //header chunk
+    int numTracks = 1 + int(m_tracks.size()) + (m_fMetronome ? 1 : 0);
+    out.write("MThd", 4);
+    MidiTrackWriter::write_32(out, 6L);
+    MidiTrackWriter::write_16(out, 1);      //format 1
+    MidiTrackWriter::write_16(out, numTracks);
+    MidiTrackWriter::write_16(out, m_division);
+
+    //track chunks
+    conductor.write(out);
+    for (auto it : m_tracks)
+        it.second->write(out);
+    if (m_fMetronome)
+        metronome.write(out);
+
+    delete_tracks();
+    m_pTable = nullptr;
+    return out.good();
+}
+
+//---------------------------------------------------------------------------------------
+void MidiExporter::collect_tempo_marks(ImoScore* pScore)
+{
+    //tempo for playback is defined in ImoSoundChange objects, either as staffobjs
+    //or as children of ImoDirection objects. Only tempo marks in first instrument
+    //are taken into account
+
+    m_tempos.clear();
+    m_tempos[0L] = m_defaultTempo;
+    if (m_fForceTempo)
+        return;
+
+    StaffObjsCursor cursor(pScore);
+    while(!cursor.is_end())
+    {
+        if (cursor.num_instrument() == 0)
+        {
+            ImoStaffObj* pSO = cursor.get_staffobj();
+            ImoSoundChange* pSound = nullptr;
+            if (pSO->is_sound_change())
+                pSound = static_cast<ImoSoundChange*>(pSO);
+            else if (pSO->is_direction())
+                pSound = static_cast<ImoSoundChange*>(
+                                pSO->get_child_of_type(k_imo_sound_change));
+
+            if (pSound && pSound->has_attributte(k_attr_tempo))
+            {
+                float bpm = pSound->get_float_attribute(k_attr_tempo);
+                if (bpm > 0.0f)
+                    m_tempos[long(pSO->get_time() + 0.5)] = bpm;
+            }
+        }
+        cursor.move_next();
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void MidiExporter::collect_rhythm_changes()
+{
+    //When no time signature, ScorePlayer assumes 4/4 with quarter note beats
+    m_rhythms.clear();
+    m_rhythms[0L] = make_pair(long(4 * k_duration_quarter), long(k_duration_quarter));
+
+    for (auto& ev : m_pTable->get_events())
+    {
+        SoundEvent* pEv = &ev;
+        if (pEv->EventType == SoundEvent::k_rhythm_change && pEv->NumPulses > 0)
+        {
+            long measure = long(pEv->TopNumber) * long(pEv->BeatDuration);
+            m_rhythms[pEv->DeltaTime] = make_pair(measure, measure / pEv->NumPulses);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+float MidiExporter::tempo_at(long time)
+{
+    map<long, float>::iterator it = m_tempos.upper_bound(time);
+    --it;       //always exists: there is an entry for time 0
+    return it->second;
+}
+
+//---------------------------------------------------------------------------------------
+long MidiExporter::to_ticks(long time)
+{
+    return long( round(double(time) * double(m_division) / double(k_duration_quarter)) );
+}
+
+//---------------------------------------------------------------------------------------
+MidiTrackWriter* MidiExporter::get_track(int channel)
+{
+    map<int, MidiTrackWriter*>::iterator it = m_tracks.find(channel);
+    if (it != m_tracks.end())
+        return it->second;
+
+    MidiTrackWriter* pTrack = LOMSE_NEW MidiTrackWriter();
+    m_tracks[channel] = pTrack;
+    return pTrack;
+}
+
+//---------------------------------------------------------------------------------------
+void MidiExporter::generate_tracks(MidiTrackWriter* pConductor,
+                                   MidiTrackWriter* pMetronome)
+{
+    //Traverse the events table as ScorePlayer does, executing the jumps. Playback
+    //time is continuous: when a jump is executed, the difference between the jump
+    //time and the target time is accumulated in 'offset', so that the time for
+    //an event in the generated sequence is (event time + offset).
+
+    std::vector<SoundEvent>& events = m_pTable->get_events();
+    int maxEvent = int(events.size());
+    long offset = 0L;
+    long segmentStart = 0L;     //score time at which current played segment started
+    float curTempo = -1.0f;
+
+    if (pMetronome)
+    {
+        pMetronome->track_name("Metronome");
+        pMetronome->program_change(0L, m_mtrChannel, 0);
+    }
+
+    //AWARE: the jump counters in the table are used by ScorePlayer, that could be
+    //playing the score. The exporter uses its own counters, indexed by jump
+    std::map<JumpEntry*, int> jumpIndex;
+    for (int iJump=0; iJump < m_pTable->num_jumps(); ++iJump)
+        jumpIndex[m_pTable->get_jump(iJump)] = iJump;
+    std::vector<int> visited(jumpIndex.size(), 0);
+    std::vector<int> applied(jumpIndex.size(), 0);
+
+    //safety limit, to protect against malformed jumps creating infinite loops
+    long maxSteps = 100L * long(maxEvent) + 1000L;
+    long steps = 0L;
+
+    int i = 0;
+    while (i < maxEvent && ++steps < maxSteps)
+    {
+        SoundEvent* pEv = &events[i];
+        long time = pEv->DeltaTime + offset;
+        long tick = to_ticks(time);
+
+        float tempo = tempo_at(pEv->DeltaTime);
+        if (tempo != curTempo)
+        {
+            pConductor->set_tempo(tick, tempo);
+            curTempo = tempo;
+        }
+
+        if (pEv->EventType == SoundEvent::k_jump)
+        {
+            bool fExecuted = false;
+            JumpEntry* pJump = pEv->pJump;
+            int iJump = jumpIndex[pJump];
+            if (m_fExpandJumps && visited[iJump] >= pJump->get_times_before())
+            {
+                if (pJump->get_times_valid() == 0
+                    || pJump->get_times_valid() > applied[iJump])
+                {
+                    if (pMetronome)
+                        add_metronome_clicks(pMetronome, segmentStart, pEv->DeltaTime,
+                                             offset);
+
+                    i = pJump->get_event();
+                    offset += pEv->DeltaTime - events[i].DeltaTime;
+                    segmentStart = events[i].DeltaTime;
+                    if (pJump->get_times_valid() > applied[iJump])
+                        ++applied[iJump];
+                    fExecuted = true;
+                }
+            }
+
+            ++visited[iJump];
+
+            if (!fExecuted)
+                ++i;
+            continue;
+        }
+
+        switch (pEv->EventType)
+        {
+            case SoundEvent::k_prog_instr:
+                get_track(pEv->Channel)->program_change(tick, pEv->Channel,
+                                                        pEv->Instrument);
+                break;
+
+            case SoundEvent::k_note_on:
+                get_track(pEv->Channel)->note_on(tick, pEv->Channel, pEv->NotePitch,
+                                                 pEv->Volume);
+                break;
+
+            case SoundEvent::k_note_off:
+                get_track(pEv->Channel)->note_off(tick, pEv->Channel, pEv->NotePitch);
+                break;
+
+            case SoundEvent::k_rhythm_change:
+            {
+                int denominator = (pEv->BeatDuration > 0 ?
+                                   int(4 * k_duration_quarter) / pEv->BeatDuration : 0);
+                int clocks = (pEv->NumPulses > 0 ?
+                              int(24L * long(pEv->TopNumber) * long(pEv->BeatDuration)
+                                  / long(pEv->NumPulses) / long(k_duration_quarter))
+                              : 24);
+                pConductor->time_signature(tick, pEv->TopNumber, denominator, clocks);
+                break;
+            }
+
+            default:
+                break;      //visual events: nothing to do
+        }
+
+        if (pEv->EventType == SoundEvent::k_end_of_score)
+        {
+            if (pMetronome)
+                add_metronome_clicks(pMetronome, segmentStart, pEv->DeltaTime, offset);
+            break;
+        }
+        ++i;
+    }
+
+    if (steps >= maxSteps)
+        LOMSE_LOG_ERROR("Jumps loop detected. MIDI export truncated.");
+}
+
+//---------------------------------------------------------------------------------------
+void MidiExporter::add_metronome_clicks(MidiTrackWriter* pTrack, long startTime,
+                                        long endTime, long offset)
+{
+    //Generate clicks for beats in score time interval [startTime, endTime).
+    //Beats are aligned to the start of the measure in which the time signature is
+    //placed. For the first time signature, the start of the first measure is
+    //shifted by the anacrusis missing time, as ScorePlayer does.
+
+    long missing = long(m_pTable->get_anacrusis_missing_time() + 0.5);
+    long t = startTime;
+    while (t < endTime)
+    {
+        map<long, pair<long, long> >::iterator it = m_rhythms.upper_bound(t);
+        long nextChange = (it == m_rhythms.end() ? endTime : min(endTime, it->first));
+        --it;
+        long anchor = (it->first == 0L ? -missing : it->first);
+        long measure = it->second.first;
+        long pulse = it->second.second;
+        if (pulse <= 0L || measure <= 0L)
+        {
+            t = nextChange;
+            continue;
+        }
+
+        long clickDuration = min(7L, pulse / 4L);
+        long k = (t - anchor + pulse - 1) / pulse;
+        for (long beat = anchor + k * pulse; beat < nextChange; beat += pulse)
+        {
+            bool fFirstBeat = ((beat - anchor) % measure == 0);
+            int tone = (fFirstBeat ? m_mtrTone1 : m_mtrTone2);
+            pTrack->note_on(to_ticks(beat + offset), m_mtrChannel, tone,
+                            (fFirstBeat ? 127 : 80));
+            pTrack->note_off(to_ticks(beat + offset + clickDuration), m_mtrChannel,
+                             tone);
+        }
+        t = nextChange;
+    }
+}
+
+
+}   //namespace lomse
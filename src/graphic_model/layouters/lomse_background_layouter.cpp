@@ -0,0 +1,137 @@
+//---------------------------------------------------------------------------------------
+// This file is part of the Lomse library.
+// Copyright (c) 2010-present, Lomse Developers
+//
+// Licensed under the MIT license.
+//
+// See LICENSE and NOTICE.md files in the root directory of this source tree.
+//---------------------------------------------------------------------------------------
+
+#include "lomse_config.h"
+#if (LOMSE_ENABLE_THREADS == 1)
+
+#include "lomse_background_layouter.h"
+
+#include "lomse_graphical_model.h"
+#include "lomse_interactor.h"
+#include "lomse_logger.h"
+
+
+namespace lomse
+{
+
+//=======================================================================================
+// BackgroundLayouter implementation
+//=======================================================================================
+BackgroundLayouter::BackgroundLayouter(GraphicModel* pGModel, Interactor* pInteractor)
+    : m_pGModel(pGModel)
+    , m_pInteractor(pInteractor)
+    , m_pThread(nullptr)
+    , m_pState( std::make_shared<ThreadState>() )
+{
+    if (m_pInteractor)
+        m_wpInteractor = WpInteractor( m_pInteractor->get_shared_ptr_from_this() );
+}
+
+//---------------------------------------------------------------------------------------
+BackgroundLayouter::~BackgroundLayouter()
+{
+    cancel();
+}
+
+//---------------------------------------------------------------------------------------
+void BackgroundLayouter::start()
+{
+    if (m_pThread)
+        return;
+
+    LOMSE_LOG_DEBUG(Logger::k_layout, "Starting background layout");
+    m_pState->fCancel = false;
+    m_pState->fRunning = true;
+    m_pThread = LOMSE_NEW std::thread(&BackgroundLayouter::thread_main, this, m_pState);
+}
+
+//---------------------------------------------------------------------------------------
+void BackgroundLayouter::cancel()
+{
+    //the page being laid out is finished before stopping the thread
+
+    m_pState->fCancel = true;
+    join();
+}
+
+//---------------------------------------------------------------------------------------
+void BackgroundLayouter::wait()
+{
+    //wait until all pages are laid out. Does nothing when invoked from the
+    //layout thread, e.g. from an EventPagesAvailable handler
+
+    if (!is_worker_thread())
+        join();
+}
+
+//---------------------------------------------------------------------------------------
+bool BackgroundLayouter::is_worker_thread()
+{
+    //AWARE: layouters can invoke methods that wait for the layout, e.g.
+    //GraphicModel::get_measures_table()
+    return m_pState->workerId.load() == std::this_thread::get_id();
+}
+
+//---------------------------------------------------------------------------------------
+void BackgroundLayouter::join()
+{
+    //When invoked from the layout thread, the layouter is being deleted by an event
+    //handler. The thread can not be joined: it is detached and will finish as soon
+    //as the handler returns, as the layout is cancelled.
+
+    if (!m_pThread)
+        return;
+
+    if (is_worker_thread())
+        m_pThread->detach();
+    else
+        m_pThread->join();
+
+    delete m_pThread;
+    m_pThread = nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+void BackgroundLayouter::thread_main(SpThreadState pState)
+{
+    //AWARE: after notifying the observers, this layouter and the graphic model could
+    //have been deleted. Only pState can be accessed until checking cancellation.
+
+    pState->workerId = std::this_thread::get_id();
+
+    bool fFinished = false;
+    while (!fFinished && !pState->fCancel)
+    {
+        fFinished = m_pGModel->layout_next_page();
+        if (!pState->fCancel)
+            notify_pages_available(fFinished);
+    }
+    pState->fRunning = false;
+
+    LOMSE_LOG_DEBUG(Logger::k_layout, "Background layout %s",
+                    (fFinished ? "finished" : "cancelled"));
+}
+
+//---------------------------------------------------------------------------------------
+void BackgroundLayouter::notify_pages_available(bool fFinished)
+{
+    if (!m_pInteractor)
+        return;
+
+    SpEventPagesAvailable pEvent(
+        LOMSE_NEW EventPagesAvailable(m_wpInteractor,
+                                      m_pGModel->get_num_laid_out_pages(),
+                                      m_pGModel->get_layout_progress(), fFinished) );
+    m_pInteractor->notify_observers(pEvent, m_pInteractor);
+}
+
+
+}  //namespace lomse
+
+#endif   //LOMSE_ENABLE_THREADS == 1
@@ -31,6 +31,7 @@ ContentLayouter::ContentLayouter(ImoContentObj* pItem, Layouter* pParent,
                                  ImoStyles* pStyles, bool fAddShapesToModel)
     : Layouter(pItem, pParent, pGModel, libraryScope, pStyles, fAddShapesToModel)
     , m_pContent( dynamic_cast<ImoContent*>(pItem) )
+    , m_pSuspendedItem(nullptr)
 {
 }
 
@@ -41,17 +42,62 @@ void ContentLayouter::layout_in_box()
 
     set_cursor_and_available_space();
 
-    TreeNode<ImoObj>::children_iterator it;
+    layout_items_from(m_pContent->begin());
+}
+
+//---------------------------------------------------------------------------------------
+void ContentLayouter::layout_items_from(TreeNode<ImoObj>::children_iterator it)
+{
     int result = k_layout_success;
-    for (it = m_pContent->begin(); it != m_pContent->end(); ++it)
+    for (; it != m_pContent->end(); ++it)
     {
         result = layout_item(static_cast<ImoContentObj*>( *it ), m_pItemMainBox, m_constrains);
         if (result == k_layout_failed_auto_scale)
             break;
+        if (result == k_layout_suspended)
+        {
+            m_pSuspendedItem = static_cast<ImoContentObj*>( *it );
+            break;
+        }
     }
     set_layout_result(result);
 }
 
+//---------------------------------------------------------------------------------------
+void ContentLayouter::resume_layout()
+{
+    //continue the suspended layout of an item and layout the remaining items
+
+    int result = resume_item_layout();
+    if (result != k_layout_suspended)
+        result = finish_item_layout();
+
+    if (result != k_layout_success)
+    {
+        set_layout_result(result);
+        return;
+    }
+
+    TreeNode<ImoObj>::children_iterator it = m_pContent->begin();
+    while (it != m_pContent->end() && *it != m_pSuspendedItem)
+        ++it;
+    m_pSuspendedItem = nullptr;
+    if (it != m_pContent->end())
+        ++it;
+
+    layout_items_from(it);
+}
+
+//---------------------------------------------------------------------------------------
+bool ContentLayouter::must_suspend_layout()
+{
+    //lazy layout is only supported for scores in main content. The parent
+    //layouter decides when the pages limit is reached
+
+    return m_pCurLayouter && m_pCurLayouter->get_item()->is_score()
+           && m_pParentLayouter && m_pParentLayouter->must_suspend_layout();
+}
+
 //---------------------------------------------------------------------------------------
 void ContentLayouter::create_main_box(GmoBox* pParentBox, UPoint pos, LUnits width,
                                       LUnits height)
@@ -16,6 +16,10 @@
 #include "lomse_score_layouter.h"
 #include "lomse_calligrapher.h"
 #include "lomse_box_system.h"
+#include "lomse_blocks_container_layouter.h"
+#include "lomse_logger.h"
+
+#include <cmath>
 
 
 namespace lomse
@@ -35,15 +39,21 @@ DocLayouter::DocLayouter(Document* pDoc, LibraryScope& libraryScope, int constra
     , m_pDoc( pDoc->get_im_root() )
     , m_viewWidth(width)
     , m_pScoreLayouter(nullptr)
+    , m_pageLimit(0)
+    , m_fSuspended(false)
+    , m_fKeepModel(false)
 {
     m_pStyles = m_pDoc->get_styles();
-    m_pGModel = LOMSE_NEW GraphicModel(m_pDoc);
+    m_pGModel = LOMSE_NEW GraphicModel(m_pDoc, &m_libraryScope.get_layout_mutex());
     m_constrains = constrains;
 }
 
 //---------------------------------------------------------------------------------------
 DocLayouter::~DocLayouter()
 {
+    if (m_fSuspended)
+        discard_suspended_layout();
+
     delete m_pScoreLayouter;
 }
 
@@ -57,6 +67,10 @@ void DocLayouter::layout_empty_document()
 //---------------------------------------------------------------------------------------
 void DocLayouter::layout_document()
 {
+    //AWARE: fonts and text meters are shared by all documents. Serialized with the
+    //layout threads of other documents and with rendering
+    std::lock_guard<std::recursive_mutex> lock(m_libraryScope.get_layout_mutex());
+
     int result = k_layout_not_finished;
     int numTrials = 0;
     while(result == k_layout_not_finished && numTrials < 30)
@@ -70,20 +84,128 @@ void DocLayouter::layout_document()
             result = k_layout_not_finished;
         }
     }
+    m_fSuspended = (result == k_layout_suspended);
     if (result == k_layout_not_finished)
         layout_empty_document();
-    else
+    else if (!m_fSuspended)
         fix_document_size();
 }
 
+//---------------------------------------------------------------------------------------
+bool DocLayouter::layout_first_pages(int numPages)
+{
+    //Lazy layout. Layouts the document as layout_document() does, but the layout
+    //is suspended when numPages pages have been created and more pages are needed.
+    //Columns and line breaks are always computed but systems for next pages are not
+    //created until layout_more_pages() is invoked. Only the layout of scores in main
+    //content can be suspended. Returns true if the document is fully laid out.
+    //When suspended, the graphic model is owned by this layouter until the layout is
+    //finished or this layouter is deleted.
+
+    m_pageLimit = max(1, numPages);
+    layout_document();
+    if (!m_fSuspended)
+        m_pageLimit = 0;
+    m_fKeepModel = m_fSuspended;
+    return !m_fSuspended;
+}
+
+//---------------------------------------------------------------------------------------
+bool DocLayouter::layout_more_pages(int iPage)
+{
+    //Lazy layout. Continues a suspended layout until page iPage (0..n-1) is created
+    //or the document is fully laid out. Pages are added to the same graphic model.
+    //Returns true if the document is fully laid out.
+
+    if (!m_fSuspended)
+        return true;
+
+    LOMSE_LOG_DEBUG(Logger::k_layout, "Resuming layout up to page %d", iPage);
+
+    m_pageLimit = iPage + 1;
+    ContentLayouter* pContentLyt = static_cast<ContentLayouter*>(m_pCurLayouter);
+    pContentLyt->resume_layout();
+    if (pContentLyt->get_layout_result() == k_layout_suspended)
+        return false;
+
+    m_fSuspended = false;
+    pContentLyt->set_box_height();
+    if (finish_item_layout() == k_layout_failed_auto_scale)
+    {
+        //auto-scaling applied. The pages already created are no longer valid
+        delete pContentLyt;
+        delete_last_trial();
+        return layout_first_pages(iPage + 1);
+    }
+
+    m_pageLimit = 0;
+    fix_document_size();
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+int DocLayouter::get_estimated_num_pages()
+{
+    //When the layout is suspended, the number of pages is estimated from the
+    //fraction of systems already added to pages
+
+    int numPages = m_pGModel->get_root()->get_num_pages();
+    if (!m_fSuspended)
+        return numPages;
+
+    int estimate = numPages + 1;
+    float progress = get_layout_progress();
+    if (progress > 0.0f)
+        estimate = max(estimate, int( ceil(float(numPages) / progress) ));
+    return estimate;
+}
+
+//---------------------------------------------------------------------------------------
+float DocLayouter::get_layout_progress()
+{
+    //fraction of the document already laid out: 1.0 when the layout is finished
+
+    if (!m_fSuspended)
+        return 1.0f;
+
+    ScoreLayouter* pScoreLyt = get_score_layouter();
+    return (pScoreLyt ? pScoreLyt->get_layout_progress() : 0.0f);
+}
+
+//---------------------------------------------------------------------------------------
+bool DocLayouter::must_suspend_layout()
+{
+    return m_pageLimit > 0 && m_pGModel->get_root()->get_num_pages() >= m_pageLimit;
+}
+
+//---------------------------------------------------------------------------------------
+void DocLayouter::discard_suspended_layout()
+{
+    //the layout is not going to be finished. Delete the objects that would have
+    //been transferred to the graphic model
+
+    ScoreLayouter* pScoreLyt = get_score_layouter();
+    if (pScoreLyt)
+        pScoreLyt->delete_not_laid_out_objects();
+
+    delete m_pCurLayouter;      //the ContentLayouter
+    m_pCurLayouter = nullptr;
+    m_fSuspended = false;
+}
+
 //---------------------------------------------------------------------------------------
 void DocLayouter::delete_last_trial()
 {
     delete m_pScoreLayouter;
-    delete m_pGModel;
+    if (m_fKeepModel)
+        m_pGModel->delete_pages_from(0);
+    else
+    {
+        delete m_pGModel;
+        m_pGModel = LOMSE_NEW GraphicModel(m_pDoc, &m_libraryScope.get_layout_mutex());
+    }
 
     m_result = k_layout_not_finished;
-    m_pGModel = LOMSE_NEW GraphicModel(m_pDoc);
     m_pParentLayouter = nullptr;
     m_pStyles = nullptr;
     m_pItemMainBox = nullptr;
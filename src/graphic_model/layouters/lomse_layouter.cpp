@@ -85,21 +85,53 @@ int Layouter::layout_item(ImoContentObj* pItem, GmoBox* pParentBox, int constrai
     m_pCurLayouter->set_constrains(constrains);
 
     m_pCurLayouter->prepare_to_start_layout();
+    continue_item_layout(pParentBox);
+    return finish_item_layout();
+}
+
+//---------------------------------------------------------------------------------------
+int Layouter::continue_item_layout(GmoBox* pParentBox)
+{
+    //layout current item until finished or, for lazy layout, until the child
+    //layouter or this layouter decides to stop creating pages
+
     while (!m_pCurLayouter->is_item_layouted())
     {
         m_pCurLayouter->create_main_box(pParentBox, m_pageCursor,
                                         m_availableWidth, m_availableHeight);
         m_pCurLayouter->layout_in_box();
+        if (m_pCurLayouter->get_layout_result() == k_layout_suspended)
+            return k_layout_suspended;
+
         m_pCurLayouter->set_box_height();
 
         if (!m_pCurLayouter->is_item_layouted())
         {
+            if (must_suspend_layout())
+            {
+                m_pCurLayouter->set_layout_result(k_layout_suspended);
+                return k_layout_suspended;
+            }
             pParentBox = start_new_page();
         }
     }
+    return m_pCurLayouter->get_layout_result();
+}
 
+//---------------------------------------------------------------------------------------
+int Layouter::resume_item_layout()
+{
+    //continue a suspended layout of current item in a new page
+
+    m_pCurLayouter->set_layout_result(k_layout_not_finished);
+    return continue_item_layout( start_new_page() );
+}
+
+//---------------------------------------------------------------------------------------
+int Layouter::finish_item_layout()
+{
     int result = m_pCurLayouter->get_layout_result();
-    if (result != k_layout_failed_auto_scale)
+    if (result != k_layout_failed_auto_scale && result != k_layout_suspended)
     {
         m_pCurLayouter->add_end_margins();
 
@@ -111,7 +143,7 @@ int Layouter::layout_item(ImoContentObj* pItem, GmoBox* pParentBox, int constrai
             m_availableHeight -= pChildBox->get_height();
         }
 
-        if (!pItem->is_score())
+        if (!m_pCurLayouter->get_item()->is_score())
             delete m_pCurLayouter;
     }
     return result;
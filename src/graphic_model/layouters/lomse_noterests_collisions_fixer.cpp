@@ -18,6 +18,7 @@
 #include "lomse_score_meter.h"
 
 #include <cmath>   //abs
+#include <algorithm>
 using namespace std;
 
 
@@ -92,71 +93,139 @@ void NoterestsCollisionsFixer::fix_spacing_issues()
     if (!m_fMoreThanOneLine)
         return;
 
-    //for each note/rest check that it does not overlap any other note/rest that is
-    //in a different line, by checking bounding boxes. Note that note/rests
-    //in the same line never overlap.
-    for (size_t i=0; i < m_notes.size() - 1; ++i)
+    size_t i, j;
+    if (!find_first_collision(&i, &j))
+        return;
+
+    compute_chord_ranges();
+
+    #if (LOMSE_NOTERESTS_COLLISIONS_COLOURED == 1)
+        //debug, to visualy identify the involved noterests
+        m_notes[i]->pShape->set_color(m_colorCollision);
+        m_notes[j]->pShape->set_color(m_colorCollision);
+    #endif
+
+    //possible conflict detected. Identify conflict type
+    int conflictType = m_notes[i]->type + 10 * m_notes[j]->type;
+    //there are nine posibilities:
+    //  1+10 = 11   rest & rest
+    //  1+20 = 21   rest & note
+    //  1+30 = 31   rest & chord
+    //  2+10 = 12   note & rest
+    //  2+20 = 22   note & note
+    //  2+30 = 32   note & chord
+    //  3+10 = 13   chord & rest
+    //  3+20 = 23   chord & note
+    //  3+30 = 33   chord & chord
+    switch (conflictType)
+    {
+        case 11: fix_two_rests_overlap(i, j);           break;
+        case 21: fix_note_and_rest_overlap(j, i);       break;
+        case 31: fix_chord_and_rest_overlap(j, i);      break;
+        case 12: fix_note_and_rest_overlap(i, j);       break;
+        case 22: fix_two_notes_overlap(i, j);           break;
+        case 32: fix_chord_and_note_overlap(j, i);      break;
+        case 13: fix_chord_and_rest_overlap(i, j);      break;
+        case 23: fix_chord_and_note_overlap(i, j);      break;
+        case 33: fix_two_chords_overlap(i, j);          break;
+        default:
+        {
+            stringstream ss;
+            ss << "Invalid conflict type: " << conflictType
+               << ", obj1:" << m_notes[i]->pNR->get_name()
+               << ", type1:" << m_notes[i]->type
+               << ", obj2:" << m_notes[j]->pNR->get_name()
+               << ", type2:" << m_notes[j]->type;
+            LOMSE_LOG_ERROR(ss.str());
+        }
+    }
+
+    //for now, assume only one conflict, until more evidence/experience
+    //about scenarios with more than one collision
+}
+
+//---------------------------------------------------------------------------------------
+bool NoterestsCollisionsFixer::find_first_collision(size_t* pI, size_t* pJ)
+{
+    //Look for a note/rest whose bounding box overlaps the box of other note/rest
+    //in a different line. Note that note/rests in the same line never overlap.
+    //When several pairs overlap, the first pair (i, j), i < j, in m_notes order is
+    //returned.
+    //
+    //All noterests in a timepos have similar x position, so they are swept from top
+    //to bottom, keeping only the boxes that are still open at current top.
+
+    size_t numNotes = m_notes.size();
+    vector<URect> bounds;
+    bounds.reserve(numNotes);
+    for (auto pData : m_notes)
+        bounds.push_back( pData->pShape->get_bounds() );
+
+    vector<size_t> sorted(numNotes);
+    for (size_t k=0; k < numNotes; ++k)
+        sorted[k] = k;
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [&bounds](size_t a, size_t b) { return bounds[a].y < bounds[b].y; });
+
+    bool fFound = false;
+    size_t iFirst = numNotes;
+    size_t jFirst = numNotes;
+    vector<size_t> active;
+    for (size_t k : sorted)
     {
-        for (size_t j=i; j < m_notes.size(); ++j)
+        const URect& box = bounds[k];
+
+        //remove boxes ending above this one
+        active.erase(std::remove_if(active.begin(), active.end(),
+                        [&bounds, &box](size_t a) { return bounds[a].bottom() <= box.y; }),
+                     active.end());
+
+        for (size_t a : active)
         {
-            //check if conflict between the two noterests when in different lines
-            if (m_notes[i]->line != m_notes[j]->line)
+            if (m_notes[a]->line == m_notes[k]->line)
+                continue;
+
+            const URect& other = bounds[a];
+            if (min(box.right(), other.right()) > max(box.x, other.x)
+                && min(box.bottom(), other.bottom()) > max(box.y, other.y))
             {
-                URect bbox = m_notes[i]->pShape->get_bounds();
-                bbox.intersection( m_notes[j]->pShape->get_bounds() );
-                if (bbox.height > 0.0f && bbox.width > 0.0f)
+                size_t i = min(a, k);
+                size_t j = max(a, k);
+                if (!fFound || i < iFirst || (i == iFirst && j < jFirst))
                 {
-                    #if (LOMSE_NOTERESTS_COLLISIONS_COLOURED == 1)
-                        //debug, to visualy identify the involved noterests
-                        m_notes[i]->pShape->set_color(m_colorCollision);
-                        m_notes[j]->pShape->set_color(m_colorCollision);
-                    #endif
-
-                    //possible conflict detected. Identify conflict type
-                    int conflictType = m_notes[i]->type + 10 * m_notes[j]->type;
-                    //there are nine posibilities:
-                    //  1+10 = 11   rest & rest
-                    //  1+20 = 21   rest & note
-                    //  1+30 = 31   rest & chord
-                    //  2+10 = 12   note & rest
-                    //  2+20 = 22   note & note
-                    //  2+30 = 32   note & chord
-                    //  3+10 = 13   chord & rest
-                    //  3+20 = 23   chord & note
-                    //  3+30 = 33   chord & chord
-                    switch (conflictType)
-                    {
-                        case 11: fix_two_rests_overlap(i, j);           break;
-                        case 21: fix_note_and_rest_overlap(j, i);       break;
-                        case 31: fix_chord_and_rest_overlap(j, i);      break;
-                        case 12: fix_note_and_rest_overlap(i, j);       break;
-                        case 22: fix_two_notes_overlap(i, j);           break;
-                        case 32: fix_chord_and_note_overlap(j, i);      break;
-                        case 13: fix_chord_and_rest_overlap(i, j);      break;
-                        case 23: fix_chord_and_note_overlap(i, j);      break;
-                        case 33: fix_two_chords_overlap(i, j);          break;
-                        default:
-                        {
-                            stringstream ss;
-                            ss << "Invalid conflict type: " << conflictType
-                               << ", obj1:" << m_notes[i]->pNR->get_name()
-                               << ", type1:" << m_notes[i]->type
-                               << ", obj2:" << m_notes[j]->pNR->get_name()
-                               << ", type2:" << m_notes[j]->type;
-                            LOMSE_LOG_ERROR(ss.str());
-
-                            return;     //do not touch anything
-                        }
-                    }
-
-                    //for now, assume only one conflict, until more evidence/experience
-                    //about scenarios with more than one collision
-                    return;
-
-                }   //conflict detected
-            }   //both in different line
-        }   //j loop
-    }   //i loop
+                    iFirst = i;
+                    jFirst = j;
+                    fFound = true;
+                }
+            }
+        }
+        active.push_back(k);
+    }
+
+    *pI = iFirst;
+    *pJ = jFirst;
+    return fFound;
+}
+
+//---------------------------------------------------------------------------------------
+void NoterestsCollisionsFixer::compute_chord_ranges()
+{
+    //chord notes are consecutive noterests in the same line
+
+    size_t numNotes = m_notes.size();
+    size_t iStart = 0;
+    for (size_t i=1; i <= numNotes; ++i)
+    {
+        if (i == numNotes || m_notes[i]->line != m_notes[iStart]->line)
+        {
+            for (size_t k=iStart; k < i; ++k)
+            {
+                m_notes[k]->iChordStart = iStart;
+                m_notes[k]->iChordEnd = i - 1;
+            }
+            iStart = i;
+        }
+    }
 }
 
 //---------------------------------------------------------------------------------------
@@ -861,7 +930,7 @@ void NoterestsCollisionsFixer::move_chord(size_t iStart1, size_t iEnd1,
 //            //the order of accidentals is the same as for single-stemmed chords, starting with
 //            //the uppermost accidental closest to the notes. Thus, it is necessary to
 //            //traverse the notes ordered by pitch
-//            list<GmoShapeNote*> notes;
+//            vector<GmoShapeNote*> notes;
 //            for (size_t i=iStart2; i <= iEnd2; ++i)
 //            {
 //                GmoShapeNote* pNoteShape = static_cast<GmoShapeNote*>(m_notes[i]->pShape);
@@ -878,35 +947,6 @@ void NoterestsCollisionsFixer::move_chord(size_t iStart1, size_t iEnd1,
     }
 }
 
-//---------------------------------------------------------------------------------------
-size_t NoterestsCollisionsFixer::find_start_of_chord(size_t i)
-{
-    //given the index to a note of the chord, returns the index to the first note
-
-    int line = m_notes[i]->line;
-    size_t iStart = i;
-    while ((iStart > 0) && (m_notes[iStart]->line == line))
-        --iStart;
-    if (m_notes[iStart]->line != line)
-        ++iStart;
-
-    return iStart;
-}
-
-//---------------------------------------------------------------------------------------
-size_t NoterestsCollisionsFixer::find_end_of_chord(size_t i)
-{
-    //given the index to a note of the chord, returns the index to the last note
-
-    int line = m_notes[i]->line;
-    size_t iEnd = i;
-    while ((iEnd < m_notes.size()) && (m_notes[iEnd]->line == line))
-        ++iEnd;
-    --iEnd;
-
-    return iEnd;
-}
-
 //---------------------------------------------------------------------------------------
 std::pair<size_t, int> NoterestsCollisionsFixer::find_chord_note_that_overlap_with(
                                                     size_t i, size_t iStart, size_t iEnd)
@@ -1004,88 +1044,55 @@ void NoterestsCollisionsFixer::move_accidental_to_left(GmoShapeNote* pShapeNote,
 }
 
 //---------------------------------------------------------------------------------------
-void NoterestsCollisionsFixer::insert_note_in_list(list<GmoShapeNote*>& notes,
+void NoterestsCollisionsFixer::insert_note_in_list(vector<GmoShapeNote*>& notes,
                                                    GmoShapeNote* pNoteShape)
 {
     //keep notes sorted by pitch
 
-    if (notes.size() == 0)
+    int newPos = pNoteShape->get_pos_on_staff();
+    vector<GmoShapeNote*>::iterator it =
+        std::lower_bound(notes.begin(), notes.end(), newPos,
+                         [](GmoShapeNote* pNote, int pos) {
+                             return pNote->get_pos_on_staff() < pos;
+                         });
+
+    if (it != notes.end() && (*it)->get_pos_on_staff() == newPos)
     {
-	    notes.push_back(pNoteShape);
-    }
-    else
-    {
-        int newPos = pNoteShape->get_pos_on_staff();
-        std::list<GmoShapeNote*>::iterator it;
-        for (it = notes.begin(); it != notes.end(); ++it)
-        {
-            int curPos((*it)->get_pos_on_staff());
-            if (newPos < curPos)
-            {
-	            notes.insert(it, 1, pNoteShape);
-                return;
-            }
-            else if (newPos == curPos)
-            {
-                //unison. when this note has a natural keep first note accidental
-                //first. For this this note has to be inserted after existing one
-                ImoNote* pNote = static_cast<ImoNote*>(pNoteShape->get_creator_imo());
-                EAccidentals acc = pNote->get_notated_accidentals();
-                if (acc != k_natural)
-                    notes.insert(it, pNoteShape);
-                else
-                {
-                    std::list<GmoShapeNote*>::iterator itNext = it;
-                    notes.insert(++itNext, pNoteShape);
-                }
-                return;
-            }
-        }
-	    notes.push_back(pNoteShape);
+        //unison. when this note has a natural keep first note accidental
+        //first. For this this note has to be inserted after existing one
+        ImoNote* pNote = static_cast<ImoNote*>(pNoteShape->get_creator_imo());
+        if (pNote->get_notated_accidentals() == k_natural)
+            ++it;
     }
+    notes.insert(it, pNoteShape);
 }
 
 //---------------------------------------------------------------------------------------
-void NoterestsCollisionsFixer::layout_accidentals(list<GmoShapeNote*>& notes)
+void NoterestsCollisionsFixer::layout_accidentals(vector<GmoShapeNote*>& notes)
 {
-    std::list<GmoShapeNote*>::reverse_iterator it;
-    for(it = notes.rbegin(); it != notes.rend(); ++it)
+    //notes are processed from highest to lowest pitch
+    size_t numNotes = notes.size();
+    for (size_t i = numNotes; i-- > 0; )
     {
-        GmoShapeNote* pNoteShape = (*it);
+        GmoShapeNote* pNoteShape = notes[i];
         GmoShapeAccidentals* pCurAcc = pNoteShape->get_accidentals_shape();
 
         if (pCurAcc)
         {
             //check if conflict with next two noteheads
-            std::list<GmoShapeNote*>::reverse_iterator itCur = it;
-            ++itCur;
-            if (itCur != notes.rend())
-            {
-                GmoShapeNotehead* pHead = (*itCur)->get_notehead_shape();
-                shift_acc_if_confict_with_shape(pNoteShape, pHead);
-                ++itCur;
-            }
-            if (itCur != notes.rend())
-            {
-                GmoShapeNotehead* pHead = (*itCur)->get_notehead_shape();
-                shift_acc_if_confict_with_shape(pNoteShape, pHead);
-            }
+            if (i >= 1)
+                shift_acc_if_confict_with_shape(pNoteShape, notes[i-1]->get_notehead_shape());
+            if (i >= 2)
+                shift_acc_if_confict_with_shape(pNoteShape, notes[i-2]->get_notehead_shape());
 
             //check if conflict with two previous notes or their accidentals
-            if (it != notes.rbegin())
-            {
-                itCur = it;
-                --itCur;
-                shift_acc_if_confict_with_shape(pNoteShape, *itCur);
-                if (itCur != notes.rbegin())
-                {
-                    --itCur;
-                    shift_acc_if_confict_with_shape(pNoteShape, *itCur);
-                }
-            }
+            if (i + 1 < numNotes)
+                shift_acc_if_confict_with_shape(pNoteShape, notes[i+1]);
+            if (i + 2 < numNotes)
+                shift_acc_if_confict_with_shape(pNoteShape, notes[i+2]);
 
             //check if conflict with any previous accidental
-            shift_accidental_if_conflict_with_previous(pNoteShape, notes, it);
+            shift_accidental_if_conflict_with_previous(pNoteShape, notes, i);
         }
     }
 }
@@ -1093,16 +1100,14 @@ void NoterestsCollisionsFixer::layout_accidentals(list<GmoShapeNote*>& notes)
 //---------------------------------------------------------------------------------------
 void NoterestsCollisionsFixer::shift_accidental_if_conflict_with_previous(
                                         GmoShapeNote* pCurAcc,
-                                        list<GmoShapeNote*>& notes,
-                                        list<GmoShapeNote*>::reverse_iterator& itCur)
+                                        vector<GmoShapeNote*>& notes, size_t iCur)
 {
-	std::list<GmoShapeNote*>::reverse_iterator it;
-	for(it = notes.rbegin(); it != itCur; ++it)
-	{
-		GmoShapeAccidentals* pPrevAcc = (*it)->get_accidentals_shape();
+    for (size_t i = notes.size(); i-- > iCur + 1; )
+    {
+        GmoShapeAccidentals* pPrevAcc = notes[i]->get_accidentals_shape();
         if (pPrevAcc)
             shift_acc_if_confict_with_shape(pCurAcc, pPrevAcc);
-	}
+    }
 }
 
 //---------------------------------------------------------------------------------------
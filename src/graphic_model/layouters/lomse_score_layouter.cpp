@@ -756,6 +756,35 @@ void ScoreLayouter::delete_not_used_objects()
     delete_system_boxes();
 }
 
+//---------------------------------------------------------------------------------------
+float ScoreLayouter::get_layout_progress()
+{
+    //fraction of systems already added to pages. Used for estimating the number
+    //of pages when the layout is suspended
+
+    if (get_num_systems() == 0)
+        return 1.0f;
+
+    int numAdded = (system_created() ? m_iCurSystem : m_iCurSystem + 1);
+    return float(numAdded) / float(get_num_systems());
+}
+
+//---------------------------------------------------------------------------------------
+void ScoreLayouter::delete_not_laid_out_objects()
+{
+    //A suspended layout is not going to be continued. Delete the objects that,
+    //when the layout is finished, are owned by the graphic model: the system not
+    //yet added to a page and the boxes and shapes of the columns not yet engraved
+
+    delete_system();
+    delete_pendig_aux_objects();
+
+    for (int iCol = max(0, m_iCurColumn); iCol < get_num_columns(); ++iCol)
+        m_pSpAlgorithm->delete_box_and_shapes(iCol);
+
+    m_engravers.delete_engravers();
+}
+
 //---------------------------------------------------------------------------------------
 void ScoreLayouter::delete_pendig_aux_objects()
 {
@@ -1589,6 +1618,9 @@ LinesBreakerOptimal::LinesBreakerOptimal(ScoreLayouter* pScoreLyt,
     : LinesBreaker(pScoreLyt, libScope, pSpAlgorithm, breaks)
     , m_numCols(0)
     , m_fJustifyLastLine(false)
+    , m_fBoundedLookahead(true)
+    , m_numPenalties(0)
+    , m_fBestOffer(false)
 {
 }
 
@@ -1621,14 +1653,39 @@ void LinesBreakerOptimal::initialize_entries_table()
     }
 }
 
+//---------------------------------------------------------------------------------------
+void LinesBreakerOptimal::initialize_lookahead_data()
+{
+    m_breakEntry.assign(m_numCols+2, m_numCols+1);
+    for (int j=m_numCols; j > 0; --j)
+    {
+        m_breakEntry[j] = (m_pScoreLyt->column_has_system_break(j-1) ? j
+                                                                     : m_breakEntry[j+1]);
+    }
+
+    m_pendingOffers.clear();
+    m_pendingOffers.resize(m_numCols+1);
+    m_fBestOffer = false;
+}
+
 //---------------------------------------------------------------------------------------
 void LinesBreakerOptimal::compute_optimal_break_sequence()
 {
     bool fTrace = (m_libraryScope.get_trace_level_for_lines_breaker()
                        & k_trace_breaks_computation) != 0;
 
+    //bounded lookahead is disabled when tracing, to not alter traces
+    bool fLookahead = m_fBoundedLookahead
+                      && (m_libraryScope.get_trace_level_for_lines_breaker()
+                          & (k_trace_breaks_computation | k_trace_breaks_penalties)) == 0;
+    initialize_lookahead_data();
+    m_numPenalties = 0;
+
     for (int i=0; i < m_numCols; ++i)
     {
+        if (i > 0)
+            apply_overflow_offers(i);
+
         if (fTrace)
         {
             dbgLogger << "Breaks i loop. "
@@ -1663,6 +1720,7 @@ void LinesBreakerOptimal::compute_optimal_break_sequence()
                 else
                 {
                     newPenalty = m_pSpAlgorithm->determine_penalty_for_line(iSystem, i, j-1);
+                    ++m_numPenalties;
                     if (newPenalty < 0.0f)
                     {
                         newPenalty = 0.0f;
@@ -1699,9 +1757,85 @@ void LinesBreakerOptimal::compute_optimal_break_sequence()
                 //optimization: if no space for column j do not try column j+1
                 if (newPenalty >= LOMSE_INFINITE_PENALTY)
                     break;
+
+                //optimization: if columns {ci,...,cj-1} do not fit in the system,
+                //the penalty for all lines {ci,...,ck}, k > j-1, is the same. There
+                //is no need to evaluate them
+                if (fLookahead && m_pSpAlgorithm->is_line_too_wide(iSystem, i, j-1))
+                {
+                    OverflowOffer offer;
+                    offer.prevPenalty = prevPenalty;
+                    offer.newPenalty = newPenalty;
+                    offer.predecessor = i;
+                    offer.system = iSystem + 1;
+                    add_overflow_offer(j, offer);
+                    break;
+                }
             }
         }
     }
+
+    if (m_numCols > 0)
+        apply_overflow_offers(m_numCols);
+}
+
+//---------------------------------------------------------------------------------------
+void LinesBreakerOptimal::add_overflow_offer(int j, const OverflowOffer& offer)
+{
+    //Line {ci,...,cj-1} is too wide. Instead of evaluating lines {ci,...,ck}, k > j-1,
+    //its penalty is offered to all entries k+1 up to next forced break, and the
+    //forced break is processed.
+
+    int iBreak = m_breakEntry[j+1];
+    if (j+1 < iBreak && j+1 <= m_numCols)
+        m_pendingOffers[j+1].push_back(offer);
+
+    if (iBreak <= m_numCols)
+    {
+        m_entries[iBreak].penalty = 0.0f;
+        m_entries[iBreak].predecessor = offer.predecessor;
+        m_entries[iBreak].system = offer.system;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void LinesBreakerOptimal::apply_overflow_offers(int iEntry)
+{
+    //Must be invoked for each entry, in order, before using it. Offers are accepted
+    //with the same criteria than when evaluating lines in order: lowest total
+    //penalty and, when equal, the first predecessor
+
+    if (m_breakEntry[iEntry] == iEntry)
+        m_fBestOffer = false;
+
+    std::vector<OverflowOffer>& offers = m_pendingOffers[iEntry];
+    std::vector<OverflowOffer>::iterator it;
+    for (it = offers.begin(); it != offers.end(); ++it)
+    {
+        float total = (*it).newPenalty + (*it).prevPenalty;
+        float best = (m_fBestOffer ? m_bestOffer.newPenalty + m_bestOffer.prevPenalty
+                                   : LOMSE_INFINITE_PENALTY);
+        if (!m_fBestOffer || total < best
+            || (total == best && (*it).predecessor < m_bestOffer.predecessor))
+        {
+            m_bestOffer = *it;
+            m_fBestOffer = true;
+        }
+    }
+    offers.clear();
+
+    if (m_fBestOffer)
+    {
+        Entry& entry = m_entries[iEntry];
+        float total = m_bestOffer.newPenalty + m_bestOffer.prevPenalty;
+        if (total < entry.penalty
+            || (total == entry.penalty && m_bestOffer.predecessor < entry.predecessor))
+        {
+            entry.penalty = total;
+            entry.predecessor = m_bestOffer.predecessor;
+            entry.system = m_bestOffer.system;
+        }
+    }
 }
 
 //---------------------------------------------------------------------------------------
@@ -27,6 +27,7 @@
 
 
 #include <vector>
+#include <new>     //placement new
 #include <cmath>   //abs
 using namespace std;
 
@@ -46,6 +47,7 @@ SpAlgGourlay::SpAlgGourlay(LibraryScope& libraryScope, ScoreMeter* pScoreMeter,
                            PartsEngraver* pPartsEngraver)
     : SpAlgColumn(libraryScope, pScoreMeter, pScoreLyt, pScore, engravers,
                   pShapesCreator, pPartsEngraver)
+    , m_arena(k_arena_block_size)
     , m_pCurSlice(nullptr)
     , m_pLastEntry(nullptr)
     , m_prevType(TimeSlice::k_undefined)
@@ -65,6 +67,12 @@ SpAlgGourlay::SpAlgGourlay(LibraryScope& libraryScope, ScoreMeter* pScoreMeter,
     , m_alpha(0.0f)
     , m_dmin(0.0f)
     , m_Fopt(0.0f)
+    , m_iLineFirstCol(-1)
+    , m_iLineLastCol(-1)
+    , m_lineSlope(0.0f)
+    , m_lineFixed(0.0f)
+    , m_lineMinWidth(0.0f)
+    , m_fNegativeMinWidths(false)
 {
     ColStaffObjs* pCol = pScore->get_staffobjs_table();
     m_shapes.reserve(pCol->num_entries());
@@ -89,20 +97,23 @@ SpAlgGourlay::~SpAlgGourlay()
         LOMSE_LOG_ERROR(ss.str());
     }
 
+    //objects are in the arena: invoke destructors and release the arena memory
     vector<ShapeData*>::iterator itD;
     for (itD = m_shapes.begin(); itD != m_shapes.end(); ++itD)
-        delete *itD;
+        (*itD)->~ShapeData();
     m_shapes.clear();
 
     vector<ColumnDataGourlay*>::iterator itC;
     for (itC = m_columns.begin(); itC != m_columns.end(); ++itC)
-        delete *itC;
+        (*itC)->~ColumnDataGourlay();
     m_columns.clear();
 
     list<TimeSlice*>::iterator itS;
     for (itS = m_slices.begin(); itS != m_slices.end(); ++itS)
-        delete *itS;
+        (*itS)->~TimeSlice();
     m_slices.clear();
+
+    m_arena.remove_all();
 }
 
 //---------------------------------------------------------------------------------------
@@ -131,7 +142,7 @@ void SpAlgGourlay::finish_sequences()
 //---------------------------------------------------------------------------------------
 void SpAlgGourlay::new_column(TimeSlice* pSlice)
 {
-    m_pCurColumn = LOMSE_NEW ColumnDataGourlay(pSlice);
+    m_pCurColumn = new (arena_allocate(sizeof(ColumnDataGourlay))) ColumnDataGourlay(pSlice);
     m_columns.push_back(m_pCurColumn);
 }
 
@@ -253,7 +264,7 @@ void SpAlgGourlay::include_object(ColStaffObjsEntry* pCurEntry, int iCol, int iI
 //---------------------------------------------------------------------------------------
 ShapeData* SpAlgGourlay::save_info_for_shape(GmoShape* pShape, int iInstr, int iStaff)
 {
-    ShapeData* pShapeData = LOMSE_NEW ShapeData();
+    ShapeData* pShapeData = new (arena_allocate(sizeof(ShapeData))) ShapeData();
     m_shapes.push_back(pShapeData);
 
     int idxStaff = m_pScoreMeter->staff_index(iInstr, iStaff);
@@ -370,28 +381,33 @@ void SpAlgGourlay::include_full_measure_rest(GmoShape* pRestShape,
 void SpAlgGourlay::new_slice(ColStaffObjsEntry* pEntry, int entryType, int iColumn,
                              int iShape)
 {
-    //create the slice object
+    //create the slice object, in the arena
     TimeSlice* pSlice;
     switch(entryType)
     {
         case TimeSlice::k_prolog:
-            pSlice = LOMSE_NEW TimeSliceProlog(pEntry, iColumn, iShape);
+            pSlice = new (arena_allocate(sizeof(TimeSliceProlog)))
+                            TimeSliceProlog(pEntry, iColumn, iShape);
             break;
         case TimeSlice::k_non_timed:
-            pSlice = LOMSE_NEW TimeSliceNonTimed(pEntry, iColumn, iShape);
+            pSlice = new (arena_allocate(sizeof(TimeSliceNonTimed)))
+                            TimeSliceNonTimed(pEntry, iColumn, iShape);
             break;
         case TimeSlice::k_barline:
-            pSlice = LOMSE_NEW TimeSliceBarline(pEntry, iColumn, iShape);
+            pSlice = new (arena_allocate(sizeof(TimeSliceBarline)))
+                            TimeSliceBarline(pEntry, iColumn, iShape);
             break;
         case TimeSlice::k_noterest:
         {
             int numLines = m_pScoreMeter->num_lines();
-            pSlice = LOMSE_NEW TimeSliceNoterest(pEntry, iColumn, iShape, numLines,
-                                                 m_pScoreMeter->num_staves());
+            pSlice = new (arena_allocate(sizeof(TimeSliceNoterest)))
+                            TimeSliceNoterest(pEntry, iColumn, iShape, numLines,
+                                              m_pScoreMeter->num_staves());
             break;
         }
         case TimeSlice::k_graces:
-            pSlice = LOMSE_NEW TimeSliceGraces(pEntry, iColumn, iShape);
+            pSlice = new (arena_allocate(sizeof(TimeSliceGraces)))
+                            TimeSliceGraces(pEntry, iColumn, iShape);
             break;
         default:
             stringstream ss;
@@ -473,6 +489,10 @@ void SpAlgGourlay::do_spacing(int iColumnToTrace)
     //when this method is invoked, all columns in the score have been created and the
     //information collected.
 
+    //columns data will change. Discard lines break data
+    m_iLineFirstCol = -1;
+    m_fNegativeMinWidths = false;
+
     //collect information, mainly by processing slices
     determine_spacing_parameters();
     compute_rods_ds_and_di();
@@ -488,6 +508,8 @@ void SpAlgGourlay::do_spacing(int iColumnToTrace)
         (*it)->order_slices();
         (*it)->collect_barlines_information(numInstruments);
         (*it)->determine_minimum_width();
+        if ((*it)->get_minimum_width() < 0.0f)
+            m_fNegativeMinWidths = true;
         (*it)->apply_force(m_Fopt);     //to get an initial estimation for columns width
         (*it)->determine_approx_sff_for(m_Fopt);
 
@@ -897,23 +919,16 @@ float SpAlgGourlay::determine_penalty_for_line(int iSystem, int iFirstCol, int i
 //        return -1.0f;
 //    }
 
-    LUnits lineWidth = m_pScoreLyt->get_target_size_for_system(iSystem);
-    if (iSystem > 0)
-        lineWidth -= 1000.0f; //m_pScoreLyt->get_prolog_width_for_system(iSystem);
+    LUnits lineWidth = determine_line_width(iSystem);
 
     //determine composite spacing function sff[cicj]
     //                       j                          j
     //    sff[cicj] = 1 / ( SUM ( 1/Cappn ) )  = 1 / ( SUM ( slope.n ) )
     //                      n=i                        n=i
-    float sum = 0.0f;
-    LUnits fixed = 0.0f;
-    LUnits minWidth = 0.0f;
-    for (int i = iFirstCol; i <= iLastCol; ++i)
-    {
-        sum += m_columns[i]->m_slope;
-        fixed += m_columns[i]->m_xFixed;
-        minWidth += m_columns[i]->get_minimum_width();
-    }
+    accumulate_line_data(iFirstCol, iLastCol);
+    float sum = m_lineSlope;
+    LUnits fixed = m_lineFixed;
+    LUnits minWidth = m_lineMinWidth;
     float c = 1.0f / sum;
 
     //if minimum width is greater than required width, it is impossible to achieve
@@ -972,6 +987,54 @@ float SpAlgGourlay::determine_penalty_for_line(int iSystem, int iFirstCol, int i
     return R;
 }
 
+//---------------------------------------------------------------------------------------
+LUnits SpAlgGourlay::determine_line_width(int iSystem)
+{
+    LUnits lineWidth = m_pScoreLyt->get_target_size_for_system(iSystem);
+    if (iSystem > 0)
+        lineWidth -= 1000.0f; //m_pScoreLyt->get_prolog_width_for_system(iSystem);
+    return lineWidth;
+}
+
+//---------------------------------------------------------------------------------------
+void SpAlgGourlay::accumulate_line_data(int iFirstCol, int iLastCol)
+{
+    //The lines break algorithm evaluates lines {ci, ..., cj} for j = i, i+1, ...
+    //Therefore, sums for line {ci, ..., cj} are obtained by adding column j to the
+    //sums for the previous line. Columns are added in the same order than when
+    //computing the sums from scratch, so results are exactly the same.
+
+    if (iFirstCol != m_iLineFirstCol || iLastCol < m_iLineLastCol)
+    {
+        m_iLineFirstCol = iFirstCol;
+        m_iLineLastCol = iFirstCol - 1;
+        m_lineSlope = 0.0f;
+        m_lineFixed = 0.0f;
+        m_lineMinWidth = 0.0f;
+    }
+
+    for (int i = m_iLineLastCol + 1; i <= iLastCol; ++i)
+    {
+        m_lineSlope += m_columns[i]->m_slope;
+        m_lineFixed += m_columns[i]->m_xFixed;
+        m_lineMinWidth += m_columns[i]->get_minimum_width();
+    }
+    m_iLineLastCol = iLastCol;
+}
+
+//---------------------------------------------------------------------------------------
+bool SpAlgGourlay::is_line_too_wide(int iSystem, int iFirstCol, int iLastCol)
+{
+    //same criterion than in determine_penalty_for_line(). When columns minimum width
+    //is not negative, adding more columns will not reduce the minimum width
+
+    if (iFirstCol == iLastCol || m_fNegativeMinWidths)
+        return false;
+
+    accumulate_line_data(iFirstCol, iLastCol);
+    return m_lineMinWidth > determine_line_width(iSystem);
+}
+
 //---------------------------------------------------------------------------------------
 bool SpAlgGourlay::is_better_option(float prevPenalty, float newPenalty,
                                     float nextPenalty, int UNUSED(i), int UNUSED(j))
@@ -2713,6 +2776,8 @@ int TimeSliceNoterest::compute_neighborhood(int prevNeighborhood, int numOpenSeq
 //=====================================================================================
 ColumnDataGourlay::ColumnDataGourlay(TimeSlice* pSlice)
     : m_pFirstSlice(pSlice)
+    , m_sumRods(0.0f)
+    , m_sumLeft(0.0f)
     , m_slope(1.0f)
     , m_minFi(0.0f)
     , m_xFixed(0.0f)
@@ -2821,6 +2886,35 @@ void ColumnDataGourlay::order_slices()
         //in this case exit loop to save time
         if (!fChanges) break;
     }
+
+    load_slices_data();
+}
+
+//---------------------------------------------------------------------------------------
+void ColumnDataGourlay::load_slices_data()
+{
+    //copy the slices data used when applying forces. Slices rods and springs are
+    //not modified after ordering the slices.
+
+    int numSlices = num_slices();
+    m_sliceFi.resize(numSlices);
+    m_sliceC.resize(numSlices);
+    m_sliceRods.resize(numSlices);
+    m_sliceLeft.resize(numSlices);
+    m_sliceWidth.assign(numSlices, 0.0f);
+
+    m_sumRods = 0.0f;
+    m_sumLeft = 0.0f;
+    for (int i=0; i < numSlices; ++i)
+    {
+        TimeSlice* pSlice = m_orderedSlices[i];
+        m_sliceFi[i] = pSlice->m_fi;
+        m_sliceC[i] = pSlice->m_c;
+        m_sliceRods[i] = pSlice->get_total_rods();
+        m_sliceLeft[i] = pSlice->m_dxLeft;
+        m_sumRods += m_sliceRods[i];
+        m_sumLeft += m_sliceLeft[i];
+    }
 }
 
 //---------------------------------------------------------------------------------------
@@ -3023,15 +3117,25 @@ bool ColumnDataGourlay::is_empty_column()
 //---------------------------------------------------------------------------------------
 void ColumnDataGourlay::apply_force(float F)
 {
-    //modify slices by applying force F to them
+    //modify slices by applying force F to them. Same computation than
+    //TimeSlice::apply_force() but using the slices data arrays
+
+    int numSlices = num_slices();
+    const float* fi = m_sliceFi.data();
+    const float* c = m_sliceC.data();
+    const LUnits* rods = m_sliceRods.data();
+    const LUnits* left = m_sliceLeft.data();
+    LUnits* width = m_sliceWidth.data();
 
     m_colWidth = 0.0f;
-    vector<TimeSlice*>::iterator it;
-    for (it = m_orderedSlices.begin(); it != m_orderedSlices.end(); ++it)
+    for (int i=0; i < numSlices; ++i)
     {
-        (*it)->apply_force(F);
-        m_colWidth += (*it)->get_width();
+        width[i] = (F > fi[i] ? F / c[i] : rods[i]) + left[i];
+        m_colWidth += width[i];
     }
+
+    for (int i=0; i < numSlices; ++i)
+        m_orderedSlices[i]->m_width = width[i];
 }
 
 //---------------------------------------------------------------------------------------
@@ -3047,13 +3151,12 @@ LUnits ColumnDataGourlay::determine_extent_for(float F)
     //find first slice whose pre-stretching force is lower than F
     for (i = num_slices()-1; i >= 0; --i)
     {
-        TimeSlice* pSlice = m_orderedSlices[i];
-        if (F > pSlice->m_fi)
+        if (F > m_sliceFi[i])
             break;      //the first slice that will react to F is found
 
         //pre-stretching force for current slice is greater than F. The slice extent
         //will be the pre-stretching extent xi
-        extent += pSlice->get_total_rods() + pSlice->m_dxLeft;
+        extent += m_sliceRods[i] + m_sliceLeft[i];
     }
 
     //if F is lower than all slices pre-stretching force, the column extent
@@ -3066,9 +3169,8 @@ LUnits ColumnDataGourlay::determine_extent_for(float F)
     float s = 0.0f;
     for (int j = i-1; j > 0; --j)
     {
-        TimeSlice* pSlice = m_orderedSlices[j];
-        s += 1.0f / pSlice->m_c;
-        extent += pSlice->m_dxLeft;
+        s += 1.0f / m_sliceC[j];
+        extent += m_sliceLeft[j];
     }
     //composite spring constant is c = 1 / s
 
@@ -3084,44 +3186,40 @@ float ColumnDataGourlay::determine_force_for(LUnits x)
     //function sff(x) : Determining the required force for a given extent x
     //The result is exact. The returned force achieves the required extent.
 
-    //Pre-calculate the minimum extent
-    LUnits xmin = 0.0f;
-    LUnits xFixed = 0.0f;
-    vector<TimeSlice*>::iterator it;
-    for (it = m_orderedSlices.begin(); it != m_orderedSlices.end(); ++it)
-    {
-        xmin += (*it)->get_total_rods();
-        xFixed += (*it)->m_dxLeft;
-    }
+    if (num_slices() == 0)
+        return 0.0f;
+
+    //the minimum extent was pre-calculated when loading slices data
+    LUnits xmin = m_sumRods;
 
     //if the required extent is lower than the minimum extent the required force is 0
-    x -= xFixed;
+    x -= m_sumLeft;
     if (x <= xmin)
         return 0.0f;
 
     //compute combined spring constant for all springs that will react to F
-    it = m_orderedSlices.begin();
-    TimeSlice* pLast = m_orderedSlices.back();
+    int iLast = num_slices() - 1;
+    int i = 0;
     float F;
-    float slope = 1.0f / (*it)->m_c;
+    float slope = 1.0f / m_sliceC[0];
     while (true)
     {
         //calculate force required by current spring
-        xmin -= (*it)->get_total_rods();
+        xmin -= m_sliceRods[i];
         F = (x - xmin) / slope;
 
         //if we are at the very last spring return the computed force
-        if (*it == pLast)
+        if (i == iLast)
             return F;
 
-        ++it;
+        ++i;
         //the next spring is bigger than current force
         //return the computed force
-        if (F <= (*it)->m_fi)
+        if (F <= m_sliceFi[i])
             return F;
 
         //Adjust the combined spring constant
-        slope += 1.0f / (*it)->m_c;
+        slope += 1.0f / m_sliceC[i];
     }
 }
 
@@ -3136,36 +3234,34 @@ void ColumnDataGourlay::determine_approx_sff_for(float F)
     m_xFixed = 0.0f;
     m_minFi = LOMSE_MAX_FORCE;
     float cFiMin = 0.0f;
-    vector<TimeSlice*>::iterator it;
-    for (it = m_orderedSlices.begin(); it != m_orderedSlices.end(); ++it)
+    int numSlices = num_slices();
+    for (int i=0; i < numSlices; ++i)
     {
-        m_xFixed += (*it)->m_dxLeft;
-        if (m_minFi > (*it)->m_fi)
+        m_xFixed += m_sliceLeft[i];
+        if (m_minFi > m_sliceFi[i])
         {
-            m_minFi = (*it)->m_fi;
-            cFiMin = (*it)->m_c;
+            m_minFi = m_sliceFi[i];
+            cFiMin = m_sliceC[i];
         };
 
         //if the force of this spring is bigger than F do not take this spring into
         //account, only its pre-stretching extent
-        if (F <= (*it)->m_fi)
-            m_xFixed += (*it)->get_total_rods();
+        if (F <= m_sliceFi[i])
+            m_xFixed += m_sliceRods[i];
         else
         {
             //Add this spring to the combined spring
             //  c = 1 / ( (1/c) + (1/ci) ), but s = 1/c       ==>
             //  s = s + (1/ci)
-            m_slope += 1.0f / (*it)->m_c;
+            m_slope += 1.0f / m_sliceC[i];
         }
 
-//        dbgLogger << "    Slice: type="<< (*it)->get_type()
-//                  << ", 1st data=" << (*it)->dbg_get_first_data()
-//                  << ", width=" << (*it)->get_width()
-//                  << ", m_fi= " << (*it)->m_fi
-//                  << ", m_c=" << (*it)->m_c
-//                  << ", xi=" << (*it)->get_total_rods()
+//        dbgLogger << "    Slice: i="<< i
+//                  << ", m_fi= " << m_sliceFi[i]
+//                  << ", m_c=" << m_sliceC[i]
+//                  << ", xi=" << m_sliceRods[i]
 //                  << ", m_xFixed=" << m_xFixed
-//                  << ", m_dxLeft=" << (*it)->m_dxLeft
+//                  << ", m_dxLeft=" << m_sliceLeft[i]
 //                  << ", slope=" << m_slope << endl;
     }
 
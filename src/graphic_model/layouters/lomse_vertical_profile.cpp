@@ -19,6 +19,7 @@
 #include "lomse_logger.h"
 
 #include <sstream>
+#include <algorithm>
 using namespace std;
 
 
@@ -155,124 +156,107 @@ void VerticalProfile::update_shape(GmoShape* pShape, int idxStaff)
 
 
     //update xPos and shapes, minimum profile
-    list<VProfilePoint>* pPointsMin = m_xMin[idxStaff];
+    PointsRow* pPointsMin = m_xMin[idxStaff];
     update_profile(pPointsMin, yTop, false, xLeft, xRight, pShape);    //false -> minimum profile
 
     //update xPos and shapes, maximum profile
-    list<VProfilePoint>* pPointsMax = m_xMax[idxStaff];
+    PointsRow* pPointsMax = m_xMax[idxStaff];
     update_profile(pPointsMax, yBottom, true, xLeft, xRight, pShape);  //true -> maximum profile
 }
 
 //---------------------------------------------------------------------------------------
-void VerticalProfile::update_profile(list<VProfilePoint>* pPoints, LUnits yPos, bool fMax,
+void VerticalProfile::update_profile(PointsRow* pPoints, LUnits yPos, bool fMax,
                                      LUnits xLeft, LUnits xRight, GmoShape* pShape)
 {
-//    cout << "Update " << (fMax ? "Max" : "Min") << " ----------------------------------------------------" << endl;
+    PointsRow& points = *pPoints;
 
-    PointsIterator itLeft = locate_insertion_point(pPoints, xLeft);
-    PointsIterator itPrevLeft = (itLeft != pPoints->begin() ? std::prev(itLeft) : itLeft);
-    VProfilePoint ptPrevLeft = *itPrevLeft;    //Data defining current level
+    size_t iLeft = locate_insertion_point(pPoints, xLeft) - points.begin();
+    VProfilePoint ptPrevLeft = points[iLeft > 0 ? iLeft - 1 : iLeft];    //current level
 
-    PointsIterator itRight = locate_insertion_point(pPoints, xRight);
-    PointsIterator itPrevRight = (itRight != pPoints->begin() ? std::prev(itRight) : itRight);
-    VProfilePoint ptPrevRight = *itPrevRight;
+    size_t iRight = locate_insertion_point(pPoints, xRight) - points.begin();
+    VProfilePoint ptPrevRight = points[iRight > 0 ? iRight - 1 : iRight];
 
 
     //Insert/update point for left border of added shape
     if ((fMax && (yPos > ptPrevLeft.y)) || (!fMax && (yPos < ptPrevLeft.y)))
     {
-        update_point(pPoints, xLeft, yPos, pShape, itLeft);
+        if (update_point(pPoints, xLeft, yPos, pShape, iLeft))
+        {
+            //inserted before iLeft: existing points are shifted
+            ++iLeft;
+            ++iRight;
+        }
     }
 
 
-    //remove or update intermediate points if necessary
+    //remove or update intermediate points if necessary. Removed points are
+    //compacted in place and erased at once
     VProfilePoint ptRef = {xRight, yPos, pShape};   //left border of new added shape
-//    cout << "Ref.point: xPos=" << ptRef.x << ", ptRef.y=" << ptRef.y
-//         << ", ptRef.shape=" << (void*)(ptRef.shape) << endl;
-    LUnits yPrev = (*std::prev(itLeft)).y;
-    GmoShape* pPrevShape = (*std::prev(itLeft)).shape;
-//    cout << "itLeft: xPos=" << (*itLeft).x << ", itRight: xPos=" << (*itRight).x << endl;
-    while (itLeft != itRight)
+    LUnits yPrev = (iLeft > 0 ? points[iLeft - 1].y : LOMSE_PAPER_LOWER_LIMIT);
+    GmoShape* pPrevShape = (iLeft > 0 ? points[iLeft - 1].shape : nullptr);
+    size_t iDest = iLeft;
+    for (size_t i = iLeft; i < iRight; ++i)
     {
-        VProfilePoint ptCur = *itLeft;
-//        cout << "Cur.point: xPos=" << ptCur.x << ", ptCur.y=" << ptCur.y
-//             << ", yPrev=" << yPrev << "--> ptRef.y=" << ptRef.y << endl;
+        VProfilePoint ptCur = points[i];
         if ( (!fMax && (ptCur.y > ptRef.y)) || (fMax && (ptCur.y < ptRef.y)) )
         {
             if (yPrev == ptRef.y && pPrevShape == ptRef.shape)
-            {
-                //remove point
-                itLeft = pPoints->erase(itLeft);
-//                cout << "    Point removed. New itLeft: xPos=" << (*itLeft).x << endl;
-            }
-            else
-            {
-                //update point
-                (*itLeft).y = ptRef.y;
-                (*itLeft).shape = ptRef.shape;
-//                cout << "    Point updated: xPos=" << ptCur.x << ", yPos=" << ptRef.y
-//                     << ", shape=" << (void*)(ptRef.shape) << endl;
-//
-                yPrev = ptRef.y;
-                pPrevShape = ptRef.shape;
-                ++itLeft;
-            }
-        }
-        else
-        {
-            //keep point as is
-//            cout << "    Point kept" << endl;
-            yPrev = (*itLeft).y;
-            pPrevShape = (*itLeft).shape;
-            ++itLeft;
+                continue;   //remove point
+
+            //update point
+            ptCur.y = ptRef.y;
+            ptCur.shape = ptRef.shape;
         }
+        //else: keep point as is
+
+        yPrev = ptCur.y;
+        pPrevShape = ptCur.shape;
+        points[iDest++] = ptCur;
+    }
+    if (iDest != iRight)
+    {
+        points.erase(points.begin() + iDest, points.begin() + iRight);
+        iRight = iDest;
     }
-//    cout << endl;
 
     //Insert/update point for right border of added shape
     if ((fMax && (yPos > ptPrevRight.y)) || (!fMax && (yPos < ptPrevRight.y)))
     {
-        update_point(pPoints, xRight, ptPrevRight.y, ptPrevRight.shape, itRight);
+        update_point(pPoints, xRight, ptPrevRight.y, ptPrevRight.shape, iRight);
     }
 }
 
 //---------------------------------------------------------------------------------------
-void VerticalProfile::update_point(list<VProfilePoint>* pPoints, LUnits xPos,
-                                   LUnits yPos, GmoShape* pShape, PointsIterator itNext)
+bool VerticalProfile::update_point(PointsRow* pPoints, LUnits xPos, LUnits yPos,
+                                   GmoShape* pShape, size_t iNext)
 {
-    VProfilePoint ptNext = *itNext;    //Data for point greater or equal to xLeft
+    //returns true if a new point has been inserted before point iNext
 
-    //update minimum profile
-    if (xPos == ptNext.x)
+    if (xPos == (*pPoints)[iNext].x)
     {
         //replace point. But nothing to do as existing point either:
         //- is valid (this is the case for the right border of the new shape, or
         //- will be upated when dealing with intermediate points (left border of new shape)
+        return false;
     }
-    else    //xPos < ptNext.x
-    {
-        //insert point
-        pPoints->insert(itNext, VProfilePoint(xPos, yPos, pShape));
-    }
+
+    //xPos < next point x: insert point
+    pPoints->insert(pPoints->begin() + iNext, VProfilePoint(xPos, yPos, pShape));
+    return true;
 }
 
 //---------------------------------------------------------------------------------------
-PointsIterator VerticalProfile::locate_insertion_point(list<VProfilePoint>* pPoints,
-                                                       LUnits xPos)
+PointsIterator VerticalProfile::locate_insertion_point(PointsRow* pPoints, LUnits xPos)
 {
-    list<VProfilePoint>::iterator it;
-    for (it = pPoints->begin(); it != pPoints->end(); ++it)
-    {
-        if ((*it).x >= xPos)
-            break;
-    }
-    return it;
+    //returns first point with x >= xPos
+    return std::lower_bound(pPoints->begin(), pPoints->end(), xPos,
+                            [](const VProfilePoint& pt, LUnits x) { return pt.x < x; });
 }
 
 //---------------------------------------------------------------------------------------
 std::pair<LUnits, GmoShape*> VerticalProfile::get_max_for(LUnits xStart, LUnits xEnd, int idxStaff)
 {
-    list<VProfilePoint>* pPoints = m_xMax[idxStaff];
+    PointsRow* pPoints = m_xMax[idxStaff];
     PointsIterator it = locate_insertion_point(pPoints, xStart);
     if (it != pPoints->begin())
         --it;
@@ -293,7 +277,7 @@ std::pair<LUnits, GmoShape*> VerticalProfile::get_max_for(LUnits xStart, LUnits
 std::pair<LUnits, GmoShape*> VerticalProfile::get_min_for(LUnits xStart, LUnits xEnd,
                                                           int idxStaff)
 {
-    list<VProfilePoint>* pPoints = m_xMin[idxStaff];
+    PointsRow* pPoints = m_xMin[idxStaff];
     PointsIterator it = locate_insertion_point(pPoints, xStart);
     if (it != pPoints->begin())
         --it;
@@ -338,7 +322,7 @@ GmoShape* VerticalProfile::dbg_generate_shape(bool fMax, int idxStaff)
     LUnits xLast = xStart;
     LUnits yLast = yStart;
 
-    list<VProfilePoint>* pPoints = (fMax ? m_xMax[idxStaff] : m_xMin[idxStaff]);
+    PointsRow* pPoints = (fMax ? m_xMax[idxStaff] : m_xMin[idxStaff]);
     PointsIterator it;
     for (it=pPoints->begin(); it != pPoints->end(); ++it)
     {
@@ -367,7 +351,7 @@ string VerticalProfile::dump_max(int idxStaff)
 }
 
 //---------------------------------------------------------------------------------------
-string VerticalProfile::dump(list<VProfilePoint>* pPoints)
+string VerticalProfile::dump(PointsRow* pPoints)
 {
     stringstream msg;
     PointsIterator it;
@@ -383,8 +367,8 @@ LUnits VerticalProfile::get_staves_distance(int idxStaff)
 {
     int idxPrev = idxStaff - 1;
 
-    list<VProfilePoint>* pPointsPrev = m_xMax[idxPrev];
-    list<VProfilePoint>* pPointsCur = m_xMin[idxStaff];
+    PointsRow* pPointsPrev = m_xMax[idxPrev];
+    PointsRow* pPointsCur = m_xMin[idxStaff];
     PointsIterator itPrev = pPointsPrev->begin();
 	LUnits xPrev = (*itPrev).x;
     LUnits yPrev = ((*itPrev).y == LOMSE_PAPER_LOWER_LIMIT ? m_yStaffBottom[idxPrev]
@@ -430,7 +414,7 @@ vector<UPoint> VerticalProfile::get_min_profile_points(LUnits xStart, LUnits xEn
                                                        int idxStaff)
 {
     vector<UPoint> dataPoints;
-    list<VProfilePoint>* pPoints = m_xMin[idxStaff];
+    PointsRow* pPoints = m_xMin[idxStaff];
     PointsIterator it = locate_insertion_point(pPoints, xStart);
     if (it != pPoints->begin())
         --it;
@@ -448,7 +432,7 @@ vector<UPoint> VerticalProfile::get_max_profile_points(LUnits xStart, LUnits xEn
                                                        int idxStaff)
 {
     vector<UPoint> dataPoints;
-    list<VProfilePoint>* pPoints = m_xMax[idxStaff];
+    PointsRow* pPoints = m_xMax[idxStaff];
     PointsIterator it = locate_insertion_point(pPoints, xStart);
     if (it != pPoints->begin())
         --it;
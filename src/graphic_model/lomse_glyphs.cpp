@@ -10,6 +10,7 @@
 #include "lomse_glyphs.h"
 
 #include "lomse_injectors.h"
+#include "lomse_font_storage.h"
 
 
 namespace lomse
@@ -873,20 +874,157 @@ const GlyphData m_glyphs_smufl[] =
 };
 
 //=======================================================================================
-// MusicGlyphs implementation
+// GlyphMetricsTable implementation
+//=======================================================================================
+GlyphMetricsTable::GlyphMetricsTable(double height, double scaling, int numGlyphs)
+    : fontHeight(height)
+    , scale(scaling)
+    , entries( LOMSE_NEW Entry[numGlyphs] )
+    , pNext(nullptr)
+{
+}
+
+//---------------------------------------------------------------------------------------
+GlyphMetricsTable::~GlyphMetricsTable()
+{
+    delete [] entries;
+}
+
 
+//=======================================================================================
+// MusicGlyphs implementation
+//=======================================================================================
 MusicGlyphs::MusicGlyphs(LibraryScope* pLibScope)
     : m_pLibScope(pLibScope)
     , m_glyphs(nullptr)
+    , m_pMetrics(nullptr)
+    , m_pMeasurer(nullptr)
 {
     update();
 }
 
+//---------------------------------------------------------------------------------------
+MusicGlyphs::~MusicGlyphs()
+{
+    std::vector<GlyphMetricsTable*>::iterator it;
+    for (it = m_allMetrics.begin(); it != m_allMetrics.end(); ++it)
+        delete *it;
+
+    delete m_pMeasurer;
+}
+
 //---------------------------------------------------------------------------------------
 void MusicGlyphs::update()
 {
     if (m_pLibScope->is_music_font_smufl_compliant())
         m_glyphs = &m_glyphs_smufl[0];
+
+    //metrics for previous font are no longer valid. Glyph metrics are read by the
+    //layouters, and layout always runs with the library layout mutex locked (see
+    //DocLayouter). Therefore, once the layout mutex is acquired no other thread is
+    //reading the tables and they can be safely deleted
+    std::lock_guard<std::recursive_mutex> layoutLock(m_pLibScope->get_layout_mutex());
+    std::lock_guard<std::mutex> lock(m_metricsMutex);
+    m_pMetrics.store(nullptr, std::memory_order_release);
+
+    std::vector<GlyphMetricsTable*>::iterator it;
+    for (it = m_allMetrics.begin(); it != m_allMetrics.end(); ++it)
+        delete *it;
+    m_allMetrics.clear();
+}
+
+//---------------------------------------------------------------------------------------
+int MusicGlyphs::get_num_metrics_tables()
+{
+    std::lock_guard<std::mutex> lock(m_metricsMutex);
+    return int(m_allMetrics.size());
+}
+
+//---------------------------------------------------------------------------------------
+int MusicGlyphs::num_glyphs()
+{
+    return int(sizeof(m_glyphs_smufl) / sizeof(GlyphData));
+}
+
+//---------------------------------------------------------------------------------------
+const GlyphMetrics& MusicGlyphs::get_glyph_metrics(int iGlyph, double fontHeight)
+{
+    //Metrics are measured only once per glyph and font size. Afterwards, they are
+    //read without locks and without accessing the font engine. This allows
+    //layouting in several threads while the GUI thread renders.
+
+    double scale = m_pLibScope->get_screen_ppi() / 2540.0;
+    GlyphMetricsTable* pTable = find_metrics_table(fontHeight, scale);
+    if (pTable)
+    {
+        GlyphMetricsTable::Entry& entry = pTable->entries[iGlyph];
+        if (entry.fValid.load(std::memory_order_acquire))
+            return entry.metrics;
+    }
+
+    return measure_glyph(iGlyph, fontHeight, scale);
+}
+
+//---------------------------------------------------------------------------------------
+GlyphMetricsTable* MusicGlyphs::find_metrics_table(double fontHeight, double scale)
+{
+    GlyphMetricsTable* pTable = m_pMetrics.load(std::memory_order_acquire);
+    while (pTable && (pTable->fontHeight != fontHeight || pTable->scale != scale))
+        pTable = pTable->pNext;
+    return pTable;
+}
+
+//---------------------------------------------------------------------------------------
+const GlyphMetrics& MusicGlyphs::measure_glyph(int iGlyph, double fontHeight,
+                                               double scale)
+{
+    std::lock_guard<std::mutex> lock(m_metricsMutex);
+
+    //other thread could have created the table or measured the glyph
+    GlyphMetricsTable* pTable = find_metrics_table(fontHeight, scale);
+    if (!pTable)
+    {
+        pTable = LOMSE_NEW GlyphMetricsTable(fontHeight, scale, num_glyphs());
+        pTable->pNext = m_pMetrics.load(std::memory_order_relaxed);
+        m_allMetrics.push_back(pTable);
+        m_pMetrics.store(pTable, std::memory_order_release);
+    }
+
+    GlyphMetricsTable::Entry& entry = pTable->entries[iGlyph];
+    if (entry.fValid.load(std::memory_order_relaxed))
+        return entry.metrics;
+
+    //the shared FontStorage is not used, as it is not thread safe
+    if (!m_pMeasurer)
+        m_pMeasurer = LOMSE_NEW FontStorage(m_pLibScope);
+
+    m_pMeasurer->select_font("any",
+                             m_pLibScope->get_music_font_file(),
+                             m_pLibScope->get_music_font_name(),
+                             fontHeight);
+
+    GlyphMetrics& metrics = entry.metrics;
+    unsigned int ch = glyph_code(iGlyph);
+    if (m_pMeasurer->is_font_valid())
+    {
+        agg::trans_affine mtx;
+        mtx *= agg::trans_affine_scaling(1.0 / scale);
+        m_pMeasurer->set_transform(mtx);
+        const lomse::glyph_cache* glyph = m_pMeasurer->get_glyph_cache(ch);
+        if (glyph)
+        {
+            //(x1,y1) is left-top corner and (x2,y2) is right-bottom corner
+            agg::rect_i bbox = glyph->bounds;
+            metrics.bounds.width = Tenths(bbox.x2 - bbox.x1);
+            metrics.bounds.height = Tenths(bbox.y2 - bbox.y1);
+            metrics.bounds.x = Tenths(bbox.x1);
+            metrics.bounds.y = Tenths(bbox.y1);
+            metrics.advance = static_cast<LUnits>(glyph->advance_x);
+        }
+    }
+
+    entry.fValid.store(true, std::memory_order_release);
+    return metrics;
 }
 
 }  //namespace lomse
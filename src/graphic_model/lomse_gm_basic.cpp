@@ -22,6 +22,8 @@
 
 #include <cstdlib>      //abs
 #include <iomanip>
+#include <cmath>        //sqrt, ceil, floor
+#include <algorithm>
 using namespace std;
 
 
@@ -71,6 +73,7 @@ void GmoObj::set_origin(LUnits xLeft, LUnits yTop)
 {
     m_origin.x = xLeft;
     m_origin.y = yTop;
+    invalidate_page_index();
 }
 
 //---------------------------------------------------------------------------------------
@@ -102,6 +105,22 @@ void GmoObj::shift_origin(const USize& shift)
 {
     m_origin.x += shift.width;
     m_origin.y += shift.height;
+    invalidate_page_index();
+}
+
+//---------------------------------------------------------------------------------------
+void GmoObj::invalidate_page_index()
+{
+    //The page spatial index and the boxes content bounds are no longer valid when
+    //an object is moved after building them. Objects not yet added to a page
+    //(i.e. while engraving) are ignored.
+
+    GmoBox* pBox = (is_box() ? static_cast<GmoBox*>(this) : m_pParentBox);
+    while (pBox && !pBox->is_box_doc_page())
+        pBox = pBox->get_parent_box();
+
+    if (pBox)
+        static_cast<GmoBoxDocPage*>(pBox)->invalidate_spatial_index();
 }
 
 //---------------------------------------------------------------------------------------
@@ -314,6 +333,7 @@ GmoBox::GmoBox(int objtype, ImoObj* pCreatorImo)
     , m_uBottomMargin(0.0f)
     , m_uLeftMargin(0.0f)
     , m_uRightMargin(0.0f)
+    , m_contentBounds(0.0f, 0.0f, 0.0f, 0.0f)
 {
 }
 
@@ -325,12 +345,14 @@ GmoBox::~GmoBox()
 }
 
 //---------------------------------------------------------------------------------------
-void GmoBox::delete_boxes()
+void GmoBox::delete_boxes(int iFirst)
 {
+    //delete child boxes iFirst..n-1
+
     std::vector<GmoBox*>::iterator it;
-    for (it=m_childBoxes.begin(); it != m_childBoxes.end(); ++it)
+    for (it=m_childBoxes.begin() + iFirst; it != m_childBoxes.end(); ++it)
         delete *it;
-    m_childBoxes.clear();
+    m_childBoxes.erase(m_childBoxes.begin() + iFirst, m_childBoxes.end());
 }
 
 //---------------------------------------------------------------------------------------
@@ -436,6 +458,11 @@ void GmoBox::set_flag_value(bool value, unsigned int flag)
 //---------------------------------------------------------------------------------------
 void GmoBox::on_draw(Drawer* pDrawer, RenderOptions& opt)
 {
+    if (is_culled(opt))
+        return;
+
+    ++opt.num_drawn;
+    pDrawer->reset_path_attributes();
     draw_border(pDrawer, opt);
     draw_shapes(pDrawer, opt);
 
@@ -445,12 +472,55 @@ void GmoBox::on_draw(Drawer* pDrawer, RenderOptions& opt)
         (*it)->on_draw(pDrawer, opt);
 }
 
+//---------------------------------------------------------------------------------------
+bool GmoBox::is_culled(RenderOptions& opt)
+{
+    //A box is culled when nothing in it (its shapes and the shapes in its child
+    //boxes) is visible. Boxes without computed content bounds are never culled, as
+    //shapes can extend out of the box bounds.
+
+    if (m_contentBounds.is_empty() || opt.is_visible(m_contentBounds))
+        return false;
+
+    ++opt.num_culled;
+    return true;
+}
+
 //---------------------------------------------------------------------------------------
 void GmoBox::draw_shapes(Drawer* pDrawer, RenderOptions& opt)
 {
+    //Each shape starts with default drawer attributes. Otherwise, the attributes
+    //left by the previous shape would be inherited, and rendering would depend on
+    //whether the previous shape has been culled.
+
+    std::list<GmoShape*>::iterator itS;
+    for (itS=m_shapes.begin(); itS != m_shapes.end(); ++itS)
+    {
+        if (opt.is_visible((*itS)->get_bounds()))
+        {
+            ++opt.num_drawn;
+            pDrawer->reset_path_attributes();
+            (*itS)->on_draw(pDrawer, opt);
+        }
+        else
+            ++opt.num_culled;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+URect GmoBox::compute_content_bounds()
+{
+    m_contentBounds = get_bounds();
+
     std::list<GmoShape*>::iterator itS;
     for (itS=m_shapes.begin(); itS != m_shapes.end(); ++itS)
-        (*itS)->on_draw(pDrawer, opt);
+        m_contentBounds.Union( (*itS)->get_bounds() );
+
+    std::vector<GmoBox*>::iterator it;
+    for (it=m_childBoxes.begin(); it != m_childBoxes.end(); ++it)
+        m_contentBounds.Union( (*it)->compute_content_bounds() );
+
+    return m_contentBounds;
 }
 
 //---------------------------------------------------------------------------------------
@@ -592,6 +662,7 @@ void GmoBox::shift_origin_and_content(const USize& shift)
 
     m_origin.x += shift.width;
     m_origin.y += shift.height;
+    invalidate_page_index();
 
     //shift contained boxes
     std::vector<GmoBox*>::iterator itB;
@@ -913,6 +984,15 @@ public:
 GmoBoxDocPage::GmoBoxDocPage(ImoObj* pCreatorImo)
     : GmoBox(GmoObj::k_box_doc_page, pCreatorImo)
     , m_numPage(1)
+    , m_fIndexValid(false)
+    , m_gridCols(0)
+    , m_gridRows(0)
+    , m_gridLeft(0.0f)
+    , m_gridTop(0.0f)
+    , m_gridRight(0.0f)
+    , m_gridBottom(0.0f)
+    , m_cellWidth(1.0f)
+    , m_cellHeight(1.0f)
 {
 }
 
@@ -926,8 +1006,10 @@ void GmoBoxDocPage::on_draw(Drawer* pDrawer, RenderOptions& opt)
         pDrawer->start_simple_notation(get_notation_id(ss.str()), "background");
     }
 
+    ensure_spatial_index();     //it also computes boxes content bounds, for culling
     draw_page_background(pDrawer, opt);
     GmoBox::on_draw(pDrawer, opt);
+    pDrawer->reset_path_attributes();   //for drawing after the page content
 }
 
 //---------------------------------------------------------------------------------------
@@ -947,18 +1029,8 @@ void GmoBoxDocPage::draw_page_background(Drawer* pDrawer, RenderOptions& UNUSED(
 //---------------------------------------------------------------------------------------
 void GmoBoxDocPage::add_to_tables(GmoShape* pShape)
 {
-    int layer = pShape->get_layer();
-    std::list<GmoShape*>::iterator it;
-    for (it = m_allShapes.begin(); it != m_allShapes.end(); ++it)
-    {
-        if ((*it)->get_layer() > layer)
-            break;
-    }
-
-    if (it == m_allShapes.end())
-        m_allShapes.push_back(pShape);
-    else
-        m_allShapes.insert(it, pShape);
+    m_layers[pShape->get_layer()].push_back(pShape);
+    m_fIndexValid = false;
 
     store_in_map_imo_shape(pShape);
 }
@@ -978,23 +1050,126 @@ void GmoBoxDocPage::store_in_map_imo_shape(GmoShape* pShape)
 //---------------------------------------------------------------------------------------
 GmoShape* GmoBoxDocPage::get_first_shape_for_layer(int layer)
 {
-    std::list<GmoShape*>::reverse_iterator it;
-    for (it = m_allShapes.rbegin(); it != m_allShapes.rend(); ++it)
+    //returns the last added shape in the layer, that is, the one on top of the others
+
+    std::map<int, std::vector<GmoShape*> >::iterator it = m_layers.find(layer);
+    if (it == m_layers.end() || it->second.empty())
+        return nullptr;
+    return it->second.back();
+}
+
+//---------------------------------------------------------------------------------------
+void GmoBoxDocPage::build_spatial_index()
+{
+    //The shapes are ordered by layer and creation order, and distributed in a uniform
+    //grid covering the bounds of all shapes, with about four shapes per cell. Cells
+    //are packed in a single vector. Building is linear in the number of shapes
+    //(plus the number of cells covered by each shape).
+
+    m_fIndexValid = true;
+    compute_content_bounds();
+    m_allShapes.clear();
+    for (auto& layer : m_layers)
+        m_allShapes.insert(m_allShapes.end(), layer.second.begin(), layer.second.end());
+
+    int numShapes = int(m_allShapes.size());
+    m_cellStart.clear();
+    m_cellShapes.clear();
+    m_gridCols = 0;
+    m_gridRows = 0;
+    if (numShapes == 0)
+        return;
+
+    //grid bounds
+    URect bounds = m_allShapes.front()->get_bounds();
+    m_gridLeft = bounds.left();
+    m_gridTop = bounds.top();
+    m_gridRight = bounds.right();
+    m_gridBottom = bounds.bottom();
+    for (GmoShape* pShape : m_allShapes)
     {
-        if ((*it)->get_layer() == layer)
-            return *it;
+        URect bbox = pShape->get_bounds();
+        m_gridLeft = min(m_gridLeft, bbox.left());
+        m_gridTop = min(m_gridTop, bbox.top());
+        m_gridRight = max(m_gridRight, bbox.right());
+        m_gridBottom = max(m_gridBottom, bbox.bottom());
     }
-    return nullptr;
+
+    //grid size
+    const int k_max_cells_per_side = 256;
+    LUnits width = max(m_gridRight - m_gridLeft, 1.0f);
+    LUnits height = max(m_gridBottom - m_gridTop, 1.0f);
+    double numCells = max(1.0, double(numShapes) / 4.0);
+    m_gridCols = int( ceil(sqrt(numCells * double(width) / double(height))) );
+    m_gridCols = max(1, min(m_gridCols, k_max_cells_per_side));
+    m_gridRows = int( ceil(numCells / double(m_gridCols)) );
+    m_gridRows = max(1, min(m_gridRows, k_max_cells_per_side));
+    m_cellWidth = width / LUnits(m_gridCols);
+    m_cellHeight = height / LUnits(m_gridRows);
+
+    //count shapes per cell
+    int totalCells = m_gridCols * m_gridRows;
+    m_cellStart.assign(totalCells + 1, 0);
+    int col1, row1, col2, row2;
+    for (GmoShape* pShape : m_allShapes)
+    {
+        get_cells_range(pShape->get_bounds(), &col1, &row1, &col2, &row2);
+        for (int row = row1; row <= row2; ++row)
+            for (int col = col1; col <= col2; ++col)
+                ++m_cellStart[row * m_gridCols + col + 1];
+    }
+    for (int i=0; i < totalCells; ++i)
+        m_cellStart[i+1] += m_cellStart[i];
+
+    //fill cells. Shapes are added in order, so each cell is sorted
+    m_cellShapes.resize(m_cellStart[totalCells]);
+    std::vector<int> next(m_cellStart.begin(), m_cellStart.end() - 1);
+    for (int i=0; i < numShapes; ++i)
+    {
+        get_cells_range(m_allShapes[i]->get_bounds(), &col1, &row1, &col2, &row2);
+        for (int row = row1; row <= row2; ++row)
+            for (int col = col1; col <= col2; ++col)
+                m_cellShapes[ next[row * m_gridCols + col]++ ] = i;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void GmoBoxDocPage::get_cells_range(const URect& rect, int* pCol1, int* pRow1,
+                                    int* pCol2, int* pRow2)
+{
+    //returns the range of cells overlapped by the rectangle, clipped to the grid
+
+    *pCol1 = int( floor((rect.left() - m_gridLeft) / m_cellWidth) );
+    *pCol2 = int( floor((rect.right() - m_gridLeft) / m_cellWidth) );
+    *pRow1 = int( floor((rect.top() - m_gridTop) / m_cellHeight) );
+    *pRow2 = int( floor((rect.bottom() - m_gridTop) / m_cellHeight) );
+
+    *pCol1 = max(0, min(*pCol1, m_gridCols - 1));
+    *pCol2 = max(0, min(*pCol2, m_gridCols - 1));
+    *pRow1 = max(0, min(*pRow1, m_gridRows - 1));
+    *pRow2 = max(0, min(*pRow2, m_gridRows - 1));
 }
 
 //---------------------------------------------------------------------------------------
 GmoShape* GmoBoxDocPage::find_shape_at(LUnits x, LUnits y)
 {
-    std::list<GmoShape*>::reverse_iterator it;
-    for (it = m_allShapes.rbegin(); it != m_allShapes.rend(); ++it)
+    //returns the shape on top (higher layer, last created) containing the point
+
+    ensure_spatial_index();
+    if (m_allShapes.empty() || x < m_gridLeft || x > m_gridRight
+        || y < m_gridTop || y > m_gridBottom)
     {
-        if ((*it)->hit_test(x, y))
-            return *it;
+        return nullptr;
+    }
+
+    int col1, row1, col2, row2;
+    get_cells_range(URect(x, y, 0.0f, 0.0f), &col1, &row1, &col2, &row2);
+    int cell = row1 * m_gridCols + col1;
+    for (int i = m_cellStart[cell+1] - 1; i >= m_cellStart[cell]; --i)
+    {
+        GmoShape* pShape = m_allShapes[ m_cellShapes[i] ];
+        if (pShape->hit_test(x, y))
+            return pShape;
     }
     return nullptr;
 }
@@ -1002,7 +1177,8 @@ GmoShape* GmoBoxDocPage::find_shape_at(LUnits x, LUnits y)
 //---------------------------------------------------------------------------------------
 GmoShape* GmoBoxDocPage::find_shape_for_object(ImoStaffObj* pSO)
 {
-    std::list<GmoShape*>::iterator it;
+    ensure_spatial_index();
+    std::vector<GmoShape*>::iterator it;
     for (it = m_allShapes.begin(); it != m_allShapes.end(); ++it)
     {
         if ((*it)->was_created_by(pSO))
@@ -1031,14 +1207,37 @@ void GmoBoxDocPage::select_objects_in_rectangle(SelectionSet* selection,
                                                 unsigned UNUSED(flags))
 {
     bool fSomethingSelected = false;
-    std::list<GmoShape*>::reverse_iterator it;
-    for (it = m_allShapes.rbegin(); it != m_allShapes.rend(); ++it)
+    ensure_spatial_index();
+    if (!m_allShapes.empty())
     {
-        URect bbox = (*it)->get_bounds();
-        if (selRect.contains(bbox))
+        //candidates: shapes in cells overlapped by the selection rectangle
+        std::vector<int> candidates;
+        int col1, row1, col2, row2;
+        get_cells_range(selRect, &col1, &row1, &col2, &row2);
+        for (int row = row1; row <= row2; ++row)
+        {
+            for (int col = col1; col <= col2; ++col)
+            {
+                int cell = row * m_gridCols + col;
+                candidates.insert(candidates.end(),
+                                  m_cellShapes.begin() + m_cellStart[cell],
+                                  m_cellShapes.begin() + m_cellStart[cell+1]);
+            }
+        }
+
+        //select them in reverse layer order, as they are found when hit testing
+        std::sort(candidates.begin(), candidates.end(), std::greater<int>());
+        candidates.erase( std::unique(candidates.begin(), candidates.end()),
+                          candidates.end() );
+        for (int i : candidates)
         {
-            selection->add(*it);
-            fSomethingSelected = true;
+            GmoShape* pShape = m_allShapes[i];
+            URect bbox = pShape->get_bounds();
+            if (selRect.contains(bbox))
+            {
+                selection->add(pShape);
+                fSomethingSelected = true;
+            }
         }
     }
 
@@ -1079,6 +1278,18 @@ GmoBoxDocPage* GmoBoxDocument::get_page(int i)
     return dynamic_cast<GmoBoxDocPage*>(get_child_box(i));
 }
 
+//---------------------------------------------------------------------------------------
+void GmoBoxDocument::delete_pages_from(int iPage)
+{
+    //delete pages iPage..n-1
+
+    if (iPage < 0 || iPage >= get_num_pages())
+        return;
+
+    delete_boxes(iPage);
+    m_pLastPage = (iPage > 0 ? get_page(iPage - 1) : nullptr);
+}
+
 //---------------------------------------------------------------------------------------
 int GmoBoxDocument::get_page_number(GmoBoxDocPage* pBoxPage)
 {
@@ -1119,10 +1330,16 @@ GmoBoxControl::GmoBoxControl(Control* ctrl, const UPoint& origin,
 //---------------------------------------------------------------------------------------
 void GmoBoxControl::on_draw(Drawer* pDrawer, RenderOptions& opt)
 {
+    if (is_culled(opt))
+        return;
+
     GmoBox::on_draw(pDrawer, opt);
 
     if (m_pControl)
+    {
+        pDrawer->reset_path_attributes();
         m_pControl->on_draw(pDrawer, opt);
+    }
 }
 
 //---------------------------------------------------------------------------------------
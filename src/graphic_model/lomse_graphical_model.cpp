@@ -25,10 +25,14 @@
 #include "lomse_box_slice.h"
 #include "lomse_timegrid_table.h"
 #include "lomse_score_algorithms.h"
+#include "lomse_document_layouter.h"
+#include "lomse_background_layouter.h"
 #include "lomse_logger.h"
 
 #include <cstdlib>      //abs
 #include <iomanip>
+#include <set>
+#include <climits>
 
 
 namespace lomse
@@ -41,9 +45,20 @@ namespace lomse
 static long m_idCounter = 0L;
 
 //---------------------------------------------------------------------------------------
-GraphicModel::GraphicModel(ImoDocument* pCreator)
+GraphicModel::GraphicModel(ImoDocument* pCreator, std::recursive_mutex* pSharedMutex)
     : m_modified(true)
+    , m_numChanges(0L)
+    , m_pLayouter(nullptr)
+    , m_fLayingOut(false)
+    , m_fLazyLayout(false)
+    , m_pBackground(nullptr)
+    , m_mutex(pSharedMutex ? *pSharedMutex : m_ownMutex)
 {
+    //AWARE: the layouters and the drawers share the fonts and text meters of the
+    //LibraryScope. Therefore, models created by the DocLayouter use the library
+    //layout mutex, so that the layout and rendering of all documents are
+    //serialized, including the background layout threads.
+
     m_root = LOMSE_NEW GmoBoxDocument(this, pCreator);
     m_modelId = ++m_idCounter;
 }
@@ -51,6 +66,8 @@ GraphicModel::GraphicModel(ImoDocument* pCreator)
 //---------------------------------------------------------------------------------------
 GraphicModel::~GraphicModel()
 {
+    cancel_background_layout();
+    delete m_pLayouter;     //AWARE: it could delete objects not yet in the model
     delete m_root;
 
     //delete stubs
@@ -64,19 +81,202 @@ GraphicModel::~GraphicModel()
 //---------------------------------------------------------------------------------------
 int GraphicModel::get_num_pages()
 {
+    finish_layout();
     return m_root->get_num_pages();
 }
 
 //---------------------------------------------------------------------------------------
 GmoBoxDocPage* GraphicModel::get_page(int i)
 {
-    return m_root->get_page(i);
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+    if (!m_pBackground)
+        layout_up_to_page(i);
+    return (i >= 0 && i < m_root->get_num_pages() ? m_root->get_page(i) : nullptr);
+}
+
+//---------------------------------------------------------------------------------------
+bool GraphicModel::is_layout_finished()
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    return m_pLayouter == nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+int GraphicModel::get_num_laid_out_pages()
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    return m_root->get_num_pages();
+}
+
+//---------------------------------------------------------------------------------------
+int GraphicModel::get_estimated_num_pages()
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    return (m_pLayouter ? m_pLayouter->get_estimated_num_pages()
+                        : m_root->get_num_pages());
+}
+
+//---------------------------------------------------------------------------------------
+float GraphicModel::get_layout_progress()
+{
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    return (m_pLayouter ? m_pLayouter->get_layout_progress() : 1.0f);
+}
+
+//---------------------------------------------------------------------------------------
+URect GraphicModel::get_page_bounds(int iPage)
+{
+    //For pages not yet laid out, the bounds of the last created page are assumed.
+    //Pages are not laid out.
+
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    int numPages = m_root->get_num_pages();
+    if (numPages == 0)
+        return URect(0.0f, 0.0f, 0.0f, 0.0f);
+
+    return m_root->get_page( min(iPage, numPages - 1) )->get_bounds();
+}
+
+//---------------------------------------------------------------------------------------
+void GraphicModel::set_pending_layout(DocLayouter* pLayouter)
+{
+    //Lazy layout. The model takes ownership of the layouter that will create the
+    //pending pages when they are requested.
+
+    delete m_pLayouter;
+    m_pLayouter = pLayouter;
+    m_fLazyLayout = true;
+}
+
+//---------------------------------------------------------------------------------------
+void GraphicModel::finish_layout()
+{
+#if (LOMSE_ENABLE_THREADS == 1)
+    if (m_pBackground)
+    {
+        //AWARE: the layout thread can not wait for itself. Pages will be available
+        //when the layout is finished
+        if (m_pBackground->is_worker_thread())
+            return;
+
+        m_pBackground->wait();
+        delete m_pBackground;
+        m_pBackground = nullptr;
+    }
+#endif
+
+    layout_up_to_page(INT_MAX - 1);
+}
+
+//---------------------------------------------------------------------------------------
+void GraphicModel::start_background_layout(Interactor* pInteractor)
+{
+    //Background layout. The pending pages are laid out in a worker thread.
+    //Requires a pending layout (see set_pending_layout()).
+
+#if (LOMSE_ENABLE_THREADS == 1)
+    if (!m_pLayouter || m_pBackground)
+        return;
+
+    m_pBackground = LOMSE_NEW BackgroundLayouter(this, pInteractor);
+    m_pBackground->start();
+#else
+    LOMSE_LOG_ERROR("Background layout requires threads support. Lazy layout used.");
+#endif
+}
+
+//---------------------------------------------------------------------------------------
+bool GraphicModel::is_background_layout_running()
+{
+#if (LOMSE_ENABLE_THREADS == 1)
+    return m_pBackground && m_pBackground->is_running();
+#else
+    return false;
+#endif
+}
+
+//---------------------------------------------------------------------------------------
+void GraphicModel::cancel_background_layout()
+{
+    //Stops the layout thread after the page being laid out. Pending pages, if any,
+    //will be laid out as in lazy layout.
+
+#if (LOMSE_ENABLE_THREADS == 1)
+    delete m_pBackground;
+    m_pBackground = nullptr;
+#endif
+}
+
+//---------------------------------------------------------------------------------------
+bool GraphicModel::layout_next_page()
+{
+    //Background layout. Invoked from the layout thread for creating the next pending
+    //page. The model is marked as modified, for redrawing the new page. Returns
+    //true when the layout is finished.
+
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+    layout_up_to_page( m_root->get_num_pages() );
+    set_modified(true);
+    return m_pLayouter == nullptr;
+}
+
+//---------------------------------------------------------------------------------------
+void GraphicModel::layout_up_to_page(int iPage)
+{
+    //Lazy layout. Creates pending pages until page iPage exists or the layout is
+    //finished. The layouter is deleted when the layout is finished.
+
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+    if (!m_pLayouter || m_fLayingOut || iPage < m_root->get_num_pages())
+        return;
+
+    m_fLayingOut = true;
+    int iFirstPage = m_root->get_num_pages();
+    GmoBox* pFirstPage = m_root->get_page(0);
+    bool fFinished = m_pLayouter->layout_more_pages(iPage);
+
+    //AWARE: when auto-scaling is applied all pages are created again
+    bool fRebuilt = (m_root->get_num_pages() == 0 || m_root->get_page(0) != pFirstPage);
+    build_main_boxes_table(fRebuilt ? 0 : iFirstPage);
+    if (fRebuilt)
+        set_modified(true);
+
+    if (fFinished)
+    {
+        delete m_pLayouter;
+        m_pLayouter = nullptr;
+    }
+    m_fLayingOut = false;
+}
+
+//---------------------------------------------------------------------------------------
+bool GraphicModel::layout_one_more_page()
+{
+    //Lazy layout. Used by the methods looking for an object, for laying out pages
+    //only until the object is found. Returns false when no page can be laid out:
+    //the layout is finished, it is in progress or it is done in background.
+
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+    if (!m_pLayouter || m_fLayingOut || m_pBackground)
+        return false;
+
+    layout_up_to_page( m_root->get_num_pages() );
+    return true;
 }
 
 //---------------------------------------------------------------------------------------
 void GraphicModel::draw_page(int iPage, UPoint& origin, Drawer* pDrawer,
                              RenderOptions& opt)
 {
+    //AWARE: drawing is serialized with the creation of pages in the layout thread.
+    //This also prevents concurrent use of fonts by the layouters and the drawer
+
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
     pDrawer->set_shift(-origin.x, -origin.y);
     GmoBoxDocPage* pPage = get_page(iPage);
     if (pPage)
@@ -85,17 +285,43 @@ void GraphicModel::draw_page(int iPage, UPoint& origin, Drawer* pDrawer,
         pDrawer->render();
         pDrawer->remove_shift();
     }
-    else
+    else if (m_pBackground && m_pLayouter)
+    {
+        draw_placeholder_page(iPage, pDrawer);
+        pDrawer->render();
+        pDrawer->remove_shift();
+    }
+    else if (!m_fLazyLayout)
     {
+        //AWARE: with lazy layout, views can request pages from an estimated
+        //number of pages
         stringstream msg;
         msg << "Page " << iPage << " does not exists!";
         LOMSE_LOG_ERROR(msg.str());
     }
 }
 
+//---------------------------------------------------------------------------------------
+void GraphicModel::draw_placeholder_page(int iPage, Drawer* pDrawer)
+{
+    //a blank page, for a page not yet created by the background layout
+
+    URect bounds = get_page_bounds(iPage);
+    pDrawer->begin_path();
+    pDrawer->fill( Color(255, 255, 255) );
+    pDrawer->stroke( Color(200, 200, 200) );
+    pDrawer->move_to(0.0, 0.0);
+    pDrawer->hline_to(bounds.width);
+    pDrawer->vline_to(bounds.height);
+    pDrawer->hline_to(0.0);
+    pDrawer->vline_to(0.0);
+    pDrawer->end_path();
+}
+
 //---------------------------------------------------------------------------------------
 void GraphicModel::dump_page(int iPage, ostream& outStream)
 {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
     outStream << "                    org.x        org.y     size.x      size.y" << endl;
     outStream << "-------------------------------------------------------------" << endl;
     get_page(iPage)->dump_boxes_shapes(outStream, 0);
@@ -104,27 +330,36 @@ void GraphicModel::dump_page(int iPage, ostream& outStream)
 //---------------------------------------------------------------------------------------
 GmoObj* GraphicModel::hit_test(int iPage, LUnits x, LUnits y)
 {
-    return get_page(iPage)->hit_test(x, y);
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    GmoBoxDocPage* pPage = get_page(iPage);
+    return (pPage ? pPage->hit_test(x, y) : nullptr);
 }
 
 //---------------------------------------------------------------------------------------
 GmoShape* GraphicModel::find_shape_at(int iPage, LUnits x, LUnits y)
 {
-    return get_page(iPage)->find_shape_at(x, y);
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    GmoBoxDocPage* pPage = get_page(iPage);
+    return (pPage ? pPage->find_shape_at(x, y) : nullptr);
 }
 
 //---------------------------------------------------------------------------------------
 GmoBox* GraphicModel::find_inner_box_at(int iPage, LUnits x, LUnits y)
 {
-    return get_page(iPage)->find_inner_box_at(x, y);
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    GmoBoxDocPage* pPage = get_page(iPage);
+    return (pPage ? pPage->find_inner_box_at(x, y) : nullptr);
 }
 
 //---------------------------------------------------------------------------------------
 void GraphicModel::select_objects_in_rectangle(int iPage, SelectionSet* selection,
                                                const URect& selRect, unsigned flags)
 {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
     selection->clear();
-    get_page(iPage)->select_objects_in_rectangle(selection, selRect, flags);
+    GmoBoxDocPage* pPage = get_page(iPage);
+    if (pPage)
+        pPage->select_objects_in_rectangle(selection, selRect, flags);
 }
 
 //---------------------------------------------------------------------------------------
@@ -199,59 +434,81 @@ GmoShape* GraphicModel::get_shape_for_imo(ImoId id, ShapeId shapeId)
 {
     if (shapeId == 0)
         return get_main_shape_for_imo(id);
-    else
+
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    do
     {
         map< pair<ImoId, ShapeId>, GmoShape*>::const_iterator it
             = m_imoToSecondaryShape.find( make_pair(id, shapeId) );
         if (it != m_imoToSecondaryShape.end())
             return it->second;
-        else
-            return nullptr;
     }
+    while (layout_one_more_page());
+
+    return nullptr;
 }
 
 //---------------------------------------------------------------------------------------
 GmoShape* GraphicModel::get_main_shape_for_imo(ImoId id)
 {
-    map<ImoId, GmoShape*>::const_iterator it = m_imoToMainShape.find(id);
-    if (it != m_imoToMainShape.end())
-        return it->second;
-    else
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    do
     {
-        LOMSE_LOG_INFO("No shape found for Imo id: %d", id );
-        return nullptr;
+        map<ImoId, GmoShape*>::const_iterator it = m_imoToMainShape.find(id);
+        if (it != m_imoToMainShape.end())
+            return it->second;
     }
+    while (layout_one_more_page());
+
+    LOMSE_LOG_INFO("No shape found for Imo id: %d", id );
+    return nullptr;
 }
 
 //---------------------------------------------------------------------------------------
 GmoObj* GraphicModel::get_box_for_control(GmoRef gref)
 {
-	map<GmoRef, GmoObj*>::const_iterator it = m_ctrolToPtr.find(gref);
-	if (it != m_ctrolToPtr.end())
-		return it->second;
-    else
-        return nullptr;
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    do
+    {
+        map<GmoRef, GmoObj*>::const_iterator it = m_ctrolToPtr.find(gref);
+        if (it != m_ctrolToPtr.end())
+            return it->second;
+    }
+    while (layout_one_more_page());
+
+    return nullptr;
 }
 
 //---------------------------------------------------------------------------------------
 GmoBox* GraphicModel::get_box_for_imo(ImoId id)
 {
-	map<ImoId, GmoBox*>::const_iterator it = m_imoToBox.find(id);
-	if (it != m_imoToBox.end())
-		return it->second;
-    else
-        return nullptr;
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    do
+    {
+        map<ImoId, GmoBox*>::const_iterator it = m_imoToBox.find(id);
+        if (it != m_imoToBox.end())
+            return it->second;
+    }
+    while (layout_one_more_page());
+
+    return nullptr;
 }
 
 //---------------------------------------------------------------------------------------
-void GraphicModel::build_main_boxes_table()
+void GraphicModel::build_main_boxes_table(int iFirstPage)
 {
+    //AWARE: for lazy layout, pages before iFirstPage are already in the tables
+
     if (m_root)
     {
         vector<GmoBox*>& pageBoxes = m_root->get_child_boxes();
-        vector<GmoBox*>::iterator itP;
-        for (itP=pageBoxes.begin(); itP != pageBoxes.end(); ++itP)
+        vector<GmoBox*>::iterator itP = pageBoxes.begin();
+        if (iFirstPage > 0)
+            itP += min(iFirstPage, int(pageBoxes.size()));
+        for (; itP != pageBoxes.end(); ++itP)
         {
+            static_cast<GmoBoxDocPage*>(*itP)->build_spatial_index();
+
             vector<GmoBox*>& contentBoxes = (*itP)->get_child_boxes();
             vector<GmoBox*>::iterator itC;
             for (itC=contentBoxes.begin(); itC != contentBoxes.end(); ++itC)
@@ -284,8 +541,8 @@ GmoBoxSystem* GraphicModel::get_system_for(ImoId scoreId, TimeUnits timepos)
 {
     //if not found returns nullptr
 
-    ScoreStub* pStub = get_stub_for(scoreId);
-    GmoBoxScorePage* pPage = pStub->get_page_for(timepos);
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    GmoBoxScorePage* pPage = get_score_page_for(scoreId, timepos);
     if (pPage)
     {
         //find system in this page
@@ -324,6 +581,29 @@ GmoBoxSystem* GraphicModel::get_system_for(ImoId scoreId, TimeUnits timepos)
     return nullptr;
 }
 
+//---------------------------------------------------------------------------------------
+GmoBoxScorePage* GraphicModel::get_score_page_for(ImoId scoreId, TimeUnits timepos)
+{
+    //AWARE: with lazy layout, pages are laid out until the page for timepos is found.
+    //When timepos is the end time of the last laid out page, the system could start
+    //in next page and it is also laid out
+
+    do
+    {
+        ScoreStub* pStub = get_stub_for(scoreId);
+        GmoBoxScorePage* pPage = (pStub ? pStub->get_page_for(timepos) : nullptr);
+        if (pPage && !(pPage == pStub->get_pages().back() && m_pLayouter
+                       && is_equal_time(timepos, pPage->end_time())) )
+        {
+            return pPage;
+        }
+    }
+    while (layout_one_more_page());
+
+    ScoreStub* pStub = get_stub_for(scoreId);
+    return (pStub ? pStub->get_page_for(timepos) : nullptr);
+}
+
 //---------------------------------------------------------------------------------------
 GmoBoxSystem* GraphicModel::get_system_for(ImoScore* pScore, const MeasureLocator& ml)
 {
@@ -349,25 +629,34 @@ GmoBoxSystem* GraphicModel::get_system_for_staffobj(ImoId id)
 //---------------------------------------------------------------------------------------
 GmoBoxSystem* GraphicModel::get_system_box(int iSystem, ImoId scoreId)
 {
-    ScoreStub* pStub = get_stub_for(scoreId);
-    if (pStub == nullptr)
-        return nullptr;
-
-    std::vector<GmoBoxScorePage*>& pages = pStub->get_pages();
-    for (auto page : pages)
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    do
     {
-        if (iSystem >= page->get_num_first_system()
-            && iSystem <= page->get_num_last_system())
+        ScoreStub* pStub = get_stub_for(scoreId);
+        if (pStub)
         {
-            return page->get_system(iSystem);
+            std::vector<GmoBoxScorePage*>& pages = pStub->get_pages();
+            for (auto page : pages)
+            {
+                if (iSystem >= page->get_num_first_system()
+                    && iSystem <= page->get_num_last_system())
+                {
+                    return page->get_system(iSystem);
+                }
+            }
         }
     }
+    while (layout_one_more_page());
+
     return nullptr;
 }
 
 //---------------------------------------------------------------------------------------
 int GraphicModel::get_num_systems(ImoId scoreId)
 {
+    //AWARE: only the systems in pages already laid out are counted
+
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
     ScoreStub* pStub = get_stub_for(scoreId);
     if (pStub == nullptr)
         return 0;
@@ -384,6 +673,12 @@ int GraphicModel::get_num_systems(ImoId scoreId)
 //---------------------------------------------------------------------------------------
 ScoreStub* GraphicModel::add_stub_for(ImoScore* pScore)
 {
+    //AWARE: when the score is laid out again (lazy layout with auto-scaling) the
+    //stub could already exist
+    map<ImoId, ScoreStub*>::iterator it = m_scores.find( pScore->get_id() );
+    if (it != m_scores.end())
+        delete it->second;
+
     ScoreStub* pStub = LOMSE_NEW ScoreStub(pScore);
     m_scores[pScore->get_id()] = pStub;
     return pStub;
@@ -402,13 +697,74 @@ ScoreStub* GraphicModel::get_stub_for(ImoId scoreId)
 //---------------------------------------------------------------------------------------
 GmMeasuresTable* GraphicModel::get_measures_table(ImoId scoreId)
 {
+    //AWARE: only the measures in pages already laid out are in the table
+
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
 	ScoreStub* pStub = get_stub_for(scoreId);
 	return (pStub ? pStub->get_measures_table() : nullptr);
 }
 
+//---------------------------------------------------------------------------------------
+void GraphicModel::delete_pages_from(int iPage)
+{
+    //Removes pages iPage..n-1 and all references to their content, so that
+    //the layout can continue from page iPage. Maps for boxes and controls must be
+    //rebuilt, by invoking build_main_boxes_table(), when the layout is finished.
+
+    //AWARE: also invoked by layouters. Pending pages must not be laid out
+    int numPages = m_root->get_num_pages();
+    if (iPage < 0 || iPage >= numPages)
+        return;
+
+    std::set<GmoBoxDocPage*> deleted;
+    for (int i=iPage; i < numPages; ++i)
+        deleted.insert( m_root->get_page(i) );
+
+    //shapes
+    map<ImoId, GmoShape*>::iterator itM = m_imoToMainShape.begin();
+    while (itM != m_imoToMainShape.end())
+    {
+        if (deleted.find( (itM->second)->get_page_box() ) != deleted.end())
+            itM = m_imoToMainShape.erase(itM);
+        else
+            ++itM;
+    }
+
+    map< pair<ImoId, ShapeId>, GmoShape*>::iterator itS = m_imoToSecondaryShape.begin();
+    while (itS != m_imoToSecondaryShape.end())
+    {
+        if (deleted.find( (itS->second)->get_page_box() ) != deleted.end())
+            itS = m_imoToSecondaryShape.erase(itS);
+        else
+            ++itS;
+    }
+
+    //scores starting in deleted pages
+    map<ImoId, ScoreStub*>::iterator itStub = m_scores.begin();
+    while (itStub != m_scores.end())
+    {
+        vector<GmoBoxScorePage*>& pages = (itStub->second)->get_pages();
+        if (!pages.empty() && deleted.find( pages.front()->get_page_box() ) != deleted.end())
+        {
+            delete itStub->second;
+            itStub = m_scores.erase(itStub);
+        }
+        else
+            ++itStub;
+    }
+
+    //boxes and controls
+    m_imoToBox.clear();
+    m_ctrolToPtr.clear();
+    m_areaInfo.clear(-1000000000000.0f, -1000000000000.0f);
+
+    m_root->delete_pages_from(iPage);
+}
+
 //---------------------------------------------------------------------------------------
 int GraphicModel::get_page_number_containing(GmoObj* pGmo)
 {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
     GmoBoxDocPage* pBoxPage = pGmo->get_page_box();
     return m_root->get_page_number(pBoxPage);
 }
@@ -416,6 +772,7 @@ int GraphicModel::get_page_number_containing(GmoObj* pGmo)
 //---------------------------------------------------------------------------------------
 AreaInfo* GraphicModel::get_info_for_point(int iPage, LUnits x, LUnits y)
 {
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
     if (x != m_areaInfo.x || y != m_areaInfo.y || m_areaInfo.areaType == k_point_unknown)
     {
         m_areaInfo.clear(x, y);
@@ -10,10 +10,14 @@
 #include "lomse_overlays_generator.h"
 
 #include "lomse_bitmap_drawer.h"
+#include "lomse_injectors.h"
 #include "lomse_logger.h"
 #include "lomse_visual_effect.h"
 #include "lomse_renderer.h"
 
+#include <cmath>
+#include <cstring>
+
 namespace lomse
 {
 
@@ -23,12 +27,14 @@ namespace lomse
 OverlaysGenerator::OverlaysGenerator(GraphicView* view, LibraryScope& libraryScope)
     : m_libraryScope(libraryScope)
     , m_pView(view)
-    , m_fBackgroundDirty(false)
+    , m_savedArea(0, 0, 0, 0)
     , m_fFullRectangle(true)
     , m_pSaveBytes(nullptr)
     , m_damagedRect(0.0, 0.0, 0.0, 0.0)
     , m_prevDamagedRect(0.0, 0.0, 0.0, 0.0)
+    , m_pendingDamage(0.0, 0.0, 0.0, 0.0)
     , m_pHandlersOwner(nullptr)
+    , m_bytesCopied(0)
 {
 }
 
@@ -57,47 +63,108 @@ void OverlaysGenerator::add_visual_effect(VisualEffect* pEffect)
 void OverlaysGenerator::remove_visual_effect(VisualEffect* pEffect)
 {
     m_effects.remove(pEffect);
+
+    //the effect pixels must be removed in next update
+    std::map<VisualEffect*, URect>::iterator it = m_drawnBounds.find(pEffect);
+    if (it != m_drawnBounds.end())
+    {
+        m_pendingDamage.Union(it->second);
+        m_drawnBounds.erase(it);
+    }
 }
 
 //---------------------------------------------------------------------------------------
 void OverlaysGenerator::update_all_visual_effects(BitmapDrawer* pDrawer)
 {
-    if (m_fBackgroundDirty)
-        m_canvasBuffer.copy_from(m_savedBuffer);
+    update_effects(nullptr, pDrawer);
+}
 
-    m_damagedRect = URect(0.0, 0.0, 0.0, 0.0);
-    int overlays = 0;
+//---------------------------------------------------------------------------------------
+void OverlaysGenerator::update_visual_effect(VisualEffect* pEffect,
+                                             BitmapDrawer* pDrawer)
+{
+    update_effects(pEffect, pDrawer);
+}
+
+//---------------------------------------------------------------------------------------
+void OverlaysGenerator::update_effects(VisualEffect* pModified, BitmapDrawer* pDrawer)
+{
+    //Restores the damaged area and redraws the effects on it. When pModified is
+    //nullptr all effects are considered modified. Otherwise, the damaged area is the
+    //old and new bounds of pModified and of any other effect whose visibility or
+    //bounds have changed.
+    //AWARE: effects are rendered with the library fonts. Serialized with the
+    //layout threads
+
+    std::lock_guard<std::recursive_mutex> lock(m_libraryScope.get_layout_mutex());
+
+    URect damaged = m_pendingDamage;
+    m_pendingDamage = URect(0.0, 0.0, 0.0, 0.0);
+
+    std::map<VisualEffect*, URect> newBounds;
     list<VisualEffect*>::const_iterator it;
     for (it = m_effects.begin(); it != m_effects.end(); ++it)
     {
+        URect bounds(0.0, 0.0, 0.0, 0.0);
         if ((*it)->is_visible())
         {
-            (*it)->on_draw(pDrawer);
-            ++overlays;
-            m_damagedRect.Union( (*it)->get_bounds() );
+            bounds = expand_bounds( (*it)->get_bounds() );
+            newBounds[*it] = bounds;
         }
-    }
 
-    if (overlays == 0)
-        m_damagedRect = m_prevDamagedRect;
-    else
-        expand_damaged_rectangle();
+        URect oldBounds(0.0, 0.0, 0.0, 0.0);
+        std::map<VisualEffect*, URect>::iterator itOld = m_drawnBounds.find(*it);
+        if (itOld != m_drawnBounds.end())
+            oldBounds = itOld->second;
 
-    m_fBackgroundDirty = (overlays > 0);
-}
+        if (pModified == nullptr || *it == pModified || bounds != oldBounds)
+        {
+            damaged.Union(oldBounds);
+            damaged.Union(bounds);
+        }
+    }
 
-//---------------------------------------------------------------------------------------
-void OverlaysGenerator::update_visual_effect(VisualEffect* pEffect,
-                                             BitmapDrawer* pDrawer)
-{
-    update_all_visual_effects(pDrawer);
-    if (pEffect->is_visible())
+    //not modified effects overlapping the damaged area must be fully redrawn
+    bool fExpanded = true;
+    while (fExpanded)
     {
-        m_damagedRect = pEffect->get_bounds();
-        expand_damaged_rectangle();
+        fExpanded = false;
+        std::map<VisualEffect*, URect>::iterator itB;
+        for (itB = newBounds.begin(); itB != newBounds.end(); ++itB)
+        {
+            URect common = itB->second;
+            if (!common.intersection(damaged).is_empty())
+            {
+                URect total = damaged;
+                if (total.Union(itB->second) != damaged)
+                {
+                    damaged = total;
+                    fExpanded = true;
+                }
+            }
+        }
     }
-    else
-        m_damagedRect = m_prevDamagedRect;
+
+    if (!damaged.is_empty())
+    {
+        VRect area = to_canvas_pixels(damaged, pDrawer);
+        restore_area(area);
+        save_area(area);
+
+        for (it = m_effects.begin(); it != m_effects.end(); ++it)
+        {
+            std::map<VisualEffect*, URect>::iterator itB = newBounds.find(*it);
+            if (itB != newBounds.end())
+            {
+                URect common = itB->second;
+                if (!common.intersection(damaged).is_empty())
+                    (*it)->on_draw(pDrawer);
+            }
+        }
+        m_damagedRect.Union(damaged);
+    }
+
+    m_drawnBounds.swap(newBounds);
 }
 
 //---------------------------------------------------------------------------------------
@@ -107,77 +174,162 @@ void OverlaysGenerator::set_rendering_buffer(unsigned char* buf, unsigned width,
     int pixFmt = m_libraryScope.get_pixel_format();
     int stride = Renderer::bytesPerPixel(pixFmt) * width;
     m_canvasBuffer.attach(buf, width, height, stride);
-    m_fBackgroundDirty = false;
+    m_savedArea = VRect(0, 0, 0, 0);
+    m_drawnBounds.clear();
+    m_pendingDamage = URect(0.0, 0.0, 0.0, 0.0);
     m_fFullRectangle = true;
 }
 
 //---------------------------------------------------------------------------------------
 void OverlaysGenerator::on_new_background()
 {
-    save_rendering_buffer();
+    //The rendering buffer is clean. The pixels under the effects will be saved
+    //before drawing the effects.
+
+    m_savedArea = VRect(0, 0, 0, 0);
+    m_drawnBounds.clear();
+    m_pendingDamage = URect(0.0, 0.0, 0.0, 0.0);
     m_fFullRectangle = true;
 }
 
 //---------------------------------------------------------------------------------------
-void OverlaysGenerator::save_rendering_buffer()
+void OverlaysGenerator::allocate_saved_buffer()
 {
-    //if necessary, allocate buffer for saving screen buffer
     unsigned w = m_canvasBuffer.width();
     unsigned h = m_canvasBuffer.height();
     int stride = m_canvasBuffer.stride();
     size_t bytes = size_t(h) * size_t(abs(stride));
-    if (bytes == 0)
-        return;     //in Unit Tests
-    if (m_pSaveBytes == nullptr
-        || bytes != size_t(m_savedBuffer.height()) * size_t(m_savedBuffer.stride()))
+    if (m_pSaveBytes == nullptr || w != m_savedBuffer.width()
+        || bytes != size_t(m_savedBuffer.height()) * size_t(abs(m_savedBuffer.stride())))
     {
         free(m_pSaveBytes);
         m_pSaveBytes = static_cast<int8u*>( malloc(bytes) );
         m_savedBuffer.attach(m_pSaveBytes, w, h, stride);
+        m_savedArea = VRect(0, 0, 0, 0);
 
 //        stringstream msg;
 //        msg << "Allocated new buffer. w=" << w << ", h=" << h << ", stride="
 //            << stride << ", bytes=" << bytes;
 //        LOMSE_LOG_INFO(msg.str());
     }
+}
 
-    m_savedBuffer.copy_from(m_canvasBuffer);
-    m_fBackgroundDirty = false;
+//---------------------------------------------------------------------------------------
+void OverlaysGenerator::save_area(const VRect& area)
+{
+    //Extends the saved area to include the given area. As effects are only drawn on
+    //the saved area, the rendering buffer is clean out of it and only the pixels not
+    //yet saved need to be copied.
+
+    if (area.is_empty())
+        return;     //also in Unit Tests, with no rendering buffer
+
+    allocate_saved_buffer();
+
+    if (m_savedArea.is_empty())
+    {
+        for (Pixels y = area.top(); y < area.bottom(); ++y)
+            copy_area(m_canvasBuffer, m_savedBuffer, area.left(), area.right(), y);
+        m_savedArea = area;
+        return;
+    }
+
+    VRect total = m_savedArea;
+    total.Union(area);
+    for (Pixels y = total.top(); y < total.bottom(); ++y)
+    {
+        if (y < m_savedArea.top() || y >= m_savedArea.bottom())
+            copy_area(m_canvasBuffer, m_savedBuffer, total.left(), total.right(), y);
+        else
+        {
+            copy_area(m_canvasBuffer, m_savedBuffer, total.left(), m_savedArea.left(), y);
+            copy_area(m_canvasBuffer, m_savedBuffer, m_savedArea.right(), total.right(), y);
+        }
+    }
+    m_savedArea = total;
+}
+
+//---------------------------------------------------------------------------------------
+void OverlaysGenerator::restore_area(const VRect& area)
+{
+    //Restores the clean pixels. Out of the saved area pixels are already clean.
+
+    VRect restore = area;
+    restore.intersection(m_savedArea);
+    if (restore.is_empty())
+        return;
+
+    for (Pixels y = restore.top(); y < restore.bottom(); ++y)
+        copy_area(m_savedBuffer, m_canvasBuffer, restore.left(), restore.right(), y);
+}
+
+//---------------------------------------------------------------------------------------
+void OverlaysGenerator::copy_area(RenderingBuffer& src, RenderingBuffer& dest,
+                                  Pixels left, Pixels right, Pixels y)
+{
+    //copy pixels [left, right) in row y
+
+    if (right <= left)
+        return;
+
+    int bpp = Renderer::bytesPerPixel( m_libraryScope.get_pixel_format() );
+    size_t bytes = size_t(right - left) * size_t(bpp);
+    memcpy(dest.row_ptr(y) + left * bpp, src.row_ptr(y) + left * bpp, bytes);
+    m_bytesCopied += bytes;
+}
+
+//---------------------------------------------------------------------------------------
+VRect OverlaysGenerator::to_canvas_pixels(const URect& rect, BitmapDrawer* pDrawer)
+{
+    //returns the pixels covered by the rectangle, trimmed to the rendering buffer
+
+    double left = rect.left();
+    double top = rect.top();
+    double right = rect.right();
+    double bottom = rect.bottom();
+    pDrawer->model_point_to_device(&left, &top);
+    pDrawer->model_point_to_device(&right, &bottom);
+
+    VRect area(VPoint(Pixels(floor(left)), Pixels(floor(top))),
+               VPoint(Pixels(ceil(right)) + 1, Pixels(ceil(bottom)) + 1));
+    area.intersection( VRect(0, 0, Pixels(m_canvasBuffer.width()),
+                             Pixels(m_canvasBuffer.height())) );
+    return area;
 }
 
 //---------------------------------------------------------------------------------------
-void OverlaysGenerator::expand_damaged_rectangle()
+URect OverlaysGenerator::expand_bounds(const URect& bounds)
 {
-    //increase damaged rectangle (1mm increment at each side) to take into account
+    //increase bounds (1mm increment at each side) to take into account
     //any additional pixels due to anti-aliasing.
 
-    m_damagedRect.x -= 100.0;   //1mm = 100 LUnits
-    m_damagedRect.y -= 100.0;
-    m_damagedRect.width += 200.0;
-    m_damagedRect.height += 200.0;
+    return URect(bounds.x - 100.0f,     //1mm = 100 LUnits
+                 bounds.y - 100.0f,
+                 bounds.width + 200.0f,
+                 bounds.height + 200.0f);
 }
 
 //---------------------------------------------------------------------------------------
 URect OverlaysGenerator::get_damaged_rectangle()
 {
+    //Returns the area modified since last invocation. An empty rectangle means that
+    //the whole rendering buffer has been modified.
+
     if (m_fFullRectangle)
     {
         m_fFullRectangle = false;
         m_prevDamagedRect = m_damagedRect;
+        m_damagedRect = URect(0.0, 0.0, 0.0, 0.0);
         return URect(0.0, 0.0, 0.0, 0.0);
     }
-    else if (m_prevDamagedRect != URect(0.0, 0.0, 0.0, 0.0))
-    {
-        URect total = m_damagedRect;
-        total.Union(m_prevDamagedRect);
-        m_prevDamagedRect = m_damagedRect;
-        return total;
-    }
-    else
-    {
-        m_prevDamagedRect = m_damagedRect;
-        return m_damagedRect;
-    }
+
+    if (m_damagedRect.is_empty())
+        return m_prevDamagedRect;   //nothing modified. Avoid full repaint
+
+    URect damaged = m_damagedRect;
+    m_prevDamagedRect = damaged;
+    m_damagedRect = URect(0.0, 0.0, 0.0, 0.0);
+    return damaged;
 }
 
 
@@ -29,6 +29,7 @@ GmoShapeGlyph::GmoShapeGlyph(ImoObj* pCreatorImo, int type, ShapeId idx,
     : GmoSimpleShape(pCreatorImo, type, idx, color)
     , m_pFontStorage( libraryScope.font_storage() )
     , m_libraryScope(libraryScope)
+    , m_iGlyph(int(nGlyph))
 {
     m_glyph = m_libraryScope.get_glyphs_table()->glyph_code(nGlyph);
     compute_size_origin(fontHeight, pos);
@@ -54,12 +55,8 @@ void GmoShapeGlyph::compute_size_origin(double fontHeight, UPoint pos)
 {
     m_fontHeight = fontHeight;
 
-    TextMeter meter(m_libraryScope);
-    meter.select_font("any",
-                      m_libraryScope.get_music_font_file(),
-                      m_libraryScope.get_music_font_name(),
-                      m_fontHeight);
-    URect bbox = meter.bounding_rectangle(m_glyph);
+    MusicGlyphs* pGlyphs = m_libraryScope.get_glyphs_table();
+    const URect& bbox = pGlyphs->get_glyph_metrics(m_iGlyph, m_fontHeight).bounds;
 
     m_origin.x = pos.x + bbox.x;
     m_origin.y = pos.y + bbox.y;
@@ -466,16 +463,17 @@ GmoShapeArpeggio::GmoShapeArpeggio(ImoObj* pCreatorImo, ShapeId idx,
 {
     MusicGlyphs* pGlyphs = m_libraryScope.get_glyphs_table();
 
-    const int iSegmentGlyph = fUp ? k_glyph_arpeggiato_wiggle_segment_up : k_glyph_arpeggiato_wiggle_segment_down;
-    m_segmentGlyph = pGlyphs->glyph_code(iSegmentGlyph);
+    m_iSegmentGlyph = fUp ? k_glyph_arpeggiato_wiggle_segment_up : k_glyph_arpeggiato_wiggle_segment_down;
+    m_segmentGlyph = pGlyphs->glyph_code(m_iSegmentGlyph);
 
     if (fHasArrow)
     {
-        const int iArrowGlyph = fUp ? k_glyph_arpeggiato_arrow_up : k_glyph_arpeggiato_arrow_down;
-        m_arrowGlyph = pGlyphs->glyph_code(iArrowGlyph);
+        m_iArrowGlyph = fUp ? k_glyph_arpeggiato_arrow_up : k_glyph_arpeggiato_arrow_down;
+        m_arrowGlyph = pGlyphs->glyph_code(m_iArrowGlyph);
     }
     else
     {
+        m_iArrowGlyph = k_glyph_none;
         m_arrowGlyph = 0;
     }
 
@@ -533,16 +531,14 @@ void GmoShapeArpeggio::increase_length_up(LUnits increment)
 //---------------------------------------------------------------------------------------
 void GmoShapeArpeggio::compute_shape_geometry(LUnits xRight, LUnits yTop, LUnits yBottom)
 {
-    TextMeter meter(m_libraryScope);
-    meter.select_font("any",
-                      m_libraryScope.get_music_font_file(),
-                      m_libraryScope.get_music_font_name(),
-                      m_fontHeight);
+    MusicGlyphs* pGlyphs = m_libraryScope.get_glyphs_table();
 
-    const URect segmentGlyphBox = meter.bounding_rectangle(m_segmentGlyph);
+    const GlyphMetrics& segment =
+                    pGlyphs->get_glyph_metrics(m_iSegmentGlyph, m_fontHeight);
+    const URect& segmentGlyphBox = segment.bounds;
     m_xInitialAdvance = 0;
     m_yInitialAdvance = -segmentGlyphBox.x;
-    m_segmentAdvance = meter.get_advance_x(m_segmentGlyph);
+    m_segmentAdvance = segment.advance;
 
     LUnits maxGlyphHeight = segmentGlyphBox.height;
 
@@ -550,7 +546,8 @@ void GmoShapeArpeggio::compute_shape_geometry(LUnits xRight, LUnits yTop, LUnits
 
     if (m_arrowGlyph)
     {
-        const URect arrowGlyphBox = meter.bounding_rectangle(m_arrowGlyph);
+        const URect& arrowGlyphBox =
+                    pGlyphs->get_glyph_metrics(m_iArrowGlyph, m_fontHeight).bounds;
         remainingHeight -= arrowGlyphBox.right();
 
         if (arrowGlyphBox.height > maxGlyphHeight)
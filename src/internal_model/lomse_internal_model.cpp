@@ -1039,6 +1039,22 @@ void ImoObj::set_children_dirty(bool value)
     value ? m_flags |= k_children_dirty : m_flags &= ~k_children_dirty;
 }
 
+//---------------------------------------------------------------------------------------
+void ImoObj::clear_dirty_flags()
+{
+    //clear dirty flags in this object and in its descendants. Only the branches
+    //marked as dirty are explored
+
+    if (!is_dirty() && !are_children_dirty())
+        return;
+
+    m_flags &= ~(k_dirty | k_children_dirty);
+
+    TreeNode<ImoObj>::children_iterator it;
+    for (it = begin(); it != end(); ++it)
+        (*it)->clear_dirty_flags();
+}
+
 //---------------------------------------------------------------------------------------
 void ImoObj::propagate_dirty()
 {
@@ -3632,8 +3648,9 @@ void ImoInstrument::delete_staffobj(ImoStaffObj* pSO)
     //            if (pSO->is_noterest() && )
             }
 
-        //remove from ColStaffObjs
-        pColStaffObjs->delete_entry_for(pSO);
+        //remove from ColStaffObjs, unless already replaced by other staffobj
+        if (*(pColStaffObjs->find(pSO)))
+            pColStaffObjs->delete_entry_for(pSO);
     }
 
     //remove from ImoTree
@@ -4899,6 +4916,13 @@ void ImoScore::end_of_changes()
     builder.structurize(this);
 }
 
+//---------------------------------------------------------------------------------------
+void ImoScore::end_of_changes(int iInstr, int firstMeasure, int lastMeasure)
+{
+    ModelBuilder builder;
+    builder.structurize(this, iInstr, firstMeasure, lastMeasure);
+}
+
 
 //=======================================================================================
 // ImoScoreLine implementation
@@ -5097,6 +5121,113 @@ void ImoStyle::set_parent_style(ImoStyle* pStyle)
         m_idParent = pStyle->get_id();
     else
         m_idParent = k_no_imoid;
+
+    on_style_modified();
+}
+
+//---------------------------------------------------------------------------------------
+void ImoStyle::on_style_modified()
+{
+    //resolved properties of this style and of all styles inheriting from it are no
+    //longer valid. Styles do not know their children: invalidate all styles in the
+    //document
+    m_resolved.epoch = -1L;
+    if (m_pDocModel)
+        m_pDocModel->on_style_modified();
+}
+
+//---------------------------------------------------------------------------------------
+long ImoStyle::get_styles_epoch()
+{
+    //styles not anchored to a model can not have a parent style
+    return (m_pDocModel ? m_pDocModel->get_styles_epoch() : 0L);
+}
+
+//---------------------------------------------------------------------------------------
+void ImoStyle::resolve_properties()
+{
+    //Engravers and layouters read style properties very often. Looking them up in the
+    //maps and, when not found, in the parent styles (that are found by id) is slow.
+    //Therefore, all properties, own or inherited, are stored in a flat array.
+    //AWARE: styles are read by the layout thread while the GUI thread could also be
+    //reading them. Once resolved, values are not modified until a style is modified,
+    //so they are read without locks. Resolution is serialized by a mutex in the model.
+
+    long epoch = get_styles_epoch();
+    if (m_resolved.epoch.load(std::memory_order_acquire) == epoch)
+        return;
+
+    if (m_pDocModel)
+    {
+        std::lock_guard<std::mutex> lock(m_pDocModel->get_styles_mutex());
+        resolve_properties(epoch);
+    }
+    else
+        resolve_properties(epoch);
+}
+
+//---------------------------------------------------------------------------------------
+void ImoStyle::resolve_properties(long epoch)
+{
+    //other thread could have resolved them while waiting for the lock
+    if (m_resolved.epoch.load(std::memory_order_relaxed) == epoch)
+        return;
+
+    ImoStyle* pParent = get_parent_style();
+    if (pParent)
+    {
+        pParent->resolve_properties(epoch);
+        m_resolved.values = pParent->m_resolved.values;
+        m_resolved.strings = pParent->m_resolved.strings;
+    }
+    else
+    {
+        m_resolved.values.assign(k_num_style_properties, ResolvedValue());
+        m_resolved.strings.clear();
+    }
+
+    for (const auto& prop : m_lunitsProps)
+    {
+        m_resolved.values[prop.first].lunitsValue = prop.second;
+        m_resolved.values[prop.first].defined = k_resolved_lunits;
+    }
+    for (const auto& prop : m_floatProps)
+    {
+        m_resolved.values[prop.first].floatValue = prop.second;
+        m_resolved.values[prop.first].defined = k_resolved_float;
+    }
+    for (const auto& prop : m_stringProps)
+    {
+        ResolvedValue& value = m_resolved.values[prop.first];
+        if (value.defined == k_resolved_string)
+            m_resolved.strings[value.iString] = &prop.second;
+        else
+        {
+            value.iString = static_cast<unsigned char>(m_resolved.strings.size());
+            m_resolved.strings.push_back(&prop.second);
+        }
+        value.defined = k_resolved_string;
+    }
+    for (const auto& prop : m_intProps)
+    {
+        m_resolved.values[prop.first].intValue = prop.second;
+        m_resolved.values[prop.first].defined = k_resolved_int;
+    }
+    for (const auto& prop : m_colorProps)
+    {
+        ResolvedValue& value = m_resolved.values[prop.first];
+        value.colorValue[0] = prop.second.r;
+        value.colorValue[1] = prop.second.g;
+        value.colorValue[2] = prop.second.b;
+        value.colorValue[3] = prop.second.a;
+        value.defined = k_resolved_color;
+    }
+
+    //if the parent can not be found yet (e.g. style not yet anchored to the model)
+    //the resolved values must be rebuilt next time. This only happens while the
+    //document is being created, not while it is being laid out
+    bool fParentMissing = (!pParent && m_idParent != k_no_imoid);
+    m_resolved.epoch.store(fParentMissing ? -1L : epoch, std::memory_order_release);
 }
 
 //---------------------------------------------------------------------------------------
@@ -5112,6 +5243,7 @@ ImoStyle* ImoStyle::get_parent_style()
 void ImoStyle::set_string_property(int prop, const std::string& value)
 {
     m_stringProps[prop] = value;
+    on_style_modified();
     switch(prop)
     {
         case ImoStyle::k_font_name:    m_modified |= k_modified_font_name;   break;
@@ -5124,6 +5256,7 @@ void ImoStyle::set_string_property(int prop, const std::string& value)
 void ImoStyle::set_float_property(int prop, float value)
 {
     m_floatProps[prop] = value;
+    on_style_modified();
     switch(prop)
     {
         case ImoStyle::k_font_size:    m_modified |= k_modified_font_size;   break;
@@ -5136,6 +5269,7 @@ void ImoStyle::set_float_property(int prop, float value)
 void ImoStyle::set_int_property(int prop, int value)
 {
     m_intProps[prop] = value;
+    on_style_modified();
     switch(prop)
     {
         case ImoStyle::k_font_style:    m_modified |= k_modified_font_style;   break;
@@ -5149,12 +5283,14 @@ void ImoStyle::set_int_property(int prop, int value)
 void ImoStyle::set_lunits_property(int prop, LUnits value)
 {
     m_lunitsProps[prop] = value;
+    on_style_modified();
 }
 
 //---------------------------------------------------------------------------------------
 void ImoStyle::set_color_property(int prop, Color value)
 {
     m_colorProps[prop] = value;
+    on_style_modified();
 }
 
 //---------------------------------------------------------------------------------------
@@ -5252,11 +5388,9 @@ bool ImoStyle::get_color_property(int prop, Color* value)
 //---------------------------------------------------------------------------------------
 float ImoStyle::get_float_property(int prop)
 {
-    map<int, float>::const_iterator it = m_floatProps.find(prop);
-    if (it != m_floatProps.end())
-        return it->second;
-    else if (m_idParent != k_no_imoid)
-        return get_parent_style()->get_float_property(prop);
+    resolve_properties();
+    if (m_resolved.values[prop].defined == k_resolved_float)
+        return m_resolved.values[prop].floatValue;
     else
     {
         LOMSE_LOG_ERROR("Aborting. Style has no parent.");
@@ -5267,11 +5401,9 @@ float ImoStyle::get_float_property(int prop)
 //---------------------------------------------------------------------------------------
 LUnits ImoStyle::get_lunits_property(int prop)
 {
-    map<int, LUnits>::const_iterator it = m_lunitsProps.find(prop);
-    if (it != m_lunitsProps.end())
-        return it->second;
-    else if (m_idParent != k_no_imoid)
-        return get_parent_style()->get_lunits_property(prop);
+    resolve_properties();
+    if (m_resolved.values[prop].defined == k_resolved_lunits)
+        return m_resolved.values[prop].lunitsValue;
     else
     {
         LOMSE_LOG_ERROR("Aborting. Style has no parent.");
@@ -5282,11 +5414,9 @@ LUnits ImoStyle::get_lunits_property(int prop)
 //---------------------------------------------------------------------------------------
 const std::string& ImoStyle::get_string_property(int prop)
 {
-    map<int, string>::const_iterator it = m_stringProps.find(prop);
-    if (it != m_stringProps.end())
-        return it->second;
-    else if (m_idParent != k_no_imoid)
-        return get_parent_style()->get_string_property(prop);
+    resolve_properties();
+    if (m_resolved.values[prop].defined == k_resolved_string)
+        return *m_resolved.strings[ m_resolved.values[prop].iString ];
     else
     {
         LOMSE_LOG_ERROR("Aborting. Style has no parent.");
@@ -5297,11 +5427,9 @@ const std::string& ImoStyle::get_string_property(int prop)
 //---------------------------------------------------------------------------------------
 int ImoStyle::get_int_property(int prop)
 {
-    map<int, int>::const_iterator it = m_intProps.find(prop);
-    if (it != m_intProps.end())
-        return it->second;
-    else if (m_idParent != k_no_imoid)
-        return get_parent_style()->get_int_property(prop);
+    resolve_properties();
+    if (m_resolved.values[prop].defined == k_resolved_int)
+        return m_resolved.values[prop].intValue;
     else
     {
         LOMSE_LOG_ERROR("Aborting. Style has no parent.");
@@ -5312,11 +5440,12 @@ int ImoStyle::get_int_property(int prop)
 //---------------------------------------------------------------------------------------
 Color ImoStyle::get_color_property(int prop)
 {
-    map<int, Color>::const_iterator it = m_colorProps.find(prop);
-    if (it != m_colorProps.end())
-        return it->second;
-    else if (m_idParent != k_no_imoid)
-        return get_parent_style()->get_color_property(prop);
+    resolve_properties();
+    if (m_resolved.values[prop].defined == k_resolved_color)
+    {
+        const unsigned char* rgba = m_resolved.values[prop].colorValue;
+        return Color(rgba[0], rgba[1], rgba[2], rgba[3]);
+    }
     else
         throw std::runtime_error( "[ImoStyle::get_color_property]. No parent" );
 }
@@ -21,6 +21,8 @@
 #include "lomse_im_measures_table.h"
 
 #include <math.h>       //round
+#include <climits>      //INT_MAX
+#include <sstream>
 
 #include <algorithm>
 using namespace std;
@@ -122,6 +124,163 @@ void ModelBuilder::structurize(ImoObj* pImo)
     }
 }
 
+//---------------------------------------------------------------------------------------
+void ModelBuilder::structurize(ImoScore* pScore, int iInstr, int firstMeasure,
+                               int lastMeasure)
+{
+    //Structurizes a score after an edition that only modified the music data of
+    //instrument iInstr in measures [firstMeasure, lastMeasure]. When firstMeasure < 0
+    //the range is derived from the dirty flags and when lastMeasure < 0 the range
+    //goes up to the end of the score.
+    //Only the ColStaffObjs entries and the measures table for the instrument are
+    //created again, the passes depending only on the instruments are skipped and
+    //pitch is only assigned in the range. When the ColStaffObjs table has to be
+    //fully rebuilt, all measures tables are rebuilt, as they point to its entries.
+
+    if (iInstr < 0 || iInstr >= pScore->get_num_instruments())
+    {
+        structurize(pScore);
+        return;
+    }
+
+    ColStaffObjsBuilder builder;
+    MeasuresTableBuilder measures;
+    if (builder.rebuild_instrument(pScore, iInstr))
+        measures.build(pScore, iInstr);
+    else
+        measures.build(pScore);
+
+    if (firstMeasure < 0)
+        find_dirty_measures(pScore, iInstr, &firstMeasure, &lastMeasure);
+
+    PitchAssigner tuner;
+    tuner.assign_pitch(pScore, iInstr, firstMeasure, lastMeasure);
+
+#if (LOMSE_DEBUG == 1)
+    check_structurize(pScore);
+#endif
+}
+
+//---------------------------------------------------------------------------------------
+void ModelBuilder::find_dirty_measures(ImoScore* pScore, int iInstr, int* pFirst,
+                                       int* pLast)
+{
+    //The modified measures are those containing dirty staffobjs. A barline splits
+    //a measure, so the next one is also modified. Removed children leave no trace
+    //but the music data flag: the whole instrument is then taken
+
+    *pFirst = 0;
+    *pLast = -1;
+
+    ImoMusicData* pMD = pScore->get_instrument(iInstr)->get_musicdata();
+    ColStaffObjs* pTable = pScore->get_staffobjs_table();
+    if (!pMD || pMD->is_dirty())
+        return;
+
+    int first = -1;
+    int last = -1;
+    ImoObj::children_iterator it;
+    for (it = pMD->begin(); it != pMD->end(); ++it)
+    {
+        if (!(*it)->is_dirty() && !(*it)->are_children_dirty())
+            continue;
+
+        ColStaffObjsEntry* pEntry = ((*it)->is_staffobj()
+                                     ? *(pTable->find(static_cast<ImoStaffObj*>(*it)))
+                                     : nullptr);
+        if (!pEntry)
+            return;
+
+        int measure = pEntry->measure();
+        first = (first < 0 ? measure : min(first, measure));
+        last = max(last, ((*it)->is_barline() ? measure + 1 : measure));
+    }
+
+    if (first >= 0)
+    {
+        *pFirst = first;
+        *pLast = last;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+bool ModelBuilder::check_structurize(ImoScore* pScore)
+{
+    //Debug. Checks that the info computed when structurizing the score is the same
+    //than the one computed by a full structurize. The score is fully structurized
+    //after the check
+
+    string current = dump_structure_info(pScore);
+    structurize(pScore);
+    string expected = dump_structure_info(pScore);
+
+    if (current == expected)
+        return true;
+
+    //report first difference
+    stringstream ssCurrent(current);
+    stringstream ssExpected(expected);
+    string lineCurrent, lineExpected;
+    while (getline(ssCurrent, lineCurrent) && getline(ssExpected, lineExpected))
+    {
+        if (lineCurrent != lineExpected)
+            break;
+    }
+
+    LOMSE_LOG_ERROR("Structurize results differ from a full structurize. "
+                    "Current: '%s', expected: '%s'",
+                    lineCurrent.c_str(), lineExpected.c_str());
+    return false;
+}
+
+//---------------------------------------------------------------------------------------
+string ModelBuilder::dump_structure_info(ImoScore* pScore)
+{
+    //the info computed by the structurize passes
+
+    stringstream ss;
+    ColStaffObjs* pTable = pScore->get_staffobjs_table();
+    ss << pTable->dump()
+       << "lines " << pTable->num_lines() << ", divisions " << pTable->get_divisions()
+       << ", min note " << pTable->min_note_duration()
+       << ", noterests " << pTable->num_half_noterests()
+       << "/" << pTable->num_quarter_noterests()
+       << "/" << pTable->num_eighth_noterests()
+       << "/" << pTable->num_16th_noterests() << endl;
+
+    for (int i=0; i < pScore->get_num_instruments(); ++i)
+    {
+        ImoInstrument* pInstr = pScore->get_instrument(i);
+        ss << "instr " << i << ": " << pInstr->get_instr_id()
+           << ", barlines " << pInstr->get_barline_layout();
+        for (int k=0; k < pInstr->get_num_sounds(); ++k)
+        {
+            ImoMidiInfo* pMidi = pInstr->get_sound_info(k)->get_midi_info();
+            ss << ", midi " << pMidi->get_midi_port() << "/" << pMidi->get_midi_channel();
+        }
+        ss << endl;
+
+        ImMeasuresTable* pMeasures = pInstr->get_measures_table();
+        if (pMeasures)
+            ss << pMeasures->dump();
+
+        ImoMusicData* pMD = pInstr->get_musicdata();
+        if (!pMD)
+            continue;
+        ImoObj::children_iterator it;
+        for (it = pMD->begin(); it != pMD->end(); ++it)
+        {
+            if ((*it)->is_note())
+            {
+                ImoNote* pNote = static_cast<ImoNote*>(*it);
+                ss << pNote->get_id() << ": " << pNote->get_actual_accidentals()
+                   << ", " << pNote->get_notated_accidentals() << endl;
+            }
+        }
+    }
+    return ss.str();
+}
+
 //---------------------------------------------------------------------------------------
 ImoDocument* ModelBuilder::fix_cloned_model(ImoDocument* pImoDoc)
 {
@@ -204,6 +363,73 @@ void PitchAssigner::assign_pitch(ImoScore* pScore)
     }
 }
 
+//---------------------------------------------------------------------------------------
+void PitchAssigner::assign_pitch(ImoScore* pScore, int iInstr, int firstMeasure,
+                                 int lastMeasure)
+{
+    //Assigns pitch only to the notes of instrument iInstr in measures
+    //[firstMeasure, lastMeasure] (lastMeasure < 0: up to the end). As the context
+    //is reset at each barline, the process starts at the barline closing the
+    //previous measure. And it finishes at the end of the measure following the range,
+    //as objects at the end of a measure (e.g. grace notes) can be placed after
+    //objects of the next measure. A key signature affects all following measures:
+    //the range is then extended to the end
+
+    if (pScore->get_accidentals_model() == ImoScore::k_pitch_and_notation_provided)
+        return;
+
+    ColStaffObjs* pTable = pScore->get_staffobjs_table();
+    ImoInstrument* pInstr = pScore->get_instrument(iInstr);
+    if (!pTable || !pInstr || pTable->num_entries() == 0)
+        return;
+
+    int numStaves = pInstr->get_num_staves();
+    m_context.assign(numStaves, {{0,0,0,0,0,0,0}} );    //alterations, per staff
+    if (lastMeasure < 0)
+        lastMeasure = INT_MAX;
+
+    ColStaffObjsEntry* pEntry = pTable->front();
+    if (firstMeasure > 0)
+    {
+        ColStaffObjsEntry* pBarline =
+            pTable->get_barline_for_measure(iInstr, firstMeasure - 1);
+        if (pBarline)
+            pEntry = pBarline;
+    }
+
+    ColStaffObjsEntry* pKeyEntry = pTable->get_prev_key_signature(iInstr, pEntry);
+    ImoKeySignature* pKey = (pKeyEntry ? static_cast<ImoKeySignature*>(
+                                            pKeyEntry->imo_object() )
+                                       : nullptr);
+
+    for (; pEntry != nullptr; pEntry = pEntry->get_next())
+    {
+        if (pEntry->num_instrument() != iInstr)
+            continue;
+
+        ImoStaffObj* pSO = pEntry->imo_object();
+        if (pSO->is_note())
+        {
+            compute_pitch(static_cast<ImoNote*>(pSO), pEntry->staff());
+        }
+        else if (pSO->is_barline())
+        {
+            if (pEntry->measure() > lastMeasure)
+                break;
+
+            for (int iStaff=0; iStaff < numStaves; ++iStaff)
+                reset_accidentals(pKey, iStaff);
+        }
+        else if (pSO->is_key_signature())
+        {
+            pKey = static_cast<ImoKeySignature*>( pSO );
+            for (int iStaff=0; iStaff < numStaves; ++iStaff)
+                reset_accidentals(pKey, iStaff);
+            lastMeasure = INT_MAX;
+        }
+    }
+}
+
 //---------------------------------------------------------------------------------------
 void PitchAssigner::compute_notated_accidentals(ImoNote* pNote, int context)
 {
@@ -745,15 +971,39 @@ void MeasuresTableBuilder::build(ImoScore* pScore)
     if (pCSO->num_entries() == 0)
         return;
 
+    build_tables(pScore, -1);
+}
+
+//---------------------------------------------------------------------------------------
+void MeasuresTableBuilder::build(ImoScore* pScore, int instr)
+{
+    //Rebuilds only the measures table for instrument instr
+
+    build_tables(pScore, instr);
+
+    if (m_tables[instr] == nullptr)
+        pScore->get_instrument(instr)->set_measures_table(nullptr);
+}
+
+//---------------------------------------------------------------------------------------
+void MeasuresTableBuilder::build_tables(ImoScore* pScore, int instr)
+{
+    //Builds the measures tables for all instruments, or only for instrument instr
+    //when it is not negative
+
+    ColStaffObjs* pCSO = pScore->get_staffobjs_table();
     int numInstrs = pScore->get_num_instruments();
     m_tables.assign(numInstrs, nullptr);
     m_curMeasure.assign(numInstrs, nullptr);
 
     ColStaffObjsIterator it = pCSO->begin();
-    while (it != pCSO->end())
+    for (; it != pCSO->end(); ++it)
     {
         ColStaffObjsEntry* pCsoEntry = *it;
         int iInstr = pCsoEntry->num_instrument();
+        if (instr >= 0 && iInstr != instr)
+            continue;
+
         ImoStaffObj* pSO = pCsoEntry->imo_object();
 
         //if first entry for the instrument create measures table and first measure
@@ -786,9 +1036,6 @@ void MeasuresTableBuilder::build(ImoScore* pScore)
             if (!pBL->is_middle())
                 finish_current_measure(iInstr, pCsoEntry);
         }
-
-        //advance to next entry
-        ++it;
     }
 }
 
@@ -178,7 +178,6 @@ std::string ColStaffObjsEntry::to_string_with_ids()
 //=======================================================================================
 ColStaffObjs::ColStaffObjs()
     : m_numLines(0)
-    , m_numEntries(0)
     , m_rMissingTime(0.0)
     , m_rAnacrusisExtraTime(0.0)
     , m_minNoteDuration(LOMSE_NO_NOTE_DURATION)
@@ -186,17 +185,14 @@ ColStaffObjs::ColStaffObjs()
     , m_numQuarter(0)
     , m_numEighth(0)
     , m_num16th(0)
-    , m_pFirst(nullptr)
-    , m_pLast(nullptr)
 {
 }
 
 //---------------------------------------------------------------------------------------
 ColStaffObjs::~ColStaffObjs()
 {
-    ColStaffObjs::iterator it;
-    for (it=begin(); it != end(); ++it)
-        delete *it;
+    for (ColStaffObjsEntry* pEntry : m_entries)
+        delete pEntry;
 }
 
 //---------------------------------------------------------------------------------------
@@ -205,8 +201,50 @@ ColStaffObjsEntry* ColStaffObjs::add_entry(int measure, int instr, int voice, in
 {
     ColStaffObjsEntry* pEntry =
         LOMSE_NEW ColStaffObjsEntry(measure, instr, voice, staff, pImo);
+    pEntry->set_order(m_nextOrder++);
     add_entry_to_list(pEntry);
-    ++m_numEntries;
+    return pEntry;
+}
+
+//---------------------------------------------------------------------------------------
+ColStaffObjsEntry* ColStaffObjs::append_entry(int measure, int instr, int line, int staff,
+                                              ImoStaffObj* pImo)
+{
+    //Adds an entry at the end of the table, without ordering it. For building the
+    //table: once all entries are added, sort_table() must be invoked
+    ColStaffObjsEntry* pEntry =
+        LOMSE_NEW ColStaffObjsEntry(measure, instr, line, staff, pImo);
+    pEntry->set_order(m_nextOrder++);
+    m_entries.push_back(pEntry);
+    return pEntry;
+}
+
+//---------------------------------------------------------------------------------------
+ColStaffObjsEntry* ColStaffObjs::insert_entry_after(ColStaffObjsEntry* pPrev,
+                                                    int measure, int instr, int line,
+                                                    int staff, ImoStaffObj* pImo)
+{
+    //Inserts a new entry just after pPrev (or at start if pPrev is nullptr), without
+    //checking the order rules. For updating the table after an edition when the
+    //right position is known. The staffobj is taken as defined just after the pPrev
+    //one
+
+    size_t i = 0;
+    if (pPrev)
+    {
+        int iPrev = pPrev->get_table_index();
+        if (iPrev < 0 || iPrev >= num_entries() || m_entries[iPrev] != pPrev)
+        {
+            LOMSE_LOG_ERROR("[ColStaffObjs::insert_entry_after] entry not found!");
+            throw runtime_error("[ColStaffObjs::insert_entry_after] entry not found!");
+        }
+        i = size_t(iPrev) + 1;
+    }
+
+    ColStaffObjsEntry* pEntry =
+        LOMSE_NEW ColStaffObjsEntry(measure, instr, line, staff, pImo);
+    pEntry->set_order(pPrev ? pPrev->get_order() : -1);
+    insert_entry_at(i, pEntry);
     return pEntry;
 }
 
@@ -224,6 +262,20 @@ void ColStaffObjs::count_noterest(ImoNoteRest* pNR)
         ++m_num16th;
 }
 
+//---------------------------------------------------------------------------------------
+void ColStaffObjs::discount_noterest(ImoNoteRest* pNR)
+{
+    int type = pNR->get_note_type();
+    if (type <= k_half)
+        --m_numHalf;
+    else if (type == k_quarter)
+        --m_numQuarter;
+    else if (type == k_eighth)
+        --m_numEighth;
+    else
+        --m_num16th;
+}
+
 //---------------------------------------------------------------------------------------
 string ColStaffObjs::dump(bool fWithIds)
 {
@@ -245,42 +297,61 @@ string ColStaffObjs::dump(bool fWithIds)
 //---------------------------------------------------------------------------------------
 void ColStaffObjs::add_entry_to_list(ColStaffObjsEntry* pEntry)
 {
-    if (!m_pFirst)
+    //insert in table in order. As entries are ordered by timepos, the insertion
+    //point is after all entries with lower timepos and before all entries with
+    //greater timepos. Search starts after the last entry at the same timepos and
+    //goes back while order rules require it
+    auto it = std::upper_bound(m_entries.begin(), m_entries.end(), pEntry->time(),
+                    [](TimeUnits time, ColStaffObjsEntry* pEntry)
+                    { return is_lower_time(time, pEntry->time()); });
+
+    size_t i = size_t(it - m_entries.begin());
+    while (i > 0 && is_lower_entry(pEntry, m_entries[i-1]))
+        --i;
+
+    insert_entry_at(i, pEntry);
+}
+
+//---------------------------------------------------------------------------------------
+void ColStaffObjs::insert_entry_at(size_t i, ColStaffObjsEntry* pEntry)
+{
+    ColStaffObjsEntry* pPrev = (i > 0 ? m_entries[i-1] : nullptr);
+    ColStaffObjsEntry* pNext = (i < m_entries.size() ? m_entries[i] : nullptr);
+    m_entries.insert(m_entries.begin() + i, pEntry);
+    renumber_entries(i);
+
+    pEntry->set_prev( pPrev );
+    pEntry->set_next( pNext );
+    if (pPrev)
+        pPrev->set_next( pEntry );
+    if (pNext)
+        pNext->set_prev( pEntry );
+
+    //barlines and time signatures indexes
+    std::vector<ColStaffObjsEntry*>* pInstrIndex = get_instr_index_for(pEntry);
+    if (pInstrIndex)
     {
-        //first entry
-        m_pFirst = pEntry;
-        m_pLast = pEntry;
-        pEntry->set_prev( nullptr );
-        pEntry->set_next( nullptr );
-        return;
+        auto it = std::lower_bound(pInstrIndex->begin(), pInstrIndex->end(), pEntry,
+                        [](ColStaffObjsEntry* a, ColStaffObjsEntry* b)
+                        { return a->get_table_index() < b->get_table_index(); });
+        pInstrIndex->insert(it, pEntry);
     }
 
-    //insert in list in order
-    ColStaffObjsEntry* pCurrent = m_pLast;
-    while (pCurrent != nullptr)
+    //the index points to the first entry for the staffobj
+    ImoStaffObj* pSO = pEntry->imo_object();
+    auto itIndex = m_index.find(pSO);
+    if (itIndex == m_index.end())
+        m_index[pSO] = pEntry;
+    else
     {
-        if (is_lower_entry(pEntry, pCurrent))
-            pCurrent = pCurrent->get_prev();
-        else
+        //other entries for the staffobj are at the same timepos, usually just before
+        for (size_t k=i; k > 0; --k)
         {
-            //insert after pCurrent
-            ColStaffObjsEntry* pNext = pCurrent->get_next();
-            pEntry->set_prev( pCurrent );
-            pEntry->set_next( pNext );
-            pCurrent->set_next( pEntry );
-            if (pNext == nullptr)
-                m_pLast = pEntry;
-            else
-                pNext->set_prev( pEntry );
-            return;
+            if (m_entries[k-1] == itIndex->second)
+                return;
         }
+        itIndex->second = pEntry;
     }
-
-    //it is the first one
-    pEntry->set_prev( nullptr );
-    pEntry->set_next( m_pFirst );
-    m_pFirst->set_prev( pEntry );
-    m_pFirst = pEntry;
 }
 
 //---------------------------------------------------------------------------------------
@@ -401,67 +472,351 @@ void ColStaffObjs::delete_entry_for(ImoStaffObj* pSO)
         throw runtime_error("[ColStaffObjs::delete_entry_for] entry not found!");
     }
 
+    std::vector<ColStaffObjsEntry*>* pInstrIndex = get_instr_index_for(pEntry);
+    if (pInstrIndex)
+        pInstrIndex->erase( std::find(pInstrIndex->begin(), pInstrIndex->end(), pEntry) );
+
+    auto it = m_entries.erase(m_entries.begin() + pEntry->get_table_index());
+    renumber_entries(size_t(pEntry->get_table_index()));
+
     ColStaffObjsEntry* pPrev = pEntry->get_prev();
     ColStaffObjsEntry* pNext = pEntry->get_next();
+    if (pPrev)
+        pPrev->set_next( pNext );
+    if (pNext)
+        pNext->set_prev( pPrev );
     delete pEntry;
-    if (pPrev == nullptr)
+
+    //update index: the staffobj could have more entries (e.g. key signatures in
+    //several staves). They follow the deleted one, at the same timepos
+    m_index.erase(pSO);
+    for (; it != m_entries.end() && !is_greater_time((*it)->time(), pSO->get_time()); ++it)
     {
-        //removing the head of the list
-        m_pFirst = pNext;
-        if (pNext)
-            pNext->set_prev(nullptr);
+        if ((*it)->imo_object() == pSO)
+        {
+            m_index[pSO] = *it;
+            break;
+        }
     }
-    else if (pNext == nullptr)
+}
+
+//---------------------------------------------------------------------------------------
+void ColStaffObjs::replace_entry_for(ImoStaffObj* pOld, ImoStaffObj* pNew)
+{
+    //The new staffobj takes the place of the old one in the table, and the old one
+    //is no longer in the table. For updating the table after replacing a staffobj
+    //with only one entry by other with the same timepos, duration, voice and staff
+
+    ColStaffObjsEntry* pEntry = find_entry_for(pOld);
+    if (!pEntry)
     {
-        //removing the tail of the list
-        m_pLast = pPrev;
-        pPrev->set_next(nullptr);
+        LOMSE_LOG_ERROR("[ColStaffObjs::replace_entry_for] entry not found!");
+        throw runtime_error("[ColStaffObjs::replace_entry_for] entry not found!");
     }
+
+    pEntry->set_imo_object(pNew);
+    pOld->set_colstaffobjs_entry(nullptr);
+    m_index.erase(pOld);
+    m_index[pNew] = pEntry;
+}
+
+//---------------------------------------------------------------------------------------
+ColStaffObjsEntry* ColStaffObjs::find_entry_for(ImoStaffObj* pSO)
+{
+    auto it = m_index.find(pSO);
+    return (it != m_index.end() ? it->second : nullptr);
+}
+
+//---------------------------------------------------------------------------------------
+void ColStaffObjs::renumber_entries(size_t i)
+{
+    for (; i < m_entries.size(); ++i)
+        m_entries[i]->set_index(int(i));
+}
+
+//---------------------------------------------------------------------------------------
+std::vector<ColStaffObjsEntry*>* ColStaffObjs::get_instr_index_for(ColStaffObjsEntry* pEntry)
+{
+    //returns the instrument index to which the entry must be added, if any
+
+    std::vector< std::vector<ColStaffObjsEntry*> >* pIndex = nullptr;
+    if (pEntry->imo_object()->is_barline())
+        pIndex = &m_barlines;
+    else if (pEntry->imo_object()->is_time_signature())
+        pIndex = &m_timeSignatures;
+    else if (pEntry->imo_object()->is_key_signature())
+        pIndex = &m_keySignatures;
     else
+        return nullptr;
+
+    size_t instr = size_t(pEntry->num_instrument());
+    if (pIndex->size() <= instr)
+        pIndex->resize(instr + 1);
+    return &(pIndex->at(instr));
+}
+
+//---------------------------------------------------------------------------------------
+ColStaffObjsEntry* ColStaffObjs::get_first_entry_not_before(TimeUnits timepos)
+{
+    //Binary search for the first entry with time >= timepos. Returns nullptr if
+    //all entries are before timepos
+
+    auto it = std::lower_bound(m_entries.begin(), m_entries.end(), timepos,
+                    [](ColStaffObjsEntry* pEntry, TimeUnits time)
+                    { return is_lower_time(pEntry->time(), time); });
+
+    return (it != m_entries.end() ? *it : nullptr);
+}
+
+//---------------------------------------------------------------------------------------
+ColStaffObjsEntry* ColStaffObjs::get_barline_for_measure(int instr, int measure)
+{
+    //Returns the first barline in the instrument for the given measure (that is, the
+    //barline at end of the measure) or nullptr if not found
+
+    if (instr < 0 || instr >= int(m_barlines.size()))
+        return nullptr;
+
+    std::vector<ColStaffObjsEntry*>& barlines = m_barlines[instr];
+    auto it = std::lower_bound(barlines.begin(), barlines.end(), measure,
+                    [](ColStaffObjsEntry* pEntry, int iMeasure)
+                    { return pEntry->measure() < iMeasure; });
+
+    return (it != barlines.end() && (*it)->measure() == measure ? *it : nullptr);
+}
+
+//---------------------------------------------------------------------------------------
+ColStaffObjsEntry* ColStaffObjs::get_prev_barline(int instr, ColStaffObjsEntry* pEntry)
+{
+    //Returns the last barline in the instrument placed before pEntry. If pEntry is
+    //nullptr (end of table) returns the last barline in the instrument
+
+    if (instr < 0 || instr >= int(m_barlines.size()))
+        return nullptr;
+    return find_prev_in(m_barlines[instr], pEntry);
+}
+
+//---------------------------------------------------------------------------------------
+ColStaffObjsEntry* ColStaffObjs::get_prev_time_signature(int instr,
+                                                         ColStaffObjsEntry* pEntry)
+{
+    //Returns the last time signature in the instrument placed before pEntry. If pEntry
+    //is nullptr (end of table) returns the last time signature in the instrument
+
+    if (instr < 0 || instr >= int(m_timeSignatures.size()))
+        return nullptr;
+    return find_prev_in(m_timeSignatures[instr], pEntry);
+}
+
+//---------------------------------------------------------------------------------------
+ColStaffObjsEntry* ColStaffObjs::get_prev_key_signature(int instr,
+                                                        ColStaffObjsEntry* pEntry)
+{
+    //Returns the last key signature in the instrument placed before pEntry. If pEntry
+    //is nullptr (end of table) returns the last key signature in the instrument
+
+    if (instr < 0 || instr >= int(m_keySignatures.size()))
+        return nullptr;
+    return find_prev_in(m_keySignatures[instr], pEntry);
+}
+
+//---------------------------------------------------------------------------------------
+ColStaffObjsEntry* ColStaffObjs::find_prev_in(std::vector<ColStaffObjsEntry*>& entries,
+                                              ColStaffObjsEntry* pEntry)
+{
+    if (pEntry == nullptr)
+        return (entries.empty() ? nullptr : entries.back());
+
+    auto it = std::lower_bound(entries.begin(), entries.end(), pEntry,
+                    [](ColStaffObjsEntry* a, ColStaffObjsEntry* b)
+                    { return a->get_table_index() < b->get_table_index(); });
+
+    return (it != entries.begin() ? *(it - 1) : nullptr);
+}
+
+//---------------------------------------------------------------------------------------
+void ColStaffObjs::sort_table()
+{
+    //The result must be the same than adding the entries, in current order, by
+    //add_entry_to_list(). As order rules only apply to entries at the same timepos,
+    //this is equivalent to a stable sort by timepos followed by the insertion, in
+    //current order, of the entries at each timepos. This avoids the quadratic cost
+    //of inserting the entries one by one when building the table
+
+    std::stable_sort(m_entries.begin(), m_entries.end(),
+                     [](ColStaffObjsEntry* a, ColStaffObjsEntry* b)
+                     { return is_lower_time(a->time(), b->time()); });
+
+    size_t iStart = 0;
+    while (iStart < m_entries.size())
     {
-        //removing intermediate node
-        pPrev->set_next( pNext );
-        pNext->set_prev( pPrev );
+        size_t iEnd = iStart + 1;
+        while (iEnd < m_entries.size()
+               && !is_greater_time(m_entries[iEnd]->time(), m_entries[iStart]->time()))
+        {
+            ++iEnd;
+        }
+        sort_entries_at_same_time(iStart, iEnd, iStart + 1);
+        iStart = iEnd;
     }
-    --m_numEntries;
+
+    rebuild_links_and_indexes();
 }
 
 //---------------------------------------------------------------------------------------
-ColStaffObjsEntry* ColStaffObjs::find_entry_for(ImoStaffObj* pSO)
+void ColStaffObjs::sort_entries_at_same_time(size_t iStart, size_t iEnd,
+                                             size_t iFirstToInsert)
 {
-    ColStaffObjs::iterator it;
-    for (it=begin(); it != end(); ++it)
+    //insertion sort, with the order rules, of entries in range [iStart, iEnd).
+    //Entries in range [iStart, iFirstToInsert) are already sorted
+
+    for (size_t k = iFirstToInsert; k < iEnd; ++k)
     {
-        if ((*it)->imo_object() == pSO)
-            return *it;
+        ColStaffObjsEntry* pEntry = m_entries[k];
+        size_t i = k;
+        while (i > iStart && is_lower_entry(pEntry, m_entries[i-1]))
+        {
+            m_entries[i] = m_entries[i-1];
+            --i;
+        }
+        m_entries[i] = pEntry;
     }
-    return nullptr;
 }
 
 //---------------------------------------------------------------------------------------
-void ColStaffObjs::sort_table()
+void ColStaffObjs::replace_instrument_entries(int instr, size_t iFirstNew)
 {
-    //The table is created with entries in order. But edition operations forces to
-    //reorder entries. The main requirement for the sort algorithm is:
-    // * stable (preserve order of elements with equal keys)
-    //The chosen algorithm is the insertion sort, that also has some advantages:
-    // * good performance when table is nearly ordered
-    // * simple to implement and much better performance than other simple algorithms,
-    //   such as the bubble sort
-    // * in-place sort (does not require extra memory)
+    //Replaces the entries for instrument instr by the new ones, appended to the table,
+    //in definition order, from position iFirstNew. The result must be the same than
+    //building the table again. Only the groups of entries at the same timepos that
+    //had or now have entries for the instrument are sorted again. The other groups
+    //do not change
+
+    std::vector<ColStaffObjsEntry*> added(m_entries.begin() + iFirstNew,
+                                          m_entries.end());
+    std::stable_sort(added.begin(), added.end(),
+                     [](ColStaffObjsEntry* a, ColStaffObjsEntry* b)
+                     { return is_lower_time(a->time(), b->time()); });
+
+    //remove old entries. Their staffobjs could be deleted, so the entries around
+    //them are marked for identifying the groups to sort
+    std::vector<ColStaffObjsEntry*> kept;
+    std::vector<bool> keptTouched;
+    kept.reserve(iFirstNew);
+    keptTouched.reserve(iFirstNew);
+    bool fTouchNext = false;
+    for (size_t i=0; i < iFirstNew; ++i)
+    {
+        ColStaffObjsEntry* pEntry = m_entries[i];
+        if (pEntry->num_instrument() == instr)
+        {
+            if (!kept.empty())
+                keptTouched.back() = true;
+            fTouchNext = true;
+            delete pEntry;
+        }
+        else
+        {
+            kept.push_back(pEntry);
+            keptTouched.push_back(fTouchNext);
+            fTouchNext = false;
+        }
+    }
 
-    ColStaffObjsEntry* pUnsorted = m_pFirst;
-    m_pFirst = nullptr;
-    m_pLast = nullptr;
+    //merge new entries, by timepos
+    m_entries.clear();
+    m_entries.reserve(kept.size() + added.size());
+    std::vector<bool> touched;
+    touched.reserve(kept.size() + added.size());
+    size_t k = 0;
+    for (ColStaffObjsEntry* pEntry : added)
+    {
+        for (; k < kept.size() && !is_lower_time(pEntry->time(), kept[k]->time()); ++k)
+        {
+            m_entries.push_back(kept[k]);
+            touched.push_back(keptTouched[k]);
+        }
+        m_entries.push_back(pEntry);
+        touched.push_back(true);
+    }
+    for (; k < kept.size(); ++k)
+    {
+        m_entries.push_back(kept[k]);
+        touched.push_back(keptTouched[k]);
+    }
 
-    while (pUnsorted != nullptr)
+    //sort affected groups
+    size_t iStart = 0;
+    while (iStart < m_entries.size())
     {
-        ColStaffObjsEntry* pCurrent = pUnsorted;
+        bool fTouched = touched[iStart];
+        size_t iEnd = iStart + 1;
+        while (iEnd < m_entries.size()
+               && !is_greater_time(m_entries[iEnd]->time(), m_entries[iStart]->time()))
+        {
+            fTouched |= touched[iEnd];
+            ++iEnd;
+        }
+        if (fTouched)
+            sort_instrument_entries_at_same_time(iStart, iEnd, instr);
+        iStart = iEnd;
+    }
+
+    rebuild_links_and_indexes();
+}
+
+//---------------------------------------------------------------------------------------
+void ColStaffObjs::sort_instrument_entries_at_same_time(size_t iStart, size_t iEnd,
+                                                        int instr)
+{
+    //When building the table, entries at the same timepos are inserted in definition
+    //order, instruments in sequence, and inserting an entry does not change the order
+    //of the previous ones. Therefore, entries for instruments before instr are
+    //already sorted, and entries for instr and next instruments must be inserted
+    //again, in definition order
+
+    auto itStart = m_entries.begin() + iStart;
+    auto itEnd = m_entries.begin() + iEnd;
+    auto itFirst = std::stable_partition(itStart, itEnd,
+                            [instr](ColStaffObjsEntry* pEntry)
+                            { return pEntry->num_instrument() < instr; });
+
+    std::stable_sort(itFirst, itEnd,
+                     [](ColStaffObjsEntry* a, ColStaffObjsEntry* b)
+                     {
+                         if (a->num_instrument() != b->num_instrument())
+                            return a->num_instrument() < b->num_instrument();
+                         return a->get_order() < b->get_order();
+                     });
+
+    sort_entries_at_same_time(iStart, iEnd, size_t(itFirst - m_entries.begin()));
+}
 
-        //get next here, as insertion could change next element
-        pUnsorted = pUnsorted->get_next();
+//---------------------------------------------------------------------------------------
+void ColStaffObjs::rebuild_links_and_indexes()
+{
+    m_index.clear();
+    m_barlines.clear();
+    m_timeSignatures.clear();
+    m_keySignatures.clear();
 
-        add_entry_to_list(pCurrent);
+    ColStaffObjsEntry* pPrev = nullptr;
+    for (size_t i=0; i < m_entries.size(); ++i)
+    {
+        ColStaffObjsEntry* pEntry = m_entries[i];
+        pEntry->set_index(int(i));
+        pEntry->set_prev(pPrev);
+        pEntry->set_next(nullptr);
+        if (pPrev)
+            pPrev->set_next(pEntry);
+        pPrev = pEntry;
+
+        std::vector<ColStaffObjsEntry*>* pInstrIndex = get_instr_index_for(pEntry);
+        if (pInstrIndex)
+            pInstrIndex->push_back(pEntry);
+
+        //the index points to the first entry for the staffobj
+        m_index.insert( std::make_pair(pEntry->imo_object(), pEntry) );
     }
 }
 
@@ -481,6 +836,30 @@ ColStaffObjs* ColStaffObjsBuilder::build(ImoScore* pScore)
     return pColStaffObjs;
 }
 
+//---------------------------------------------------------------------------------------
+bool ColStaffObjsBuilder::rebuild_instrument(ImoScore* pScore, int iInstr)
+{
+    //Updates the table after changes limited to the music data of instrument iInstr.
+    //Only the entries for this instrument are created again. When this is not
+    //possible the whole table is built again and returns false.
+    //LDP 1.x algorithm modifies the music data when building the table, so it
+    //always requires a full build
+
+    ColStaffObjs* pColStaffObjs = pScore->get_staffobjs_table();
+    if (pColStaffObjs && pScore->get_version_major() >= 2)
+    {
+        ColStaffObjsBuilderEngine* builder = create_builder_engine(pScore);
+        bool fDone = builder->do_rebuild_instrument(pColStaffObjs, iInstr);
+        delete builder;
+
+        if (fDone)
+            return true;
+    }
+
+    build(pScore);
+    return false;
+}
+
 //---------------------------------------------------------------------------------------
 ColStaffObjsBuilderEngine* ColStaffObjsBuilder::create_builder_engine(ImoScore* pScore)
 {
@@ -524,9 +903,11 @@ void ColStaffObjsBuilderEngine::create_table()
     int totalInstruments = m_pImScore->get_num_instruments();
     for (int instr = 0; instr < totalInstruments; instr++)
     {
+        m_pColStaffObjs->add_first_line( m_lines.get_number_of_lines() );
         create_entries_for_instrument(instr);
         prepare_for_next_instrument();
     }
+    m_pColStaffObjs->sort_table();
 
     //the table is created. Fix notes playback time and playback duration
     compute_grace_notes_playback_time();
@@ -541,6 +922,84 @@ void ColStaffObjsBuilderEngine::create_table()
     compute_divisions();
 }
 
+//---------------------------------------------------------------------------------------
+bool ColStaffObjsBuilderEngine::do_rebuild_instrument(ColStaffObjs* pColStaffObjs,
+                                                      int iInstr)
+{
+    //Creates again the entries for instrument iInstr and replaces the old ones in the
+    //table. Returns false when the table must be fully rebuilt: the instruments
+    //changed, the lines used by the instrument changed and next instruments lines
+    //must be shifted, or there are grace notes, as they can change the playback time
+    //of all other instruments.
+
+    int numInstrs = m_pImScore->get_num_instruments();
+    if (pColStaffObjs->num_instruments() != numInstrs
+        || is_greater_time(pColStaffObjs->anacrusis_extra_time(), 0.0))
+    {
+        return false;
+    }
+
+    m_pColStaffObjs = pColStaffObjs;
+    size_t iFirstNew = size_t(m_pColStaffObjs->num_entries());
+    m_lines.start_instrument_at( m_pColStaffObjs->first_line_for(iInstr) );
+    create_entries_for_instrument(iInstr);
+    prepare_for_next_instrument();
+
+    bool fLastInstr = (iInstr == numInstrs - 1);
+    if (!m_graces.empty()
+        || (!fLastInstr && m_lines.get_number_of_lines()
+                           != m_pColStaffObjs->first_line_for(iInstr + 1)))
+    {
+        return false;
+    }
+
+    m_pColStaffObjs->replace_instrument_entries(iInstr, iFirstNew);
+    if (fLastInstr)
+        set_num_lines();
+
+    compute_arpeggiated_chords_playback_time();
+
+    m_pColStaffObjs->set_anacrusis_missing_time(0.0);
+    collect_anacrusis_info();
+
+    collect_table_info();
+    compute_divisions();
+    set_min_note_duration();
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+void ColStaffObjsBuilderEngine::collect_table_info()
+{
+    //noterests count, divisions and min note duration are computed again for all
+    //instruments. The rules for the note duration are those in LDP 2.x algorithm.
+    //Repeated durations are ignored by the divisions computer
+
+    m_pColStaffObjs->reset_noterests_count();
+    m_minNoteDuration = LOMSE_NO_NOTE_DURATION;
+
+    ColStaffObjsIterator it;
+    for (it = m_pColStaffObjs->begin(); it != m_pColStaffObjs->end(); ++it)
+    {
+        ImoStaffObj* pSO = (*it)->imo_object();
+        if (!pSO->is_note_rest() || pSO->is_grace_note())
+            continue;
+
+        ImoNoteRest* pNR = static_cast<ImoNoteRest*>(pSO);
+        collect_note_rest_info(pNR);
+
+        TimeUnits duration = pNR->get_duration();
+        if (pNR->is_note())
+        {
+            ImoNote* pNote = static_cast<ImoNote*>(pNR);
+            if (pNote->is_in_chord() && !pNote->is_end_of_chord())
+                duration = 0.0;
+        }
+        if (duration > 0.0)
+            m_minNoteDuration = min(m_minNoteDuration, duration);
+    }
+}
+
 //---------------------------------------------------------------------------------------
 void ColStaffObjsBuilderEngine::collect_anacrusis_info()
 {
@@ -644,14 +1103,14 @@ void ColStaffObjsBuilderEngine::add_entries_for_key_or_time_signature(ImoObj* pI
         for (int nStaff=0; nStaff < numStaves; nStaff++)
         {
             int nLine = get_line_for(0, nStaff);
-            m_pColStaffObjs->add_entry(m_nCurMeasure, nInstr, nLine, nStaff, pSO);
+            m_pColStaffObjs->append_entry(m_nCurMeasure, nInstr, nLine, nStaff, pSO);
         }
     }
     else
     {
         //key signature, specific for one staff
         int nLine = get_line_for(0, staff);
-        m_pColStaffObjs->add_entry(m_nCurMeasure, nInstr, nLine, staff, pSO);
+        m_pColStaffObjs->append_entry(m_nCurMeasure, nInstr, nLine, staff, pSO);
     }
 }
 
@@ -1046,8 +1505,8 @@ void ColStaffObjsBuilderEngine1x::add_entry_for_staffobj(ImoObj* pImo, int nInst
         }
     }
     int nLine = get_line_for(nVoice, nStaff);
-    ColStaffObjsEntry* pEntry = m_pColStaffObjs->add_entry(m_nCurMeasure, nInstr,
-                                                           nLine, nStaff, pSO);
+    ColStaffObjsEntry* pEntry = m_pColStaffObjs->append_entry(m_nCurMeasure, nInstr,
+                                                              nLine, nStaff, pSO);
     if (pSO->is_grace_note())
         m_graces.push_back(pEntry);
 }
@@ -1231,8 +1690,8 @@ void ColStaffObjsBuilderEngine2x::add_entry_for_staffobj(ImoObj* pImo, int nInst
         nVoice = m_curVoice;
 
     int nLine = get_line_for(nVoice, nStaff);
-    ColStaffObjsEntry* pEntry = m_pColStaffObjs->add_entry(m_nCurMeasure, nInstr,
-                                                           nLine, nStaff, pSO);
+    ColStaffObjsEntry* pEntry = m_pColStaffObjs->append_entry(m_nCurMeasure, nInstr,
+                                                              nLine, nStaff, pSO);
 //    cout << "    add_entry_for_staffobj() pSO=" << pSO->to_string()
 //        << ", time=" << pSO->get_time()
 //        << ", get_line_for(nVoice=" << nVoice << ", nStaff=" << nStaff
@@ -1399,6 +1858,14 @@ int StaffVoiceLineTable::assign_line_to(int nVoice, int nStaff)
     return line;
 }
 
+//---------------------------------------------------------------------------------------
+void StaffVoiceLineTable::start_instrument_at(int line)
+{
+    //for assigning lines to an instrument that starts at the given line
+    m_lastDefinedLine = line - 1;
+    new_instrument();
+}
+
 //---------------------------------------------------------------------------------------
 void StaffVoiceLineTable::new_instrument()
 {
@@ -9,6 +9,8 @@
 
 #include "lomse_events_dispatcher.h"
 
+#include <algorithm>
+
 namespace lomse
 {
 
@@ -17,28 +19,55 @@ namespace lomse
 //=======================================================================================
 // EventsDispatcher implementation
 //=======================================================================================
+EventsDispatcher::~EventsDispatcher()
+{
+    stop_events_loop();
+}
+
+//---------------------------------------------------------------------------------------
 void EventsDispatcher::start_events_loop()
 {
     //Create the thread. It starts inmediately to execute the events loop (method
     //run_events_loop())
 
     //AWARE: this method is only intended to be invoked by Lomse, when the library is
-    //initialized. This method only returns when the stop_events_loop() method
-    //is invoked.
+    //initialized. The loop runs until the stop_events_loop() method is invoked.
 
-    delete m_pThread;
+    stop_events_loop();
+    {
+        QueueLock lock(m_mutex);
+        m_fStopLoop = false;
+    }
     m_pThread = LOMSE_NEW EventsThread(&EventsDispatcher::thread_main, this);
 }
 
 //---------------------------------------------------------------------------------------
 void EventsDispatcher::stop_events_loop()
 {
-    //stops the events dispatch loop
+    //stops the events dispatch loop and waits for the thread to finish. Events
+    //still pending are discarded.
 
     //AWARE: this method is only intended to be run by Lomse, when the
     //Lomse LibraryScope object is destroyed.
 
-    m_fStopLoop = true;
+    if (!m_pThread)
+        return;
+
+    {
+        QueueLock lock(m_mutex);
+        m_fStopLoop = true;
+    }
+    m_wakeUp.notify_one();
+
+    if (m_pThread->joinable())
+    {
+        if (m_pThread->get_id() == std::this_thread::get_id())
+            m_pThread->detach();    //invoked from an event handler
+        else
+            m_pThread->join();
+    }
+    delete m_pThread;
+    m_pThread = nullptr;
 }
 
 //---------------------------------------------------------------------------------------
@@ -49,9 +78,140 @@ void EventsDispatcher::thread_main()
 
 //---------------------------------------------------------------------------------------
 void EventsDispatcher::post_event(Observer* pObserver, SpEventInfo pEvent)
+{
+    {
+        QueueLock lock(m_mutex);
+        if (coalesce_event(pObserver, pEvent))
+            return;
+
+        m_events.push_back( QueuedEvent(pEvent, pObserver,
+                                        std::chrono::steady_clock::now()) );
+        m_maxQueueDepth = max(m_maxQueueDepth, m_events.size());
+    }
+    m_wakeUp.notify_one();
+}
+
+//---------------------------------------------------------------------------------------
+bool EventsDispatcher::coalesce_event(Observer* pObserver, SpEventInfo pEvent)
+{
+    //If coalescing is enabled and there is a pending event of the same type for the
+    //same observer, replace it by the new one, keeping its place in the queue.
+    //Visual tracking events can not be replaced, as the sub-events of the pending
+    //event (e.g. highlight off) would be lost. Instead, the sub-events of the new
+    //event are appended to the pending one.
+    //Returns true if the event has been merged.
+    //AWARE: must be invoked with the queue locked
+
+    if (m_coalescing == k_coalesce_none || !is_coalescable(pEvent))
+        return false;
+
+    EEventType type = pEvent->get_event_type();
+    std::deque<QueuedEvent>::reverse_iterator it;
+    for (it = m_events.rbegin(); it != m_events.rend(); ++it)
+    {
+        if (it->pObserver == pObserver && it->pEvent->get_event_type() == type)
+        {
+            if (type == k_tracking_event)
+            {
+                EventVisualTracking* pPending =
+                            static_cast<EventVisualTracking*>( it->pEvent.get() );
+                EventVisualTracking* pNew =
+                            static_cast<EventVisualTracking*>( pEvent.get() );
+                if (pPending->get_score_id() != pNew->get_score_id())
+                    return false;
+                pPending->append_items(pNew);
+            }
+            else
+                it->pEvent = pEvent;
+
+            ++m_numCoalesced;
+            return true;
+        }
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------------------
+bool EventsDispatcher::is_coalescable(SpEventInfo pEvent)
+{
+    switch (pEvent->get_event_type())
+    {
+        case k_tracking_event:
+        case k_update_viewport_event:
+        case k_update_window_event:
+        case k_selection_set_change:
+        case k_pointed_object_change:
+            return true;
+        default:
+            return false;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void EventsDispatcher::set_coalescing_policy(int policy)
+{
+    QueueLock lock(m_mutex);
+    m_coalescing = policy;
+}
+
+//---------------------------------------------------------------------------------------
+int EventsDispatcher::get_coalescing_policy()
+{
+    QueueLock lock(m_mutex);
+    return m_coalescing;
+}
+
+//---------------------------------------------------------------------------------------
+size_t EventsDispatcher::get_queue_depth()
+{
+    QueueLock lock(m_mutex);
+    return m_events.size();
+}
+
+//---------------------------------------------------------------------------------------
+size_t EventsDispatcher::get_max_queue_depth()
+{
+    QueueLock lock(m_mutex);
+    return m_maxQueueDepth;
+}
+
+//---------------------------------------------------------------------------------------
+long EventsDispatcher::get_num_dispatched()
+{
+    QueueLock lock(m_mutex);
+    return m_numDispatched;
+}
+
+//---------------------------------------------------------------------------------------
+long EventsDispatcher::get_num_coalesced()
 {
     QueueLock lock(m_mutex);
-    m_events.push( make_pair(pEvent, pObserver));
+    return m_numCoalesced;
+}
+
+//---------------------------------------------------------------------------------------
+double EventsDispatcher::get_mean_latency()
+{
+    QueueLock lock(m_mutex);
+    return (m_numDispatched > 0L ? m_totalLatency / double(m_numDispatched) : 0.0);
+}
+
+//---------------------------------------------------------------------------------------
+double EventsDispatcher::get_max_latency()
+{
+    QueueLock lock(m_mutex);
+    return m_maxLatency;
+}
+
+//---------------------------------------------------------------------------------------
+void EventsDispatcher::reset_statistics()
+{
+    QueueLock lock(m_mutex);
+    m_maxQueueDepth = m_events.size();
+    m_numDispatched = 0L;
+    m_numCoalesced = 0L;
+    m_totalLatency = 0.0;
+    m_maxLatency = 0.0;
 }
 
 //---------------------------------------------------------------------------------------
@@ -60,31 +220,44 @@ void EventsDispatcher::post_event(Observer* pObserver, SpEventInfo pEvent)
 
 void EventsDispatcher::run_events_loop()
 {
-    std::chrono::milliseconds waitTime(5);   //5ms
+    std::deque<QueuedEvent> batch;
 
-    while (!stop_event_received())
+    while (true)
     {
-        if (pending_events())
-            dispatch_next_event();
-        else
-            std::this_thread::sleep_for(waitTime);
+        {
+            QueueLock lock(m_mutex);
+            m_wakeUp.wait(lock, [this]{ return m_fStopLoop || !m_events.empty(); });
+            if (m_fStopLoop)
+                return;
+
+            batch.swap(m_events);
+        }
+
+        dispatch_events(batch);
+        batch.clear();
     }
 }
 
 //---------------------------------------------------------------------------------------
-void EventsDispatcher::dispatch_next_event()
+void EventsDispatcher::dispatch_events(std::deque<QueuedEvent>& events)
 {
-    pair<SpEventInfo, Observer*> event;
-
+    double totalLatency = 0.0;
+    double maxLatency = 0.0;
+    std::deque<QueuedEvent>::iterator it;
+    for (it = events.begin(); it != events.end(); ++it)
     {
-        QueueLock lock(m_mutex);
-        event = m_events.front();
-        m_events.pop();
+        std::chrono::duration<double, std::micro> latency =
+            std::chrono::steady_clock::now() - it->posted;
+        totalLatency += latency.count();
+        maxLatency = max(maxLatency, latency.count());
+
+        it->pObserver->notify(it->pEvent);
     }
 
-    SpEventInfo pEvent = event.first;
-    Observer* pObserver = event.second;
-    pObserver->notify(pEvent);
+    QueueLock lock(m_mutex);
+    m_numDispatched += long(events.size());
+    m_totalLatency += totalLatency;
+    m_maxLatency = max(m_maxLatency, maxLatency);
 }
 
 #endif
@@ -121,6 +121,7 @@ LdpFactory* LibraryScope::ldp_factory()
 //---------------------------------------------------------------------------------------
 FontStorage* LibraryScope::font_storage()
 {
+    std::lock_guard<std::recursive_mutex> lock(m_layoutMutex);
     if (!m_pFontStorage)
         m_pFontStorage = LOMSE_NEW FontStorage(this);
     return m_pFontStorage;
@@ -146,6 +147,9 @@ MusicGlyphs* LibraryScope::get_glyphs_table()
 void LibraryScope::set_music_font(const string& fontFile, const string& fontName,
                                   const string& path)
 {
+    //AWARE: the music font can not be changed while a document is being laid out
+    std::lock_guard<std::recursive_mutex> lock(m_layoutMutex);
+
     m_sMusicFontName = fontName;
     m_sMusicFontFile = fontFile;
     m_sMusicFontPath = path;
@@ -30,6 +30,7 @@
 #include "lomse_half_page_view.h"
 #include "lomse_renderer.h"
 #include "lomse_svg_drawer.h"
+#include "lomse_tile_cache.h"
 #include "lomse_measure_highlight.h"
 #include "lomse_score_algorithms.h"
 #include "lomse_gm_measures_table.h"
@@ -180,6 +181,8 @@ GraphicView::~GraphicView()
     delete m_pDrawer;
     delete m_pPrintDrawer;
     delete m_pOverlaysGenerator;
+    delete m_pTileCache;
+    delete m_pTileDrawer;
 
     //AWARE: ownership of all VisualEffects (m_pCaret, m_pDragImg, m_pHighlighted,
     //       m_pTimeGrid & m_pTempoLine) is transferred to OverlaysGenerator.
@@ -636,7 +639,12 @@ void GraphicView::toggle_caret()
 //---------------------------------------------------------------------------------------
 void GraphicView::layout_caret()
 {
+    //AWARE: a hidden caret is not laid out when there are pending pages, as
+    //positioning the caret requires to finish the layout
     GraphicModel* pGModel = get_graphic_model();
+    if (!m_pCaret->is_visible() && !pGModel->is_layout_finished())
+        return;
+
     CaretPositioner positioner;
     positioner.layout_caret(m_pCaret, m_pCursor, pGModel);
 }
@@ -781,10 +789,21 @@ void GraphicView::render_as_svg(SvgDrawer& drawer, int page)
 
     UPoint origin(0.0f, 0.0f);
     GraphicModel* pGModel = get_graphic_model();
+    m_options.reset_draw_counters();
     pGModel->draw_page(page, origin, &drawer, m_options);
     drawer.render();
 }
 
+//---------------------------------------------------------------------------------------
+void GraphicView::render_as_svg(SvgDrawer& drawer, int page, const URect& region)
+{
+    //region is in page coordinates. Objects out of it are not exported
+
+    m_options.set_clip_rect(region);
+    render_as_svg(drawer, page);
+    m_options.remove_clip_rect();
+}
+
 //---------------------------------------------------------------------------------------
 void GraphicView::set_svg_canvas_width(Pixels x)
 {
@@ -873,6 +892,15 @@ void GraphicView::draw_graphic_model()
     m_options.read_only_mode =
         m_pInteractor->get_operating_mode() != Interactor::k_mode_edition;
 
+    BitmapDrawer* pBmpDrawer = dynamic_cast<BitmapDrawer*>(m_pDrawer);
+    if (m_pTileCache && pBmpDrawer)
+    {
+        m_pDrawer->new_viewport_origin(double(m_vxOrg), double(m_vyOrg));
+        m_pDrawer->set_affine_transformation(m_transform);
+        draw_graphic_model_using_tiles(pBmpDrawer);
+        return;
+    }
+
     m_pDrawer->reset(m_options.background_color);
     m_pDrawer->new_viewport_origin(double(m_vxOrg), double(m_vyOrg));
     m_pDrawer->set_affine_transformation(m_transform);
@@ -881,6 +909,152 @@ void GraphicView::draw_graphic_model()
     m_pDrawer->render();
 }
 
+//---------------------------------------------------------------------------------------
+static inline int floor_div(int value, int divisor)
+{
+    return (value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor));
+}
+
+//---------------------------------------------------------------------------------------
+void GraphicView::draw_graphic_model_using_tiles(BitmapDrawer* pDrawer)
+{
+    //The view area is composed by copying cached tiles. Only missing tiles are
+    //rendered. Draw counters only account for objects drawn in rendered tiles.
+
+    collect_page_bounds();
+    m_options.reset_draw_counters();
+    m_pTileCache->validate(get_graphic_model(), m_options, m_pageBounds);
+
+    RenderingBuffer& rbuf = pDrawer->get_view_area_buffer();
+    int width = int(rbuf.width());
+    int height = int(rbuf.height());
+    if (!is_valid_viewport() || width == 0 || height == 0)
+    {
+        pDrawer->reset(m_options.background_color);
+        return;
+    }
+
+    int size = TileCache::k_tile_size;
+    int col1 = floor_div(m_vxOrg, size);
+    int col2 = floor_div(m_vxOrg + width - 1, size);
+    int row1 = floor_div(m_vyOrg, size);
+    int row2 = floor_div(m_vyOrg + height - 1, size);
+    double scale = m_transform.scale();
+
+    for (int row = row1; row <= row2; ++row)
+    {
+        for (int col = col1; col <= col2; ++col)
+        {
+            RasterTile* pTile = m_pTileCache->find_tile(scale, col, row);
+            if (!pTile)
+            {
+                pTile = m_pTileCache->create_tile(scale, col, row);
+                render_tile(pTile);
+            }
+            m_pTileCache->copy_tile_to(pTile, rbuf, col * size - m_vxOrg,
+                                       row * size - m_vyOrg);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void GraphicView::render_tile(RasterTile* pTile)
+{
+    //Render the pages in tile area. Drawing is restricted to the tile area, plus a
+    //margin for antialiasing pixels, so that contiguous tiles match.
+
+    int size = TileCache::k_tile_size;
+    Pixels xOrg = pTile->col * size;
+    Pixels yOrg = pTile->row * size;
+    m_pTileDrawer->set_rendering_buffer(pTile->rbuf.buf(),
+                                        TileCache::k_tile_bitmap_size,
+                                        TileCache::k_tile_bitmap_size,
+                                        m_options.background_color);
+    m_pTileDrawer->new_viewport_origin(double(xOrg), double(yOrg));
+    TransAffine transform = m_transform;
+    transform.tx = double(-xOrg);
+    transform.ty = double(-yOrg);
+    m_pTileDrawer->set_affine_transformation(transform);
+
+    double xLeft = 0.0;
+    double yTop = 0.0;
+    double xRight = double(size);
+    double yBottom = double(size);
+    m_pTileDrawer->device_point_to_model(&xLeft, &yTop);
+    m_pTileDrawer->device_point_to_model(&xRight, &yBottom);
+    pTile->bounds = URect(LUnits(xLeft), LUnits(yTop), LUnits(xRight - xLeft),
+                          LUnits(yBottom - yTop));
+
+    LUnits margin = LUnits( m_pTileDrawer->device_units_to_model(4.0) );
+    URect area(pTile->bounds.x - margin, pTile->bounds.y - margin,
+               pTile->bounds.width + 2.0f * margin,
+               pTile->bounds.height + 2.0f * margin);
+
+    GraphicModel* pGModel = get_graphic_model();
+    list<URect>::iterator it;
+    int iPage = 0;
+    for (it = m_pageBounds.begin(); it != m_pageBounds.end(); ++it, ++iPage)
+    {
+        URect& page = *it;
+        if (page.left() <= area.right() && page.right() >= area.left()
+            && page.top() <= area.bottom() && page.bottom() >= area.top())
+        {
+            UPoint origin = page.get_top_left();
+            URect clip = area;
+            clip.x -= origin.x;
+            clip.y -= origin.y;
+            m_options.set_clip_rect(clip);
+            pGModel->draw_page(iPage, origin, m_pTileDrawer, m_options);
+        }
+    }
+    m_options.remove_clip_rect();
+    m_pTileDrawer->render();
+}
+
+//---------------------------------------------------------------------------------------
+void GraphicView::enable_tile_cache(bool value, size_t maxMemory)
+{
+    if (value)
+    {
+        if (!m_pTileCache)
+        {
+            m_pTileCache = LOMSE_NEW TileCache(m_libraryScope, maxMemory);
+            m_pTileDrawer = Injector::inject_BitmapDrawer(m_libraryScope);
+        }
+        else
+            m_pTileCache->set_max_memory(maxMemory);
+    }
+    else
+    {
+        delete m_pTileCache;
+        m_pTileCache = nullptr;
+        delete m_pTileDrawer;
+        m_pTileDrawer = nullptr;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void GraphicView::invalidate_tile_cache()
+{
+    if (m_pTileCache)
+        m_pTileCache->invalidate();
+}
+
+//---------------------------------------------------------------------------------------
+void GraphicView::invalidate_tile_cache(int iPage, const URect& area)
+{
+    //area is in page logical units
+
+    if (m_pTileCache && iPage >= 0 && iPage < int(m_pageBounds.size()))
+    {
+        UPoint origin = get_page_origin_for(iPage);
+        URect rect = area;
+        rect.x += origin.x;
+        rect.y += origin.y;
+        m_pTileCache->invalidate(rect);
+    }
+}
+
 //---------------------------------------------------------------------------------------
 void GraphicView::draw_all_visual_effects()
 {
@@ -1658,8 +1832,25 @@ void GraphicView::delete_rectangles(list<PageRectangle*>& rectangles)
 //---------------------------------------------------------------------------------------
 void GraphicView::draw_visible_pages(int minPage, int maxPage)
 {
+    //Only objects in the viewport are drawn. A small margin is added to the
+    //viewport for objects whose ink slightly exceeds their bounds (antialiasing).
+
     GraphicModel* pGModel = get_graphic_model();
 
+    double xLeft = 0.0;
+    double yTop = 0.0;
+    double xRight = double(m_viewportSize.width);
+    double yBottom = double(m_viewportSize.height);
+    m_pDrawer->device_point_to_model(&xLeft, &yTop);
+    m_pDrawer->device_point_to_model(&xRight, &yBottom);
+    normalize_rectangle(&xLeft, &yTop, &xRight, &yBottom);
+    LUnits margin = pixels_to_lunits(4);
+    URect viewport(LUnits(xLeft) - margin, LUnits(yTop) - margin,
+                   LUnits(xRight - xLeft) + 2.0f * margin,
+                   LUnits(yBottom - yTop) + 2.0f * margin);
+
+    m_options.reset_draw_counters();
+
     list<URect>::iterator it = m_pageBounds.begin();
     for (int i=0; i < minPage; i++)
         ++it;
@@ -1667,8 +1858,14 @@ void GraphicView::draw_visible_pages(int minPage, int maxPage)
     for (int i=minPage; i <= maxPage; i++, ++it)
     {
         UPoint origin = (*it).get_top_left();
+        URect clip = viewport;
+        clip.x -= origin.x;
+        clip.y -= origin.y;
+        m_options.set_clip_rect(clip);
         pGModel->draw_page(i, origin, m_pDrawer, m_options);
     }
+
+    m_options.remove_clip_rect();
 }
 
 //---------------------------------------------------------------------------------------
@@ -1959,12 +2156,12 @@ void VerticalBookView::collect_page_bounds()
 
     m_pageBounds.clear();
 
-    for (int i=0; i < pGModel->get_num_pages(); i++)
+    //AWARE: with lazy layout, pages not yet laid out are not created
+    for (int i=0; i < pGModel->get_estimated_num_pages(); i++)
     {
         if (i > 0)
             origin.y += 1000;
-        GmoBoxDocPage* pPage = pGModel->get_page(i);
-        URect rect = pPage->get_bounds();
+        URect rect = pGModel->get_page_bounds(i);
         UPoint bottomRight(origin.x+rect.width, origin.y+rect.height);
         m_pageBounds.push_back( URect(origin, bottomRight) );
         origin.y += rect.height;
@@ -1986,12 +2183,11 @@ void VerticalBookView::get_view_size(Pixels* xWidth, Pixels* yHeight)
     GraphicModel* pGModel = get_graphic_model();
     if (pGModel)
     {
-        for (int i=0; i < pGModel->get_num_pages(); i++)
+        for (int i=0; i < pGModel->get_estimated_num_pages(); i++)
         {
             if (i > 0)
                 height += 1000.0f;
-            GmoBoxDocPage* pPage = pGModel->get_page(i);
-            URect rect = pPage->get_bounds();
+            URect rect = pGModel->get_page_bounds(i);
             width = max(width, rect.width);
             height += rect.height;
         }
@@ -2024,10 +2220,10 @@ void HorizontalBookView::collect_page_bounds()
 
     m_pageBounds.clear();
 
-    for (int i=0; i < pGModel->get_num_pages(); i++)
+    //AWARE: with lazy layout, pages not yet laid out are not created
+    for (int i=0; i < pGModel->get_estimated_num_pages(); i++)
     {
-        GmoBoxDocPage* pPage = pGModel->get_page(i);
-        URect rect = pPage->get_bounds();
+        URect rect = pGModel->get_page_bounds(i);
         UPoint bottomRight(origin.x+rect.width, origin.y+rect.height);
         m_pageBounds.push_back( URect(origin, bottomRight) );
         origin.x += rect.width + 1500;
@@ -2064,10 +2260,9 @@ void HorizontalBookView::get_view_size(Pixels* xWidth, Pixels* yHeight)
     LUnits height = 0.0f;
 
     GraphicModel* pGModel = get_graphic_model();
-    for (int i=0; i < pGModel->get_num_pages(); i++)
+    for (int i=0; i < pGModel->get_estimated_num_pages(); i++)
     {
-        GmoBoxDocPage* pPage = pGModel->get_page(i);
-        URect rect = pPage->get_bounds();
+        URect rect = pGModel->get_page_bounds(i);
         height = max(height, rect.height);
         width += rect.width + 1500;
     }
@@ -34,6 +34,7 @@
 #include "lomse_score_algorithms.h"
 #include "lomse_renderer.h"
 #include "lomse_svg_drawer.h"
+#include "lomse_tile_cache.h"
 
 #include <sstream>
 #include <chrono>
@@ -61,6 +62,8 @@ Interactor::Interactor(LibraryScope& libraryScope, WpDocument wpDoc, View* pView
     , m_wpDoc(wpDoc)
     , m_pView(pView)
     , m_pGraphicModel(nullptr)
+    , m_fLazyLayout(false)
+    , m_fBackgroundLayout(false)
     , m_pTask(nullptr)
     , m_pCursor(nullptr)
     , m_pSelections(nullptr)
@@ -118,8 +121,16 @@ void Interactor::switch_task(int taskType)
 //---------------------------------------------------------------------------------------
 GraphicModel* Interactor::get_graphic_model()
 {
-    if (!m_pGraphicModel || graphic_model_must_be_updated())
+    if (!m_pGraphicModel)
         create_graphic_model();
+    else if (graphic_model_must_be_updated())
+    {
+        //the layout depends on the viewport width. The current model can not be
+        //reused but glyph measurements, the most expensive part of the layout not
+        //depending on the width, are cached by FontStorage
+        delete_graphic_model();
+        create_graphic_model();
+    }
     return m_pGraphicModel;
 }
 
@@ -145,15 +156,31 @@ void Interactor::create_graphic_model()
             LOMSE_LOG_DEBUG(Logger::k_render, "[Interactor::create_graphic_model]");
             int constrains = pView->get_layout_constrains();
             LUnits width = pView->get_viewport_width();
-            DocLayouter layouter(pDoc, m_libScope, constrains, width);
-
-            if (pView->is_valid_for_this_view(pDoc))
-                layouter.layout_document();
+            DocLayouter* pLayouter = LOMSE_NEW DocLayouter(pDoc, m_libScope,
+                                                           constrains, width);
+
+            //lazy and background layout only for paged views
+            bool fLazy = (m_fLazyLayout || m_fBackgroundLayout)
+                && !(constrains & (k_infinite_width | k_infinite_height));
+
+            bool fFinished = true;
+            if (!pView->is_valid_for_this_view(pDoc))
+                pLayouter->layout_empty_document();
+            else if (fLazy)
+                fFinished = pLayouter->layout_first_pages(1);
             else
-                layouter.layout_empty_document();
+                pLayouter->layout_document();
 
-            m_pGraphicModel = layouter.get_graphic_model();
+            m_pGraphicModel = pLayouter->get_graphic_model();
             m_pGraphicModel->build_main_boxes_table();
+            if (fFinished)
+                delete pLayouter;
+            else
+            {
+                m_pGraphicModel->set_pending_layout(pLayouter);
+                if (m_fBackgroundLayout)
+                    m_pGraphicModel->start_background_layout(this);
+            }
             m_pSelections->graphic_model_changed(m_pGraphicModel);
         }
         spDoc->clear_dirty();
@@ -1085,7 +1112,7 @@ void Interactor::get_viewport(Pixels* x, Pixels* y)
 USize Interactor::get_page_size(int page)
 {
     //ensure page is always valid
-    if (page < 0 || page > get_num_pages() - 1)
+    if (!page_exists(page))
         page = 0;
 
     GraphicView* pGView = dynamic_cast<GraphicView*>(m_pView);
@@ -1496,6 +1523,75 @@ void Interactor::set_view_background(Color color)
         pGView->set_background(color);
 }
 
+//---------------------------------------------------------------------------------------
+void Interactor::enable_tile_cache(bool value, size_t maxMemory)
+{
+    GraphicView* pGView = dynamic_cast<GraphicView*>(m_pView);
+    if (pGView)
+        pGView->enable_tile_cache(value, maxMemory);
+}
+
+//---------------------------------------------------------------------------------------
+void Interactor::enable_lazy_layout(bool value)
+{
+    m_fLazyLayout = value;
+}
+
+//---------------------------------------------------------------------------------------
+void Interactor::enable_background_layout(bool value)
+{
+    m_fBackgroundLayout = value;
+}
+
+//---------------------------------------------------------------------------------------
+void Interactor::invalidate_tile_cache()
+{
+    GraphicView* pGView = dynamic_cast<GraphicView*>(m_pView);
+    if (pGView)
+        pGView->invalidate_tile_cache();
+}
+
+//---------------------------------------------------------------------------------------
+void Interactor::invalidate_tile_cache(int iPage, const URect& area)
+{
+    GraphicView* pGView = dynamic_cast<GraphicView*>(m_pView);
+    if (pGView)
+        pGView->invalidate_tile_cache(iPage, area);
+}
+
+//---------------------------------------------------------------------------------------
+long Interactor::get_tile_cache_hits()
+{
+    GraphicView* pGView = dynamic_cast<GraphicView*>(m_pView);
+    TileCache* pCache = (pGView ? pGView->get_tile_cache() : nullptr);
+    return (pCache ? pCache->get_num_hits() : 0L);
+}
+
+//---------------------------------------------------------------------------------------
+long Interactor::get_tile_cache_misses()
+{
+    GraphicView* pGView = dynamic_cast<GraphicView*>(m_pView);
+    TileCache* pCache = (pGView ? pGView->get_tile_cache() : nullptr);
+    return (pCache ? pCache->get_num_misses() : 0L);
+}
+
+//---------------------------------------------------------------------------------------
+size_t Interactor::get_tile_cache_memory()
+{
+    GraphicView* pGView = dynamic_cast<GraphicView*>(m_pView);
+    TileCache* pCache = (pGView ? pGView->get_tile_cache() : nullptr);
+    return (pCache ? pCache->get_memory_used() : 0);
+}
+
+//---------------------------------------------------------------------------------------
+void Interactor::reset_tile_cache_statistics()
+{
+    GraphicView* pGView = dynamic_cast<GraphicView*>(m_pView);
+    TileCache* pCache = (pGView ? pGView->get_tile_cache() : nullptr);
+    if (pCache)
+        pCache->reset_statistics();
+}
+
 //---------------------------------------------------------------------------------------
 void Interactor::set_box_to_draw(int boxType)
 {
@@ -1588,6 +1684,16 @@ int Interactor::get_num_pages()
         return 0;
 }
 
+//---------------------------------------------------------------------------------------
+bool Interactor::page_exists(int page)
+{
+    //AWARE: with lazy layout only the pages up to the requested one are laid out.
+    //With background layout, only the pages already published exist
+
+    GraphicModel* pGModel = get_graphic_model();
+    return pGModel && pGModel->get_page(page) != nullptr;
+}
+
 //---------------------------------------------------------------------------------------
 void Interactor::render_as_svg(std::ostream& svg, int page)
 {
@@ -1595,7 +1701,7 @@ void Interactor::render_as_svg(std::ostream& svg, int page)
     if (pGView)
     {
         //ensure page is always valid
-        if (page < 0 || page > get_num_pages() - 1)
+        if (!page_exists(page))
             page = 0;
 
         //determine the GM viewport
@@ -1616,6 +1722,32 @@ void Interactor::render_as_svg(std::ostream& svg, int page)
     }
 }
 
+//---------------------------------------------------------------------------------------
+void Interactor::render_as_svg(std::ostream& svg, int page, const URect& region)
+{
+    GraphicView* pGView = dynamic_cast<GraphicView*>(m_pView);
+    if (pGView)
+    {
+        //ensure page is always valid
+        if (!page_exists(page))
+            page = 0;
+
+        //add <svg> element with the region as viewport
+        svg << "<svg xmlns='http://www.w3.org/2000/svg' version='1.1' viewBox='"
+            << region.x << " " << region.y << " "
+            << region.width << " " << region.height << "'>";
+        if (m_svgOptions.add_newlines)
+            svg << endl;
+
+        //render the region
+        SvgDrawer drawer(m_libScope, svg, m_svgOptions);
+        pGView->render_as_svg(drawer, page, region);
+
+        //terminate svg element
+        svg << "</svg>";
+    }
+}
+
 //---------------------------------------------------------------------------------------
 void Interactor::set_svg_canvas_width(Pixels x)
 {
@@ -1943,6 +2075,20 @@ void Interactor::timing_graphic_model_build_end()
     m_elapsedTimes[k_timing_gmodel_build_time] = double( diff );
 }
 
+//---------------------------------------------------------------------------------------
+int Interactor::get_num_drawn_objects()
+{
+    GraphicView* pGView = dynamic_cast<GraphicView*>(m_pView);
+    return (pGView ? pGView->get_num_drawn_objects() : 0);
+}
+
+//---------------------------------------------------------------------------------------
+int Interactor::get_num_culled_objects()
+{
+    GraphicView* pGView = dynamic_cast<GraphicView*>(m_pView);
+    return (pGView ? pGView->get_num_culled_objects() : 0);
+}
+
 //---------------------------------------------------------------------------------------
 void Interactor::timing_graphic_model_render_end()
 {
@@ -2131,6 +2277,7 @@ void Interactor::set_drag_image(GmoShape* pShape, bool fGetOwnership, UPoint off
 //---------------------------------------------------------------------------------------
 void Interactor::exec_command(DocCommand* pCmd)
 {
+    discard_pending_layout();
     m_pExec->execute(m_pCursor, pCmd, m_pSelections);
     update_caret_and_view();
     send_update_UI_event(k_pointed_object_change);
@@ -2139,6 +2286,7 @@ void Interactor::exec_command(DocCommand* pCmd)
 //---------------------------------------------------------------------------------------
 void Interactor::exec_undo()
 {
+    discard_pending_layout();
     m_pExec->undo(m_pCursor, m_pSelections);
     update_caret_and_view();
     send_update_UI_event(k_pointed_object_change);
@@ -2147,11 +2295,26 @@ void Interactor::exec_undo()
 //---------------------------------------------------------------------------------------
 void Interactor::exec_redo()
 {
+    discard_pending_layout();
     m_pExec->redo(m_pCursor, m_pSelections);
     update_caret_and_view();
     send_update_UI_event(k_pointed_object_change);
 }
 
+//---------------------------------------------------------------------------------------
+void Interactor::discard_pending_layout()
+{
+    //AWARE: pending pages can not be laid out after modifying the document.
+    //A pending layout, lazy or in background, is not finished but discarded: the
+    //graphic model will be created again after the edition
+
+    if (m_pGraphicModel && (m_pGraphicModel->is_background_layout_running()
+                            || !m_pGraphicModel->is_layout_finished()) )
+    {
+        delete_graphic_model();
+    }
+}
+
 //---------------------------------------------------------------------------------------
 void Interactor::update_caret_and_view()
 {
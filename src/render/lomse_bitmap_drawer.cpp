@@ -273,6 +273,7 @@ BitmapDrawer::BitmapDrawer(LibraryScope& libraryScope)
 //    , m_pTextMeter(nullptr)
     , m_pCalligrapher( LOMSE_NEW Calligrapher(m_pFonts, m_pRenderer) )
     , m_numPaths(0)
+    , m_fDefaultAttr(false)
     , m_rbuf(nullptr, 0, 0, 0)
     , m_pBuf(nullptr)
 {
@@ -309,8 +310,12 @@ void BitmapDrawer::delete_paths()
 void BitmapDrawer::begin_path()
 {
     unsigned idx = m_path.start_new_path();
-    m_attr_storage.add( m_numPaths==0 ? PathAttributes(idx) : PathAttributes(cur_attr(), idx) );
+    if (m_numPaths == 0 || m_fDefaultAttr)
+        m_attr_storage.add( PathAttributes(idx) );
+    else
+        m_attr_storage.add( PathAttributes(cur_attr(), idx) );
     m_numPaths++;
+    m_fDefaultAttr = false;
 }
 
 //---------------------------------------------------------------------------------------
@@ -76,6 +76,14 @@ FontStorage::~FontStorage()
 bool FontStorage::set_font(const std::string& fontFullName, double height,
                            EFontCacheType type)
 {
+    //nothing to do if the font is already selected. Selecting the font again is
+    //expensive and layouters select the same font for every glyph they measure
+    if (m_fValidFont && type == m_fontCacheType && fontFullName == m_fontFullName
+        && height == m_fontHeight && height == m_fontWidth)
+    {
+        return false;
+    }
+
     m_fValidFont = false;
     lomse::glyph_rendering gren = lomse::glyph_ren_agg_gray8;
     if(! m_fontEngine.select_font(fontFullName, 0, gren))
@@ -0,0 +1,209 @@
+//---------------------------------------------------------------------------------------
+// This file is part of the Lomse library.
+// Copyright (c) 2010-present, Lomse Developers
+//
+// Licensed under the MIT license.
+//
+// See LICENSE and NOTICE.md files in the root directory of this source tree.
+//---------------------------------------------------------------------------------------
+
+#include "lomse_tile_cache.h"
+
+#include "lomse_drawer.h"
+#include "lomse_graphical_model.h"
+#include "lomse_renderer.h"
+
+#include <cstring>
+#include <sstream>
+
+namespace lomse
+{
+
+//=======================================================================================
+// TileCache implementation
+//=======================================================================================
+TileCache::TileCache(LibraryScope& libraryScope, size_t maxMemory)
+    : m_libraryScope(libraryScope)
+    , m_bytesPerPixel( Renderer::bytesPerPixel(libraryScope.get_pixel_format()) )
+    , m_maxMemory(maxMemory)
+{
+}
+
+//---------------------------------------------------------------------------------------
+TileCache::~TileCache()
+{
+    invalidate();
+}
+
+//---------------------------------------------------------------------------------------
+void TileCache::validate(GraphicModel* pGModel, RenderOptions& opt,
+                         const std::list<URect>& pageBounds)
+{
+    //discard all tiles if they were rendered from other graphic model, from a
+    //modified graphic model, with other rendering options or with other page
+    //bounds. Otherwise, discard the tiles of the pages laid out after the tiles
+    //were rendered, as these pages were rendered as blank pages
+
+    long modelId = (pGModel ? pGModel->get_model_id() : -1L);
+    long changes = (pGModel ? pGModel->get_num_changes() : -1L);
+    int numPages = (pGModel ? pGModel->get_num_laid_out_pages() : 0);
+    std::string options = options_signature(opt);
+
+    if (modelId != m_modelId || changes != m_modelChanges || options != m_options
+        || pageBounds != m_pageBounds || numPages < m_numLaidOutPages)
+    {
+        invalidate();
+        m_modelId = modelId;
+        m_modelChanges = changes;
+        m_options = options;
+        m_pageBounds = pageBounds;
+    }
+    else if (numPages > m_numLaidOutPages)
+    {
+        std::list<URect>::const_iterator it = pageBounds.begin();
+        for (int i=0; it != pageBounds.end() && i < numPages; ++it, ++i)
+        {
+            if (i >= m_numLaidOutPages)
+                invalidate(*it);
+        }
+    }
+    m_numLaidOutPages = numPages;
+}
+
+//---------------------------------------------------------------------------------------
+std::string TileCache::options_signature(RenderOptions& opt)
+{
+    //options affecting the rendering of the graphic model
+
+    std::stringstream ss;
+    ss << opt.boxes.to_string()
+       << opt.draw_anchor_objects << opt.draw_anchor_lines << opt.draw_shape_bounds
+       << opt.draw_slur_points << opt.draw_vertical_profile << opt.draw_chords_coloured
+       << opt.draw_voices_coloured << opt.read_only_mode
+       << "," << opt.highlighted_voice
+       << "," << int(opt.background_color.r) << "," << int(opt.background_color.g)
+       << "," << int(opt.background_color.b) << "," << int(opt.background_color.a);
+    return ss.str();
+}
+
+//---------------------------------------------------------------------------------------
+RasterTile* TileCache::find_tile(double scale, int col, int row)
+{
+    std::map<TileKey, TilesList::iterator>::iterator it =
+                                        m_index.find( TileKey(scale, col, row) );
+    if (it == m_index.end())
+    {
+        ++m_numMisses;
+        return nullptr;
+    }
+
+    ++m_numHits;
+
+    //move to front of the list (most recently used)
+    m_tiles.splice(m_tiles.begin(), m_tiles, it->second);
+    return *(it->second);
+}
+
+//---------------------------------------------------------------------------------------
+RasterTile* TileCache::create_tile(double scale, int col, int row)
+{
+    //creates a new tile, with an uninitialized bitmap. If the memory limit is
+    //exceeded the least recently used tiles are deleted.
+
+    RasterTile* pTile = LOMSE_NEW RasterTile(scale, col, row);
+    int stride = m_bytesPerPixel * k_tile_bitmap_size;
+    pTile->pixels.resize(size_t(stride) * size_t(k_tile_bitmap_size));
+    pTile->rbuf.attach(&pTile->pixels[0], k_tile_bitmap_size, k_tile_bitmap_size,
+                       stride);
+
+    m_tiles.push_front(pTile);
+    m_index[ TileKey(scale, col, row) ] = m_tiles.begin();
+    m_usedMemory += pTile->pixels.size();
+
+    enforce_memory_limit();
+    return pTile;
+}
+
+//---------------------------------------------------------------------------------------
+void TileCache::copy_tile_to(RasterTile* pTile, RenderingBuffer& dest,
+                             int xDest, int yDest)
+{
+    //copy the tile bitmap onto the destination buffer, with its top-left corner at
+    //point (xDest, yDest). The parts out of the buffer are ignored.
+
+    int xStart = max(0, -xDest);
+    int yStart = max(0, -yDest);
+    int xEnd = min(int(k_tile_size), int(dest.width()) - xDest);
+    int yEnd = min(int(k_tile_size), int(dest.height()) - yDest);
+    if (xStart >= xEnd || yStart >= yEnd)
+        return;
+
+    size_t bytes = size_t(xEnd - xStart) * size_t(m_bytesPerPixel);
+    for (int y = yStart; y < yEnd; ++y)
+    {
+        memcpy(dest.row_ptr(yDest + y) + (xDest + xStart) * m_bytesPerPixel,
+               pTile->rbuf.row_ptr(y) + xStart * m_bytesPerPixel,
+               bytes);
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void TileCache::invalidate()
+{
+    TilesList::iterator it;
+    for (it = m_tiles.begin(); it != m_tiles.end(); ++it)
+        delete *it;
+
+    m_tiles.clear();
+    m_index.clear();
+    m_usedMemory = 0;
+}
+
+//---------------------------------------------------------------------------------------
+void TileCache::invalidate(const URect& area)
+{
+    //discard tiles intersecting the area, in view logical units
+
+    TilesList::iterator it = m_tiles.begin();
+    while (it != m_tiles.end())
+    {
+        URect& bounds = (*it)->bounds;
+        if (bounds.left() <= area.right() && bounds.right() >= area.left()
+            && bounds.top() <= area.bottom() && bounds.bottom() >= area.top())
+        {
+            TilesList::iterator itDel = it++;
+            delete_tile(itDel);
+        }
+        else
+            ++it;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+void TileCache::set_max_memory(size_t bytes)
+{
+    m_maxMemory = bytes;
+    enforce_memory_limit();
+}
+
+//---------------------------------------------------------------------------------------
+void TileCache::enforce_memory_limit()
+{
+    //delete least recently used tiles, but never the most recent one
+
+    while (m_usedMemory > m_maxMemory && m_tiles.size() > 1)
+        delete_tile(--m_tiles.end());
+}
+
+//---------------------------------------------------------------------------------------
+void TileCache::delete_tile(TilesList::iterator it)
+{
+    RasterTile* pTile = *it;
+    m_index.erase( TileKey(pTile->scale, pTile->col, pTile->row) );
+    m_usedMemory -= pTile->pixels.size();
+    m_tiles.erase(it);
+    delete pTile;
+}
+
+
+}  //namespace lomse
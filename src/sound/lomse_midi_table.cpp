@@ -28,11 +28,20 @@ namespace lomse
 // SoundEventsTable: Manager for the events table
 //
 //    There are two tables to maintain:
-//    - m_events (std::vector<SoundEvent*>):
-//        Contains the MIDI events.
+//    - m_events (std::vector<SoundEvent>):
+//        Contains the MIDI events. Events are stored by value, in a single block of
+//        memory, to avoid one allocation per event.
 //    - m_measures (std::vector<int>):
 //        Contains the index over m_events for the first event of each measure.
 //
+//    Once the table is sorted, some indexes are created for fast positioning
+//    (binary search) when playback does not start at the beginning:
+//    - m_times: the time of each event, in the same order than m_events.
+//    - m_seekMeasures: index over m_events for the first event at or after the
+//        start of each measure. Unlike m_measures, empty measures point to the first
+//        event of the next non-empty measure.
+//    - m_rhythms: index over m_events for the time signature changes.
+//
 //    AWARE
 //    Measures are numbered 1..n (musicians usual way) not 0..n-1. But tables
 //    go 0..n+1 :
@@ -65,9 +74,10 @@ SoundEventsTable::~SoundEventsTable()
 //---------------------------------------------------------------------------------------
 void SoundEventsTable::delete_events_table()
 {
-    for (auto it : m_events)
-        delete it;
     m_events.clear();
+    m_times.clear();
+    m_seekMeasures.clear();
+    m_rhythms.clear();
 }
 
 //---------------------------------------------------------------------------------------
@@ -94,6 +104,7 @@ void SoundEventsTable::create_table()
     sort_by_time();
     close_table();
     create_measures_table();
+    create_seek_index();
     replace_label_in_jumps();
     add_events_to_jumps();
 }
@@ -336,17 +347,15 @@ void SoundEventsTable::store_event(TimeUnits rTime, int eventType, int channel,
                                    MidiPitch pitch, int volume, int step,
                                    ImoStaffObj* pSO, int measure)
 {
-    SoundEvent* pEvent = LOMSE_NEW SoundEvent(rTime, eventType, channel, pitch,
-                                              volume, step, pSO, measure);
-    m_events.push_back(pEvent);
+    m_events.push_back( SoundEvent(rTime, eventType, channel, pitch, volume, step,
+                                   pSO, measure) );
     m_numMeasures = max(m_numMeasures, measure);
 }
 
 //---------------------------------------------------------------------------------------
 void SoundEventsTable::store_jump_event(TimeUnits rTime, JumpEntry* pJump, int measure)
 {
-    SoundEvent* pEvent = LOMSE_NEW SoundEvent(rTime, SoundEvent::k_jump, pJump, measure);
-    m_events.push_back(pEvent);
+    m_events.push_back( SoundEvent(rTime, SoundEvent::k_jump, pJump, measure) );
     m_numMeasures = max(m_numMeasures, measure);
 }
 
@@ -451,7 +460,7 @@ void SoundEventsTable::close_table()
 {
     TimeUnits maxTime = 0.0;
     if (m_events.size() > 0)
-        maxTime = TimeUnits(m_events.back()->DeltaTime);
+        maxTime = TimeUnits(m_events.back().DeltaTime);
     store_event(maxTime, SoundEvent::k_end_of_score, 0, 0, 0, 0, nullptr, 0);
 }
 
@@ -465,10 +474,10 @@ void SoundEventsTable::create_measures_table()
 
     for (int i=0; i < int(m_events.size()); i++)
     {
-        if (m_measures[m_events[i]->Measure] == -1)
+        if (m_measures[m_events[i].Measure] == -1)
         {
             //Add index to the table
-            m_measures[m_events[i]->Measure] = i;
+            m_measures[m_events[i].Measure] = i;
         }
     }
 
@@ -478,41 +487,137 @@ void SoundEventsTable::create_measures_table()
 }
 
 //---------------------------------------------------------------------------------------
-void SoundEventsTable::sort_by_time()
+void SoundEventsTable::create_seek_index()
 {
-    // Sort events by time, measure and event type. Uses the bubble sort algorithm
-
-    int j, k;
-    bool fChanges;
-    int nNumElements = int(m_events.size());
-    SoundEvent* pEvAux;
+    int numEvents = int(m_events.size());
+    m_times.clear();
+    m_times.reserve(numEvents);
+    m_rhythms.clear();
+    for (int i=0; i < numEvents; ++i)
+    {
+        m_times.push_back(m_events[i].DeltaTime);
+        if (m_events[i].EventType == SoundEvent::k_rhythm_change)
+            m_rhythms.push_back(i);
+    }
 
-    for (int i = 0; i < nNumElements; i++)
+    //backwards, so that empty measures inherit the first event of next measure
+    int numEntries = int(m_measures.size());
+    m_seekMeasures.assign(numEntries, -1);
+    int next = -1;
+    for (int i=numEntries-1; i >= 0; --i)
     {
-        fChanges = false;
-        j = nNumElements - 1;
+        if (m_measures[i] != -1)
+            next = m_measures[i];
+        m_seekMeasures[i] = next;
+    }
+}
 
-        while ( j != i )
-        {
-            k = j - 1;
-            if ((m_events[j]->DeltaTime < m_events[k]->DeltaTime) ||
-                ((m_events[j]->DeltaTime == m_events[k]->DeltaTime) &&
-                 ((m_events[j]->Measure < m_events[k]->Measure) ||
-                  (m_events[j]->EventType < m_events[k]->EventType))))
-            {
-                //interchange elements
-                pEvAux = m_events[j];
-                m_events[j] = m_events[k];
-                m_events[k] = pEvAux;
-                fChanges = true;
-            }
-            j = k;
-        }
+//---------------------------------------------------------------------------------------
+int SoundEventsTable::find_event_for_measure(int nMeasure)
+{
+    //Returns the index to the first event of measure nMeasure (1..n) or, if the measure
+    //is empty, the first event of next non-empty measure. Returns -1 if there are
+    //no more events but the end of score event.
+
+    if (nMeasure < 0 || nMeasure > m_numMeasures)
+        return -1;
 
-        //If there were no changes in this loop step it implies that the table is ordered;
-        //in this case exit loop to save time
-        if (!fChanges) break;
+    int i = m_seekMeasures[nMeasure];
+    return (i == get_last_event() ? -1 : i);
+}
+
+//---------------------------------------------------------------------------------------
+int SoundEventsTable::find_event_for_timepos(TimeUnits timepos)
+{
+    //Returns the index to the first event at time >= timepos
+
+    long time = long(timepos + 0.5);
+    std::vector<long>::iterator it = std::lower_bound(m_times.begin(), m_times.end(),
+                                                      time);
+    int i = int(it - m_times.begin());
+    return (i >= get_last_event() ? -1 : i);
+}
+
+//---------------------------------------------------------------------------------------
+int SoundEventsTable::find_event_for_beat(int nMeasure, int nBeat)
+{
+    //Returns the index to the first event at or after beat nBeat (0..n-1) of measure
+    //nMeasure (1..n). Beat duration is taken from the time signature in effect at
+    //the start of the measure. Default beat duration is a quarter note.
+
+    if (nMeasure < 1 || nMeasure > m_numMeasures || nBeat < 0)
+        return -1;
+
+    int iStart = m_measures[nMeasure];
+    if (iStart == -1)
+        return find_event_for_measure(nMeasure);
+
+    long start = m_times[iStart];
+    long beatDuration = long(k_duration_quarter);
+    int iTS = find_rhythm_change_at(start);
+    if (iTS >= 0 && m_events[iTS].NumPulses > 0)
+    {
+        SoundEvent& ev = m_events[iTS];
+        beatDuration = long(ev.TopNumber) * long(ev.BeatDuration) / long(ev.NumPulses);
     }
+
+    int i = find_event_for_timepos(TimeUnits(start + long(nBeat) * beatDuration));
+    return (i >= iStart ? i : -1);
+}
+
+//---------------------------------------------------------------------------------------
+int SoundEventsTable::find_rhythm_change_at(long time)
+{
+    //Returns the index to the last k_rhythm_change event at or before time, or
+    //-1 if none
+
+    std::vector<int>::iterator it =
+        std::upper_bound(m_rhythms.begin(), m_rhythms.end(), time,
+                         [this](long t, int i) { return t < m_events[i].DeltaTime; });
+    if (it == m_rhythms.begin())
+        return -1;
+    return *(--it);
+}
+
+//---------------------------------------------------------------------------------------
+size_t SoundEventsTable::memory_footprint()
+{
+    size_t bytes = sizeof(SoundEventsTable);
+    bytes += m_events.capacity() * sizeof(SoundEvent);
+    bytes += m_times.capacity() * sizeof(long);
+    bytes += (m_measures.capacity() + m_seekMeasures.capacity() + m_rhythms.capacity()
+              + m_channels.capacity() + m_semitones.capacity()) * sizeof(int);
+    bytes += m_jumps.capacity() * (sizeof(JumpEntry*) + sizeof(JumpEntry));
+    bytes += m_measuresJumps.capacity()
+             * (sizeof(MeasuresJumpsEntry*) + sizeof(MeasuresJumpsEntry));
+    return bytes;
+}
+
+//---------------------------------------------------------------------------------------
+void SoundEventsTable::sort_by_time()
+{
+    // Sort events by time, measure and event type. At the same time, sound and
+    // visual off events go first, whatever their measure is, so that a note
+    // ending in one instrument is not sounding when a note starts in other
+    // instrument in which a different measure has started (multimetric scores).
+    // The sort must be stable, to preserve creation order of events with equal keys
+
+    std::stable_sort(m_events.begin(), m_events.end(),
+                     [](const SoundEvent& a, const SoundEvent& b)
+                     {
+                        if (a.DeltaTime != b.DeltaTime)
+                            return a.DeltaTime < b.DeltaTime;
+
+                        bool fOffA = a.EventType == SoundEvent::k_note_off
+                                     || a.EventType == SoundEvent::k_visual_off;
+                        bool fOffB = b.EventType == SoundEvent::k_note_off
+                                     || b.EventType == SoundEvent::k_visual_off;
+                        if (fOffA != fOffB)
+                            return fOffA;
+                        if (a.Measure != b.Measure)
+                            return a.Measure < b.Measure;
+                        return a.EventType < b.EventType;
+                     });
 }
 
 //---------------------------------------------------------------------------------------
@@ -541,7 +646,7 @@ string SoundEventsTable::dump_events_table()
             }
 
             //list current entry
-            SoundEvent* pSE = m_events[i];
+            SoundEvent* pSE = &m_events[i];
             msg << i << ":\t" << pSE->DeltaTime << "\t\t" << pSE->Channel << "\t"
                 << pSE->Measure << "\t";
 
@@ -606,7 +711,7 @@ string SoundEventsTable::dump_measures_table()
         int nEntry = m_measures[i];
         if (nEntry >= 0)
         {
-            SoundEvent* pSE = m_events[nEntry];
+            SoundEvent* pSE = &m_events[nEntry];
             msg << i << ":\t" << pSE->DeltaTime << "\t" << nEntry << "\n";
         }
         else
@@ -735,41 +840,41 @@ vector<MeasuresJumpsEntry*> SoundEventsTable::get_measures_jumps()
 
     //Execute control m_events that take place before firts play event
     size_t i = 0;
-    while ((m_events[i]->EventType == SoundEvent::k_prog_instr)
-           || (m_events[i]->EventType == SoundEvent::k_rhythm_change) )
+    while ((m_events[i].EventType == SoundEvent::k_prog_instr)
+           || (m_events[i].EventType == SoundEvent::k_rhythm_change) )
     {
         ++i;
     }
 
     //Here i points to the first event to play
     //loop to process m_events
-    int fromMeasure = m_events[i]->Measure;
-    TimeUnits fromTime = TimeUnits(m_events[i]->DeltaTime);
+    int fromMeasure = m_events[i].Measure;
+    TimeUnits fromTime = TimeUnits(m_events[i].DeltaTime);
     do
     {
         //if it is a jump event, execute the jump if applicable
-        if (m_events[i]->EventType == SoundEvent::k_jump)
+        if (m_events[i].EventType == SoundEvent::k_jump)
         {
             bool fExecuted = false;
-            JumpEntry* pJump = m_events[i]->pJump;
+            JumpEntry* pJump = m_events[i].pJump;
             if (pJump->get_visited() >= pJump->get_times_before())
             {
                 if (pJump->get_times_valid() == 0
                     || pJump->get_times_valid() > pJump->get_executed())
                 {
                     int iCur = i;
-                    long curTime =  m_events[iCur]->DeltaTime;     //the jmp entry time
+                    long curTime =  m_events[iCur].DeltaTime;     //the jmp entry time
                     i = pJump->get_event();
-                    TimeUnits jmpTime = TimeUnits(m_events[i]->DeltaTime);
+                    TimeUnits jmpTime = TimeUnits(m_events[i].DeltaTime);
                     if (pJump->get_times_valid() > pJump->get_executed())
                         pJump->increment_applied();
 
                     //find previous timepos (cur timepos is jmp entry timepos,
                     //that is, barline timepos, the start of next measure timepos)
                     int j=iCur;
-                    while (j > 0 && m_events[j]->DeltaTime == curTime)
+                    while (j > 0 && m_events[j].DeltaTime == curTime)
                         --j;
-                    curTime = m_events[j]->DeltaTime;
+                    curTime = m_events[j].DeltaTime;
 
                     //create the entry
                     m_measuresJumps.push_back(
@@ -798,7 +903,7 @@ vector<MeasuresJumpsEntry*> SoundEventsTable::get_measures_jumps()
 
     if (fromMeasure != -1)      //-1 = it finished before last measure (e.g. 'Fine' mark)
     {
-        TimeUnits curTime = TimeUnits(m_events[maxEvent-2]->DeltaTime);
+        TimeUnits curTime = TimeUnits(m_events[maxEvent-2].DeltaTime);
         m_measuresJumps.push_back(
             LOMSE_NEW MeasuresJumpsEntry(fromMeasure, fromTime, 0, curTime,       //0 = end of score
                                          int(maxEvent-2), curTime) );
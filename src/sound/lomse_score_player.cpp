@@ -24,13 +24,410 @@
 #include "lomse_im_note.h"
 
 #include <algorithm>    //max(), min()
-#include <ctime>        //clock()
+#include <cmath>        //fabs()
 
 
 namespace lomse
 {
 
+//=======================================================================================
+// PlaybackScheduler implementation
+//=======================================================================================
+PlaybackScheduler::PlaybackScheduler()
+    : m_origin( Clock::now() )
+    , m_pauseStart( m_origin )
+    , m_pauseTime(0.0)
+    , m_spin( Clock::duration::zero() )
+    , m_fPaused(false)
+    , m_fStop(false)
+    , m_totalJitter(0.0)
+{
+}
+
+//---------------------------------------------------------------------------------------
+void PlaybackScheduler::reset()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_fPaused = false;
+    m_fStop = false;
+    m_stats = PlaybackTimingStats();
+    m_totalJitter = 0.0;
+}
+
+//---------------------------------------------------------------------------------------
+void PlaybackScheduler::start(double time)
+{
+    //current real time is playback time 'time' (milliseconds)
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_origin = Clock::now() - std::chrono::duration_cast<Clock::duration>(
+                                    std::chrono::duration<double, std::milli>(time) );
+}
+
+//---------------------------------------------------------------------------------------
+void PlaybackScheduler::rebase(double oldTime, double newTime)
+{
+    //playback time changes without real time elapsing (i.e., a jump or a tempo
+    //change). Shift the origin so that the deadline for oldTime is now the
+    //deadline for newTime
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_origin += std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double, std::milli>(oldTime - newTime) );
+}
+
+//---------------------------------------------------------------------------------------
+PlaybackScheduler::Clock::time_point PlaybackScheduler::to_deadline(double time)
+{
+    return m_origin + std::chrono::duration_cast<Clock::duration>(
+                            std::chrono::duration<double, std::milli>(time) );
+}
+
+//---------------------------------------------------------------------------------------
+bool PlaybackScheduler::wait_until(double time, bool* pPaused)
+{
+    //Wait until playback time 'time' (milliseconds) arrives. Returns false if the
+    //wait was interrupted by a stop request.
+    //When pPaused is not nullptr, the wait also finishes, returning true and with
+    //*pPaused set to true, when playback is paused, so that the caller can take
+    //actions before waiting for resume.
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        if (m_fStop)
+            return false;
+        if (m_fPaused)
+        {
+            if (pPaused)
+            {
+                *pPaused = true;
+                return true;
+            }
+            wait_for_resume(lock);
+            continue;
+        }
+
+        Clock::time_point deadline = to_deadline(time);
+        if (m_wakeUp.wait_until(lock, deadline - m_spin,
+                                [this]{ return m_fStop || m_fPaused; }) )
+        {
+            continue;   //paused or stopped while waiting
+        }
+
+        lock.unlock();
+        Clock::time_point now = Clock::now();
+        while (now < deadline)
+            now = Clock::now();
+        lock.lock();
+
+        add_deviation(deadline, now);
+        return true;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+bool PlaybackScheduler::wait_while_paused()
+{
+    //Returns false if stop requested
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_fPaused && !m_fStop)
+        wait_for_resume(lock);
+    return !m_fStop;
+}
+
+//---------------------------------------------------------------------------------------
+bool PlaybackScheduler::is_paused()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_fPaused;
+}
+
+//---------------------------------------------------------------------------------------
+double PlaybackScheduler::get_pause_time()
+{
+    //playback time at which current pause started
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_pauseTime;
+}
+
+//---------------------------------------------------------------------------------------
+void PlaybackScheduler::wait_for_resume(std::unique_lock<std::mutex>& lock)
+{
+    m_wakeUp.wait(lock, [this]{ return m_fStop || !m_fPaused; });
+}
+
+//---------------------------------------------------------------------------------------
+void PlaybackScheduler::pause()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_fPaused)
+            return;
+        m_fPaused = true;
+        m_pauseStart = Clock::now();
+        m_pauseTime = std::chrono::duration<double, std::milli>(
+                                                m_pauseStart - m_origin ).count();
+    }
+    m_wakeUp.notify_all();
+}
+
+//---------------------------------------------------------------------------------------
+void PlaybackScheduler::resume()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_fPaused)
+            return;
+        m_fPaused = false;
+        m_origin += Clock::now() - m_pauseStart;    //pause time does not count
+    }
+    m_wakeUp.notify_all();
+}
+
+//---------------------------------------------------------------------------------------
+void PlaybackScheduler::request_stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_fStop = true;
+    }
+    m_wakeUp.notify_all();
+}
+
+//---------------------------------------------------------------------------------------
+void PlaybackScheduler::set_spin_time(long microseconds)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_spin = std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::microseconds( max(0L, microseconds) ));
+}
+
+//---------------------------------------------------------------------------------------
+long PlaybackScheduler::get_spin_time()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return long( std::chrono::duration_cast<std::chrono::microseconds>(m_spin).count() );
+}
+
+//---------------------------------------------------------------------------------------
+void PlaybackScheduler::add_deviation(Clock::time_point deadline, Clock::time_point now)
+{
+    double deviation = std::chrono::duration<double, std::micro>(now - deadline).count();
+
+    ++m_stats.numEvents;
+    m_totalJitter += fabs(deviation);
+    m_stats.meanJitter = m_totalJitter / double(m_stats.numEvents);
+    m_stats.maxJitter = max(m_stats.maxJitter, fabs(deviation));
+    m_stats.lastDeviation = deviation;
+}
+
+//---------------------------------------------------------------------------------------
+PlaybackTimingStats PlaybackScheduler::get_statistics()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+//---------------------------------------------------------------------------------------
+PlaybackScheduler::Clock::time_point PlaybackScheduler::get_deadline(double time)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return to_deadline(time);
+}
+
+
+//=======================================================================================
+// MidiServerBase implementation
+//=======================================================================================
+void MidiServerBase::events(const SoundEventBatch& batch)
+{
+    //default adapter: invoke the per-event methods
+
+    for (const BatchedMidiEvent& ev : batch.events)
+    {
+        switch (ev.type)
+        {
+            case BatchedMidiEvent::k_note_on:
+                note_on(ev.channel, ev.data1, ev.data2);
+                break;
+            case BatchedMidiEvent::k_note_off:
+                note_off(ev.channel, ev.data1, ev.data2);
+                break;
+            case BatchedMidiEvent::k_voice_change:
+                voice_change(ev.channel, ev.data1);
+                break;
+            case BatchedMidiEvent::k_program_change:
+                program_change(ev.channel, ev.data1);
+                break;
+            case BatchedMidiEvent::k_all_sounds_off:
+                all_sounds_off();
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+
+//=======================================================================================
+// SoundEventQueue implementation
+//  Classic ring buffer with one empty slot for distinguishing full from empty. Only
+//  the producer writes m_tail and only the consumer writes m_head. Release/acquire
+//  ordering ensures that slot contents are visible before the index that
+//  publishes them.
+//=======================================================================================
+SoundEventQueue::SoundEventQueue(size_t capacity)
+    : m_slots( max(capacity, size_t(1)) + 1 )
+    , m_head(0)
+    , m_tail(0)
+    , m_numDropped(0L)
+    , m_flushTail(0)
+    , m_fFlush(false)
+{
+    m_allSoundsOff.add(BatchedMidiEvent::k_all_sounds_off, 0, 0, 0);
+}
+
+//---------------------------------------------------------------------------------------
+bool SoundEventQueue::push(const SoundEventBatch& batch)
+{
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    size_t next = (tail + 1) % m_slots.size();
+    if (next == m_head.load(std::memory_order_acquire))
+    {
+        ++m_numDropped;
+        return false;
+    }
+
+    //copy into existing slot, reusing its capacity
+    SoundEventBatch& slot = m_slots[tail];
+    slot.timestamp = batch.timestamp;
+    slot.playbackTime = batch.playbackTime;
+    slot.events.assign(batch.events.begin(), batch.events.end());
+
+    m_tail.store(next, std::memory_order_release);
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+void SoundEventQueue::request_flush()
+{
+    //Only the consumer can remove batches. The producer just saves the position of
+    //its last batch and the consumer will discard all batches up to it. Batches
+    //pushed after this request are not affected. As slots are not modified, it is
+    //safe to invoke it from other thread than the producer
+
+    m_flushTail.store(m_tail.load(std::memory_order_acquire), std::memory_order_relaxed);
+    m_fFlush.store(true, std::memory_order_release);
+}
+
+//---------------------------------------------------------------------------------------
+bool SoundEventQueue::pop(SoundEventBatch& batch)
+{
+    if (m_fFlush.exchange(false, std::memory_order_acquire))
+    {
+        //AWARE: the flush could have been requested while the consumer was in a
+        //previous pop(), after checking m_fFlush. That pop() could have removed the
+        //batch at m_flushTail, pushed after the request. Therefore, the head is only
+        //moved forward: when m_flushTail is between head and tail
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t flushTail = m_flushTail.load(std::memory_order_relaxed);
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        size_t numSlots = m_slots.size();
+        size_t toFlushTail = (flushTail + numSlots - head) % numSlots;
+        size_t toTail = (tail + numSlots - head) % numSlots;
+        if (toFlushTail <= toTail)
+            m_head.store(flushTail, std::memory_order_release);
+
+        batch.timestamp = std::chrono::steady_clock::now();
+        batch.playbackTime = 0.0;
+        batch.events = m_allSoundsOff.events;
+        return true;
+    }
+
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire))
+        return false;
+
+    //swap, so that the slot keeps the capacity of the received batch
+    SoundEventBatch& slot = m_slots[head];
+    batch.timestamp = slot.timestamp;
+    batch.playbackTime = slot.playbackTime;
+    batch.events.swap(slot.events);
+    slot.events.clear();
+
+    m_head.store((head + 1) % m_slots.size(), std::memory_order_release);
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+const SoundEventBatch* SoundEventQueue::peek()
+{
+    if (m_fFlush.load(std::memory_order_acquire))
+    {
+        m_allSoundsOff.timestamp = std::chrono::steady_clock::now();
+        return &m_allSoundsOff;
+    }
+
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire))
+        return nullptr;
+    return &m_slots[head];
+}
+
+//---------------------------------------------------------------------------------------
+size_t SoundEventQueue::size()
+{
+    size_t head = m_head.load(std::memory_order_acquire);
+    size_t tail = m_tail.load(std::memory_order_acquire);
+    return (tail + m_slots.size() - head) % m_slots.size();
+}
+
+
+//=======================================================================================
+// QueuedMidiServer implementation
+//=======================================================================================
+void QueuedMidiServer::push_event(int type, int channel, int data1, int data2)
+{
+    //per-event requests, not generated by ScorePlayer, are enqueued as batches
+    //for current time
+
+    SoundEventBatch batch;
+    batch.timestamp = std::chrono::steady_clock::now();
+    batch.add(type, channel, data1, data2);
+    m_queue.push(batch);
+}
+
+//---------------------------------------------------------------------------------------
+void QueuedMidiServer::program_change(int channel, int instr)
+{
+    push_event(BatchedMidiEvent::k_program_change, channel, instr, 0);
+}
+
+//---------------------------------------------------------------------------------------
+void QueuedMidiServer::voice_change(int channel, int instr)
+{
+    push_event(BatchedMidiEvent::k_voice_change, channel, instr, 0);
+}
+
 //---------------------------------------------------------------------------------------
+void QueuedMidiServer::note_on(int channel, int pitch, int volume)
+{
+    push_event(BatchedMidiEvent::k_note_on, channel, pitch, volume);
+}
+
+//---------------------------------------------------------------------------------------
+void QueuedMidiServer::note_off(int channel, int pitch, int volume)
+{
+    push_event(BatchedMidiEvent::k_note_off, channel, pitch, volume);
+}
+
+
+//=======================================================================================
+// ScorePlayer implementation
+//=======================================================================================
 ScorePlayer::ScorePlayer(LibraryScope& libScope, MidiServerBase* pMidi)
     : m_libScope(libScope)
     , m_pThread(nullptr)
@@ -44,6 +441,7 @@ ScorePlayer::ScorePlayer(LibraryScope& libScope, MidiServerBase* pMidi)
     , m_fFinalEventSent(false)
     , m_pScore(nullptr)
     , m_pTable(nullptr)
+    , m_lookahead(0L)
     , m_MtrChannel(9)
     , m_MtrInstr(0)
     , m_MtrTone1(60)
@@ -135,17 +533,8 @@ void ScorePlayer::play_from_measure(int nMeasure, bool fVisualTracking,
     m_nMM = nMM;
     m_pInteractor = pInteractor;
 
-    //remember:
-    //   real measures 1..n correspond to table items 1..n
-    //   items 0 and n+1 are fictitius measures for pre and post control events
-    int nEvStart = m_pTable->get_first_event_for_measure(nMeasure);
-    int numMeasures = m_pTable->get_num_measures();
-    while (nEvStart == -1 && nMeasure < numMeasures)
-    {
-        //Current measure is empty. Start in next one
-        nEvStart = m_pTable->get_first_event_for_measure(++nMeasure);
-    }
-
+    //if measure is empty, playback starts in next non-empty one
+    int nEvStart = m_pTable->find_event_for_measure(nMeasure);
     if (nEvStart == -1)
         return;     //all measures are empty after selected one!
 
@@ -164,26 +553,21 @@ void ScorePlayer::play_measures(int startMeasure, int numMeasures, bool fVisualT
     m_nMM = nMM;
     m_pInteractor = pInteractor;
 
-    //remember:
-    //   real measures 1..n correspond to table items 1..n
-    //   items 0 and n+1 are fictitius measures for pre and post control events
-    int evStart = m_pTable->get_first_event_for_measure(startMeasure);
-    int maxMeasure = m_pTable->get_num_measures();
-    while (evStart == -1 && startMeasure < maxMeasure)
-    {
-        //Current measure is empty. Start in next one
-        evStart = m_pTable->get_first_event_for_measure(++startMeasure);
-    }
-
+    //if measure is empty, playback starts in next non-empty one
+    int evStart = m_pTable->find_event_for_measure(startMeasure);
     if (evStart == -1)
         return;     //all measures are empty after selected one!
 
+    startMeasure = m_pTable->get_event(evStart).Measure;
+    int maxMeasure = m_pTable->get_num_measures();
     int lastMeasure = min(startMeasure + numMeasures, maxMeasure+1);
-    int evEnd;
-    if (lastMeasure > maxMeasure)
+    int evEnd = -1;
+    if (lastMeasure <= maxMeasure)
+        evEnd = m_pTable->find_event_for_measure(lastMeasure);
+    if (evEnd == -1)
         evEnd = m_pTable->get_last_event();
     else
-        evEnd = m_pTable->get_first_event_for_measure(lastMeasure) - 1;
+        evEnd--;
 
     play_segment(evStart, evEnd);
 }
@@ -194,6 +578,8 @@ void ScorePlayer::play_segment(int nEvStart, int nEvEnd)
     LOMSE_LOG_DEBUG(Logger::k_score_player, ">>[ScorePlayer::play_segment]");
     m_fQuit = false;
     m_fFinalEventSent = false;
+    m_fPaused = false;
+    m_scheduler.reset();
 
     //Create a new thread. It starts immediately to execute do_play()
     m_pThread.reset();
@@ -261,9 +647,16 @@ void ScorePlayer::pause()
     m_fPaused = !m_fPaused;
 
     if (m_fPaused)
-        m_pMidi->all_sounds_off();
+    {
+        m_scheduler.pause();
+
+        //when sounds are sent ahead of time, the playback thread mutes the sounds,
+        //as it must also send again the events when resuming
+        if (m_lookahead == 0L)
+            m_pMidi->all_sounds_off();
+    }
     else
-        m_canPlay.notify_one();
+        m_scheduler.resume();
 }
 
 //---------------------------------------------------------------------------------------
@@ -275,6 +668,7 @@ void ScorePlayer::stop()
     {
         LOMSE_LOG_DEBUG(Logger::k_score_player, "Ending thread ...");
         m_fShouldStop = true;
+        m_scheduler.request_stop();
         m_pThread->join();
 
         m_pTable->reset_jumps();
@@ -292,6 +686,7 @@ void ScorePlayer::stop()
 
     m_fRunning = false;
     m_fShouldStop = false;
+    m_fPaused = false;
 
     LOMSE_LOG_DEBUG(Logger::k_score_player, "<< Exit");
 }
@@ -318,7 +713,7 @@ void ScorePlayer::do_play(int nEvStart, int nEvEnd, bool fVisualTracking,
 
     //TODO All issues related to sol-fa voice playback
 
-    std::vector<SoundEvent*>& events = m_pTable->get_events();
+    std::vector<SoundEvent>& events = m_pTable->get_events();
     if (events.size() == 0)
     {
         LOMSE_LOG_DEBUG(Logger::k_score_player, "<< Enter. No events to play. << Exit");
@@ -339,7 +734,10 @@ void ScorePlayer::do_play(int nEvStart, int nEvEnd, bool fVisualTracking,
 
     //Prepare instrument for metronome. Instruments for music voices
     //are prepared by events of type ProgInstr
-    m_pMidi->program_change(m_MtrChannel, m_MtrInstr);
+    m_batch.clear();
+    m_pendingTracking.clear();
+    m_sentBatches.clear();
+    add_sound_event(BatchedMidiEvent::k_program_change, m_MtrChannel, m_MtrInstr, 0);
 
     //-----------------------------------------------------------------------------------
     //Naming convention for variables:
@@ -407,28 +805,31 @@ void ScorePlayer::do_play(int nEvStart, int nEvEnd, bool fVisualTracking,
     bool fContinue = true;
     while (fContinue)
     {
-        if (events[i]->EventType == SoundEvent::k_prog_instr)
+        if (events[i].EventType == SoundEvent::k_prog_instr)
         {
             //change program
             switch (playMode)
             {
                 case k_play_rhythm_instrument:
-                    m_pMidi->voice_change(events[i]->Channel, 57);        //57 = Trumpet
+                    add_sound_event(BatchedMidiEvent::k_voice_change, events[i].Channel,
+                                    57, 0);        //57 = Trumpet
                     break;
                 case k_play_rhythm_percussion:
-                    m_pMidi->voice_change(events[i]->Channel, 66);        //66 = High Timbale
+                    add_sound_event(BatchedMidiEvent::k_voice_change, events[i].Channel,
+                                    66, 0);        //66 = High Timbale
                     break;
                 case k_play_rhythm_human_voice:
                     //do nothing. Wave sound will be used
                     break;
                 case k_play_normal_instrument:
                 default:
-                    m_pMidi->voice_change(events[i]->Channel, events[i]->Instrument);
+                    add_sound_event(BatchedMidiEvent::k_voice_change, events[i].Channel,
+                                    events[i].Instrument, 0);
             }
         }
-        else if (events[i]->EventType == SoundEvent::k_rhythm_change)
+        else if (events[i].EventType == SoundEvent::k_rhythm_change)
         {
-            set_new_beat_information(events[i]);
+            set_new_beat_information(&events[i]);
 
             nMtrIntvalOff = min(7L, m_nMtrPulseDuration / 4L);            //click sound duration (interval to click off), in TU
             nMtrIntvalNextClick = m_nMtrPulseDuration - nMtrIntvalOff;    //interval from click off to next click, in TU
@@ -456,7 +857,7 @@ void ScorePlayer::do_play(int nEvStart, int nEvEnd, bool fVisualTracking,
     //measure
     long curTime = 0L;
 	if (nEvStart > 1)
-		curTime = time_units_to_milliseconds( events[nEvStart]->DeltaTime );
+		curTime = time_units_to_milliseconds( events[nEvStart].DeltaTime );
 
 
     //determine last metronome pulse before first note to play.
@@ -468,7 +869,7 @@ void ScorePlayer::do_play(int nEvStart, int nEvEnd, bool fVisualTracking,
     while (nMissingTime > 0)
         nMissingTime -= m_nMtrPulseDuration;
 
-    nMtrEvDeltaTime = ((events[i]->DeltaTime / m_nMtrPulseDuration) - 1) * m_nMtrPulseDuration;
+    nMtrEvDeltaTime = ((events[i].DeltaTime / m_nMtrPulseDuration) - 1) * m_nMtrPulseDuration;
     nMtrEvDeltaTime -= nMissingTime;
     curTime = time_units_to_milliseconds( nMtrEvDeltaTime );
     long nExtraTime = long( m_pTable->get_anacrusis_extra_time() );
@@ -476,7 +877,7 @@ void ScorePlayer::do_play(int nEvStart, int nEvEnd, bool fVisualTracking,
     LOMSE_LOG_DEBUG(Logger::k_score_player,
                     "At start: nMtrEvDeltaTime=%ld, event=%d, event time=%ld, anacrusis missing time=%f, "
                     "curTime=%ld, nMissingTime=%ld, nExtraTime=%ld, nDeltaShift=%ld",
-                    nMtrEvDeltaTime, i, events[i]->DeltaTime, m_pTable->get_anacrusis_missing_time(),
+                    nMtrEvDeltaTime, i, events[i].DeltaTime, m_pTable->get_anacrusis_missing_time(),
                     curTime, nMissingTime, nExtraTime, nDeltaShift);
 
     //prepare weak_ptr to interactor
@@ -506,21 +907,25 @@ void ScorePlayer::do_play(int nEvStart, int nEvEnd, bool fVisualTracking,
                         "Count-off: nMtrIntvalOff=%ld, nMtrIntvalNextClick=%ld, "
                         "nMtrEvDeltaTime=%ld",
                         nMtrIntvalOff, nMtrIntvalNextClick, nMtrEvDeltaTime);
-        //generate two metronome pulses before starting
-        std::chrono::milliseconds timeToOff( time_units_to_milliseconds(nMtrIntvalOff) );
-        std::chrono::milliseconds timeToNext( time_units_to_milliseconds(nMtrIntvalNextClick) );
+        //generate two metronome pulses before starting. Clicks are scheduled
+        //backwards from the start time, so that last click is at curTime
+        double timeToOff = time_units_to_playback_time(nMtrIntvalOff);
+        double timePulse = time_units_to_playback_time(nMtrIntvalOff + nMtrIntvalNextClick);
 
         int numPulses = (nMissingTime != 0 ? 2 : 1);
+        double startTime = time_units_to_playback_time(nMtrEvDeltaTime)
+                           - double(numPulses) * timePulse;
+        start_playback_clock(startTime);
         for (int j=0 ; j < numPulses; ++j)
         {
-            m_pMidi->note_on(m_MtrChannel, m_MtrTone2, 100);
-            std::this_thread::sleep_for( timeToOff );
-            m_pMidi->note_off(m_MtrChannel, m_MtrTone2, 100);
-            std::this_thread::sleep_for( timeToNext );
+            add_sound_event(BatchedMidiEvent::k_note_on, m_MtrChannel, m_MtrTone2, 100);
+            wait_until(startTime + double(j) * timePulse + timeToOff);
+            add_sound_event(BatchedMidiEvent::k_note_off, m_MtrChannel, m_MtrTone2, 100);
+            wait_until(startTime + double(j+1) * timePulse);
         }
 
         //last click
-        m_pMidi->note_on(m_MtrChannel, m_MtrTone2, 100);
+        add_sound_event(BatchedMidiEvent::k_note_on, m_MtrChannel, m_MtrTone2, 100);
 
         fSendMtrOff = true;
         nMtrEvDeltaTime += nMtrIntvalOff;
@@ -530,16 +935,19 @@ void ScorePlayer::do_play(int nEvStart, int nEvEnd, bool fVisualTracking,
                         "end of count-off: nMtrEvDeltaTime=%ld", nMtrEvDeltaTime);
     }
 
+    else
+        start_playback_clock( time_units_to_playback_time(nMtrEvDeltaTime) );
+
     //loop to process events
     do
     {
         LOMSE_LOG_DEBUG(Logger::k_score_player,
                         "new iteration: i=%d, curTime=%ld, nMtrEvDeltaTime=%ld, "
-                        "events[i]->DeltaTime=%ld",
-                        i, curTime, nMtrEvDeltaTime, events[i]->DeltaTime);
+                        "events[i].DeltaTime=%ld",
+                        i, curTime, nMtrEvDeltaTime, events[i].DeltaTime);
 
         //Verify if next event is a metronome click on/off
-        if (nMtrEvDeltaTime <= events[i]->DeltaTime)
+        if (nMtrEvDeltaTime <= events[i].DeltaTime)
         {
             //Next event should be a metronome click or the click off event for the previous metronome click
             nEvTime = time_units_to_milliseconds(nMtrEvDeltaTime);
@@ -547,31 +955,20 @@ void ScorePlayer::do_play(int nEvStart, int nEvEnd, bool fVisualTracking,
             if (curTime < nEvTime)
             {
                 //flush pending events
-                long elapsed = 0L;
                 if (fVisualTracking && pEvent->get_num_items() > 0)
                 {
-                    clock_t t1=clock();
-                    if (m_fPostEvents)
-                        m_libScope.post_event(pEvent);
-                    else if (pInteractor)
-                        pInteractor->handle_event(pEvent);
+                    post_tracking_event(pEvent, pInteractor);
                     pEvent = SpEventVisualTracking(
                                 LOMSE_NEW EventVisualTracking(wpInteractor,
                                                               m_pScore->get_id()) );
-                    clock_t t2=clock();
-                    elapsed = long( ((t2-t1)*1000.0)/double(CLOCKS_PER_SEC));
                 }
 
-                //wait for current time
-                long waitT = nEvTime - curTime - elapsed;
-                if (waitT > 0L)
-                {
-                    std::chrono::milliseconds waitTime(waitT);
-                    std::this_thread::sleep_for(waitTime);
-                }
+                //wait for current time. As deadlines are absolute, time spent in
+                //flushing events is automatically discounted
+                wait_until( time_units_to_playback_time(nMtrEvDeltaTime) );
                 curTime = nEvTime;
-                LOMSE_LOG_DEBUG(Logger::k_score_player, "flush pending events: waitT=%ld, new curTime=%ld",
-                                waitT, curTime);
+                LOMSE_LOG_DEBUG(Logger::k_score_player, "flush pending events: new curTime=%ld",
+                                curTime);
             }
 
             if (fSendMtrOff)
@@ -580,9 +977,9 @@ void ScorePlayer::do_play(int nEvStart, int nEvEnd, bool fVisualTracking,
                 if (fPlayWithMetronome || fCountOffPulseActive)
                 {
                     if (fFirstBeatInMeasure)
-                        m_pMidi->note_off(m_MtrChannel, m_MtrTone1, 127);
+                        add_sound_event(BatchedMidiEvent::k_note_off, m_MtrChannel, m_MtrTone1, 127);
                     else
-                        m_pMidi->note_off(m_MtrChannel, m_MtrTone2, 80);
+                        add_sound_event(BatchedMidiEvent::k_note_off, m_MtrChannel, m_MtrTone2, 80);
 
                     fCountOffPulseActive = false;
                 }
@@ -601,9 +998,9 @@ void ScorePlayer::do_play(int nEvStart, int nEvEnd, bool fVisualTracking,
                 if (fPlayWithMetronome)
                 {
                     if (fFirstBeatInMeasure)
-                        m_pMidi->note_on(m_MtrChannel, m_MtrTone1, 127);
+                        add_sound_event(BatchedMidiEvent::k_note_on, m_MtrChannel, m_MtrTone1, 127);
                     else
-                        m_pMidi->note_on(m_MtrChannel, m_MtrTone2, 80);
+                        add_sound_event(BatchedMidiEvent::k_note_on, m_MtrChannel, m_MtrTone2, 80);
                 }
 
                 if (fVisualTracking && nMtrEvDeltaTime >= 0L)
@@ -627,51 +1024,41 @@ void ScorePlayer::do_play(int nEvStart, int nEvEnd, bool fVisualTracking,
         else
         {
             //next even comes from the table. Usually it will be a note on/off
-            nEvTime = time_units_to_milliseconds( events[i]->DeltaTime );
+            nEvTime = time_units_to_milliseconds( events[i].DeltaTime );
             LOMSE_LOG_DEBUG(Logger::k_score_player, "nEvTime updated (event i) = %ld", nEvTime);
             if (nEvTime > curTime)
             {
                 //flush accumulated events for curTime
-                long elapsed = 0L;
                 if (fVisualTracking && pEvent->get_num_items() > 0)
                 {
                     LOMSE_LOG_DEBUG(Logger::k_events | Logger::k_score_player,
                                     "Flush pending events");
-                    clock_t t1=clock();
-                    if (m_fPostEvents)
-                        m_libScope.post_event(pEvent);
-                    else if (pInteractor)
-                        pInteractor->handle_event(pEvent);
+                    post_tracking_event(pEvent, pInteractor);
                     pEvent = SpEventVisualTracking(
                                 LOMSE_NEW EventVisualTracking(wpInteractor,
                                                               m_pScore->get_id()) );
-                    clock_t t2=clock();
-                    elapsed = long( ((t2-t1)*1000.0)/double(CLOCKS_PER_SEC));
                 }
 
                 //wait until new time arrives
-                long waitT = nEvTime - curTime - elapsed;
-                if (waitT > 0L)
-                {
-                    std::chrono::milliseconds waitTime(waitT);
-                    std::this_thread::sleep_for(waitTime);
-                }
+                wait_until( time_units_to_playback_time(events[i].DeltaTime) );
             }
 
             //if it is a jump event, execute the jump if applicable
-            if (events[i]->EventType == SoundEvent::k_jump)
+            if (events[i].EventType == SoundEvent::k_jump)
             {
                 bool fExecuted = false;
-                JumpEntry* pJump = events[i]->pJump;
+                JumpEntry* pJump = events[i].pJump;
                 if (pJump->get_visited() >= pJump->get_times_before())
                 {
                     if (pJump->get_times_valid() == 0
                         || pJump->get_times_valid() > pJump->get_executed())
                     {
+                        double jumpTime = time_units_to_playback_time(events[i].DeltaTime);
                         i = pJump->get_event();
-                        nEvTime = time_units_to_milliseconds( events[i]->DeltaTime );
+                        rebase(jumpTime, time_units_to_playback_time(events[i].DeltaTime));
+                        nEvTime = time_units_to_milliseconds( events[i].DeltaTime );
                         curTime = nEvTime;
-                        nMtrEvDeltaTime = events[i]->DeltaTime;
+                        nMtrEvDeltaTime = events[i].DeltaTime;
                         if (pJump->get_times_valid() > pJump->get_executed())
                             pJump->increment_applied();
                         fExecuted = true;
@@ -687,98 +1074,101 @@ void ScorePlayer::do_play(int nEvStart, int nEvEnd, bool fVisualTracking,
             }
 
 
-            if (events[i]->EventType == SoundEvent::k_note_on)
+            if (events[i].EventType == SoundEvent::k_note_on)
             {
                 //start of note
                 switch(playMode)
                 {
                     case k_play_rhythm_instrument:
-                        m_pMidi->note_on(events[i]->Channel, k_SOLFA_NOTE,
-                                        events[i]->Volume);
+                        add_sound_event(BatchedMidiEvent::k_note_on, events[i].Channel,
+                                        k_SOLFA_NOTE, events[i].Volume);
                         break;
                     case k_play_rhythm_percussion:
-                        m_pMidi->note_on(nPercussionChannel, k_SOLFA_NOTE,
-                                        events[i]->Volume);
+                        add_sound_event(BatchedMidiEvent::k_note_on, nPercussionChannel,
+                                        k_SOLFA_NOTE, events[i].Volume);
                         break;
                     case k_play_rhythm_human_voice:
-                        //WaveOn .NoteStep, events[i]->Volume);
+                        //WaveOn .NoteStep, events[i].Volume);
                         break;
                     case k_play_normal_instrument:
                     default:
-                        m_pMidi->note_on(events[i]->Channel, events[i]->NotePitch,
-                                        events[i]->Volume);
+                        add_sound_event(BatchedMidiEvent::k_note_on, events[i].Channel,
+                                        events[i].NotePitch, events[i].Volume);
                 }
 
                 //generate implicit visual on event
-                if (fVisualTracking && events[i]->pSO->is_visible())
+                if (fVisualTracking && events[i].pSO->is_visible())
                 {
-                    ImoId id = events[i]->pSO->get_id();
+                    ImoId id = events[i].pSO->get_id();
                     pEvent->add_item(EventVisualTracking::k_highlight_on, id);
                     LOMSE_LOG_DEBUG(Logger::k_events | Logger::k_score_player,
                                     "implicit k_highlight_on generated for %d", id);
                 }
                 LOMSE_LOG_DEBUG(Logger::k_score_player, "Note On");
             }
-            else if (events[i]->EventType == SoundEvent::k_note_off)
+            else if (events[i].EventType == SoundEvent::k_note_off)
             {
                 //end of note
                 switch(playMode)
                 {
                     case k_play_rhythm_instrument:
-                        m_pMidi->note_off(events[i]->Channel, k_SOLFA_NOTE, 127);
+                        add_sound_event(BatchedMidiEvent::k_note_off, events[i].Channel,
+                                        k_SOLFA_NOTE, 127);
                         break;
                     case k_play_rhythm_percussion:
-                        m_pMidi->note_off(nPercussionChannel, k_SOLFA_NOTE, 127);
+                        add_sound_event(BatchedMidiEvent::k_note_off, nPercussionChannel,
+                                        k_SOLFA_NOTE, 127);
                         break;
                     case k_play_rhythm_human_voice:
                         //WaveOff
                         break;
                     case k_play_normal_instrument:
                     default:
-                        m_pMidi->note_off(events[i]->Channel, events[i]->NotePitch, 127);
+                        add_sound_event(BatchedMidiEvent::k_note_off, events[i].Channel,
+                                        events[i].NotePitch, 127);
                 }
 
                 //generate implicit visual off event
-                if (fVisualTracking && events[i]->pSO->is_visible())
+                if (fVisualTracking && events[i].pSO->is_visible())
                 {
-                    pEvent->add_item(EventVisualTracking::k_highlight_off, events[i]->pSO->get_id());
+                    pEvent->add_item(EventVisualTracking::k_highlight_off, events[i].pSO->get_id());
                     LOMSE_LOG_DEBUG(Logger::k_events | Logger::k_score_player,
                                     "implicit k_highlight_off generated for %d",
-                                    events[i]->pSO->get_id());
+                                    events[i].pSO->get_id());
                 }
                 LOMSE_LOG_DEBUG(Logger::k_score_player, "Note Off");
             }
-            else if (events[i]->EventType == SoundEvent::k_visual_on)
+            else if (events[i].EventType == SoundEvent::k_visual_on)
             {
                 //set visual highlight
                 if (fVisualTracking)
                 {
-                    ImoId id = events[i]->pSO->get_id();
+                    ImoId id = events[i].pSO->get_id();
                     pEvent->add_item(EventVisualTracking::k_highlight_on, id);
                     LOMSE_LOG_DEBUG(Logger::k_events | Logger::k_score_player,
                                     "explicit k_highlight_on generated for %d", id);
                 }
             }
-            else if (events[i]->EventType == SoundEvent::k_visual_off)
+            else if (events[i].EventType == SoundEvent::k_visual_off)
             {
                 //remove visual highlight
                 if (fVisualTracking)
                 {
-                    pEvent->add_item(EventVisualTracking::k_highlight_off, events[i]->pSO->get_id());
+                    pEvent->add_item(EventVisualTracking::k_highlight_off, events[i].pSO->get_id());
                     LOMSE_LOG_DEBUG(Logger::k_events | Logger::k_score_player,
                                     "explicit k_highlight_off generated for %d",
-                                    events[i]->pSO->get_id());
+                                    events[i].pSO->get_id());
                 }
 
             }
-            else if (events[i]->EventType == SoundEvent::k_end_of_score)
+            else if (events[i].EventType == SoundEvent::k_end_of_score)
             {
                 //end of table
                 break;
             }
-            else if (events[i]->EventType == SoundEvent::k_rhythm_change)
+            else if (events[i].EventType == SoundEvent::k_rhythm_change)
             {
-                set_new_beat_information(events[i]);
+                set_new_beat_information(&events[i]);
 
                 nMtrIntvalOff = min(7L, m_nMtrPulseDuration / 4L);            //click duration (interval to click off)
                 nMtrIntvalNextClick = m_nMtrPulseDuration - nMtrIntvalOff;    //interval from click off to next click
@@ -787,23 +1177,26 @@ void ScorePlayer::do_play(int nEvStart, int nEvEnd, bool fVisualTracking,
                                 "new TS: nCurMeasureDuration=%ld, nCurMtrIntval=%ld",
                                 m_nCurMeasureDuration, m_nCurMtrIntval);
             }
-            else if (events[i]->EventType == SoundEvent::k_prog_instr)
+            else if (events[i].EventType == SoundEvent::k_prog_instr)
             {
                 //change program
                 switch (playMode)
                 {
                     case k_play_rhythm_instrument:
-                        m_pMidi->voice_change(events[i]->Channel, 57);        //57 = Trumpet
+                        add_sound_event(BatchedMidiEvent::k_voice_change, events[i].Channel,
+                                        57, 0);        //57 = Trumpet
                         break;
                     case k_play_rhythm_percussion:
-                        m_pMidi->voice_change(events[i]->Channel, 66);        //66 = High Timbale
+                        add_sound_event(BatchedMidiEvent::k_voice_change, events[i].Channel,
+                                        66, 0);        //66 = High Timbale
                         break;
                     case k_play_rhythm_human_voice:
                         //do nothing. Wave sound will be used
                         break;
                     case k_play_normal_instrument:
                     default:
-                        m_pMidi->voice_change(events[i]->Channel, events[i]->NotePitch);
+                        add_sound_event(BatchedMidiEvent::k_voice_change, events[i].Channel,
+                                        events[i].NotePitch, 0);
                 }
             }
             else
@@ -824,14 +1217,10 @@ void ScorePlayer::do_play(int nEvStart, int nEvEnd, bool fVisualTracking,
             LOMSE_LOG_DEBUG(Logger::k_score_player, "Going to finish 1");
             break;
         }
-        while(m_fPaused)
+        if (!wait_while_paused())
         {
-            std::this_thread::sleep_for( std::chrono::milliseconds(200) );
-            if (m_fShouldStop)
-            {
-                LOMSE_LOG_DEBUG(Logger::k_score_player, "Going to finish 2");
-                break;
-            }
+            LOMSE_LOG_DEBUG(Logger::k_score_player, "Going to finish 2");
+            break;
         }
 
         //update metronome information, just in case metronome was updated
@@ -842,7 +1231,9 @@ void ScorePlayer::do_play(int nEvStart, int nEvEnd, bool fVisualTracking,
             {
                 float factor = float(m_prevGuiBpm) / float(curGuiBpm);
                 TimeUnits curTU = double(curTime) / double(m_conversionFactor);
+                double oldTime = time_units_to_playback_time(long(curTU));
                 m_conversionFactor *= factor;
+                rebase(oldTime, time_units_to_playback_time(long(curTU)));
                 m_nPrevMtrIntval = m_nCurMtrIntval;
                 m_nCurMtrIntval = long( float(m_nCurMtrIntval) * factor);
                 m_prevGuiBpm = curGuiBpm;
@@ -857,6 +1248,10 @@ void ScorePlayer::do_play(int nEvStart, int nEvEnd, bool fVisualTracking,
 
     } while (i <= nEvEnd);
 
+    //send sound events for last instant
+    flush_sound_events();
+    finish_sounds_sent_ahead();
+
     //TODO: Last Highlight event (note off) is not send because loop break at line
     // 690 without sending last event. It is not important as next event will remove all
     // highlight but should be studied and decided. Can be sent here.
@@ -870,10 +1265,7 @@ void ScorePlayer::do_play(int nEvStart, int nEvEnd, bool fVisualTracking,
         pEvent->add_item(EventVisualTracking::k_end_of_visual_tracking, k_no_imoid);
         LOMSE_LOG_DEBUG(Logger::k_events | Logger::k_score_player,
                         "Flush pending events");
-        if (m_fPostEvents)
-            m_libScope.post_event(pEvent);
-        else if (pInteractor)
-            pInteractor->handle_event(pEvent);
+        send_tracking_event(pEvent, pInteractor);
     }
     LOMSE_LOG_DEBUG(Logger::k_score_player, "<< Exit");
 }
@@ -950,6 +1342,184 @@ void ScorePlayer::end_of_playback_housekeeping(bool fVisualTracking,
     LOMSE_LOG_DEBUG(Logger::k_score_player, "<< Exit");
 }
 
+//---------------------------------------------------------------------------------------
+void ScorePlayer::start_playback_clock(double time)
+{
+    //When sound events are sent ahead of time, playback proceeds in advance of real
+    //time: events for playback time 'time' will sound after the lookahead time, and
+    //waits are done for the time at which events must be sent (see wait_until())
+
+    m_scheduler.start(time - lookahead_time());
+    m_batch.playbackTime = time;
+}
+
+//---------------------------------------------------------------------------------------
+void ScorePlayer::flush_sound_events()
+{
+    //send all pending sound events, as a single batch
+
+    if (m_batch.empty())
+        return;
+
+    m_batch.timestamp = m_scheduler.get_deadline(m_batch.playbackTime);
+    m_pMidi->events(m_batch);
+    if (m_lookahead > 0L)
+        m_sentBatches.push_back(m_batch);
+    m_batch.clear();
+}
+
+//---------------------------------------------------------------------------------------
+bool ScorePlayer::wait_until(double time)
+{
+    //send pending sound events and wait until the time for sending the sound events
+    //for playback time 'time' arrives. Returns false if the wait was interrupted by
+    //a stop request.
+    //When sound events are sent ahead of time, the visual tracking events retained
+    //are posted when their time arrives
+
+    flush_sound_events();
+
+    double sendTime = time - lookahead_time();
+    while (!m_pendingTracking.empty() && m_pendingTracking.front().time <= sendTime)
+    {
+        if (!wait_for(m_pendingTracking.front().time))
+            return false;
+        send_tracking_event(m_pendingTracking.front().event,
+                            m_pendingTracking.front().pInteractor);
+        m_pendingTracking.pop_front();
+    }
+
+    bool fContinue = wait_for(sendTime);
+
+    //batches due at this time are already played
+    while (!m_sentBatches.empty() && m_sentBatches.front().playbackTime <= sendTime)
+        m_sentBatches.pop_front();
+
+    m_batch.playbackTime = time;
+    return fContinue;
+}
+
+//---------------------------------------------------------------------------------------
+bool ScorePlayer::wait_for(double time)
+{
+    //wait until playback time 'time' arrives. Returns false if stop requested
+
+    if (m_lookahead == 0L)
+        return m_scheduler.wait_until(time);
+
+    while (true)
+    {
+        bool fPaused = false;
+        if (!m_scheduler.wait_until(time, &fPaused))
+            return false;
+        if (!fPaused)
+            return true;
+        if (!pause_sounds_sent_ahead())
+            return false;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+bool ScorePlayer::wait_while_paused()
+{
+    //Returns false if stop requested
+
+    if (m_lookahead > 0L && m_scheduler.is_paused())
+        return pause_sounds_sent_ahead();
+    return m_scheduler.wait_while_paused();
+}
+
+//---------------------------------------------------------------------------------------
+bool ScorePlayer::pause_sounds_sent_ahead()
+{
+    //Playback is paused and sound events were sent ahead of time. Mute all sounds,
+    //which also discards the events sent but not yet played, and wait for resume.
+    //Then, send again the events not played, with new timestamps.
+    //Returns false if stop requested
+
+    m_pMidi->all_sounds_off();
+    double pauseTime = m_scheduler.get_pause_time();    //last sounding time
+
+    if (!m_scheduler.wait_while_paused())
+        return false;
+
+    for (SoundEventBatch& batch : m_sentBatches)
+    {
+        if (batch.playbackTime > pauseTime)
+        {
+            batch.timestamp = m_scheduler.get_deadline(batch.playbackTime);
+            m_pMidi->events(batch);
+        }
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------------------
+void ScorePlayer::finish_sounds_sent_ahead()
+{
+    //At end of playback, when sound events were sent ahead of time, wait until
+    //all sounds are played, posting the retained visual tracking events when
+    //their time arrives. Not needed if playback was stopped, as all sounds will
+    //be muted.
+
+    if (m_lookahead == 0L || m_fShouldStop)
+    {
+        m_pendingTracking.clear();
+        m_sentBatches.clear();
+        return;
+    }
+
+    double lastTime = m_batch.playbackTime;
+    if (!m_sentBatches.empty())
+        lastTime = max(lastTime, m_sentBatches.back().playbackTime);
+    if (!m_pendingTracking.empty())
+        lastTime = max(lastTime, m_pendingTracking.back().time);
+
+    wait_until(lastTime + lookahead_time());
+
+    m_pendingTracking.clear();
+    m_sentBatches.clear();
+}
+
+//---------------------------------------------------------------------------------------
+void ScorePlayer::rebase(double oldTime, double newTime)
+{
+    //pending events must be time stamped before changing the time reference
+    flush_sound_events();
+    m_scheduler.rebase(oldTime, newTime);
+    m_batch.playbackTime = newTime;
+
+    //events sent ahead of time and retained visual events keep their real time
+    double shift = newTime - oldTime;
+    for (SoundEventBatch& batch : m_sentBatches)
+        batch.playbackTime += shift;
+    for (PendingTrackingEvent& pending : m_pendingTracking)
+        pending.time += shift;
+}
+
+//---------------------------------------------------------------------------------------
+void ScorePlayer::post_tracking_event(SpEventVisualTracking pEvent,
+                                      Interactor* pInteractor)
+{
+    //visual tracking events for current playback time. When sound events are sent
+    //ahead of time, visual events are retained until their time arrives
+
+    if (m_lookahead > 0L)
+        m_pendingTracking.push_back({m_batch.playbackTime, pEvent, pInteractor});
+    else
+        send_tracking_event(pEvent, pInteractor);
+}
+
+//---------------------------------------------------------------------------------------
+void ScorePlayer::send_tracking_event(SpEventVisualTracking pEvent,
+                                      Interactor* pInteractor)
+{
+    if (m_fPostEvents)
+        m_libScope.post_event(pEvent);
+    else if (pInteractor)
+        pInteractor->handle_event(pEvent);
+}
+
 //---------------------------------------------------------------------------------------
 void ScorePlayer::set_new_beat_information(SoundEvent* pEvent)
 {
@@ -20,6 +20,7 @@
 #include "lomse_im_attributes.h"
 #include "lomse_selections.h"
 #include "lomse_ldp_exporter.h"
+#include "lomse_model_builder.h"
 
 using namespace UnitTest;
 using namespace std;
@@ -155,7 +156,7 @@ SUITE(DocCommandTest)
         cursor.enter_element();     //points to clef
         cursor.move_next();         //points to end of score
         DocCommand* pCmd = LOMSE_NEW CmdAddNoteRest("(n a4 e v1)", k_edit_mode_replace);
-        CHECK( pCmd->get_undo_policy() == DocCommand::k_undo_policy_replay_from_start );
+        CHECK( pCmd->get_undo_policy() == DocCommand::k_undo_policy_partial_checkpoint );
         CHECK( pCmd->get_cursor_update_policy() == DocCommand::k_refresh );
 
         MySelectionSet sel(&doc);
@@ -1201,6 +1202,79 @@ SUITE(DocCommandTest)
 //        cout << pTable->dump();
     }
 
+    TEST_FIXTURE(DocCommandTestFixture, add_noterest_0901)
+    {
+        //@0901. Replacing a noterest by other with the same duration updates the
+        //@      ColStaffObjs table, not rebuilds it. Results are the same than for
+        //@      a full structurize
+
+        MyDocument3 doc(m_libraryScope);
+        doc.from_string("(score (vers 2.0)(instrument#90 (musicData#122 "
+            "(clef G)(n c4 q v1 p1)(n e4 q v1 p1)(barline)"
+            "(n f4 q v1 p1)(n f4 q v1 p1)(barline)"
+            ")))");
+        doc.my_clear_dirty();
+        ImoScore* pScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        ImoMusicData* pMD = pScore->get_instrument(0)->get_musicdata();
+        ColStaffObjs* pTable = pScore->get_staffobjs_table();
+        DocCursor cursor(&doc);
+        DocCommandExecuter executer(&doc);
+        MySelectionSet sel(&doc);
+        cursor.enter_element();     //points to clef
+        cursor.point_to( pMD->get_child(4)->get_id() );     //first f4, measure start
+
+        executer.execute(&cursor, LOMSE_NEW CmdAddNoteRest("(n +f4 q v1 p1)",
+                                                           k_edit_mode_replace), &sel);
+
+        CHECK( pScore->get_staffobjs_table() == pTable );
+        CHECK( pTable->num_entries() == 7 );
+        ImoNote* pNote = static_cast<ImoNote*>( pMD->get_child(4) );
+        CHECK( pNote->to_string() == "(n +f4 q v1 p1)" );
+        CHECK( (*pTable->find(pNote))->imo_object() == pNote );
+        //next f4 requires a natural
+        pNote = static_cast<ImoNote*>( pMD->get_child(5) );
+        CHECK( pNote->get_notated_accidentals() == k_natural );
+
+        ModelBuilder builder;
+        CHECK( builder.check_structurize(pScore) == true );
+    }
+
+    TEST_FIXTURE(DocCommandTestFixture, add_noterest_0902)
+    {
+        //@0902. Replacing a beamed note. The beam is reorganized as when the table
+        //@      is rebuilt and the new note is not added to the beam
+
+        MyDocument3 doc(m_libraryScope);
+        doc.from_string("(score (vers 2.0)(instrument#90 (musicData#122 "
+            "(clef G)(n c4 e v1 p1 (beam 129 +))(n e4 e v1 p1 (beam 129 -))"
+            "(n g4 q v1 p1)(barline)"
+            ")))");
+        doc.my_clear_dirty();
+        ImoScore* pScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        ImoMusicData* pMD = pScore->get_instrument(0)->get_musicdata();
+        DocCursor cursor(&doc);
+        DocCommandExecuter executer(&doc);
+        MySelectionSet sel(&doc);
+        cursor.enter_element();     //points to clef
+        cursor.point_to( pMD->get_child(2)->get_id() );     //e4, end of beam
+
+        executer.execute(&cursor, LOMSE_NEW CmdAddNoteRest("(n f4 e v1 p1)",
+                                                           k_edit_mode_replace), &sel);
+
+        ColStaffObjs* pTable = pScore->get_staffobjs_table();
+        CHECK( pTable->num_entries() == 5 );
+        ImoNote* pNote = static_cast<ImoNote*>( pMD->get_child(1) );
+        CHECK( pNote->is_beamed() == false );
+        pNote = static_cast<ImoNote*>( pMD->get_child(2) );
+        CHECK( pNote->to_string() == "(n f4 e v1 p1)" );
+        CHECK( pNote->is_beamed() == false );
+        CHECK( (*pTable->find(pNote))->imo_object() == pNote );
+
+        ModelBuilder builder;
+        CHECK( builder.check_structurize(pScore) == true );
+    }
+
+
     // CmdAddTuplet ---------------------------------------------------------------------
 
     TEST_FIXTURE(DocCommandTestFixture, add_tuplet_1101)
@@ -1349,7 +1423,7 @@ SUITE(DocCommandTest)
         MySelectionSet sel(&doc);
         int result = executer.execute(&cursor, pCmd, &sel);
 
-        CHECK( pCmd->get_undo_policy() == DocCommand::k_undo_policy_replay_from_start );
+        CHECK( pCmd->get_undo_policy() == DocCommand::k_undo_policy_partial_checkpoint );
         CHECK ( result == k_success );
         CHECK( doc.is_dirty() == true );
         CHECK( pCmd->get_name() == "Break beam" );
@@ -1858,6 +1932,29 @@ SUITE(DocCommandTest)
         CHECK( pNote->get_dots() == 1 );
     }
 
+    TEST_FIXTURE(DocCommandTestFixture, change_dots_1503)
+    {
+        //@1503. only the measures with modified noterests are structurized.
+        //@      Results are the same than for a full structurize
+        MyDocument3 doc(m_libraryScope);
+        doc.from_string("(score (vers 2.0)(instrument (musicData "
+            "(clef G)(n +c4 e v1)(n c4 q v1)(n c4 q v2)(n d4 q v2)"
+            "(barline)(n +c4 q)(n c4 q)(barline)"
+            ")))");
+        doc.my_clear_dirty();
+        ImoScore* pScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        DocCursor cursor(&doc);
+        cursor.enter_element();     //points to clef
+        cursor.move_next();         //points to n +c4 e
+        DocCommandExecuter executer(&doc);
+        MySelectionSet sel(&doc);
+        sel.debug_add( *cursor );
+        executer.execute(&cursor, LOMSE_NEW CmdChangeDots(1), &sel);
+
+        ModelBuilder builder;
+        CHECK( builder.check_structurize(pScore) == true );
+    }
+
     TEST_FIXTURE(DocCommandTestFixture, change_dots_1502)
     {
         //undo change dots
@@ -2493,7 +2590,7 @@ SUITE(DocCommandTest)
         //cout << pScore->get_staffobjs_table()->dump() << endl;
         //cout << "cmd name = " << pCmd->get_name() << endl;
 
-        CHECK( pCmd->get_undo_policy() == DocCommand::k_undo_policy_replay_from_start );
+        CHECK( pCmd->get_undo_policy() == DocCommand::k_undo_policy_partial_checkpoint );
         CHECK( pCmd->get_name() == "Delete note" );
         CHECK( *cursor != nullptr );
         CHECK( (*cursor)->is_rest() == true );
@@ -2988,6 +3085,73 @@ SUITE(DocCommandTest)
         CHECK( pSC->is_at_end_of_score() );
     }
 
+    TEST_FIXTURE(DocCommandTestFixture, delete_staffobj_2014)
+    {
+        //@2014. only the modified measures are structurized. Results are the same
+        //@      than for a full structurize
+        MyDocument3 doc(m_libraryScope);
+        doc.from_string("(score (vers 2.0)(instrument (musicData "
+            "(clef G)(n +c4 q)(n c4 q)(barline)(n +d4 q)(barline)(n d4 q)(barline)"
+            ")))");
+        doc.my_clear_dirty();
+        ImoScore* pScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        ImoMusicData* pMD = pScore->get_instrument(0)->get_musicdata();
+        DocCursor cursor(&doc);
+        cursor.enter_element();     //points to clef
+        cursor.move_next();         //points to n +c4 q
+        DocCommandExecuter executer(&doc);
+        MySelectionSet sel(&doc);
+        executer.execute(&cursor, LOMSE_NEW CmdDeleteStaffObj(), &sel);
+
+        //remaining note is c#4 and must display the sharp
+        ImoNote* pNote = static_cast<ImoNote*>( pMD->get_child(1) );
+        CHECK( pNote->get_notated_accidentals() == k_sharp );
+
+        //delete barline after +d4. Measures are merged and d4 requires a natural
+        cursor.point_to( pMD->get_child(4)->get_id() );
+        executer.execute(&cursor, LOMSE_NEW CmdDeleteStaffObj(), &sel);
+        pNote = static_cast<ImoNote*>( pMD->get_child(4) );
+        CHECK( pNote->get_notated_accidentals() == k_natural );
+
+        ModelBuilder builder;
+        CHECK( builder.check_structurize(pScore) == true );
+    }
+
+    TEST_FIXTURE(DocCommandTestFixture, delete_staffobj_2015)
+    {
+        //@2015. Deleting chord notes updates the ColStaffObjs table, not rebuilds it.
+        //@      Results are the same than for a full structurize
+        MyDocument3 doc(m_libraryScope);
+        doc.from_string("(score (vers 2.0)(instrument (musicData "
+            "(clef G)(chord (n c4 q)(n e4 q)(n g4 q))(n d4 q)(barline)"
+            "(chord (n c4 q)(n e4 q))(n d4 q)(barline)"
+            ")))");
+        doc.my_clear_dirty();
+        ImoScore* pScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        ImoMusicData* pMD = pScore->get_instrument(0)->get_musicdata();
+        ColStaffObjs* pTable = pScore->get_staffobjs_table();
+        DocCursor cursor(&doc);
+        cursor.enter_element();     //points to clef
+        DocCommandExecuter executer(&doc);
+        MySelectionSet sel(&doc);
+
+        //delete middle note of first chord
+        cursor.point_to( pMD->get_child(2)->get_id() );
+        executer.execute(&cursor, LOMSE_NEW CmdDeleteStaffObj(), &sel);
+        CHECK( pScore->get_staffobjs_table() == pTable );
+        CHECK( pTable->num_entries() == 9 );
+
+        //delete base note of second chord, at measure start
+        cursor.point_to( pMD->get_child(5)->get_id() );
+        executer.execute(&cursor, LOMSE_NEW CmdDeleteStaffObj(), &sel);
+        CHECK( pScore->get_staffobjs_table() == pTable );
+        CHECK( pTable->num_entries() == 8 );
+
+        ModelBuilder builder;
+        CHECK( builder.check_structurize(pScore) == true );
+    }
+
+
     // CmdInsertBlockLevelObj -----------------------------------------------------------
 
     TEST_FIXTURE(DocCommandTestFixture, insert_block_2101)
@@ -3137,7 +3301,7 @@ SUITE(DocCommandTest)
         doc.my_clear_dirty();
         DocCommandExecuter executer(&doc);
         DocCommand* pCmd = LOMSE_NEW CmdInsertManyStaffObjs("(clef G)(n e4 e g+)(n c4 e g-)");
-        CHECK( pCmd->get_undo_policy() == DocCommand::k_undo_policy_replay_from_start );
+        CHECK( pCmd->get_undo_policy() == DocCommand::k_undo_policy_partial_checkpoint );
 
         DocCursor cursor(&doc);
         cursor.enter_element();
@@ -3302,7 +3466,7 @@ SUITE(DocCommandTest)
         doc.my_clear_dirty();
         DocCommandExecuter executer(&doc);
         DocCommand* pCmd = LOMSE_NEW CmdInsertStaffObj("(clef G)");
-        CHECK( pCmd->get_undo_policy() == DocCommand::k_undo_policy_replay_from_start );
+        CHECK( pCmd->get_undo_policy() == DocCommand::k_undo_policy_partial_checkpoint );
 
         DocCursor cursor(&doc);
         cursor.enter_element();
@@ -3606,6 +3770,33 @@ SUITE(DocCommandTest)
 //        cout << doc.to_string() << endl;
     }
 
+    TEST_FIXTURE(DocCommandTestFixture, insert_staffobj_2312)
+    {
+        //@2312. inserting a barline splits the measure. Only the modified measures
+        //@      are structurized. Results are the same than for a full structurize
+        MyDocument3 doc(m_libraryScope);
+        doc.from_string("(score (vers 2.0)(instrument (musicData "
+            "(clef G)(n +c4 q)(n c4 q)(barline)(n d4 q)(barline)"
+            ")))");
+        doc.my_clear_dirty();
+        ImoScore* pScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        ImoMusicData* pMD = pScore->get_instrument(0)->get_musicdata();
+        ImoNote* pNote = static_cast<ImoNote*>( pMD->get_child(2) );
+        CHECK( pNote->get_notated_accidentals() == k_no_accidentals );
+        DocCursor cursor(&doc);
+        cursor.point_to( pNote->get_id() );
+        DocCommandExecuter executer(&doc);
+        MySelectionSet sel(&doc);
+        executer.execute(&cursor, LOMSE_NEW CmdInsertStaffObj("(barline)"), &sel);
+
+        //note c#4 is now in next measure and must display the sharp
+        CHECK( pMD->get_child(2)->is_barline() );
+        CHECK( pNote->get_notated_accidentals() == k_sharp );
+
+        ModelBuilder builder;
+        CHECK( builder.check_structurize(pScore) == true );
+    }
+
     TEST_FIXTURE(DocCommandTestFixture, insert_staffobj_2311)
     {
         //undo/redo when cursor repositioned (two consecutive commands but
@@ -4477,6 +4668,45 @@ SUITE(DocCommandTest)
         CHECK( pChord->get_end_object() == pNote2 );
     }
 
+    TEST_FIXTURE(DocCommandTestFixture, add_chord_note_2705)
+    {
+        //@2705. The ColStaffObjs table is updated, not rebuilt. The updated table is
+        //@      equal to a rebuilt one
+        Document doc(m_libraryScope);
+        doc.from_string("(score (vers 2.0)"
+            "(instrument (staves 2)(musicData (clef G p1)(clef F4 p2)"
+            "(n c4 q v1 p1)(n e4 q v1 p1)(n c3 h v2 p2)(barline)))"
+            "(instrument (musicData (clef G)(n g4 q)(n a4 q)(barline)))"
+            ")");
+        DocCursor cursor(&doc);
+        DocCommandExecuter executer(&doc);
+        ImoScore* pScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        ImoMusicData* pMD = pScore->get_instrument(0)->get_musicdata();
+        ImoNote* pNote1 = static_cast<ImoNote*>( pMD->get_child(3) );     //e4
+        cursor.point_to(pNote1->get_id());
+        ColStaffObjs* pTable = pScore->get_staffobjs_table();
+        ColStaffObjsEntry* pEntry = *(pTable->find(pNote1));
+
+        MySelectionSet sel(&doc);
+        sel.debug_add(pNote1);
+        executer.execute(&cursor, LOMSE_NEW CmdAddChordNote("g4"), &sel);
+        executer.execute(&cursor, LOMSE_NEW CmdAddChordNote("b4"), &sel);
+
+        CHECK( pScore->get_staffobjs_table() == pTable );
+        CHECK( *(pTable->find(pNote1)) == pEntry );
+        CHECK( pTable->num_entries() == 12 );
+        ImoNote* pNote2 = static_cast<ImoNote*>( sel.front() );
+        CHECK( pNote2->get_fpitch() == FPitch("b4") );
+        CHECK( (*pTable->find(pNote2))->imo_object() == pNote2 );
+        string incremental = pTable->dump();
+        int numQuarter = pTable->num_quarter_noterests();
+
+        pScore->end_of_changes();
+        pTable = pScore->get_staffobjs_table();
+        CHECK( pTable->dump() == incremental );
+        CHECK( pTable->num_quarter_noterests() == numQuarter );
+    }
+
 
     //@ CmdTransposeChromatically -------------------------------------------------------
 
@@ -5322,4 +5552,166 @@ SUITE(DocCommandTest)
         CHECK( (*cursor)->to_string() == "(n f4 e v1 p1)" );
     }
 
+    TEST_FIXTURE(DocCommandTestFixture, undo_9003)
+    {
+        //9003. undo: full checkpoints. Replay from nearest checkpoint restores
+        //      the model, including ids
+
+        MyDocument3 doc(m_libraryScope);
+        doc.from_string("(score (vers 2.0)(instrument#90 (musicData#122 "
+            "(clef G)"
+            ")))");
+        DocCursor cursor(&doc);
+        DocCommandExecuter executer(&doc);
+        executer.set_checkpoint_interval(10);
+        executer.set_max_score_checkpoints(0);
+        cursor.enter_element();     //points to clef
+        cursor.move_next();         //points to end of score
+        MySelectionSet sel(&doc);
+
+        const char* pitches[] = { "c4", "d4", "e4", "f4", "g4", "a4", "b4" };
+        vector<string> states;
+        states.push_back( doc.to_string(true) );
+        for (int i=0; i < 45; ++i)
+        {
+            stringstream src;
+            src << "(n " << pitches[i % 7] << " e v1)";
+            executer.execute(&cursor,
+                             LOMSE_NEW CmdAddNoteRest(src.str(), k_edit_mode_replace),
+                             &sel);
+            states.push_back( doc.to_string(true) );
+        }
+        CHECK( executer.get_num_checkpoints() == 4 );
+
+        for (int i=44; i >= 15; --i)
+        {
+            executer.undo(&cursor, &sel);
+            CHECK( doc.to_string(true) == states[i] );
+        }
+        CHECK( executer.get_num_checkpoints() == 1 );
+
+        executer.redo(&cursor, &sel);
+        CHECK( doc.to_string(true) == states[16] );
+    }
+
+    TEST_FIXTURE(DocCommandTestFixture, undo_9004)
+    {
+        //9004. undo: partial checkpoints restore the score. Redo assigns same ids
+
+        MyDocument3 doc(m_libraryScope);
+        doc.from_string("(score (vers 2.0)(instrument#90 (musicData#122 "
+            "(clef G)(n c4 q)(n d4 q)"
+            ")))");
+        DocCursor cursor(&doc);
+        DocCommandExecuter executer(&doc);
+        executer.set_checkpoint_interval(0);
+        cursor.enter_element();     //points to clef
+        cursor.move_next();         //points to n c4
+        MySelectionSet sel(&doc);
+
+        vector<string> states;
+        states.push_back( doc.to_string(true) );
+        executer.execute(&cursor, LOMSE_NEW CmdAddNoteRest("(n e4 e v1)",
+                                                           k_edit_mode_replace), &sel);
+        states.push_back( doc.to_string(true) );
+        executer.execute(&cursor, LOMSE_NEW CmdInsertStaffObj("(barline)"), &sel);
+        states.push_back( doc.to_string(true) );
+        executer.execute(&cursor, LOMSE_NEW CmdDeleteStaffObj(), &sel);
+        states.push_back( doc.to_string(true) );
+        CHECK( executer.get_num_checkpoints() == 0 );
+
+        //the model is not replaced
+        DocModel* pModel = doc.get_doc_model();
+        for (int i=2; i >= 0; --i)
+        {
+            executer.undo(&cursor, &sel);
+            CHECK( doc.to_string(true) == states[i] );
+        }
+        CHECK( doc.get_doc_model() == pModel );
+        for (int i=1; i <= 3; ++i)
+        {
+            executer.redo(&cursor, &sel);
+            CHECK( doc.to_string(true) == states[i] );
+        }
+        executer.undo(&cursor, &sel);
+        CHECK( doc.to_string(true) == states[2] );
+    }
+
+    TEST_FIXTURE(DocCommandTestFixture, undo_9005)
+    {
+        //9005. undo: checkpoints are limited. Commands without score copy are
+        //      undone by replaying
+
+        MyDocument3 doc(m_libraryScope);
+        doc.from_string("(score (vers 2.0)(instrument#90 (musicData#122 "
+            "(clef G)"
+            ")))");
+        DocCursor cursor(&doc);
+        DocCommandExecuter executer(&doc);
+        executer.set_checkpoint_interval(5);
+        executer.set_max_checkpoints(2);
+        executer.set_max_score_checkpoints(4);
+        cursor.enter_element();     //points to clef
+        cursor.move_next();         //points to end of score
+        MySelectionSet sel(&doc);
+
+        const char* pitches[] = { "c5", "b4", "a4", "g4", "f4" };
+        vector<string> states;
+        states.push_back( doc.to_string(true) );
+        for (int i=0; i < 30; ++i)
+        {
+            stringstream src;
+            src << "(n " << pitches[i % 5] << " q v1)";
+            executer.execute(&cursor,
+                             LOMSE_NEW CmdAddNoteRest(src.str(), k_edit_mode_replace),
+                             &sel);
+            states.push_back( doc.to_string(true) );
+        }
+        CHECK( executer.get_num_checkpoints() == 2 );
+
+        for (int i=29; i >= 0; --i)
+        {
+            executer.undo(&cursor, &sel);
+            CHECK( doc.to_string(true) == states[i] );
+        }
+        CHECK( executer.get_num_checkpoints() == 0 );
+        CHECK( executer.is_undo_possible() == false );
+    }
+
+    TEST_FIXTURE(DocCommandTestFixture, undo_9006)
+    {
+        //9006. undo: partial checkpoints only copy the music data of the edited
+        //      instrument. Other instruments are not replaced
+
+        MyDocument3 doc(m_libraryScope);
+        doc.from_string("(score (vers 2.0)"
+            "(instrument#90 (musicData#91 (clef G)(n c4 q)(n e4 q)(barline)))"
+            "(instrument#100 (musicData#101 (clef F4)(n c3 q)(n#105 e3 q)(barline)))"
+            ")");
+        DocCursor cursor(&doc);
+        DocCommandExecuter executer(&doc);
+        executer.set_checkpoint_interval(0);
+        cursor.enter_element();
+        cursor.point_to(105L);
+        MySelectionSet sel(&doc);
+        ImoObj* pMD1 = doc.get_pointer_to_imo(91L);
+
+        string start = doc.to_string(true);
+        executer.execute(&cursor, LOMSE_NEW CmdAddNoteRest("(n g3 q v1)",
+                                                           k_edit_mode_replace), &sel);
+        string edited = doc.to_string(true);
+        CHECK( edited != start );
+        CHECK( doc.get_pointer_to_imo(91L) == pMD1 );
+
+        executer.undo(&cursor, &sel);
+        CHECK( doc.to_string(true) == start );
+        CHECK( doc.get_pointer_to_imo(91L) == pMD1 );
+        ImoScore* pScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        CHECK( pScore->get_instrument(1)->get_musicdata()->get_id() == 101L );
+        CHECK( pScore->get_staffobjs_table()->num_entries() == 8 );
+
+        executer.redo(&cursor, &sel);
+        CHECK( doc.to_string(true) == edited );
+    }
+
 }
@@ -65,6 +65,56 @@ public:
     ~DocLayouterTestFixture()
     {
     }
+
+    void load_multipage_document(Document& doc)
+    {
+        //small pages: a score followed by paragraphs, several pages
+        stringstream src;
+        src << "(lenmusdoc (vers 0.0) "
+            << "(pageLayout (pageSize 21000 6000)(pageMargins 1000 1000 1000 1000 0) portrait) "
+            << "(content "
+            << "(score (vers 2.0)(instrument (musicData (clef G)(n c4 q)(n e4 q)(barline))))";
+        for (int i=0; i < 20; ++i)
+            src << "(para (txt \"Paragraph " << i << "\"))";
+        src << "))";
+        doc.from_string(src.str());
+    }
+
+    void load_long_score_document(Document& doc)
+    {
+        //small pages: a long score, several pages, followed by a paragraph
+        stringstream src;
+        src << "(lenmusdoc (vers 0.0) "
+            << "(pageLayout (pageSize 21000 6000)(pageMargins 1000 1000 1000 1000 0) portrait) "
+            << "(content "
+            << "(score (vers 2.0)(instrument (musicData (clef G)(time 2 4)";
+        for (int i=0; i < 60; ++i)
+            src << "(n c4 q)(n e4 e)(n g4 e)(barline)";
+        src << ")))(para (txt \"The end\"))))";
+        doc.from_string(src.str());
+    }
+
+    ImoContentObj* get_content_item(Document& doc, int i)
+    {
+        return static_cast<ImoContentObj*>( doc.get_im_root()->get_content_item(i) );
+    }
+
+    bool same_layout(GraphicModel* pGM1, GraphicModel* pGM2)
+    {
+        if (pGM1->get_num_pages() != pGM2->get_num_pages())
+            return false;
+
+        for (int i=0; i < pGM1->get_num_pages(); ++i)
+        {
+            stringstream dump1;
+            stringstream dump2;
+            pGM1->dump_page(i, dump1);
+            pGM2->dump_page(i, dump2);
+            if (dump1.str() != dump2.str())
+                return false;
+        }
+        return true;
+    }
 };
 
 //---------------------------------------------------------------------------------------
@@ -499,5 +549,101 @@ SUITE(DocLayouterTest)
         delete pGModel;
     }
 
+    TEST_FIXTURE(DocLayouterTestFixture, DocLayouter_lazy_layout_first_page)
+    {
+        //@ lazy layout: only first page is created. Next pages are created when
+        //@ requested and the result is the same than a full layout
+
+        Document doc(m_libraryScope);
+        load_long_score_document(doc);
+        DocLayouter* pLayouter = LOMSE_NEW DocLayouter(&doc, m_libraryScope);
+        CHECK( pLayouter->layout_first_pages(1) == false );
+        CHECK( pLayouter->is_layout_suspended() == true );
+        GraphicModel* pGModel = pLayouter->get_graphic_model();
+        pGModel->build_main_boxes_table();
+        pGModel->set_pending_layout(pLayouter);
+
+        CHECK( pGModel->is_layout_finished() == false );
+        CHECK( pGModel->get_num_laid_out_pages() == 1 );
+        CHECK( pGModel->get_estimated_num_pages() > 1 );
+
+        GmoBoxDocPage* pFirstPage = pGModel->get_page(0);
+        CHECK( pGModel->get_num_laid_out_pages() == 1 );
+        CHECK( pGModel->get_page(2) != nullptr );
+        CHECK( pGModel->get_num_laid_out_pages() == 3 );
+        CHECK( pGModel->get_page(0) == pFirstPage );
+
+        DocLayouter full(&doc, m_libraryScope);
+        full.layout_document();
+        GraphicModel* pExpected = full.get_graphic_model();
+        CHECK( pGModel->get_num_pages() == pExpected->get_num_pages() );
+        CHECK( pGModel->is_layout_finished() == true );
+        CHECK( pGModel->get_estimated_num_pages() == pExpected->get_num_pages() );
+        CHECK( same_layout(pGModel, pExpected) );
+
+        delete pGModel;
+        delete pExpected;
+    }
+
+    TEST_FIXTURE(DocLayouterTestFixture, DocLayouter_lazy_layout_lookup_until_found)
+    {
+        //@ lazy layout: looking for the boxes of an object lays out pages only until
+        //@ the object is found
+
+        Document doc(m_libraryScope);
+        load_long_score_document(doc);
+        DocLayouter* pLayouter = LOMSE_NEW DocLayouter(&doc, m_libraryScope);
+        pLayouter->layout_first_pages(1);
+        GraphicModel* pGModel = pLayouter->get_graphic_model();
+        pGModel->build_main_boxes_table();
+        pGModel->set_pending_layout(pLayouter);
+
+        ImoObj* pScore = get_content_item(doc, 0);
+        CHECK( pGModel->get_box_for_imo(pScore->get_id()) != nullptr );
+        CHECK( pGModel->get_num_laid_out_pages() == 1 );
+
+        CHECK( pGModel->get_system_box(2, pScore->get_id()) != nullptr );
+        CHECK( pGModel->is_layout_finished() == false );
+
+        ImoObj* pPara = get_content_item(doc, 1);
+        CHECK( pGModel->get_box_for_imo(pPara->get_id()) != nullptr );
+        CHECK( pGModel->is_layout_finished() == true );
+
+        delete pGModel;
+    }
+
+    TEST_FIXTURE(DocLayouterTestFixture, DocLayouter_lazy_layout_not_finished)
+    {
+        //@ lazy layout: the model can be deleted with pages not yet laid out
+
+        Document doc(m_libraryScope);
+        load_long_score_document(doc);
+        DocLayouter* pLayouter = LOMSE_NEW DocLayouter(&doc, m_libraryScope);
+        pLayouter->layout_first_pages(2);
+        GraphicModel* pGModel = pLayouter->get_graphic_model();
+        pGModel->build_main_boxes_table();
+        pGModel->set_pending_layout(pLayouter);
+
+        CHECK( pGModel->get_num_laid_out_pages() == 2 );
+        CHECK( pGModel->get_page_bounds(5) == pGModel->get_page(1)->get_bounds() );
+        CHECK( pGModel->is_layout_finished() == false );
+
+        delete pGModel;
+    }
+
+    TEST_FIXTURE(DocLayouterTestFixture, DocLayouter_lazy_layout_one_page)
+    {
+        //@ lazy layout: nothing pending when the document fits in the first pages
+
+        Document doc(m_libraryScope);
+        load_multipage_document(doc);
+        DocLayouter dl(&doc, m_libraryScope);
+        CHECK( dl.layout_first_pages(100) == true );
+        CHECK( dl.is_layout_suspended() == false );
+        GraphicModel* pGModel = dl.get_graphic_model();
+        CHECK( pGModel->get_num_pages() > 2 );
+
+        delete pGModel;
+    }
 
 };
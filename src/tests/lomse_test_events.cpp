@@ -9,6 +9,10 @@
 
 #include <UnitTest++.h>
 #include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include "lomse_config.h"
 
 //classes related to these tests
@@ -16,6 +20,7 @@
 #include "private/lomse_document_p.h"
 #include "lomse_internal_model.h"
 #include "lomse_events.h"
+#include "lomse_events_dispatcher.h"
 #include "lomse_hyperlink_ctrl.h"
 #include "lomse_button_ctrl.h"
 
@@ -98,6 +103,68 @@ public:
     bool event_received() { return m_fEventReceived; }
 };
 
+//---------------------------------------------------------------------------------------
+// Helper, to wait for the events thread. Returns immediately when there is no
+// events thread
+static bool wait_for_dispatched(EventsDispatcher* pDispatcher, long numEvents)
+{
+    for (int i=0; i < 500 && pDispatcher->get_num_dispatched() < numEvents; ++i)
+        std::this_thread::sleep_for( std::chrono::milliseconds(2) );
+    return pDispatcher->get_num_dispatched() >= numEvents;
+}
+
+//---------------------------------------------------------------------------------------
+class MyEventSelectionChanged : public EventUpdateUI
+{
+public:
+    MyEventSelectionChanged() : EventUpdateUI(k_selection_set_change) {}
+};
+
+//---------------------------------------------------------------------------------------
+// Records the received events. Optionally, blocks when receiving the first event,
+// until unblock() is invoked
+class MyRecordingHandler : public EventHandler
+{
+protected:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_fBlock;
+    std::vector<EventInfo*> m_events;
+    std::vector<std::thread::id> m_threads;
+
+public:
+    MyRecordingHandler(bool fBlock=false) : m_fBlock(fBlock) {}
+    ~MyRecordingHandler() {}
+
+    void handle_event(SpEventInfo pEvent)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_events.push_back(pEvent.get());
+        m_threads.push_back( std::this_thread::get_id() );
+        m_cv.wait(lock, [this]{ return !m_fBlock; });
+    }
+
+    void unblock()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_fBlock = false;
+        }
+        m_cv.notify_all();
+    }
+
+    std::vector<EventInfo*> get_events()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_events;
+    }
+    std::vector<std::thread::id> get_threads()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_threads;
+    }
+};
+
 //---------------------------------------------------------------------------------------
 class DocumentEventsTestFixture
 {
@@ -154,6 +221,7 @@ SUITE(DocumentEventsTest)
         SpEventInfo ev( new MyEventOnClick(pLink, WpDocument(spDoc)) );
         spDoc->notify_observers(ev, pLink);
 
+        CHECK( wait_for_dispatched(m_libraryScope.get_events_dispatcher(), 1L) == true );
         CHECK( handler.event_received() == true );
     }
 
@@ -187,6 +255,7 @@ SUITE(DocumentEventsTest)
         SpEventInfo ev( new MyEventOnClick(pLink,WpDocument(spDoc)) );
         spDoc->notify_observers(ev, ev->get_source() );
 
+        CHECK( wait_for_dispatched(m_libraryScope.get_events_dispatcher(), 1L) == true );
         CHECK( handler.event_received() == true );
     }
 
@@ -208,6 +277,207 @@ SUITE(DocumentEventsTest)
         CHECK( handler.event_received() == true );
     }
 
+    TEST_FIXTURE(DocumentEventsTestFixture, dispatcher_statistics)
+    {
+        SpDocument spDoc( new MyDocument(m_libraryScope) );
+        spDoc->create_empty();
+        ImoParagraph* pPara = spDoc->add_paragraph();
+        ImoLink* pLink = pPara->add_link("Click me");
+        MyEventHandlerCPP handler;
+        pLink->add_event_handler(k_on_click_event, &handler);
+        EventsDispatcher* pDispatcher = m_libraryScope.get_events_dispatcher();
+        pDispatcher->reset_statistics();
+
+        SpEventInfo ev( new MyEventOnClick(pLink, WpDocument(spDoc)) );
+        spDoc->notify_observers(ev, pLink);
+        spDoc->notify_observers(ev, pLink);
+
+        CHECK( wait_for_dispatched(pDispatcher, 2L) == true );
+        CHECK( handler.event_received() == true );
+        CHECK( pDispatcher->get_num_dispatched() == 2L );
+        CHECK( pDispatcher->get_queue_depth() == 0 );
+        CHECK( pDispatcher->get_num_coalesced() == 0L );
+    }
+
+    TEST_FIXTURE(DocumentEventsTestFixture, dispatcher_keeps_order)
+    {
+        //events are dispatched in the order they were posted
+        SpDocument spDoc( new MyDocument(m_libraryScope) );
+        spDoc->create_empty();
+        MyRecordingHandler handler;
+        spDoc->add_event_handler(k_on_click_event, &handler);
+        spDoc->add_event_handler(k_selection_set_change, &handler);
+        Observer* pObserver = static_cast<MyDocument*>(spDoc.get())->my_get_first_observer();
+        EventsDispatcher* pDispatcher = m_libraryScope.get_events_dispatcher();
+        pDispatcher->set_coalescing_policy(k_coalesce_none);
+        pDispatcher->reset_statistics();
+
+        ImoObj* pImo = spDoc->get_im_root();
+        std::vector<SpEventInfo> posted;
+        for (int i=0; i < 50; ++i)
+        {
+            SpEventInfo ev;
+            if (i % 3 == 0)
+                ev = SpEventInfo( new MyEventSelectionChanged() );
+            else
+                ev = SpEventInfo( new MyEventOnClick(static_cast<ImoContentObj*>(pImo),
+                                                     WpDocument(spDoc)) );
+            posted.push_back(ev);
+            pDispatcher->post_event(pObserver, ev);
+        }
+
+        CHECK( wait_for_dispatched(pDispatcher, 50L) == true );
+        std::vector<EventInfo*> received = handler.get_events();
+        CHECK( received.size() == 50 );
+        bool fSameOrder = (received.size() == 50);
+        for (size_t i=0; fSameOrder && i < received.size(); ++i)
+            fSameOrder = (received[i] == posted[i].get());
+        CHECK( fSameOrder );
+        CHECK( pDispatcher->get_num_coalesced() == 0L );
+    }
+
+#if (LOMSE_DIRECT_INVOCATION == 0)
+    TEST_FIXTURE(DocumentEventsTestFixture, dispatcher_uses_events_thread)
+    {
+        //handlers are invoked from the events thread
+        SpDocument spDoc( new MyDocument(m_libraryScope) );
+        spDoc->create_empty();
+        MyRecordingHandler handler;
+        spDoc->add_event_handler(k_selection_set_change, &handler);
+        Observer* pObserver = static_cast<MyDocument*>(spDoc.get())->my_get_first_observer();
+        EventsDispatcher* pDispatcher = m_libraryScope.get_events_dispatcher();
+        pDispatcher->reset_statistics();
+
+        pDispatcher->post_event(pObserver, SpEventInfo( new MyEventSelectionChanged() ));
+
+        CHECK( wait_for_dispatched(pDispatcher, 1L) == true );
+        std::vector<std::thread::id> threads = handler.get_threads();
+        CHECK( threads.size() == 1 );
+        CHECK( threads.size() == 1 && threads[0] != std::this_thread::get_id() );
+    }
+
+    TEST_FIXTURE(DocumentEventsTestFixture, dispatcher_coalesces_ui_updates)
+    {
+        //While the events thread is busy, pending UI update events for the same
+        //observer are merged, keeping the newest one. Other events are not merged
+        SpDocument spDoc1( new MyDocument(m_libraryScope) );
+        spDoc1->create_empty();
+        SpDocument spDoc2( new MyDocument(m_libraryScope) );
+        spDoc2->create_empty();
+        MyRecordingHandler handler1(true);      //blocks on first event
+        MyRecordingHandler handler2;
+        spDoc1->add_event_handler(k_on_click_event, &handler1);
+        spDoc1->add_event_handler(k_selection_set_change, &handler1);
+        spDoc2->add_event_handler(k_selection_set_change, &handler2);
+        Observer* pObserver1 = static_cast<MyDocument*>(spDoc1.get())->my_get_first_observer();
+        Observer* pObserver2 = static_cast<MyDocument*>(spDoc2.get())->my_get_first_observer();
+        EventsDispatcher* pDispatcher = m_libraryScope.get_events_dispatcher();
+        pDispatcher->set_coalescing_policy(k_coalesce_ui_updates);
+        pDispatcher->reset_statistics();
+
+        //block the events thread
+        ImoContentObj* pImo = static_cast<ImoContentObj*>(spDoc1->get_im_root());
+        SpEventInfo click1( new MyEventOnClick(pImo, WpDocument(spDoc1)) );
+        pDispatcher->post_event(pObserver1, click1);
+        for (int i=0; i < 500 && handler1.get_events().empty(); ++i)
+            std::this_thread::sleep_for( std::chrono::milliseconds(2) );
+
+        SpEventInfo sel1( new MyEventSelectionChanged() );
+        SpEventInfo sel2( new MyEventSelectionChanged() );
+        SpEventInfo sel3( new MyEventSelectionChanged() );
+        SpEventInfo selOther( new MyEventSelectionChanged() );
+        SpEventInfo click2( new MyEventOnClick(pImo, WpDocument(spDoc1)) );
+        SpEventInfo click3( new MyEventOnClick(pImo, WpDocument(spDoc1)) );
+        pDispatcher->post_event(pObserver1, sel1);
+        pDispatcher->post_event(pObserver1, click2);
+        pDispatcher->post_event(pObserver2, selOther);
+        pDispatcher->post_event(pObserver1, sel2);
+        pDispatcher->post_event(pObserver1, click3);
+        pDispatcher->post_event(pObserver1, sel3);
+        CHECK( pDispatcher->get_queue_depth() == 4 );
+
+        handler1.unblock();
+        CHECK( wait_for_dispatched(pDispatcher, 5L) == true );
+
+        //sel3 replaces sel1 and keeps its place in the queue
+        std::vector<EventInfo*> received = handler1.get_events();
+        CHECK( received.size() == 4 );
+        if (received.size() == 4)
+        {
+            CHECK( received[0] == click1.get() );
+            CHECK( received[1] == sel3.get() );
+            CHECK( received[2] == click2.get() );
+            CHECK( received[3] == click3.get() );
+        }
+        CHECK( handler2.get_events().size() == 1 );
+        CHECK( pDispatcher->get_num_coalesced() == 2L );
+        CHECK( pDispatcher->get_num_dispatched() == 5L );
+
+        pDispatcher->set_coalescing_policy(k_coalesce_none);
+    }
+
+    TEST_FIXTURE(DocumentEventsTestFixture, dispatcher_merges_tracking_events)
+    {
+        //Pending visual tracking events are not replaced. The sub-events of the
+        //new event are appended to the pending one, so none is lost
+        SpDocument spDoc( new MyDocument(m_libraryScope) );
+        spDoc->create_empty();
+        MyRecordingHandler handler(true);      //blocks on first event
+        spDoc->add_event_handler(k_on_click_event, &handler);
+        spDoc->add_event_handler(k_tracking_event, &handler);
+        Observer* pObserver = static_cast<MyDocument*>(spDoc.get())->my_get_first_observer();
+        EventsDispatcher* pDispatcher = m_libraryScope.get_events_dispatcher();
+        pDispatcher->set_coalescing_policy(k_coalesce_ui_updates);
+        pDispatcher->reset_statistics();
+
+        //block the events thread
+        ImoContentObj* pImo = static_cast<ImoContentObj*>(spDoc->get_im_root());
+        SpEventInfo click( new MyEventOnClick(pImo, WpDocument(spDoc)) );
+        pDispatcher->post_event(pObserver, click);
+        for (int i=0; i < 500 && handler.get_events().empty(); ++i)
+            std::this_thread::sleep_for( std::chrono::milliseconds(2) );
+
+        SpEventVisualTracking track1( new EventVisualTracking(WpInteractor(), 10L) );
+        track1->add_item(EventVisualTracking::k_highlight_on, 20L);
+        track1->add_move_tempo_line_event(64.0);
+        SpEventVisualTracking track2( new EventVisualTracking(WpInteractor(), 10L) );
+        track2->add_item(EventVisualTracking::k_highlight_off, 20L);
+        track2->add_move_tempo_line_event(128.0);
+        SpEventVisualTracking track3( new EventVisualTracking(WpInteractor(), 10L) );
+        track3->add_item(EventVisualTracking::k_end_of_visual_tracking, 0L);
+        pDispatcher->post_event(pObserver, track1);
+        pDispatcher->post_event(pObserver, track2);
+        pDispatcher->post_event(pObserver, track3);
+        CHECK( pDispatcher->get_queue_depth() == 1 );
+
+        handler.unblock();
+        CHECK( wait_for_dispatched(pDispatcher, 2L) == true );
+
+        std::vector<EventInfo*> received = handler.get_events();
+        CHECK( received.size() == 2 );
+        if (received.size() == 2)
+        {
+            CHECK( received[1] == track1.get() );
+        }
+        CHECK( track1->get_num_items() == 5 );
+        std::list< pair<int, ImoId> >& items = track1->get_items();
+        std::list< pair<int, ImoId> >::iterator it = items.begin();
+        CHECK( it->first == EventVisualTracking::k_highlight_on );
+        ++it;
+        CHECK( it->first == EventVisualTracking::k_move_tempo_line );
+        ++it;
+        CHECK( it->first == EventVisualTracking::k_highlight_off );
+        ++it;
+        CHECK( it->first == EventVisualTracking::k_move_tempo_line );
+        ++it;
+        CHECK( it->first == EventVisualTracking::k_end_of_visual_tracking );
+        CHECK( track1->get_timepos() == 128.0 );
+        CHECK( pDispatcher->get_num_coalesced() == 2L );
+
+        pDispatcher->set_coalescing_policy(k_coalesce_none);
+    }
+#endif
+
 ////    TEST_FIXTURE(DocumentEventsTestFixture, ReplaceHandler)
 ////    {
 ////        Document doc(m_libraryScope);
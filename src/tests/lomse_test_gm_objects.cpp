@@ -21,6 +21,7 @@
 #include "lomse_internal_model.h"
 #include "lomse_shape_staff.h"
 #include "lomse_im_factory.h"
+#include "lomse_selections.h"
 #include "private/lomse_document_p.h"
 
 using namespace UnitTest;
@@ -35,7 +36,22 @@ public:
     MyGmoBoxDocPage(ImoObj* pCreatorImo) : GmoBoxDocPage(pCreatorImo) {}
     ~MyGmoBoxDocPage() {}
 
-    inline std::list<GmoShape*>& get_all_shapes() { return m_allShapes; }
+    inline std::vector<GmoShape*>& get_all_shapes() {
+        ensure_spatial_index();
+        return m_allShapes;
+    }
+};
+
+
+//---------------------------------------------------------------------------------------
+// for accessing selected shapes
+class MySelectionSet : public SelectionSet
+{
+public:
+    MySelectionSet(Document* pDoc) : SelectionSet(pDoc) {}
+    ~MySelectionSet() {}
+
+    inline std::list<GmoObj*>& my_get_gmos() { return m_gmos; }
 };
 
 
@@ -56,6 +72,18 @@ public:
     ~GmoTestFixture()    //TearDown fixture
     {
     }
+
+    GmoShape* add_rectangle(GmoBox* pBox, ImoStaffInfo* pInfo, int layer, LUnits x,
+                            LUnits y, LUnits width, LUnits height)
+    {
+        GmoShapeStaff* pShape = LOMSE_NEW GmoShapeStaff(pInfo, 0, pInfo, 0, width,
+                                                        Color(0,0,0));
+        pBox->add_shape(pShape, layer);
+        pShape->set_origin(x, y);
+        pShape->set_width(width);
+        pShape->set_height(height);
+        return pShape;
+    }
 };
 
 //---------------------------------------------------------------------------------------
@@ -222,8 +250,8 @@ SUITE(GmoTest)
         pScorePage->add_system(pBox, 0);
         pBox->add_shapes_to_tables();
 
-        std::list<GmoShape*>& shapes = page.get_all_shapes();
-        std::list<GmoShape*>::iterator it = shapes.begin();
+        std::vector<GmoShape*>& shapes = page.get_all_shapes();
+        std::vector<GmoShape*>::iterator it = shapes.begin();
 
         //cout << (*it)->get_layer() << endl;
         CHECK( (*it) == pShape4 );
@@ -254,6 +282,134 @@ SUITE(GmoTest)
         delete pInfo;
     }
 
+    TEST_FIXTURE(GmoTestFixture, DocPage_SpatialIndex_FindShapeAt)
+    {
+        Document doc(m_libraryScope);
+        GmoBoxDocPage page(nullptr);
+        GmoBoxDocPageContent* pDPC = LOMSE_NEW GmoBoxDocPageContent(nullptr);
+        page.add_child_box(pDPC);
+        ImoStaffInfo* pInfo = static_cast<ImoStaffInfo*>(
+                                    ImFactory::inject(k_imo_staff_info, &doc));
+
+        //a background shape and a grid of 10x10 shapes, 100x100 each, with gaps
+        GmoShape* pBackground = add_rectangle(pDPC, pInfo, GmoShape::k_layer_background,
+                                              0.0f, 0.0f, 2000.0f, 2000.0f);
+        GmoShape* shapes[10][10];
+        for (int i=0; i < 10; ++i)
+            for (int j=0; j < 10; ++j)
+                shapes[i][j] = add_rectangle(pDPC, pInfo, GmoShape::k_layer_notes,
+                                             200.0f * j, 200.0f * i, 100.0f, 100.0f);
+        //shape in lower layer created after the others
+        add_rectangle(pDPC, pInfo, GmoShape::k_layer_staff, 0.0f, 0.0f, 50.0f, 50.0f);
+        pDPC->add_shapes_to_tables();
+        page.build_spatial_index();
+
+        bool fOk = true;
+        for (int i=0; i < 10; ++i)
+        {
+            for (int j=0; j < 10; ++j)
+            {
+                fOk &= (page.find_shape_at(200.0f * j + 10.0f, 200.0f * i + 10.0f)
+                        == shapes[i][j]);
+                fOk &= (page.find_shape_at(200.0f * j + 150.0f, 200.0f * i + 150.0f)
+                        == pBackground);
+            }
+        }
+        CHECK( fOk == true );
+        CHECK( page.find_shape_at(2500.0f, 100.0f) == nullptr );
+        CHECK( page.find_shape_at(-10.0f, 100.0f) == nullptr );
+        CHECK( page.get_num_shapes_in_page() == 102 );
+        delete pInfo;
+    }
+
+    TEST_FIXTURE(GmoTestFixture, DocPage_SpatialIndex_RebuiltWhenShapesAdded)
+    {
+        Document doc(m_libraryScope);
+        GmoBoxDocPage page(nullptr);
+        GmoBoxDocPageContent* pDPC = LOMSE_NEW GmoBoxDocPageContent(nullptr);
+        page.add_child_box(pDPC);
+        ImoStaffInfo* pInfo = static_cast<ImoStaffInfo*>(
+                                    ImFactory::inject(k_imo_staff_info, &doc));
+
+        GmoShape* pShape1 = add_rectangle(pDPC, pInfo, GmoShape::k_layer_notes,
+                                          0.0f, 0.0f, 100.0f, 100.0f);
+        page.add_to_tables(pShape1);
+        CHECK( page.find_shape_at(50.0f, 50.0f) == pShape1 );
+        CHECK( page.find_shape_at(500.0f, 500.0f) == nullptr );
+
+        GmoShape* pShape2 = add_rectangle(pDPC, pInfo, GmoShape::k_layer_notes,
+                                          400.0f, 400.0f, 200.0f, 200.0f);
+        page.add_to_tables(pShape2);
+        CHECK( page.find_shape_at(500.0f, 500.0f) == pShape2 );
+        delete pInfo;
+    }
+
+    TEST_FIXTURE(GmoTestFixture, DocPage_SpatialIndex_RebuiltWhenShapesMoved)
+    {
+        Document doc(m_libraryScope);
+        GmoBoxDocPage page(nullptr);
+        GmoBoxDocPageContent* pDPC = LOMSE_NEW GmoBoxDocPageContent(nullptr);
+        page.add_child_box(pDPC);
+        GmoBoxSystem* pBox = LOMSE_NEW GmoBoxSystem(nullptr);
+        pDPC->add_child_box(pBox);
+        ImoStaffInfo* pInfo = static_cast<ImoStaffInfo*>(
+                                    ImFactory::inject(k_imo_staff_info, &doc));
+
+        GmoShape* pShape1 = add_rectangle(pDPC, pInfo, GmoShape::k_layer_notes,
+                                          0.0f, 0.0f, 100.0f, 100.0f);
+        GmoShape* pShape2 = add_rectangle(pBox, pInfo, GmoShape::k_layer_notes,
+                                          1000.0f, 1000.0f, 100.0f, 100.0f);
+        pDPC->add_shapes_to_tables();
+        page.build_spatial_index();
+        CHECK( page.find_shape_at(50.0f, 50.0f) == pShape1 );
+        CHECK( page.find_shape_at(1050.0f, 1050.0f) == pShape2 );
+
+        //move shape, out of the current grid bounds
+        pShape1->set_origin(3000.0f, 200.0f);
+        CHECK( page.find_shape_at(50.0f, 50.0f) == nullptr );
+        CHECK( page.find_shape_at(3050.0f, 250.0f) == pShape1 );
+
+        pShape1->shift_origin(USize(-2500.0f, 0.0f));
+        CHECK( page.find_shape_at(3050.0f, 250.0f) == nullptr );
+        CHECK( page.find_shape_at(550.0f, 250.0f) == pShape1 );
+
+        //move a box and its content
+        pBox->shift_origin_and_content(USize(0.0f, 2000.0f));
+        CHECK( page.find_shape_at(1050.0f, 1050.0f) == nullptr );
+        CHECK( page.find_shape_at(1050.0f, 3050.0f) == pShape2 );
+        delete pInfo;
+    }
+
+    TEST_FIXTURE(GmoTestFixture, DocPage_SpatialIndex_SelectInRectangle)
+    {
+        Document doc(m_libraryScope);
+        GmoBoxDocPage page(nullptr);
+        GmoBoxDocPageContent* pDPC = LOMSE_NEW GmoBoxDocPageContent(nullptr);
+        page.add_child_box(pDPC);
+        ImoStaffInfo* pInfo = static_cast<ImoStaffInfo*>(
+                                    ImFactory::inject(k_imo_staff_info, &doc));
+
+        add_rectangle(pDPC, pInfo, GmoShape::k_layer_background,
+                      0.0f, 0.0f, 2000.0f, 2000.0f);
+        GmoShape* shapes[10][10];
+        for (int i=0; i < 10; ++i)
+            for (int j=0; j < 10; ++j)
+                shapes[i][j] = add_rectangle(pDPC, pInfo, GmoShape::k_layer_notes,
+                                             200.0f * j, 200.0f * i, 100.0f, 100.0f);
+        pDPC->add_shapes_to_tables();
+
+        //rectangle containing shapes [1..2][3..4]
+        MySelectionSet selection(&doc);
+        page.select_objects_in_rectangle(&selection, URect(550.0f, 150.0f, 400.0f, 400.0f));
+        std::list<GmoObj*>& gmos = selection.my_get_gmos();
+        CHECK( gmos.size() == 4 );
+        CHECK( std::find(gmos.begin(), gmos.end(), shapes[1][3]) != gmos.end() );
+        CHECK( std::find(gmos.begin(), gmos.end(), shapes[1][4]) != gmos.end() );
+        CHECK( std::find(gmos.begin(), gmos.end(), shapes[2][3]) != gmos.end() );
+        CHECK( std::find(gmos.begin(), gmos.end(), shapes[2][4]) != gmos.end() );
+        delete pInfo;
+    }
+
     TEST_FIXTURE(GmoTestFixture, Shape_SetOrigin)
     {
         Document doc(m_libraryScope);
@@ -1191,6 +1191,72 @@ SUITE(InternalModelTest)
         CHECK( pStyle->font_size() == 21.0f );
     }
 
+    TEST_FIXTURE(InternalModelTestFixture, Style_parent_changes_are_inherited)
+    {
+        //@ Style_parent_changes_are_inherited. Resolved values are updated when
+        //@ a parent style is modified after reading the child values
+        Document doc(m_libraryScope);
+        doc.create_empty();
+        ImoDocument* pDoc = doc.get_im_root();
+        ImoStyle* pStyle = pDoc->create_private_style();
+        ImoStyle* pParent = pStyle->get_parent_style();
+
+        CHECK( pParent != nullptr );
+        CHECK( pStyle->font_size() == 12.0f );
+        CHECK( pStyle->margin_top() == pParent->margin_top() );
+
+        pParent->font_size(15.0f);
+        pParent->margin_top(700.0f);
+        CHECK( pStyle->font_size() == 15.0f );
+        CHECK( pStyle->margin_top() == 700.0f );
+
+        pStyle->font_size(21.0f);
+        CHECK( pStyle->font_size() == 21.0f );
+        CHECK( pParent->font_size() == 15.0f );
+    }
+
+    TEST_FIXTURE(InternalModelTestFixture, Style_changes_only_invalidate_own_document)
+    {
+        //@ Style_changes_only_invalidate_own_document. Modifying a style of a
+        //@ document does not invalidate the resolved styles of other documents
+        Document doc1(m_libraryScope);
+        doc1.create_empty();
+        Document doc2(m_libraryScope);
+        doc2.create_empty();
+        ImoStyle* pStyle1 = doc1.get_im_root()->create_private_style();
+        ImoStyle* pStyle2 = doc2.get_im_root()->create_private_style();
+        CHECK( pStyle2->font_size() == 12.0f );
+        long epoch1 = doc1.get_doc_model()->get_styles_epoch();
+        long epoch2 = doc2.get_doc_model()->get_styles_epoch();
+
+        pStyle1->font_size(15.0f);
+
+        CHECK( doc1.get_doc_model()->get_styles_epoch() != epoch1 );
+        CHECK( doc2.get_doc_model()->get_styles_epoch() == epoch2 );
+        CHECK( pStyle1->font_size() == 15.0f );
+        CHECK( pStyle2->font_size() == 12.0f );
+    }
+
+    TEST_FIXTURE(InternalModelTestFixture, Style_font_name_not_invalidated_by_other_styles)
+    {
+        //@ Style_font_name_not_invalidated_by_other_styles. The reference returned
+        //@ by font_name() is still valid after modifying other styles
+        Document doc(m_libraryScope);
+        doc.create_empty();
+        ImoDocument* pDoc = doc.get_im_root();
+        ImoStyle* pStyle = pDoc->create_private_style();
+        ImoStyle* pOther = pDoc->create_private_style();
+        pStyle->font_name("Liberation Sans");
+        const std::string& name = pStyle->font_name();
+
+        pOther->font_name("Liberation Serif");
+        pOther->font_size(15.0f);
+        CHECK( pStyle->font_size() == 12.0f );
+
+        CHECK( &name == &pStyle->font_name() );
+        CHECK( name == "Liberation Sans" );
+    }
+
 
     //@ ImoArticulationSymbol ------------------------------------------------------------
 
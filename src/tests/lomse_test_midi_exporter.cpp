@@ -0,0 +1,344 @@
+//---------------------------------------------------------------------------------------
+// This file is part of the Lomse library.
+// Copyright (c) 2010-present, Lomse Developers
+//
+// Licensed under the MIT license.
+//
+// See LICENSE and NOTICE.md files in the root directory of this source tree.
+//---------------------------------------------------------------------------------------
+
+#include <UnitTest++.h>
+#include <sstream>
+#include "lomse_build_options.h"
+
+//classes related to these tests
+#include "lomse_injectors.h"
+#include "lomse_midi_exporter.h"
+#include "lomse_midi_table.h"
+#include "private/lomse_document_p.h"
+#include "lomse_internal_model.h"
+
+
+using namespace UnitTest;
+using namespace std;
+using namespace lomse;
+
+//---------------------------------------------------------------------------------------
+// Helper: a decoded SMF event
+struct DecodedMidiEvent
+{
+    int track;
+    long tick;
+    std::vector<unsigned char> data;
+};
+
+//---------------------------------------------------------------------------------------
+class MidiExporterTestFixture
+{
+public:
+    LibraryScope m_libraryScope;
+    string m_scores_path;
+    Document* m_pDoc;
+    ImoScore* m_pScore;
+
+    int m_format;
+    int m_numTracks;
+    int m_division;
+    std::vector<DecodedMidiEvent> m_events;
+
+    MidiExporterTestFixture()     //SetUp fixture
+        : m_libraryScope(cout)
+        , m_scores_path(TESTLIB_SCORES_PATH)
+        , m_pDoc(nullptr)
+        , m_pScore(nullptr)
+        , m_format(-1)
+        , m_numTracks(0)
+        , m_division(0)
+    {
+        m_scores_path += "unit-tests/";
+        m_libraryScope.set_default_fonts_path(TESTLIB_FONTS_PATH);
+    }
+
+    ~MidiExporterTestFixture()    //TearDown fixture
+    {
+        delete m_pDoc;
+        m_pDoc = nullptr;
+        m_pScore = nullptr;
+    }
+
+    void load_ldp_string(const std::string& src)
+    {
+        m_pDoc = LOMSE_NEW Document(m_libraryScope, cout);
+        m_pDoc->from_string(src);
+        m_pScore = static_cast<ImoScore*>( m_pDoc->get_im_root()->get_content_item(0) );
+    }
+
+    void load_mxl_score(const std::string& score)
+    {
+        m_pDoc = LOMSE_NEW Document(m_libraryScope, cout);
+        m_pDoc->from_file(m_scores_path + score, Document::k_format_mxl);
+        m_pScore = static_cast<ImoScore*>( m_pDoc->get_im_root()->get_content_item(0) );
+    }
+
+    void load_simple_score()
+    {
+        load_ldp_string("(score (vers 2.0) (instrument (musicData "
+            "(clef G)(time 4 4)(n c4 h)(n e4 h)(barline) )))");
+    }
+
+    static long read_number(const string& s, size_t pos, int bytes)
+    {
+        long value = 0L;
+        for (int i=0; i < bytes; ++i)
+            value = (value << 8) | (static_cast<unsigned char>(s[pos+i]));
+        return value;
+    }
+
+    bool decode(const string& smf)
+    {
+        m_events.clear();
+        if (smf.size() < 14 || smf.substr(0, 4) != "MThd")
+            return false;
+
+        m_format = int(read_number(smf, 8, 2));
+        m_numTracks = int(read_number(smf, 10, 2));
+        m_division = int(read_number(smf, 12, 2));
+
+        size_t pos = 14;
+        for (int track=0; track < m_numTracks; ++track)
+        {
+            if (smf.substr(pos, 4) != "MTrk")
+                return false;
+            size_t end = pos + 8 + size_t(read_number(smf, pos + 4, 4));
+            pos += 8;
+            long tick = 0L;
+            while (pos < end)
+            {
+                long delta = 0L;
+                unsigned char c;
+                do {
+                    c = static_cast<unsigned char>(smf[pos++]);
+                    delta = (delta << 7) | (c & 0x7F);
+                } while (c & 0x80);
+                tick += delta;
+
+                DecodedMidiEvent ev;
+                ev.track = track;
+                ev.tick = tick;
+                unsigned char status = static_cast<unsigned char>(smf[pos]);
+                size_t len = 0;
+                if (status == 0xFF)
+                    len = 3 + static_cast<unsigned char>(smf[pos+2]);
+                else if ((status & 0xF0) == 0xC0)
+                    len = 2;
+                else
+                    len = 3;
+                ev.data.assign(smf.begin() + pos, smf.begin() + pos + len);
+                m_events.push_back(ev);
+                pos += len;
+            }
+        }
+        return pos == smf.size();
+    }
+
+    int count_events(unsigned char status, unsigned char mask=0xF0)
+    {
+        int count = 0;
+        for (auto& ev : m_events)
+        {
+            if ((ev.data[0] & mask) == status)
+                ++count;
+        }
+        return count;
+    }
+
+    int count_meta(unsigned char type)
+    {
+        int count = 0;
+        for (auto& ev : m_events)
+        {
+            if (ev.data[0] == 0xFF && ev.data[1] == type)
+                ++count;
+        }
+        return count;
+    }
+
+    DecodedMidiEvent* find_meta(unsigned char type)
+    {
+        for (auto& ev : m_events)
+        {
+            if (ev.data[0] == 0xFF && ev.data[1] == type)
+                return &ev;
+        }
+        return nullptr;
+    }
+
+};
+
+
+SUITE(MidiExporterTest)
+{
+
+    TEST_FIXTURE(MidiExporterTestFixture, midi_exporter_001)
+    {
+        //@001. Header chunk: format 1, conductor track plus one track per channel
+
+        load_simple_score();
+        MidiExporter exporter(m_libraryScope);
+        stringstream out;
+        CHECK( exporter.export_score(m_pScore, out) == true );
+
+        CHECK( decode(out.str()) == true );
+        CHECK( m_format == 1 );
+        CHECK( m_numTracks == 2 );
+        CHECK( m_division == 480 );
+    }
+
+    TEST_FIXTURE(MidiExporterTestFixture, midi_exporter_002)
+    {
+        //@002. Notes are exported with times converted to ticks
+
+        load_simple_score();
+        MidiExporter exporter(m_libraryScope);
+        exporter.set_ticks_per_quarter(96);
+        stringstream out;
+        exporter.export_score(m_pScore, out);
+
+        CHECK( decode(out.str()) == true );
+        CHECK( m_division == 96 );
+        CHECK( count_events(0x90) == 2 );
+        CHECK( count_events(0x80) == 2 );
+        std::vector<long> noteOnTicks;
+        for (auto& ev : m_events)
+        {
+            if ((ev.data[0] & 0xF0) == 0x90)
+                noteOnTicks.push_back(ev.tick);
+        }
+        CHECK( noteOnTicks.size() == 2 );
+        CHECK( noteOnTicks[0] == 0L );
+        CHECK( noteOnTicks[1] == 192L );
+    }
+
+    TEST_FIXTURE(MidiExporterTestFixture, midi_exporter_003)
+    {
+        //@003. Default tempo and time signature in conductor track
+
+        load_simple_score();
+        MidiExporter exporter(m_libraryScope);
+        stringstream out;
+        exporter.export_score(m_pScore, out);
+
+        CHECK( decode(out.str()) == true );
+        DecodedMidiEvent* pTempo = find_meta(0x51);
+        CHECK( pTempo != nullptr );
+        CHECK( pTempo && pTempo->track == 0 );
+        CHECK( pTempo && read_number(string(pTempo->data.begin(), pTempo->data.end()),
+                                     3, 3) == 1000000L );
+        DecodedMidiEvent* pTS = find_meta(0x58);
+        CHECK( pTS != nullptr );
+        CHECK( pTS && pTS->data[3] == 4 );     //numerator
+        CHECK( pTS && pTS->data[4] == 2 );     //denominator: 2^2
+    }
+
+    TEST_FIXTURE(MidiExporterTestFixture, midi_exporter_004)
+    {
+        //@004. Forced tempo
+
+        load_simple_score();
+        MidiExporter exporter(m_libraryScope);
+        exporter.set_tempo(120.0f);
+        stringstream out;
+        exporter.export_score(m_pScore, out);
+
+        CHECK( decode(out.str()) == true );
+        CHECK( count_meta(0x51) == 1 );
+        DecodedMidiEvent* pTempo = find_meta(0x51);
+        CHECK( pTempo && read_number(string(pTempo->data.begin(), pTempo->data.end()),
+                                     3, 3) == 500000L );
+    }
+
+    TEST_FIXTURE(MidiExporterTestFixture, midi_exporter_005)
+    {
+        //@005. Repetitions are expanded
+
+        load_mxl_score("repeats/01-repeat-end-repetition-barline.xml");
+        MidiExporter exporter(m_libraryScope);
+
+        stringstream asWritten;
+        exporter.set_expand_jumps(false);
+        exporter.export_score(m_pScore, asWritten);
+        CHECK( decode(asWritten.str()) == true );
+        int notesWritten = count_events(0x90);
+
+        stringstream expanded;
+        exporter.set_expand_jumps(true);
+        exporter.export_score(m_pScore, expanded);
+        CHECK( decode(expanded.str()) == true );
+        int notesExpanded = count_events(0x90);
+
+        //measures 1 to 3 (one note each) are played twice
+        CHECK( notesWritten == 5 );
+        CHECK( notesExpanded == 8 );
+
+        //jumps counters are left clean for ScorePlayer
+        SoundEventsTable* pTable = m_pScore->get_midi_table();
+        for (int i=0; i < pTable->num_jumps(); ++i)
+            CHECK( pTable->get_jump(i)->get_visited() == 0 );
+    }
+
+    TEST_FIXTURE(MidiExporterTestFixture, midi_exporter_006)
+    {
+        //@006. Metronome track: one click per beat, accented first beat
+
+        load_simple_score();
+        MidiExporter exporter(m_libraryScope);
+        exporter.set_metronome_track(true);
+        stringstream out;
+        exporter.export_score(m_pScore, out);
+
+        CHECK( decode(out.str()) == true );
+        CHECK( m_numTracks == 3 );
+        int clicks = 0;
+        int accented = 0;
+        for (auto& ev : m_events)
+        {
+            if (ev.track == 2 && ev.data[0] == 0x99)
+            {
+                ++clicks;
+                if (ev.data[1] == 60)
+                    ++accented;
+            }
+        }
+        CHECK( clicks == 4 );
+        CHECK( accented == 1 );
+    }
+
+    TEST_FIXTURE(MidiExporterTestFixture, midi_exporter_007)
+    {
+        //@007. Expanding repetitions does not modify the jump counters used by
+        //@     ScorePlayer, that could be playing the score
+
+        load_mxl_score("repeats/01-repeat-end-repetition-barline.xml");
+        SoundEventsTable* pTable = m_pScore->get_midi_table();
+        CHECK( pTable->num_jumps() > 0 );
+        JumpEntry* pJump = pTable->get_jump(0);
+        pJump->increment_visited();
+        pJump->increment_applied();
+
+        MidiExporter exporter(m_libraryScope);
+        exporter.set_expand_jumps(true);
+        stringstream out;
+        exporter.export_score(m_pScore, out);
+
+        CHECK( decode(out.str()) == true );
+        CHECK( count_events(0x90) == 8 );
+        CHECK( pJump->get_visited() == 1 );
+        CHECK( pJump->get_executed() == 1 );
+        for (int i=1; i < pTable->num_jumps(); ++i)
+        {
+            CHECK( pTable->get_jump(i)->get_visited() == 0 );
+            CHECK( pTable->get_jump(i)->get_executed() == 0 );
+        }
+    }
+
+}
@@ -31,6 +31,19 @@ using namespace std;
 using namespace lomse;
 
 
+//---------------------------------------------------------------------------------------
+// helper, for accessing protected members
+class MyModelBuilder : public ModelBuilder
+{
+public:
+    MyModelBuilder() : ModelBuilder() {}
+
+    void my_find_dirty_measures(ImoScore* pScore, int iInstr, int* pFirst, int* pLast)
+    {
+        find_dirty_measures(pScore, iInstr, pFirst, pLast);
+    }
+};
+
 //---------------------------------------------------------------------------------------
 class ModelBuilderTestFixture
 {
@@ -48,6 +61,31 @@ public:
     ~ModelBuilderTestFixture()    //TearDown fixture
     {
     }
+
+    ImoNote* get_note(ImoScore* pScore, int iInstr, int iNote)
+    {
+        ImoMusicData* pMD = pScore->get_instrument(iInstr)->get_musicdata();
+        ImoObj::children_iterator it;
+        for (it = pMD->begin(); it != pMD->end(); ++it)
+        {
+            if ((*it)->is_note() && iNote-- == 0)
+                return static_cast<ImoNote*>(*it);
+        }
+        return nullptr;
+    }
+
+    vector<ColStaffObjsEntry*> get_entries(ImoScore* pScore, int iInstr)
+    {
+        vector<ColStaffObjsEntry*> entries;
+        ColStaffObjs* pTable = pScore->get_staffobjs_table();
+        ColStaffObjsIterator it;
+        for (it = pTable->begin(); it != pTable->end(); ++it)
+        {
+            if ((*it)->num_instrument() == iInstr)
+                entries.push_back(*it);
+        }
+        return entries;
+    }
 };
 
 SUITE(ModelBuilderTest)
@@ -73,6 +111,202 @@ SUITE(ModelBuilderTest)
         if (pRoot && !pRoot->is_document()) delete pRoot;
     }
 
+    TEST_FIXTURE(ModelBuilderTestFixture, model_builder_01)
+    {
+        //@01. scoped structurize: pitch is only assigned in the given measures
+
+        Document doc(m_libraryScope);
+        doc.from_string(
+            "(score (vers 2.0)(instrument (musicData "
+            "(clef G)(n c4 q)(n c4 q)(barline)(n +c4 q)(n c4 q)(barline)"
+            "(n c4 q)(n c4 q)(barline)(n c4 q)(n c4 q)(barline)"
+            ")))" );
+        ImoScore* pScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        ImoNote* pNote2 = get_note(pScore, 0, 2);
+        ImoNote* pNote3 = get_note(pScore, 0, 3);
+        ImoNote* pNote7 = get_note(pScore, 0, 7);
+        CHECK( pNote3->get_notated_accidentals() == k_no_accidentals );
+
+        //remove sharp from note 2. Note 3 is c#4 and now requires the sharp
+        pNote2->set_notated_pitch(k_step_C, k_octave_4, k_no_accidentals);
+        pNote7->set_notated_accidentals(k_flat);
+        ModelBuilder builder;
+        builder.structurize(pScore, 0, 1, 1);
+
+        CHECK( pNote2->get_notated_accidentals() == k_no_accidentals );
+        CHECK( pNote3->get_notated_accidentals() == k_sharp );
+#if (LOMSE_DEBUG == 0)
+        //measure 3 not processed
+        CHECK( pNote7->get_notated_accidentals() == k_flat );
+        CHECK( builder.check_structurize(pScore) == false );
+#endif
+        CHECK( pNote7->get_notated_accidentals() == k_no_accidentals );
+        CHECK( builder.check_structurize(pScore) == true );
+    }
+
+    TEST_FIXTURE(ModelBuilderTestFixture, model_builder_02)
+    {
+        //@02. scoped structurize: a key signature in the range affects all
+        //@    following measures
+
+        Document doc(m_libraryScope);
+        doc.from_string(
+            "(score (vers 2.0)(instrument (musicData "
+            "(clef G)(key C)(n c4 q)(barline)(n f4 q)(barline)(n f4 q)(barline)"
+            "(n f4 q)(barline)"
+            ")))" );
+        ImoScore* pScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        ImoNote* pNote3 = get_note(pScore, 0, 3);
+        pNote3->set_notated_accidentals(k_flat);
+
+        ModelBuilder builder;
+        builder.structurize(pScore, 0, 0, 0);
+
+        CHECK( pNote3->get_notated_accidentals() == k_no_accidentals );
+        CHECK( builder.check_structurize(pScore) == true );
+    }
+
+    TEST_FIXTURE(ModelBuilderTestFixture, model_builder_03)
+    {
+        //@03. dirty measures are derived from dirty flags
+
+        Document doc(m_libraryScope);
+        doc.from_string(
+            "(score (vers 2.0)(instrument (musicData "
+            "(clef G)(n c4 q)(barline)(n d4 q)(barline)(n e4 q)(barline)"
+            "(n f4 q)(barline)"
+            ")))" );
+        doc.get_im_root()->clear_dirty_flags();
+        ImoScore* pScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        ImoMusicData* pMD = pScore->get_instrument(0)->get_musicdata();
+        MyModelBuilder builder;
+        int first, last;
+
+        get_note(pScore, 0, 2)->set_dirty(true);
+        builder.my_find_dirty_measures(pScore, 0, &first, &last);
+        CHECK( first == 2 );
+        CHECK( last == 2 );
+
+        //barline: next measure is also modified
+        pMD->get_child(2)->set_dirty(true);
+        builder.my_find_dirty_measures(pScore, 0, &first, &last);
+        CHECK( first == 0 );
+        CHECK( last == 2 );
+
+        //children added or removed: whole instrument
+        pMD->set_dirty(true);
+        builder.my_find_dirty_measures(pScore, 0, &first, &last);
+        CHECK( first == 0 );
+        CHECK( last == -1 );
+    }
+
+    TEST_FIXTURE(ModelBuilderTestFixture, model_builder_04)
+    {
+        //@04. scoped structurize: only the table entries and the measures table for
+        //@    the instrument are created again
+
+        Document doc(m_libraryScope);
+        doc.from_string(
+            "(score (vers 2.0)"
+            "(instrument (musicData (clef G)(key D)(time 2 4)(n c4 q)(n d4 q)(barline)"
+            "(n e4 h)(barline)))"
+            "(instrument (musicData (clef F4)(key D)(time 2 4)(n c3 h)(barline)"
+            "(n e3 q)(n f3 q)(barline)))"
+            ")" );
+        ImoScore* pScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        ColStaffObjs* pTable = pScore->get_staffobjs_table();
+        vector<ColStaffObjsEntry*> entries = get_entries(pScore, 0);
+        ImMeasuresTable* pMeasures = pScore->get_instrument(0)->get_measures_table();
+
+        //a note at start shifts all other staffobjs in second instrument
+        ImoInstrument* pInstr = pScore->get_instrument(1);
+        pInstr->insert_staffobj_at(get_note(pScore, 1, 0), "(n a2 q)");
+        ModelBuilder builder;
+        builder.structurize(pScore, 1, 0, -1);
+
+        CHECK( pScore->get_staffobjs_table() == pTable );
+        CHECK( get_entries(pScore, 0) == entries );
+        CHECK( pScore->get_instrument(0)->get_measures_table() == pMeasures );
+        CHECK( get_note(pScore, 1, 1)->get_time() == 64.0 );
+        CHECK( builder.check_structurize(pScore) == true );
+    }
+
+    TEST_FIXTURE(ModelBuilderTestFixture, model_builder_05)
+    {
+        //@05. scoped structurize: entries at the same time in other instruments are
+        //@    ordered as in a full build
+
+        Document doc(m_libraryScope);
+        doc.from_string(
+            "(score (vers 2.0)"
+            "(instrument (musicData (clef G)(key F)(time 3 4)(n c4 h.)(barline)"
+            "(clef F4)(n c3 q)(n d3 h)(barline)))"
+            "(instrument (staves 2)(musicData (clef G p1)(clef F4 p2)(key F)(time 3 4)"
+            "(n c4 q p1)(n d4 h p1)(barline)(n e4 h. p1)(barline)))"
+            "(instrument (musicData (clef C3)(key F)(time 3 4)(n c4 h.)(barline)"
+            "(clef G)(n e4 h.)(barline)))"
+            ")" );
+        ImoScore* pScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        vector<ColStaffObjsEntry*> entries0 = get_entries(pScore, 0);
+        vector<ColStaffObjsEntry*> entries2 = get_entries(pScore, 2);
+
+        //clefs at the same time than key and time signatures and barlines
+        ImoInstrument* pInstr = pScore->get_instrument(1);
+        pInstr->insert_staffobj_at(get_note(pScore, 1, 0), "(clef C1 p1)");
+        pInstr->insert_staffobj_at(get_note(pScore, 1, 2), "(clef G p2)");
+        ModelBuilder builder;
+        builder.structurize(pScore, 1, 0, -1);
+
+        CHECK( get_entries(pScore, 0) == entries0 );
+        CHECK( get_entries(pScore, 2) == entries2 );
+        CHECK( builder.check_structurize(pScore) == true );
+
+        //staffobjs removed
+        ImoNote* pNote = get_note(pScore, 1, 1);
+        pInstr->get_musicdata()->remove_child_imo(pNote);
+        delete pNote;
+        builder.structurize(pScore, 1, 0, -1);
+        CHECK( builder.check_structurize(pScore) == true );
+    }
+
+    TEST_FIXTURE(ModelBuilderTestFixture, model_builder_06)
+    {
+        //@06. scoped structurize: the table is fully rebuilt when lines for next
+        //@    instruments change or there are grace notes
+
+        Document doc(m_libraryScope);
+        doc.from_string(
+            "(score (vers 2.0)"
+            "(instrument (musicData (clef G)(n c4 q)(n d4 q)(barline)))"
+            "(instrument (musicData (clef G)(n e4 h)(barline)))"
+            "(instrument (musicData (clef F4)(n c3 h)(barline)))"
+            ")" );
+        ImoScore* pScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        ColStaffObjs* pTable = pScore->get_staffobjs_table();
+        int numLines = pTable->num_lines();
+
+        //new voice: new line for instrument 1
+        ImoInstrument* pInstr = pScore->get_instrument(1);
+        ImoStaffObj* pBarline = static_cast<ImoStaffObj*>(
+                                            pInstr->get_musicdata()->get_child(2) );
+        pInstr->insert_staffobj_at(pBarline, "(n g4 h v2)");
+        ModelBuilder builder;
+        builder.structurize(pScore, 1, 0, -1);
+
+        CHECK( pScore->get_staffobjs_table()->num_lines() == numLines + 1 );
+        CHECK( builder.check_structurize(pScore) == true );
+
+        //grace notes
+        Document doc2(m_libraryScope);
+        doc2.from_file(m_scores_path + "unit-tests/grace-notes/222-graces-two-voices.xml",
+                       Document::k_format_mxl);
+        pScore = static_cast<ImoScore*>( doc2.get_im_root()->get_content_item(0) );
+        pInstr = pScore->get_instrument(0);
+        pInstr->insert_staffobj_at(get_note(pScore, 0, 0), "(clef F4)");
+        builder.structurize(pScore, 0, 0, -1);
+        CHECK( builder.check_structurize(pScore) == true );
+    }
+
 }
 
 
@@ -0,0 +1,214 @@
+//---------------------------------------------------------------------------------------
+// This file is part of the Lomse library.
+// Copyright (c) 2010-present, Lomse Developers
+//
+// Licensed under the MIT license.
+//
+// See LICENSE and NOTICE.md files in the root directory of this source tree.
+//---------------------------------------------------------------------------------------
+
+#include <UnitTest++.h>
+#include <sstream>
+#include "lomse_build_options.h"
+
+//classes related to these tests
+#include "lomse_injectors.h"
+#include "private/lomse_document_p.h"
+#include "lomse_internal_model.h"
+#include "lomse_im_note.h"
+#include "lomse_staffobjs_table.h"
+#include "lomse_score_meter.h"
+#include "lomse_shape_note.h"
+#include "lomse_shapes.h"
+#include "lomse_noterests_collisions_fixer.h"
+
+using namespace UnitTest;
+using namespace std;
+using namespace lomse;
+
+//---------------------------------------------------------------------------------------
+// helper, for accessing protected members
+class MyNoterestsCollisionsFixer : public NoterestsCollisionsFixer
+{
+public:
+    MyNoterestsCollisionsFixer(GmoShape* pShape, ColStaffObjsEntry* pEntry,
+                               ScoreMeter* pMeter)
+        : NoterestsCollisionsFixer(pShape, pEntry, pMeter)
+    {
+    }
+
+    bool my_find_first_collision(size_t* pI, size_t* pJ)
+    {
+        return find_first_collision(pI, pJ);
+    }
+
+    bool brute_force_first_collision(size_t* pI, size_t* pJ)
+    {
+        for (size_t i=0; i < m_notes.size(); ++i)
+        {
+            for (size_t j=i+1; j < m_notes.size(); ++j)
+            {
+                if (m_notes[i]->line != m_notes[j]->line)
+                {
+                    URect bbox = m_notes[i]->pShape->get_bounds();
+                    bbox.intersection( m_notes[j]->pShape->get_bounds() );
+                    if (bbox.height > 0.0f && bbox.width > 0.0f)
+                    {
+                        *pI = i;
+                        *pJ = j;
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    void my_compute_chord_ranges() { compute_chord_ranges(); }
+    size_t my_chord_start(size_t i) { return find_start_of_chord(i); }
+    size_t my_chord_end(size_t i) { return find_end_of_chord(i); }
+};
+
+
+//=======================================================================================
+class NoterestsCollisionsFixerTestFixture
+{
+public:
+    LibraryScope m_libraryScope;
+    Document* m_pDoc;
+    ImoScore* m_pScore;
+    ScoreMeter* m_pMeter;
+    vector<ColStaffObjsEntry*> m_entries;
+    vector<GmoShape*> m_shapes;
+
+    NoterestsCollisionsFixerTestFixture()     //SetUp fixture
+        : m_libraryScope(cout)
+        , m_pDoc(nullptr)
+        , m_pScore(nullptr)
+        , m_pMeter(nullptr)
+    {
+        m_libraryScope.set_default_fonts_path(TESTLIB_FONTS_PATH);
+        m_pDoc = LOMSE_NEW Document(m_libraryScope);
+        m_pDoc->from_string("(score (vers 2.0)(instrument (musicData (r q))))");
+        m_pScore = static_cast<ImoScore*>( m_pDoc->get_im_root()->get_content_item(0) );
+        m_pMeter = LOMSE_NEW ScoreMeter(m_pScore);
+    }
+
+    ~NoterestsCollisionsFixerTestFixture()    //TearDown fixture
+    {
+        for (auto pEntry : m_entries)
+            delete pEntry;
+        for (auto pShape : m_shapes)
+            delete pShape;
+        delete m_pMeter;
+        delete m_pDoc;
+    }
+
+    ImoRest* get_rest()
+    {
+        ImoInstrument* pInstr = m_pScore->get_instrument(0);
+        ImoMusicData* pMD = pInstr->get_musicdata();
+        return static_cast<ImoRest*>( pMD->get_first_child() );
+    }
+
+    //creates a rest shape with the given bounds, and its entry in given line
+    GmoShape* create_rest(int line, LUnits x, LUnits y, LUnits width, LUnits height)
+    {
+        ImoRest* pRest = get_rest();
+        m_entries.push_back( LOMSE_NEW ColStaffObjsEntry(0, 0, line, 0, pRest) );
+
+        GmoShapeRest* pShape = LOMSE_NEW GmoShapeRest(pRest, 0, x, y, Color(0,0,0),
+                                                      m_libraryScope);
+        pShape->add( LOMSE_NEW GmoShapeRectangle(nullptr, GmoObj::k_shape_rectangle, 0,
+                                                 UPoint(x, y), USize(width, height)) );
+        m_shapes.push_back(pShape);
+        return pShape;
+    }
+
+    ColStaffObjsEntry* last_entry() { return m_entries.back(); }
+};
+
+
+SUITE(NoterestsCollisionsFixerTest)
+{
+
+    TEST_FIXTURE(NoterestsCollisionsFixerTestFixture, noterests_collisions_fixer_01)
+    {
+        //@01. noterests in the same line never collide
+
+        GmoShape* pShape = create_rest(0, 1000.0f, 1000.0f, 200.0f, 400.0f);
+        MyNoterestsCollisionsFixer fixer(pShape, last_entry(), m_pMeter);
+        pShape = create_rest(0, 1000.0f, 1100.0f, 200.0f, 400.0f);
+        fixer.add_noterest(pShape, last_entry());
+
+        size_t i, j;
+        CHECK( fixer.my_find_first_collision(&i, &j) == false );
+    }
+
+    TEST_FIXTURE(NoterestsCollisionsFixerTestFixture, noterests_collisions_fixer_02)
+    {
+        //@02. touching boxes do not collide. Overlapping boxes in different lines
+        //@    collide
+
+        GmoShape* pShape = create_rest(0, 1000.0f, 1000.0f, 200.0f, 400.0f);
+        MyNoterestsCollisionsFixer fixer(pShape, last_entry(), m_pMeter);
+        pShape = create_rest(1, 1000.0f, 1400.0f, 200.0f, 400.0f);
+        fixer.add_noterest(pShape, last_entry());
+        pShape = create_rest(1, 1100.0f, 1300.0f, 200.0f, 400.0f);
+        fixer.add_noterest(pShape, last_entry());
+
+        size_t i = 9;
+        size_t j = 9;
+        CHECK( fixer.my_find_first_collision(&i, &j) == true );
+        CHECK( i == 0 );
+        CHECK( j == 2 );
+    }
+
+    TEST_FIXTURE(NoterestsCollisionsFixerTestFixture, noterests_collisions_fixer_03)
+    {
+        //@03. many voices: the collision found is the first pair in noterests order
+
+        GmoShape* pShape = create_rest(0, 1000.0f, 5000.0f, 250.0f, 200.0f);
+        MyNoterestsCollisionsFixer fixer(pShape, last_entry(), m_pMeter);
+        for (int k=1; k < 60; ++k)
+        {
+            int line = k / 15;
+            LUnits x = 1000.0f + float((k * 37) % 11) * 100.0f;
+            LUnits y = 1000.0f + float((k * 53) % 29) * 250.0f;
+            pShape = create_rest(line, x, y, 250.0f, 200.0f);
+            fixer.add_noterest(pShape, last_entry());
+        }
+
+        size_t i, j, iExpected, jExpected;
+        bool fExpected = fixer.brute_force_first_collision(&iExpected, &jExpected);
+        CHECK( fixer.my_find_first_collision(&i, &j) == fExpected );
+        CHECK( fExpected == true );
+        CHECK( i == iExpected );
+        CHECK( j == jExpected );
+    }
+
+    TEST_FIXTURE(NoterestsCollisionsFixerTestFixture, noterests_collisions_fixer_04)
+    {
+        //@04. chord ranges are consecutive noterests in the same line
+
+        GmoShape* pShape = create_rest(0, 1000.0f, 1000.0f, 200.0f, 200.0f);
+        MyNoterestsCollisionsFixer fixer(pShape, last_entry(), m_pMeter);
+        int lines[] = { 0, 0, 1, 1, 1, 2 };
+        for (int line : lines)
+        {
+            pShape = create_rest(line, 1000.0f, 1000.0f, 200.0f, 200.0f);
+            fixer.add_noterest(pShape, last_entry());
+        }
+
+        fixer.my_compute_chord_ranges();
+        CHECK( fixer.my_chord_start(0) == 0 );
+        CHECK( fixer.my_chord_end(0) == 2 );
+        CHECK( fixer.my_chord_start(2) == 0 );
+        CHECK( fixer.my_chord_start(4) == 3 );
+        CHECK( fixer.my_chord_end(3) == 5 );
+        CHECK( fixer.my_chord_start(6) == 6 );
+        CHECK( fixer.my_chord_end(6) == 6 );
+    }
+
+}
+
@@ -0,0 +1,210 @@
+//---------------------------------------------------------------------------------------
+// This file is part of the Lomse library.
+// Copyright (c) 2010-present, Lomse Developers
+//
+// Licensed under the MIT license.
+//
+// See LICENSE and NOTICE.md files in the root directory of this source tree.
+//---------------------------------------------------------------------------------------
+
+#include <UnitTest++.h>
+#include <sstream>
+#include <cmath>
+#include "lomse_build_options.h"
+
+//classes related to these tests
+#include "lomse_injectors.h"
+#include "lomse_doorway.h"
+#include "lomse_bitmap_drawer.h"
+#include "lomse_overlays_generator.h"
+#include "lomse_visual_effect.h"
+
+using namespace UnitTest;
+using namespace std;
+using namespace lomse;
+
+
+//---------------------------------------------------------------------------------------
+class OverlaysTestDoorway : public LomseDoorway
+{
+public:
+    OverlaysTestDoorway()
+        : LomseDoorway()
+    {
+        init_library(k_pix_format_rgba32, 96);
+    }
+    virtual ~OverlaysTestDoorway() {}
+};
+
+//---------------------------------------------------------------------------------------
+class OverlaysGeneratorTestFixture
+{
+public:
+    OverlaysTestDoorway m_platform;
+    LibraryScope m_libraryScope;
+    BitmapDrawer* m_pDrawer;
+    std::vector<unsigned char> m_buf;
+    std::vector<unsigned char> m_background;
+
+    enum { k_width = 800, k_height = 600, };
+
+    OverlaysGeneratorTestFixture()     //SetUp fixture
+        : m_libraryScope(cout, &m_platform)
+        , m_pDrawer(nullptr)
+        , m_buf(k_width * k_height * 4)
+    {
+        m_pDrawer = Injector::inject_BitmapDrawer(m_libraryScope);
+        m_pDrawer->set_rendering_buffer(&m_buf[0], k_width, k_height);
+
+        //a background in which any wrong pixel would be noticed
+        for (size_t i=0; i < m_buf.size(); ++i)
+            m_buf[i] = static_cast<unsigned char>((i * 7) & 0xFF);
+        m_background = m_buf;
+    }
+
+    ~OverlaysGeneratorTestFixture()    //TearDown fixture
+    {
+        delete m_pDrawer;
+    }
+
+    size_t bytes_for_area(LUnits left, LUnits top, LUnits right, LUnits bottom)
+    {
+        double x1 = left;
+        double y1 = top;
+        double x2 = right;
+        double y2 = bottom;
+        m_pDrawer->model_point_to_device(&x1, &y1);
+        m_pDrawer->model_point_to_device(&x2, &y2);
+        int width = int(ceil(x2)) + 1 - int(floor(x1));
+        int height = int(ceil(y2)) + 1 - int(floor(y1));
+        return size_t(width * height * 4);
+    }
+
+    void set_rectangle(SelectionRectangle* pRect, LUnits x1, LUnits y1,
+                       LUnits x2, LUnits y2)
+    {
+        pRect->set_start_point(x1, y1);
+        pRect->set_end_point(x2, y2);
+        pRect->set_visible(true);
+    }
+};
+
+
+SUITE(OverlaysGeneratorTest)
+{
+
+    TEST_FIXTURE(OverlaysGeneratorTestFixture, overlays_generator_01)
+    {
+        //@01. after a new background only the pixels under effects are saved
+
+        OverlaysGenerator generator(nullptr, m_libraryScope);
+        generator.set_rendering_buffer(&m_buf[0], k_width, k_height);
+        SelectionRectangle* pRect = LOMSE_NEW SelectionRectangle(nullptr, m_libraryScope);
+        set_rectangle(pRect, 2000.0f, 2000.0f, 4000.0f, 3000.0f);
+        generator.add_visual_effect(pRect);
+
+        generator.on_new_background();
+        generator.update_all_visual_effects(m_pDrawer);
+
+        //bounds plus 1mm at each side
+        CHECK( generator.get_num_bytes_copied() == bytes_for_area(1900.0f, 1900.0f,
+                                                                  4100.0f, 3100.0f) );
+        CHECK( m_buf != m_background );
+        CHECK( generator.get_damaged_rectangle() == URect(0.0f, 0.0f, 0.0f, 0.0f) );
+    }
+
+    TEST_FIXTURE(OverlaysGeneratorTestFixture, overlays_generator_02)
+    {
+        //@02. moved effect: damaged area is old plus new bounds, and result is the
+        //@    same than drawing the effect on a clean background
+
+        OverlaysGenerator generator(nullptr, m_libraryScope);
+        generator.set_rendering_buffer(&m_buf[0], k_width, k_height);
+        SelectionRectangle* pRect = LOMSE_NEW SelectionRectangle(nullptr, m_libraryScope);
+        set_rectangle(pRect, 2000.0f, 2000.0f, 4000.0f, 3000.0f);
+        generator.add_visual_effect(pRect);
+        generator.on_new_background();
+        generator.update_all_visual_effects(m_pDrawer);
+        generator.get_damaged_rectangle();
+
+        generator.reset_statistics();
+        set_rectangle(pRect, 3000.0f, 2500.0f, 5000.0f, 3500.0f);
+        generator.update_visual_effect(pRect, m_pDrawer);
+
+        CHECK( generator.get_damaged_rectangle() == URect(1900.0f, 1900.0f, 3200.0f, 1700.0f) );
+        CHECK( generator.get_num_bytes_copied() < 2 * bytes_for_area(1900.0f, 1900.0f,
+                                                                     5100.0f, 3600.0f) );
+
+        std::vector<unsigned char> result = m_buf;
+        m_buf = m_background;
+        OverlaysGenerator expected(nullptr, m_libraryScope);
+        expected.set_rendering_buffer(&m_buf[0], k_width, k_height);
+        SelectionRectangle* pExpected = LOMSE_NEW SelectionRectangle(nullptr, m_libraryScope);
+        set_rectangle(pExpected, 3000.0f, 2500.0f, 5000.0f, 3500.0f);
+        expected.add_visual_effect(pExpected);
+        expected.on_new_background();
+        expected.update_all_visual_effects(m_pDrawer);
+
+        CHECK( result == m_buf );
+    }
+
+    TEST_FIXTURE(OverlaysGeneratorTestFixture, overlays_generator_03)
+    {
+        //@03. not overlapping effects are not redrawn. Hidden and removed effects
+        //@    are erased
+
+        OverlaysGenerator generator(nullptr, m_libraryScope);
+        generator.set_rendering_buffer(&m_buf[0], k_width, k_height);
+        SelectionRectangle* pRect1 = LOMSE_NEW SelectionRectangle(nullptr, m_libraryScope);
+        set_rectangle(pRect1, 2000.0f, 2000.0f, 3000.0f, 3000.0f);
+        generator.add_visual_effect(pRect1);
+        SelectionRectangle* pRect2 = LOMSE_NEW SelectionRectangle(nullptr, m_libraryScope);
+        set_rectangle(pRect2, 12000.0f, 9000.0f, 13000.0f, 10000.0f);
+        generator.add_visual_effect(pRect2);
+        generator.on_new_background();
+        generator.update_all_visual_effects(m_pDrawer);
+        generator.get_damaged_rectangle();
+
+        pRect1->hide();
+        generator.update_visual_effect(pRect1, m_pDrawer);
+        CHECK( generator.get_damaged_rectangle() == URect(1900.0f, 1900.0f, 1200.0f, 1200.0f) );
+
+        generator.remove_visual_effect(pRect2);
+        delete pRect2;
+        generator.update_all_visual_effects(m_pDrawer);
+        CHECK( generator.get_damaged_rectangle() == URect(11900.0f, 8900.0f, 1200.0f, 1200.0f) );
+
+        CHECK( m_buf == m_background );
+    }
+
+    TEST_FIXTURE(OverlaysGeneratorTestFixture, overlays_generator_04)
+    {
+        //@04. overlapping effects are redrawn
+
+        OverlaysGenerator generator(nullptr, m_libraryScope);
+        generator.set_rendering_buffer(&m_buf[0], k_width, k_height);
+        SelectionRectangle* pRect1 = LOMSE_NEW SelectionRectangle(nullptr, m_libraryScope);
+        set_rectangle(pRect1, 2000.0f, 2000.0f, 4000.0f, 4000.0f);
+        generator.add_visual_effect(pRect1);
+        SelectionRectangle* pRect2 = LOMSE_NEW SelectionRectangle(nullptr, m_libraryScope);
+        set_rectangle(pRect2, 4100.0f, 2000.0f, 6000.0f, 4000.0f);
+        generator.add_visual_effect(pRect2);
+        generator.on_new_background();
+        generator.update_all_visual_effects(m_pDrawer);
+        generator.get_damaged_rectangle();
+
+        set_rectangle(pRect1, 2000.0f, 2100.0f, 4000.0f, 4100.0f);
+        generator.update_visual_effect(pRect1, m_pDrawer);
+
+        //pRect2 bounds (plus 1mm) overlap pRect1 bounds
+        CHECK( generator.get_damaged_rectangle() == URect(1900.0f, 1900.0f, 4200.0f, 2300.0f) );
+
+        std::vector<unsigned char> result = m_buf;
+        m_buf = m_background;
+        generator.on_new_background();
+        generator.update_all_visual_effects(m_pDrawer);
+        CHECK( result == m_buf );
+    }
+
+}
+
@@ -2227,6 +2227,48 @@ SUITE(ScoreCursorTest)
         CHECK( ti.get_current_measure_start_timepos() == 0.0 );
     }
 
+    TEST_FIXTURE(ScoreCursorTestFixture, time_info_615)
+    {
+        //615. to_measure() and to_time() update time related info
+        m_pDoc = LOMSE_NEW Document(m_libraryScope);
+        m_pDoc->from_string("(score (vers 2.0)"
+            "(instrument (musicData (clef G)(time 2 4)(n c4 q)(n e4 q)(barline)"
+            "(n c4 q)(n e4 q)(barline)(time 6 8)(n c4 q.)(n e4 q.)(barline)"
+            "(n c4 q.)(n e4 q.)(barline)))"
+            "(instrument (musicData (clef F4)(time 2 4)(n c3 h)(barline)"
+            "(n c3 h)(barline)(time 6 8)(n c3 h.)(barline)(n c3 h.)(barline)))"
+            ")");
+        m_pScore = static_cast<ImoScore*>( m_pDoc->get_im_root()->get_content_item(0) );
+        MyScoreCursor cursor(m_pDoc, m_pScore);
+
+        cursor.to_measure(3, 0, 0);
+        TimeInfo ti = cursor.get_time_info();
+        CHECK( (*cursor)->is_note() == true );
+        CHECK( ti.get_timepos() == 448.0 );
+        CHECK( ti.get_current_beat_duration() == k_duration_quarter_dotted );
+        CHECK( ti.get_current_measure_start_timepos() == 448.0 );
+
+        cursor.to_measure(1, 1, 0);
+        ti = cursor.get_time_info();
+        CHECK( cursor.instrument() == 1 );
+        CHECK( ti.get_timepos() == 128.0 );
+        CHECK( ti.get_current_beat_duration() == k_duration_quarter );
+        CHECK( ti.get_current_measure_start_timepos() == 128.0 );
+
+        cursor.to_time(0, 0, 352.0);
+        ti = cursor.get_time_info();
+        CHECK( (*cursor)->is_note() == true );
+        CHECK( ti.get_timepos() == 352.0 );
+        CHECK( ti.get_current_beat_duration() == k_duration_quarter_dotted );
+        CHECK( ti.get_current_measure_start_timepos() == 256.0 );
+
+        cursor.to_measure(9, 0, 0);      //not found: end of staff
+        ti = cursor.get_time_info();
+        CHECK( cursor.is_at_end_of_staff() == true );
+        CHECK( ti.get_current_beat_duration() == k_duration_quarter_dotted );
+        CHECK( ti.get_current_measure_start_timepos() == 640.0 );
+    }
+
 };
 
 //=======================================================================================
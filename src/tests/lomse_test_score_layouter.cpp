@@ -36,6 +36,7 @@ using namespace lomse;
 
 #include "lomse_time.h"
 #include <cmath>
+#include <algorithm>
 
 
 //---------------------------------------------------------------------------------------
@@ -81,6 +82,7 @@ public:
     GmoBoxSystem* my_get_current_system_box() { return m_pCurBoxSystem; }
     ShapesCreator* my_shapes_creator() { return m_pShapesCreator; }
     void my_engrave_system() { engrave_system(); }
+    SpacingAlgorithm* my_get_spacing_algorithm() { return m_pSpAlgorithm; }
 
     void my_delete_all() { delete_not_used_objects(); }
 };
@@ -243,6 +245,41 @@ public:
         ofs.close();
     }
 
+    std::string long_score(int numMeasures, int breakEvery=0)
+    {
+        //a score with measures of different widths. Optionally, a system break is
+        //forced every breakEvery measures
+
+        static const char* measures[] = {
+            "(n c4 q)(n e4 q)",
+            "(n c4 e)(n d4 e)(n e4 e)(n f4 e)",
+            "(n g4 h)",
+            "(n c4 s)(n d4 s)(n e4 s)(n f4 s)(n g4 s)(n a4 s)(n b4 s)(n c5 s)",
+            "(n c4 q.)(n d4 e)",
+        };
+        std::stringstream ss;
+        ss << "(score (vers 2.0)(instrument (musicData (clef G)(time 2 4)";
+        for (int i=0; i < numMeasures; ++i)
+        {
+            ss << measures[(i * 7) % 5];
+            ss << "(barline)";
+            if (breakEvery > 0 && (i+1) % breakEvery == 0 && i+1 < numMeasures)
+                ss << "(newSystem)";
+        }
+        ss << ")))";
+        return ss.str();
+    }
+
+    void prepare_for_breaks(MyScoreLayouter& scoreLyt, GmoBoxScorePage& pageBox)
+    {
+        scoreLyt.prepare_to_start_layout();
+        pageBox.set_origin(1500.0f, 2000.0f);
+        pageBox.set_width(18000.0f);
+        pageBox.set_height(25700.0f);
+        scoreLyt.my_page_initializations(&pageBox);
+        scoreLyt.my_move_cursor_to_top_left_corner();
+    }
+
     void delete_test_data()
     {
         delete m_pDoc;
@@ -918,6 +955,74 @@ SUITE(ScoreLayouterTest)
 //        scoreLyt.my_delete_all();
 //    }
 
+
+    //@3xx. LinesBreakerOptimal
+
+    TEST_FIXTURE(ScoreLayouterTestFixture, ScoreLayouter_300)
+    {
+        //@300. Bounded lookahead does not change breaks but less lines are evaluated
+
+        Document doc(m_libraryScope);
+        doc.from_string( long_score(60) );
+        GraphicModel gmodel( doc.get_im_root() );
+        ImoScore* pImoScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        MyScoreLayouter scoreLyt(pImoScore, &gmodel, m_libraryScope);
+        GmoBoxScorePage pageBox(pImoScore);
+        prepare_for_breaks(scoreLyt, pageBox);
+        SpacingAlgorithm* pSpAlg = scoreLyt.my_get_spacing_algorithm();
+
+        std::vector<int> breaks;
+        LinesBreakerOptimal breaker(&scoreLyt, m_libraryScope, pSpAlg, breaks);
+        breaker.decide_line_breaks();
+
+        std::vector<int> allBreaks;
+        LinesBreakerOptimal allBreaker(&scoreLyt, m_libraryScope, pSpAlg, allBreaks);
+        allBreaker.use_bounded_lookahead(false);
+        allBreaker.decide_line_breaks();
+
+        CHECK( breaks.size() > 4 );
+        CHECK( breaks == allBreaks );
+        CHECK( breaker.get_num_penalties_computed() * 3
+               < allBreaker.get_num_penalties_computed() );
+
+        stringstream entries;
+        breaker.dump_entries(entries);
+        stringstream allEntries;
+        allBreaker.dump_entries(allEntries);
+        CHECK( entries.str() == allEntries.str() );
+
+        scoreLyt.my_delete_all();
+    }
+
+    TEST_FIXTURE(ScoreLayouterTestFixture, ScoreLayouter_301)
+    {
+        //@301. Bounded lookahead and forced system breaks
+
+        Document doc(m_libraryScope);
+        doc.from_string( long_score(60, 13) );
+        GraphicModel gmodel( doc.get_im_root() );
+        ImoScore* pImoScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        MyScoreLayouter scoreLyt(pImoScore, &gmodel, m_libraryScope);
+        GmoBoxScorePage pageBox(pImoScore);
+        prepare_for_breaks(scoreLyt, pageBox);
+        SpacingAlgorithm* pSpAlg = scoreLyt.my_get_spacing_algorithm();
+
+        std::vector<int> breaks;
+        LinesBreakerOptimal breaker(&scoreLyt, m_libraryScope, pSpAlg, breaks);
+        breaker.decide_line_breaks();
+
+        std::vector<int> allBreaks;
+        LinesBreakerOptimal allBreaker(&scoreLyt, m_libraryScope, pSpAlg, allBreaks);
+        allBreaker.use_bounded_lookahead(false);
+        allBreaker.decide_line_breaks();
+
+        CHECK( breaks == allBreaks );
+        CHECK( std::find(breaks.begin(), breaks.end(), 13) != breaks.end() );
+        CHECK( std::find(breaks.begin(), breaks.end(), 26) != breaks.end() );
+
+        scoreLyt.my_delete_all();
+    }
+
 };
 
 
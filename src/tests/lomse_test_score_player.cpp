@@ -36,6 +36,7 @@ using namespace lomse;
 //---------------------------------------------------------------------------------------
 //Helper, to save Highlight events
 std::list<SpEventInfo> m_notifications;
+std::list<std::chrono::steady_clock::time_point> m_notificationTimes;
 
 //---------------------------------------------------------------------------------------
 //Helper, as mock class and for accessing protected members
@@ -52,9 +53,10 @@ public:
     }
     virtual ~MyScorePlayer() {
         m_notifications.clear();
+        m_notificationTimes.clear();
     }
 
-    //std::vector<SoundEvent*>& my_get_events() { return m_events; }
+    //std::vector<SoundEvent>& my_get_events() { return m_events; }
     SoundEventsTable* my_get_table() { return m_pTable; }
     bool my_play_segment_invoked() { return m_fPlaySegmentInvoked; }
     void my_do_play(int nEvStart, int nEvEnd, int UNUSED(playMode), bool fVisualTracking,
@@ -75,6 +77,7 @@ public:
     static void my_callback(void* UNUSED(pThis), SpEventInfo event)
     {
         m_notifications.push_back(event);
+        m_notificationTimes.push_back( std::chrono::steady_clock::now() );
     }
 
     //access to protected members
@@ -179,6 +182,60 @@ public:
     std::list<int>& my_get_events() { return m_events; }
 };
 
+//---------------------------------------------------------------------------------------
+class MyBatchMidiServer : public MidiServerBase
+{
+public:
+    std::vector<SoundEventBatch> m_batches;
+    std::vector<std::chrono::steady_clock::time_point> m_received;
+    int m_numAllSoundsOff;
+
+    MyBatchMidiServer() : MidiServerBase(), m_numAllSoundsOff(0) {}
+    virtual ~MyBatchMidiServer() {}
+
+    void events(const SoundEventBatch& batch) override
+    {
+        m_batches.push_back(batch);
+        m_received.push_back( std::chrono::steady_clock::now() );
+    }
+    void all_sounds_off() override { ++m_numAllSoundsOff; }
+
+    int count_all_events(int type)
+    {
+        int count = 0;
+        for (size_t i=0; i < m_batches.size(); ++i)
+            count += count_events(type, i);
+        return count;
+    }
+
+    int count_events(int type, size_t iBatch)
+    {
+        int count = 0;
+        for (auto& ev : m_batches[iBatch].events)
+        {
+            if (ev.type == type)
+                ++count;
+        }
+        return count;
+    }
+};
+
+//---------------------------------------------------------------------------------------
+class MySoundEventQueue : public SoundEventQueue
+{
+public:
+    MySoundEventQueue(size_t capacity) : SoundEventQueue(capacity) {}
+
+    //a pop() that started before the flush was requested
+    bool pop_started_before_flush(SoundEventBatch& batch)
+    {
+        bool fFlush = m_fFlush.exchange(false);
+        bool fResult = pop(batch);
+        m_fFlush = fFlush;
+        return fResult;
+    }
+};
+
 //---------------------------------------------------------------------------------------
 class MyEventHandlerCPP2 : public EventHandler
 {
@@ -476,6 +533,333 @@ SUITE(ScorePlayerTest)
         CHECK( handler.my_last_event_type() == k_end_of_playback_event );
     }
 
+    TEST_FIXTURE(ScorePlayerTestFixture, TimingStatisticsCollected)
+    {
+        SpDocument spDoc( new Document(m_libraryScope) );
+        spDoc->from_string("(lenmusdoc (vers 0.0) (content (score (vers 2.0) "
+            "(instrument (musicData (clef G)(n c4 s)(n e4 s)(n g4 s)(n c5 s) )) )))" );
+        ImoScore* pScore = static_cast<ImoScore*>( spDoc->get_im_root()->get_content_item(0) );
+        MyMidiServer midi;
+        MyScorePlayer2 player(m_libraryScope, &midi);
+        PlayerNoGui playGui;
+        player.load_score(pScore, &playGui);
+        player.play(k_no_visual_tracking, 240L, nullptr);
+        player.my_wait_for_termination();
+
+        PlaybackTimingStats stats = player.get_timing_statistics();
+        CHECK( stats.numEvents > 0L );
+        CHECK( stats.maxJitter >= stats.meanJitter );
+        CHECK( stats.maxJitter < 50000.0 );     //less than 50ms, even on a loaded machine
+    }
+
+    TEST_FIXTURE(ScorePlayerTestFixture, SchedulerUsesAbsoluteDeadlines)
+    {
+        PlaybackScheduler scheduler;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        scheduler.start(0.0);
+        for (int i=1; i <= 10; ++i)
+            CHECK( scheduler.wait_until(double(i) * 2.0) == true );
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        CHECK( elapsed.count() >= 20.0 );
+        PlaybackTimingStats stats = scheduler.get_statistics();
+        CHECK( stats.numEvents == 10L );
+        CHECK( stats.lastDeviation >= 0.0 );
+    }
+
+    TEST_FIXTURE(ScorePlayerTestFixture, SchedulerPauseShiftsDeadlines)
+    {
+        PlaybackScheduler scheduler;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        scheduler.start(0.0);
+        scheduler.pause();
+        std::thread resumer([&scheduler]() {
+            std::this_thread::sleep_for( std::chrono::milliseconds(30) );
+            scheduler.resume();
+        });
+
+        CHECK( scheduler.wait_until(10.0) == true );
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+        resumer.join();
+
+        CHECK( elapsed.count() >= 40.0 );
+    }
+
+    TEST_FIXTURE(ScorePlayerTestFixture, SchedulerStopInterruptsWait)
+    {
+        PlaybackScheduler scheduler;
+        scheduler.start(0.0);
+        std::thread stopper([&scheduler]() {
+            std::this_thread::sleep_for( std::chrono::milliseconds(10) );
+            scheduler.request_stop();
+        });
+
+        CHECK( scheduler.wait_until(60000.0) == false );
+        stopper.join();
+        CHECK( scheduler.get_statistics().numEvents == 0L );
+    }
+
+    TEST_FIXTURE(ScorePlayerTestFixture, ChordDeliveredInOneBatch)
+    {
+        SpDocument spDoc( new Document(m_libraryScope) );
+        spDoc->from_string("(lenmusdoc (vers 0.0) (content (score (vers 2.0) "
+            "(instrument (musicData (clef G)(chord (n c4 s)(n e4 s)(n g4 s)) )) )))" );
+        ImoScore* pScore = static_cast<ImoScore*>( spDoc->get_im_root()->get_content_item(0) );
+        MyBatchMidiServer midi;
+        MyScorePlayer player(m_libraryScope, &midi);
+        PlayerNoGui playGui;
+        player.load_score(pScore, &playGui);
+        int nEvMax = player.my_get_table()->num_events() - 1;
+        player.my_do_play(0, nEvMax, k_play_normal_instrument, k_no_visual_tracking,
+                          k_no_countoff, 240L, nullptr);
+        player.my_wait_for_termination();
+
+        //batch 0: programs, before metronome start. batch 1: all note on.
+        //batch 2: all note off
+        CHECK( midi.m_batches.size() == 3 );
+        if (midi.m_batches.size() == 3)
+        {
+            CHECK( midi.count_events(BatchedMidiEvent::k_program_change, 0) == 1 );
+            CHECK( midi.count_events(BatchedMidiEvent::k_voice_change, 0) == 1 );
+            CHECK( midi.m_batches[1].size() == 3 );
+            CHECK( midi.count_events(BatchedMidiEvent::k_note_on, 1) == 3 );
+            CHECK( midi.m_batches[2].size() == 3 );
+            CHECK( midi.count_events(BatchedMidiEvent::k_note_off, 2) == 3 );
+            CHECK( midi.m_batches[2].playbackTime > midi.m_batches[1].playbackTime );
+        }
+    }
+
+    TEST_FIXTURE(ScorePlayerTestFixture, BatchTimestampIncludesLookahead)
+    {
+        SpDocument spDoc( new Document(m_libraryScope) );
+        spDoc->from_string("(lenmusdoc (vers 0.0) (content (score (vers 2.0) "
+            "(instrument (musicData (clef G)(n c4 s)(n e4 s) )) )))" );
+        ImoScore* pScore = static_cast<ImoScore*>( spDoc->get_im_root()->get_content_item(0) );
+        MyBatchMidiServer midi;
+        MyScorePlayer player(m_libraryScope, &midi);
+        player.set_sound_lookahead(50000L);     //50 ms
+        PlayerNoGui playGui;
+        player.load_score(pScore, &playGui);
+        int nEvMax = player.my_get_table()->num_events() - 1;
+        player.my_do_play(0, nEvMax, k_play_normal_instrument, k_no_visual_tracking,
+                          k_no_countoff, 240L, nullptr);
+        player.my_wait_for_termination();
+
+        CHECK( midi.m_batches.size() >= 2 );
+        for (size_t i=0; i < midi.m_batches.size(); ++i)
+        {
+            std::chrono::duration<double, std::milli> ahead =
+                midi.m_batches[i].timestamp - midi.m_received[i];
+            CHECK( ahead.count() > 20.0 );
+            CHECK( ahead.count() <= 50.0 );
+        }
+    }
+
+    TEST_FIXTURE(ScorePlayerTestFixture, LookaheadSendsSoundsAhead)
+    {
+        //sounds are sent ahead of time but visual tracking is posted when the
+        //sounds are due
+        LomseDoorway* pLomse = m_libraryScope.platform_interface();
+        pLomse->set_notify_callback(nullptr, MyScorePlayer::my_callback);
+        SpDocument spDoc( new Document(m_libraryScope) );
+        spDoc->from_string("(lenmusdoc (vers 0.0) (content (score (vers 2.0) "
+            "(instrument (musicData (clef G)(n c4 e)(n e4 e) )) )))" );
+        ImoScore* pScore = static_cast<ImoScore*>( spDoc->get_im_root()->get_content_item(0) );
+        MyBatchMidiServer midi;
+        MyScorePlayer player(m_libraryScope, &midi);
+        player.set_sound_lookahead(80000L);     //80 ms
+        PlayerNoGui playGui;
+        player.load_score(pScore, &playGui);
+        int nEvMax = player.my_get_table()->num_events() - 1;
+        SpInteractor inter( LOMSE_NEW Interactor(m_libraryScope, WpDocument(spDoc), nullptr, nullptr) );
+        player.my_do_play(0, nEvMax, k_play_normal_instrument, k_do_visual_tracking,
+                          k_no_countoff, 120L, inter.get());
+        player.my_wait_for_termination();
+
+        //batch 0: programs. batch 1: first note on
+        CHECK( midi.m_batches.size() >= 2 );
+        CHECK( m_notifications.size() >= 2 );
+        if (midi.m_batches.size() >= 2 && m_notifications.size() >= 2)
+        {
+            CHECK( midi.count_events(BatchedMidiEvent::k_note_on, 1) == 1 );
+            std::chrono::duration<double, std::milli> ahead =
+                midi.m_batches[1].timestamp - midi.m_received[1];
+            CHECK( ahead.count() > 50.0 );
+
+            //first notification: tempo line and highlight on for first note
+            std::chrono::duration<double, std::milli> delay =
+                m_notificationTimes.front() - midi.m_batches[1].timestamp;
+            CHECK( delay.count() > -1.0 );
+            CHECK( delay.count() < 30.0 );
+        }
+        //playback waits until all sounds are played. All sounds off at end
+        CHECK( midi.count_all_events(BatchedMidiEvent::k_note_off) == 2 );
+        CHECK( midi.m_numAllSoundsOff == 1 );
+        CHECK( std::chrono::steady_clock::now() >= midi.m_batches.back().timestamp );
+    }
+
+    TEST_FIXTURE(ScorePlayerTestFixture, LookaheadPauseSendsAgain)
+    {
+        //on pause, sounds are muted and the events sent ahead of time are sent
+        //again when resuming
+        SpDocument spDoc( new Document(m_libraryScope) );
+        spDoc->from_string("(lenmusdoc (vers 0.0) (content (score (vers 2.0) "
+            "(instrument (musicData (clef G)(n c4 s)(n d4 s)(n e4 s)(n f4 s)"
+            "(n g4 s)(n a4 s) )) )))" );
+        ImoScore* pScore = static_cast<ImoScore*>( spDoc->get_im_root()->get_content_item(0) );
+        MyBatchMidiServer midi;
+        MyScorePlayer2 player(m_libraryScope, &midi);
+        player.set_sound_lookahead(150000L);     //150 ms
+        PlayerNoGui playGui;
+        player.load_score(pScore, &playGui);
+        player.play(k_no_visual_tracking, 240L, nullptr);     //a note each 62.5 ms
+
+        //first note sounds at 250+150 ms. Pause after sending it but before playing
+        std::this_thread::sleep_for( std::chrono::milliseconds(330) );
+        player.pause();
+        std::this_thread::sleep_for( std::chrono::milliseconds(50) );
+        player.pause();
+        player.my_wait_for_termination();
+
+        //pause + end of playback
+        CHECK( midi.m_numAllSoundsOff == 2 );
+        //notes after the pause, already sent, were sent again
+        CHECK( midi.count_all_events(BatchedMidiEvent::k_note_on) > 6 );
+    }
+
+    TEST_FIXTURE(ScorePlayerTestFixture, LookaheadStopFlushesQueue)
+    {
+        SpDocument spDoc( new Document(m_libraryScope) );
+        spDoc->from_string("(lenmusdoc (vers 0.0) (content (score (vers 2.0) "
+            "(instrument (musicData (clef G)(n c4 s)(n d4 s)(n e4 s)(n f4 s)"
+            "(n g4 s)(n a4 s) )) )))" );
+        ImoScore* pScore = static_cast<ImoScore*>( spDoc->get_im_root()->get_content_item(0) );
+        QueuedMidiServer midi;
+        MyScorePlayer2 player(m_libraryScope, &midi);
+        player.set_sound_lookahead(200000L);     //200 ms
+        PlayerNoGui playGui;
+        player.load_score(pScore, &playGui);
+        player.play(k_no_visual_tracking, 240L, nullptr);
+
+        //first note sounds at 250+200 ms. Stop after sending it but before playing
+        std::this_thread::sleep_for( std::chrono::milliseconds(330) );
+        player.stop();
+
+        //batches for next 200 ms were sent but are discarded
+        SoundEventBatch batch;
+        CHECK( midi.get_queue().pop(batch) == true );
+        CHECK( batch.size() == 1 );
+        CHECK( batch.events[0].type == BatchedMidiEvent::k_all_sounds_off );
+        CHECK( midi.get_queue().pop(batch) == false );
+    }
+
+    TEST_FIXTURE(ScorePlayerTestFixture, SoundEventQueueFlush)
+    {
+        SoundEventQueue queue(4);
+        SoundEventBatch batch;
+        batch.add(BatchedMidiEvent::k_note_on, 0, 60, 100);
+        batch.playbackTime = 1.0;
+        queue.push(batch);
+        queue.push(batch);
+        queue.request_flush();
+        batch.playbackTime = 2.0;
+        queue.push(batch);
+
+        SoundEventBatch out;
+        CHECK( queue.peek() != nullptr );
+        CHECK( queue.peek()->events[0].type == BatchedMidiEvent::k_all_sounds_off );
+        CHECK( queue.pop(out) == true );
+        CHECK( out.size() == 1 );
+        CHECK( out.events[0].type == BatchedMidiEvent::k_all_sounds_off );
+        CHECK( queue.pop(out) == true );
+        CHECK( out.playbackTime == 2.0 );
+        CHECK( out.events[0].type == BatchedMidiEvent::k_note_on );
+        CHECK( queue.pop(out) == false );
+    }
+
+    TEST_FIXTURE(ScorePlayerTestFixture, SoundEventQueueFlushDuringPop)
+    {
+        //the consumer pops a batch pushed after the flush request, in a pop()
+        //started before the request. The head is not moved backwards
+        MySoundEventQueue queue(4);
+        SoundEventBatch batch;
+        batch.add(BatchedMidiEvent::k_note_on, 0, 60, 100);
+        queue.request_flush();
+        batch.playbackTime = 2.0;
+        queue.push(batch);
+
+        SoundEventBatch out;
+        CHECK( queue.pop_started_before_flush(out) == true );
+        CHECK( out.playbackTime == 2.0 );
+        CHECK( queue.pop(out) == true );
+        CHECK( out.events[0].type == BatchedMidiEvent::k_all_sounds_off );
+        CHECK( queue.pop(out) == false );
+        CHECK( queue.empty() == true );
+    }
+
+    TEST_FIXTURE(ScorePlayerTestFixture, SoundEventQueueFifo)
+    {
+        SoundEventQueue queue(2);
+        SoundEventBatch batch;
+        batch.add(BatchedMidiEvent::k_note_on, 0, 60, 100);
+        batch.playbackTime = 1.0;
+        CHECK( queue.push(batch) == true );
+        batch.add(BatchedMidiEvent::k_note_on, 0, 64, 100);
+        batch.playbackTime = 2.0;
+        CHECK( queue.push(batch) == true );
+        CHECK( queue.push(batch) == false );
+        CHECK( queue.get_num_dropped() == 1L );
+        CHECK( queue.size() == 2 );
+
+        SoundEventBatch out;
+        CHECK( queue.peek() != nullptr );
+        CHECK( queue.pop(out) == true );
+        CHECK( out.playbackTime == 1.0 );
+        CHECK( out.size() == 1 );
+        CHECK( queue.pop(out) == true );
+        CHECK( out.playbackTime == 2.0 );
+        CHECK( out.size() == 2 );
+        CHECK( queue.pop(out) == false );
+        CHECK( queue.empty() == true );
+    }
+
+    TEST_FIXTURE(ScorePlayerTestFixture, SoundEventQueueThreads)
+    {
+        QueuedMidiServer midi(8);
+        const int numEvents = 1000;
+        std::thread producer([&midi]() {
+            for (int i=0; i < numEvents; ++i)
+            {
+                SoundEventBatch batch;
+                batch.add(BatchedMidiEvent::k_note_on, 0, i % 128, 100);
+                batch.playbackTime = double(i);
+                while (midi.get_queue().size() == midi.get_queue().capacity())
+                    std::this_thread::yield();
+                midi.events(batch);
+            }
+        });
+
+        int received = 0;
+        bool fOrdered = true;
+        SoundEventBatch batch;
+        while (received < numEvents)
+        {
+            if (midi.get_queue().pop(batch))
+            {
+                fOrdered &= (batch.playbackTime == double(received));
+                ++received;
+            }
+            else
+                std::this_thread::yield();
+        }
+        producer.join();
+
+        CHECK( fOrdered == true );
+        CHECK( midi.get_queue().get_num_dropped() == 0L );
+    }
+
 }
 
 #endif  //LOMSE_ENABLE_THREADS == 1
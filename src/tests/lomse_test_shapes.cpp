@@ -9,6 +9,7 @@
 
 #include <UnitTest++.h>
 #include <sstream>
+#include <thread>
 #include "lomse_build_options.h"
 
 //classes related to these tests
@@ -25,6 +26,7 @@
 #include "lomse_engravers_map.h"
 #include "private/lomse_document_p.h"
 #include "lomse_im_factory.h"
+#include "lomse_calligrapher.h"
 
 using namespace UnitTest;
 using namespace std;
@@ -233,6 +235,94 @@ SUITE(GmoShapeTest)
         delete pInfo;
     }
 
+    // glyph metrics ----------------------------------------------------------------------
+
+    TEST_FIXTURE(GmoShapeTestFixture, glyph_metrics_as_font_metrics)
+    {
+        //precomputed metrics are the same than those measured with the font
+
+        MusicGlyphs* pGlyphs = m_libraryScope.get_glyphs_table();
+        unsigned int ch = pGlyphs->glyph_code(k_glyph_g_clef);
+        TextMeter meter(m_libraryScope);
+        meter.select_font("any", m_libraryScope.get_music_font_file(),
+                          m_libraryScope.get_music_font_name(), 21.0);
+
+        const GlyphMetrics& metrics = pGlyphs->get_glyph_metrics(k_glyph_g_clef, 21.0);
+
+        CHECK( metrics.bounds == meter.bounding_rectangle(ch) );
+        CHECK( metrics.advance == meter.get_advance_x(ch) );
+        CHECK( metrics.advance > 0.0f );
+    }
+
+    TEST_FIXTURE(GmoShapeTestFixture, glyph_metrics_computed_once)
+    {
+        //glyphs are measured only once per font size. Glyph shapes use them
+
+        MusicGlyphs* pGlyphs = m_libraryScope.get_glyphs_table();
+        int iGlyph = k_glyph_notehead_quarter;
+        const GlyphMetrics& metrics1 = pGlyphs->get_glyph_metrics(iGlyph, 21.0);
+        const GlyphMetrics& metrics2 = pGlyphs->get_glyph_metrics(iGlyph, 21.0);
+        const GlyphMetrics& metrics3 = pGlyphs->get_glyph_metrics(iGlyph, 42.0);
+
+        CHECK( &metrics1 == &metrics2 );
+        CHECK( &metrics1 != &metrics3 );
+        CHECK( metrics3.bounds.width > metrics1.bounds.width );
+
+        UPoint pos(200.0f, 500.0f);
+        GmoShapeNotehead shape(nullptr, 0, k_glyph_notehead_quarter, pos, Color(0,0,0),
+                               m_libraryScope, 21.0);
+        CHECK( shape.get_width() == metrics1.bounds.width );
+        CHECK( shape.get_left() == pos.x + metrics1.bounds.x );
+    }
+
+    TEST_FIXTURE(GmoShapeTestFixture, glyph_metrics_freed_when_font_changed)
+    {
+        //tables for the previous music font are deleted. Metrics are measured again
+
+        MusicGlyphs* pGlyphs = m_libraryScope.get_glyphs_table();
+        GlyphMetrics metrics1 = pGlyphs->get_glyph_metrics(k_glyph_g_clef, 21.0);
+        pGlyphs->get_glyph_metrics(k_glyph_g_clef, 42.0);
+        CHECK( pGlyphs->get_num_metrics_tables() == 2 );
+
+        string file = m_libraryScope.get_music_font_file();
+        string name = m_libraryScope.get_music_font_name();
+        string path = m_libraryScope.get_music_font_path();
+        m_libraryScope.set_music_font(file, name, path);
+
+        CHECK( pGlyphs->get_num_metrics_tables() == 0 );
+        const GlyphMetrics& metrics2 = pGlyphs->get_glyph_metrics(k_glyph_g_clef, 21.0);
+        CHECK( pGlyphs->get_num_metrics_tables() == 1 );
+        CHECK( metrics2.bounds == metrics1.bounds );
+        CHECK( metrics2.advance == metrics1.advance );
+    }
+
+#if (LOMSE_ENABLE_THREADS == 1)
+    TEST_FIXTURE(GmoShapeTestFixture, glyph_metrics_thread_safe)
+    {
+        //several threads can request glyph metrics at the same time
+
+        MusicGlyphs* pGlyphs = m_libraryScope.get_glyphs_table();
+        const int numThreads = 4;
+        std::vector<const GlyphMetrics*> results[numThreads];
+        std::vector<std::thread> threads;
+        for (int t=0; t < numThreads; ++t)
+        {
+            std::vector<const GlyphMetrics*>& metrics = results[t];
+            threads.push_back( std::thread([pGlyphs, &metrics]() {
+                for (int i=0; i < k_glyph_error; ++i)
+                    metrics.push_back( &pGlyphs->get_glyph_metrics(i, 33.0) );
+            }) );
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+
+        for (int t=1; t < numThreads; ++t)
+            CHECK( results[t] == results[0] );
+        CHECK( results[0][k_glyph_g_clef]->bounds
+               == pGlyphs->get_glyph_metrics(k_glyph_g_clef, 33.0).bounds );
+    }
+#endif
+
 }
 
 
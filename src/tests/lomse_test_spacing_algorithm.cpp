@@ -420,4 +420,115 @@ SUITE(SpAlgGourlayTest)
         scoreLyt.my_delete_all();
     }
 
+    TEST_FIXTURE(SpAlgGourlayTestFixture, SpAlgGourlay_06)
+    {
+        //@ 06. Slices data arrays are ordered as the slices and applying a force to
+        //@     the column gives the same widths than applying it to each slice
+
+        Document doc(m_libraryScope);
+        doc.from_string("(lenmusdoc (vers 0.0) (content (score (vers 2.0) "
+            "(instrument (staves 2)(musicData "
+            "(clef G p1)(clef F4 p2)(n a4 e p1 g+ (tm 2 3)(t 1 + 3 2))"
+            "(n a4 e (tm 2 3))(n d4 e g- (tm 2 3)(t 1 -))(n g4 q)"
+            "(n c3 s p2 g+ v2)(n d3 e. g-)(n e3 q)"
+            ")) )))" );
+        GraphicModel gmodel( doc.get_im_root() );
+        ImoScore* pImoScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        MyScoreLayouter3 scoreLyt(pImoScore, &gmodel, m_libraryScope);
+
+        scoreLyt.prepare_to_start_layout();     //this creates columns and do spacing
+        MySpAlgGourlay* pAlg = static_cast<MySpAlgGourlay*>(scoreLyt.get_spacing_algorithm());
+        MyColumnDataGourlay* pCol = static_cast<MyColumnDataGourlay*>(pAlg->my_get_column(0));
+        int numSlices = pCol->num_slices();
+        CHECK( numSlices == 5 );
+        CHECK( int(pCol->m_sliceFi.size()) == numSlices );
+
+        LUnits sumRods = 0.0f;
+        for (int i=0; i < numSlices; ++i)
+        {
+            MyTimeSlice* pSlice = pCol->my_get_ordered_slice(i);
+            CHECK( pCol->m_sliceFi[i] == pSlice->get_pre_stretching_force() );
+            CHECK( pCol->m_sliceRods[i] == pSlice->get_total_rods() );
+            CHECK( pCol->m_sliceLeft[i] == pSlice->get_left_space() );
+            sumRods += pSlice->get_total_rods();
+        }
+        CHECK( pCol->m_sumRods == sumRods );
+
+        float forces[] = { 0.0f, 1.0f, 10.0f, 1000.0f };
+        for (float F : forces)
+        {
+            pCol->apply_force(F);
+            LUnits colWidth = 0.0f;
+            for (int i=0; i < numSlices; ++i)
+            {
+                MyTimeSlice* pSlice = pCol->my_get_ordered_slice(i);
+                LUnits width = pSlice->get_width();
+                pSlice->apply_force(F);
+                CHECK( width == pSlice->get_width() );
+                colWidth += width;
+            }
+            CHECK( pCol->get_column_width() == colWidth );
+        }
+
+        scoreLyt.my_delete_all();
+    }
+
+    TEST_FIXTURE(SpAlgGourlayTestFixture, SpAlgGourlay_07)
+    {
+        //@ 07. The force computed for a column extent achieves that extent
+
+        Document doc(m_libraryScope);
+        doc.from_string("(lenmusdoc (vers 0.0) (content (score (vers 2.0) "
+            "(instrument (musicData "
+            "(clef G)(n c4 q)(n e4 e)(n f4 e)(n g4 h)(barline)"
+            ")) )))" );
+        GraphicModel gmodel( doc.get_im_root() );
+        ImoScore* pImoScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        MyScoreLayouter3 scoreLyt(pImoScore, &gmodel, m_libraryScope);
+
+        scoreLyt.prepare_to_start_layout();     //this creates columns and do spacing
+        MySpAlgGourlay* pAlg = static_cast<MySpAlgGourlay*>(scoreLyt.get_spacing_algorithm());
+        ColumnDataGourlay* pCol = pAlg->my_get_column(0);
+
+        LUnits extent = pCol->get_minimum_width() + 1000.0f;
+        float F = pCol->determine_force_for(extent);
+        pCol->apply_force(F);
+        CHECK( abs(pCol->get_column_width() - extent) < 1.0f );
+        CHECK( pCol->determine_force_for(pCol->get_minimum_width()) == 0.0f );
+
+        scoreLyt.my_delete_all();
+    }
+
+    TEST_FIXTURE(SpAlgGourlayTestFixture, SpAlgGourlay_08)
+    {
+        //@ 08. Slices are allocated contiguously, in creation order
+
+        Document doc(m_libraryScope);
+        doc.from_string("(lenmusdoc (vers 0.0) (content (score (vers 2.0) "
+            "(instrument (musicData "
+            "(clef G)(n c4 q)(n e4 e)(n f4 e)(n g4 h)(barline)"
+            "(n c4 q)(n e4 q)(barline)"
+            ")) )))" );
+        GraphicModel gmodel( doc.get_im_root() );
+        ImoScore* pImoScore = static_cast<ImoScore*>( doc.get_im_root()->get_content_item(0) );
+        MyScoreLayouter3 scoreLyt(pImoScore, &gmodel, m_libraryScope);
+
+        scoreLyt.prepare_to_start_layout();     //this creates columns and do spacing
+        MySpAlgGourlay* pAlg = static_cast<MySpAlgGourlay*>(scoreLyt.get_spacing_algorithm());
+        list<TimeSlice*>& slices = pAlg->my_get_slices();
+        CHECK( slices.size() > 5 );
+
+        list<TimeSlice*>::iterator it = slices.begin();
+        char* pPrev = reinterpret_cast<char*>(*it);
+        for (++it; it != slices.end(); ++it)
+        {
+            char* pCur = reinterpret_cast<char*>(*it);
+            CHECK( pCur > pPrev );
+            CHECK( pCur - pPrev < 4096 );
+            pPrev = pCur;
+        }
+
+        scoreLyt.my_delete_all();
+    }
+
 };
@@ -97,6 +97,26 @@ SUITE(StaffVoiceLineTableTest)
             CHECK( (*it)->to_string() == _object );   \
             ++it;
 
+//---------------------------------------------------------------------------------------
+// helper, for accessing protected members
+class MyColStaffObjs : public ColStaffObjs
+{
+public:
+    MyColStaffObjs() : ColStaffObjs() {}
+
+    void my_append_entry(ColStaffObjsEntry* pEntry)
+    {
+        append_entry(pEntry->measure(), pEntry->num_instrument(), pEntry->line(),
+                     pEntry->staff(), pEntry->imo_object());
+    }
+    void my_add_entry(ColStaffObjsEntry* pEntry)
+    {
+        add_entry(pEntry->measure(), pEntry->num_instrument(), pEntry->line(),
+                  pEntry->staff(), pEntry->imo_object());
+    }
+    void my_sort_table() { sort_table(); }
+};
+
 //=======================================================================================
 // ColStaffObjsBuilder test
 //=======================================================================================
@@ -497,8 +517,8 @@ SUITE(ColStaffObjsBuilderTest)
         //@10. R8. Graces must go before barlines in the same timepos (two parts)
 
         Document doc(m_libraryScope);
-        doc.from_file(m_scores_path + "unit-tests/grace-notes/227-grace-notes-two-parts-alignment.xml",
-                      Document::k_format_mxl);
+        doc.from_file(m_scores_path + "unit-tests/grace-notes/"
+                      "227-grace-notes-two-parts-alignment.xml", Document::k_format_mxl);
         ImoScore* pScore = dynamic_cast<ImoScore*>( doc.get_content_item(0) );
         CHECK( pScore != nullptr );
         ColStaffObjs* pTable = pScore->get_staffobjs_table();
@@ -3626,6 +3646,220 @@ SUITE(ColStaffObjsBuilderTest)
         if (pRoot && !pRoot->is_document()) delete pRoot;
     }
 
+    // index and incremental maintenance -----------------------------------------------
+
+    TEST_FIXTURE(ColStaffObjsBuilderTestFixture, colstaffobjs_index_01)
+    {
+        //@01. find() returns the entry for an staffobj. For key signatures in
+        //@    several staves it returns the first entry
+
+        create_score("(score (vers 2.0)(instrument (staves 2)(musicData "
+            "(clef G p1)(clef F4 p2)(key#30 D)(n#31 c4 q p1)(n#32 c3 q p2)"
+            "(barline))))");
+        ColStaffObjsBuilder builder;
+        ColStaffObjs* pTable = builder.build(m_pScore);
+
+        CHECK( pTable->num_entries() == 7 );
+        for (int i=0; i < pTable->num_entries(); ++i)
+        {
+            ColStaffObjsEntry* pEntry = pTable->get_entry(i);
+            ImoStaffObj* pSO = pEntry->imo_object();
+            if (!pSO->is_key_signature())
+                CHECK( *(pTable->find(pSO)) == pEntry );
+        }
+
+        ImoStaffObj* pKey = static_cast<ImoStaffObj*>( m_pDoc->get_pointer_to_imo(30L) );
+        ColStaffObjsEntry* pEntry = *(pTable->find(pKey));
+        CHECK( pEntry == pTable->get_entry(2) );
+        CHECK( pEntry->staff() == 0 );
+        CHECK( pEntry->get_next()->imo_object() == pKey );
+        CHECK( pEntry->get_next()->staff() == 1 );
+    }
+
+    TEST_FIXTURE(ColStaffObjsBuilderTestFixture, colstaffobjs_index_02)
+    {
+        //@02. delete_entry_for() keeps links, entries and index updated
+
+        create_score("(score (vers 2.0)(instrument (staves 2)(musicData "
+            "(clef G p1)(clef F4 p2)(key#30 D)(n#31 c4 q p1)(n#32 c3 q p2)"
+            "(barline))))");
+        ColStaffObjsBuilder builder;
+        ColStaffObjs* pTable = builder.build(m_pScore);
+        ImoStaffObj* pNote = static_cast<ImoStaffObj*>( m_pDoc->get_pointer_to_imo(31L) );
+        ImoStaffObj* pKey = static_cast<ImoStaffObj*>( m_pDoc->get_pointer_to_imo(30L) );
+
+        pTable->delete_entry_for(pNote);
+        CHECK( pTable->num_entries() == 6 );
+        CHECK( pTable->find(pNote) == pTable->end() );
+        CHECK( pTable->get_entry(3)->get_next() == pTable->get_entry(4) );
+        CHECK( pTable->get_entry(4)->get_prev() == pTable->get_entry(3) );
+
+        //deleting first entry for the key: index points to the second one
+        ColStaffObjsEntry* pSecond = pTable->get_entry(3);
+        pTable->delete_entry_for(pKey);
+        CHECK( pTable->num_entries() == 5 );
+        CHECK( *(pTable->find(pKey)) == pSecond );
+        CHECK( pSecond->get_prev() == pTable->get_entry(1) );
+
+        //deleting first and last entries
+        pTable->delete_entry_for( pTable->front()->imo_object() );
+        pTable->delete_entry_for( pTable->back()->imo_object() );
+        CHECK( pTable->num_entries() == 3 );
+        CHECK( pTable->front()->get_prev() == nullptr );
+        CHECK( pTable->back()->get_next() == nullptr );
+        int numEntries = 0;
+        for (ColStaffObjsIterator it=pTable->begin(); it != pTable->end(); ++it)
+            ++numEntries;
+        CHECK( numEntries == 3 );
+    }
+
+    TEST_FIXTURE(ColStaffObjsBuilderTestFixture, colstaffobjs_index_03)
+    {
+        //@03. insert_entry_after() inserts the entry at the given position
+
+        create_score("(score (vers 2.0)(instrument (musicData "
+            "(clef G)(n#31 c4 q)(n#32 e4 q)(barline))))");
+        ColStaffObjsBuilder builder;
+        ColStaffObjs* pTable = builder.build(m_pScore);
+        ImoStaffObj* pNote = static_cast<ImoStaffObj*>( m_pDoc->get_pointer_to_imo(32L) );
+        ImoStaffObj* pClef = pTable->front()->imo_object();
+
+        ColStaffObjsEntry* pPrev = pTable->get_entry(1);
+        ColStaffObjsEntry* pEntry = pTable->insert_entry_after(pPrev, 0, 0, 0, 0, pNote);
+        CHECK( pTable->num_entries() == 5 );
+        CHECK( pTable->get_entry(2) == pEntry );
+        CHECK( pPrev->get_next() == pEntry );
+        CHECK( pEntry->get_next() == pTable->get_entry(3) );
+        CHECK( pTable->get_entry(3)->get_prev() == pEntry );
+        //index points to the first entry for the staffobj
+        CHECK( *(pTable->find(pNote)) == pEntry );
+        pTable->delete_entry_for(pNote);
+        CHECK( *(pTable->find(pNote)) == pTable->get_entry(2) );
+        CHECK( pTable->num_entries() == 4 );
+
+        //at start, before the existing entry for the clef
+        pEntry = pTable->insert_entry_after(nullptr, 0, 0, 0, 0, pClef);
+        CHECK( pTable->front() == pEntry );
+        CHECK( pEntry->get_prev() == nullptr );
+        CHECK( *(pTable->find(pClef)) == pEntry );
+    }
+
+    TEST_FIXTURE(ColStaffObjsBuilderTestFixture, colstaffobjs_index_04)
+    {
+        //@04. search by timepos, and barlines and time signatures per instrument
+
+        create_score("(score (vers 2.0)"
+            "(instrument (musicData (clef G)(time#30 2 4)(n c4 q)(n e4 q)"
+            "(barline#31)(time#32 3 4)(n c4 h.)(barline#33)))"
+            "(instrument (musicData (clef F4)(time#40 2 4)(n c3 h)(barline#41)"
+            "(time#42 3 4)(n#43 c3 h.)(barline#44)))"
+            ")");
+        ColStaffObjsBuilder builder;
+        ColStaffObjs* pTable = builder.build(m_pScore);
+
+        for (int i=0; i < pTable->num_entries(); ++i)
+            CHECK( pTable->get_entry(i)->get_table_index() == i );
+
+        CHECK( pTable->get_first_entry_not_before(0.0) == pTable->front() );
+        ColStaffObjsEntry* pEntry = pTable->get_first_entry_not_before(100.0);
+        CHECK( is_equal_time(pEntry->time(), 128.0) );
+        CHECK( is_lower_time(pEntry->get_prev()->time(), 100.0) );
+        CHECK( pTable->get_first_entry_not_before(400.0) == nullptr );
+
+        CHECK( pTable->get_barline_for_measure(0, 0)->imo_object()->get_id() == 31L );
+        CHECK( pTable->get_barline_for_measure(1, 1)->imo_object()->get_id() == 44L );
+        CHECK( pTable->get_barline_for_measure(1, 2) == nullptr );
+        CHECK( pTable->get_barline_for_measure(2, 0) == nullptr );
+
+        ImoStaffObj* pNote = static_cast<ImoStaffObj*>( m_pDoc->get_pointer_to_imo(43L) );
+        pEntry = *(pTable->find(pNote));
+        CHECK( pTable->get_prev_barline(1, pEntry)->imo_object()->get_id() == 41L );
+        CHECK( pTable->get_prev_time_signature(1, pEntry)->imo_object()->get_id() == 42L );
+        CHECK( pTable->get_prev_barline(1, nullptr)->imo_object()->get_id() == 44L );
+        CHECK( pTable->get_prev_barline(0, pTable->front()) == nullptr );
+
+        //indexes are updated when deleting entries
+        ImoStaffObj* pTS = static_cast<ImoStaffObj*>( m_pDoc->get_pointer_to_imo(42L) );
+        pTable->delete_entry_for(pTS);
+        CHECK( pTable->get_prev_time_signature(1, pEntry)->imo_object()->get_id() == 40L );
+        for (int i=0; i < pTable->num_entries(); ++i)
+            CHECK( pTable->get_entry(i)->get_table_index() == i );
+    }
+
+    TEST_FIXTURE(ColStaffObjsBuilderTestFixture, colstaffobjs_index_05)
+    {
+        //@05. sort_table() orders the entries as when adding them one by one
+
+        Document doc(m_libraryScope);
+        doc.from_file(m_scores_path + "unit-tests/grace-notes/"
+                      "227-grace-notes-two-parts-alignment.xml", Document::k_format_mxl);
+        ImoScore* pScore = dynamic_cast<ImoScore*>( doc.get_content_item(0) );
+        CHECK( pScore != nullptr );
+        ColStaffObjs* pTable = pScore->get_staffobjs_table();
+        int numEntries = pTable->num_entries();
+
+        //entries in reverse order and interleaved
+        vector<ColStaffObjsEntry*> reversed;
+        vector<ColStaffObjsEntry*> interleaved;
+        for (int i=0; i < numEntries; ++i)
+        {
+            reversed.push_back( pTable->get_entry(numEntries - i - 1) );
+            interleaved.push_back( pTable->get_entry((i % 2 == 0 ? i / 2
+                                                      : numEntries - 1 - i / 2)) );
+        }
+
+        vector<ColStaffObjsEntry*>* orders[] = { &reversed, &interleaved };
+        for (vector<ColStaffObjsEntry*>* pOrder : orders)
+        {
+            MyColStaffObjs added;
+            MyColStaffObjs sorted;
+            for (ColStaffObjsEntry* pEntry : *pOrder)
+            {
+                added.my_add_entry(pEntry);
+                sorted.my_append_entry(pEntry);
+            }
+            sorted.my_sort_table();
+
+            CHECK( sorted.dump() == added.dump() );
+            CHECK( sorted.front()->get_prev() == nullptr );
+            CHECK( sorted.back()->get_next() == nullptr );
+            for (int i=0; i < numEntries; ++i)
+            {
+                ColStaffObjsEntry* pEntry = sorted.get_entry(i);
+                CHECK( pEntry->get_table_index() == i );
+                CHECK( i == 0 || pEntry->get_prev() == sorted.get_entry(i-1) );
+                CHECK( (*added.find(pEntry->imo_object()))->get_table_index()
+                       == (*sorted.find(pEntry->imo_object()))->get_table_index() );
+            }
+        }
+
+        //restore staffobjs links to the score table entries
+        ColStaffObjsBuilder builder;
+        builder.build(pScore);
+    }
+
+    TEST_FIXTURE(ColStaffObjsBuilderTestFixture, colstaffobjs_index_06)
+    {
+        //@06. key signatures are indexed per instrument
+
+        create_score("(score (vers 2.0)"
+            "(instrument (staves 2)(musicData (clef G p1)(clef F4 p2)(key#30 D)"
+            "(n c4 q p1)(barline)(key#31 F)(n#32 c4 q p1)(barline)))"
+            "(instrument (musicData (clef G)(key#40 C)(n#41 c4 q)(barline)))"
+            ")");
+        ColStaffObjsBuilder builder;
+        ColStaffObjs* pTable = builder.build(m_pScore);
+
+        ImoStaffObj* pNote = static_cast<ImoStaffObj*>( m_pDoc->get_pointer_to_imo(32L) );
+        ColStaffObjsEntry* pEntry = *(pTable->find(pNote));
+        CHECK( pTable->get_prev_key_signature(0, pEntry)->imo_object()->get_id() == 31L );
+        CHECK( pTable->get_prev_key_signature(0, pTable->front()) == nullptr );
+        pNote = static_cast<ImoStaffObj*>( m_pDoc->get_pointer_to_imo(41L) );
+        pEntry = *(pTable->find(pNote));
+        CHECK( pTable->get_prev_key_signature(1, pEntry)->imo_object()->get_id() == 40L );
+        CHECK( pTable->get_prev_key_signature(2, pEntry) == nullptr );
+    }
+
 //    TEST_FIXTURE(ColStaffObjsBuilderTestFixture, playback_time_100)
 //    {
 //        //@100. auxiliary, for checking the ColStaffObjs
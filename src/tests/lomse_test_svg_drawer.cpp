@@ -128,6 +128,90 @@ SUITE(SvgDrawerTest)
     }
 
 
+    //@ culling -------------------------------------------------------------------------
+
+    TEST_FIXTURE(SvgDrawerTestFixture, culling_01)
+    {
+        //@01. full page: nothing culled
+        LomseDoorway doorway;
+        doorway.init_library(k_pix_format_rgba32, 96);
+        LibraryScope libraryScope(cout, &doorway);
+        libraryScope.set_default_fonts_path(TESTLIB_FONTS_PATH);
+        Presenter* pPresenter = doorway.open_document(k_view_vertical_book,
+            m_scores_path + "00205-multimetric.lmd");
+        Interactor* pIntor = pPresenter->get_interactor_raw_ptr(0);
+
+        stringstream svg;
+        pIntor->render_as_svg(svg, 0);
+
+        CHECK( pIntor->get_num_drawn_objects() > 0 );
+        CHECK( pIntor->get_num_culled_objects() == 0 );
+        delete pPresenter;
+    }
+
+    TEST_FIXTURE(SvgDrawerTestFixture, culling_02)
+    {
+        //@02. page region: objects out of region are not exported
+        LomseDoorway doorway;
+        doorway.init_library(k_pix_format_rgba32, 96);
+        LibraryScope libraryScope(cout, &doorway);
+        libraryScope.set_default_fonts_path(TESTLIB_FONTS_PATH);
+        Presenter* pPresenter = doorway.open_document(k_view_vertical_book,
+            m_scores_path + "00205-multimetric.lmd");
+        Interactor* pIntor = pPresenter->get_interactor_raw_ptr(0);
+
+        stringstream svgPage;
+        pIntor->render_as_svg(svgPage, 0);
+        int numObjects = pIntor->get_num_drawn_objects();
+
+        stringstream svgRegion;
+        pIntor->render_as_svg(svgRegion, 0, URect(0.0f, 0.0f, 5000.0f, 5000.0f));
+
+        CHECK( pIntor->get_num_drawn_objects() > 0 );
+        CHECK( pIntor->get_num_drawn_objects() < numObjects );
+        CHECK( pIntor->get_num_culled_objects() > 0 );
+        CHECK( svgRegion.str().size() < svgPage.str().size() );
+        CHECK( svgRegion.str().find("viewBox='0 0 5000 5000'") != string::npos );
+        delete pPresenter;
+    }
+
+    TEST_FIXTURE(SvgDrawerTestFixture, culling_03)
+    {
+        //@03. shapes out of the clip rectangle are not drawn
+        Document doc(m_libraryScope);
+        ImoStaffInfo* pInfo = static_cast<ImoStaffInfo*>(
+                                    ImFactory::inject(k_imo_staff_info, &doc));
+        GmoBoxDocPage page(nullptr);
+        GmoBoxDocPageContent* pDPC = LOMSE_NEW GmoBoxDocPageContent(nullptr);
+        page.add_child_box(pDPC);
+        page.set_width(10000.0f);
+        page.set_height(10000.0f);
+        pDPC->set_width(10000.0f);
+        pDPC->set_height(10000.0f);
+        for (int i=0; i < 10; ++i)
+        {
+            GmoShapeStaff* pShape = LOMSE_NEW GmoShapeStaff(pInfo, 0, pInfo, 0,
+                                                            1000.0f, Color(0,0,0));
+            pDPC->add_shape(pShape, GmoShape::k_layer_staff);
+            pShape->set_origin(0.0f, 1000.0f * i);
+            pShape->set_height(500.0f);
+        }
+        pDPC->add_shapes_to_tables();
+
+        stringstream ss;
+        SvgOptions options;
+        SvgDrawer drawer(m_libraryScope, ss, options);
+        RenderOptions opt;
+        opt.set_clip_rect(URect(0.0f, 2200.0f, 3000.0f, 1500.0f));
+        page.on_draw(&drawer, opt);
+
+        //drawn: page, page content and shapes 2 and 3
+        CHECK( opt.num_drawn == 4 );
+        CHECK( opt.num_culled == 8 );
+        delete pInfo;
+    }
+
+
     //@ options -------------------------------------------------------------------------
 
     TEST_FIXTURE(SvgDrawerTestFixture, options_01)
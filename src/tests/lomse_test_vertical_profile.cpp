@@ -36,22 +36,12 @@ public:
 
     inline size_t my_x_min_size(int idxStaff) { return m_xMin[idxStaff]->size(); }
     inline size_t my_x_max_size(int idxStaff) { return m_xMax[idxStaff]->size(); }
-    inline list<VProfilePoint>* my_xMin(int idxStaff) { return m_xMin[idxStaff]; }
-    inline list<VProfilePoint>* my_xMax(int idxStaff) { return m_xMax[idxStaff]; }
-    VProfilePoint my_xMin(int idxStaff, int i)
-    {
-        list<VProfilePoint>::iterator it = m_xMin[idxStaff]->begin();
-        std::advance(it, i);
-        return *it;
-    }
-    inline VProfilePoint my_xMax(int idxStaff, int i)
-    {
-        list<VProfilePoint>::iterator it = m_xMax[idxStaff]->begin();
-        std::advance(it, i);
-        return *it;
-    }
+    inline PointsRow* my_xMin(int idxStaff) { return m_xMin[idxStaff]; }
+    inline PointsRow* my_xMax(int idxStaff) { return m_xMax[idxStaff]; }
+    inline VProfilePoint my_xMin(int idxStaff, int i) { return m_xMin[idxStaff]->at(i); }
+    inline VProfilePoint my_xMax(int idxStaff, int i) { return m_xMax[idxStaff]->at(i); }
 
-    string dump_points(list<VProfilePoint>* pPoints, int idxStaff)
+    string dump_points(PointsRow* pPoints, int idxStaff)
     {
         stringstream msg;
         msg << "size = " << pPoints->size() << endl;
@@ -801,6 +791,63 @@ SUITE(VerticalProfileTest)
     }
 
 
+    TEST_FIXTURE(VerticalProfileTestFixture, vertical_profile_300)
+    {
+        //@300 dense profile: points are sorted and get_max_for()/get_min_for() give
+        //@    the same result than checking all overlapping shapes
+        LUnits xStart = 1500.0f;
+        LUnits xEnd = 41500.0f;
+        MyVerticalProfile vp(xStart, xEnd, 1);
+        vp.initialize(0, 3000.0f, 3400.0f);
+
+        const int numShapes = 300;
+        vector<GmoShapeRectangle*> shapes;
+        for (int i=0; i < numShapes; ++i)
+        {
+            GmoShapeRectangle* pShape = LOMSE_NEW GmoShapeRectangle(nullptr);
+            pShape->set_origin(xStart + float((i * 37) % 390) * 100.0f,
+                               float((i * 53) % 41) * 100.0f);
+            pShape->set_width(float(1 + (i * 11) % 13) * 100.0f);
+            pShape->set_height(float(1 + (i * 7) % 17) * 100.0f);
+            vp.update(pShape, 0);
+            shapes.push_back(pShape);
+        }
+
+        bool fSorted = true;
+        for (size_t i=1; i < vp.my_x_max_size(0); ++i)
+            fSorted &= vp.my_xMax(0, int(i-1)).x < vp.my_xMax(0, int(i)).x;
+        for (size_t i=1; i < vp.my_x_min_size(0); ++i)
+            fSorted &= vp.my_xMin(0, int(i-1)).x < vp.my_xMin(0, int(i)).x;
+        CHECK( fSorted );
+
+        //intervals not starting/ending at shape borders
+        int numErrors = 0;
+        for (int i=0; i < 100; ++i)
+        {
+            LUnits x1 = xStart + float((i * 29) % 380) * 100.0f + 50.0f;
+            LUnits x2 = x1 + float((i * 13) % 20) * 100.0f;
+            LUnits yMax = LOMSE_PAPER_LOWER_LIMIT;
+            LUnits yMin = LOMSE_PAPER_UPPER_LIMIT;
+            for (GmoShapeRectangle* pShape : shapes)
+            {
+                if (pShape->get_left() < x2 && pShape->get_right() > x1)
+                {
+                    yMax = max(yMax, pShape->get_bottom());
+                    yMin = min(yMin, pShape->get_top());
+                }
+            }
+            if (vp.get_max_for(x1, x2, 0).first != yMax)
+                ++numErrors;
+            if (vp.get_min_for(x1, x2, 0).first != yMin)
+                ++numErrors;
+        }
+        CHECK( numErrors == 0 );
+
+        for (GmoShapeRectangle* pShape : shapes)
+            delete pShape;
+    }
+
+
 };
 
 
@@ -10,6 +10,10 @@
 #define LOMSE_INTERNAL_API
 #include <UnitTest++.h>
 #include <sstream>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
 #include "lomse_build_options.h"
 
 //classes related to these tests
@@ -19,6 +23,13 @@
 #include "lomse_doorway.h"
 #include "lomse_bitmap_drawer.h"
 #include "lomse_interactor.h"
+#include "lomse_tile_cache.h"
+#include "lomse_graphical_model.h"
+#include "lomse_gm_basic.h"
+#include "lomse_shapes.h"
+#include "lomse_shape_staff.h"
+#include "lomse_im_factory.h"
+#include "lomse_events_dispatcher.h"
 
 using namespace UnitTest;
 using namespace std;
@@ -100,6 +111,77 @@ public:
 
 };
 
+//---------------------------------------------------------------------------------------
+//helper, for collecting the events generated by a background layout
+class PagesAvailableHandler
+{
+public:
+    std::mutex m_mutex;
+    std::vector<SpEventPagesAvailable> m_events;
+
+    static void wrapper_on_pages_available(void* pThis, SpEventInfo pEvent)
+    {
+        PagesAvailableHandler* pHandler = static_cast<PagesAvailableHandler*>(pThis);
+        std::lock_guard<std::mutex> lock(pHandler->m_mutex);
+        pHandler->m_events.push_back(
+            static_pointer_cast<EventPagesAvailable>(pEvent) );
+    }
+};
+
+//---------------------------------------------------------------------------------------
+//helper, for pausing a background layout: the layout thread is blocked in the first
+//EventPagesAvailable handler until released
+class BlockingPagesHandler
+{
+public:
+    std::atomic<bool> m_fBlocked;
+    std::atomic<bool> m_fReleased;
+
+    BlockingPagesHandler() : m_fBlocked(false), m_fReleased(false) {}
+
+    static void wrapper_on_pages_available(void* pThis, SpEventInfo UNUSED(pEvent))
+    {
+        BlockingPagesHandler* pHandler = static_cast<BlockingPagesHandler*>(pThis);
+        if (pHandler->m_fBlocked)
+            return;
+        pHandler->m_fBlocked = true;
+        for (int i=0; i < 5000 && !pHandler->m_fReleased; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    void wait_until_blocked()
+    {
+        for (int i=0; i < 5000 && !m_fBlocked; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+};
+
+//---------------------------------------------------------------------------------------
+//helper, for deleting the graphic model from an EventPagesAvailable handler. The
+//document is updated on first event: the model is deleted and a new one is created
+class UpdatingPagesHandler
+{
+public:
+    Interactor* m_pIntor;
+    std::atomic<int> m_numEvents;
+    std::atomic<bool> m_fUpdated;
+
+    UpdatingPagesHandler(Interactor* pIntor)
+        : m_pIntor(pIntor), m_numEvents(0), m_fUpdated(false)
+    {
+    }
+
+    static void wrapper_on_pages_available(void* pThis, SpEventInfo UNUSED(pEvent))
+    {
+        UpdatingPagesHandler* pHandler = static_cast<UpdatingPagesHandler*>(pThis);
+        if (++pHandler->m_numEvents == 1)
+        {
+            pHandler->m_pIntor->on_document_updated();
+            pHandler->m_fUpdated = true;
+        }
+    }
+};
+
 //---------------------------------------------------------------------------------------
 class GraphicViewTestFixture
 {
@@ -114,6 +196,103 @@ public:
     ~GraphicViewTestFixture()    //TearDown fixture
     {
     }
+
+    void load_score(SpDocument& spDoc)
+    {
+        spDoc->from_string("(lenmusdoc (vers 0.0) (content (score (vers 1.6) "
+            "(instrument (musicData (clef G)(key e)(n c4 q)(r q)(barline simple)"
+            "(n e4 q)(n g4 q)(barline simple)(n c5 h)(barline simple))))))" );
+    }
+
+    bool same_bitmap(std::vector<unsigned char>& buf1, std::vector<unsigned char>& buf2,
+                     int width, int height)
+    {
+        //compare bitmaps but last column and last row, never painted when rendering
+        //directly on the view buffer
+        for (int y=0; y < height - 1; ++y)
+        {
+            for (int i=0; i < (width - 1) * 4; ++i)
+            {
+                if (buf1[y * width * 4 + i] != buf2[y * width * 4 + i])
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    bool same_region(std::vector<unsigned char>& page, int pageWidth,
+                     std::vector<unsigned char>& region, int width, int height,
+                     int x, int y)
+    {
+        //compare bitmap 'region' with the area at (x, y) in bitmap 'page'. Last
+        //column and last row are not compared, as in same_bitmap()
+        for (int j=0; j < height - 1; ++j)
+        {
+            for (int i=0; i < (width - 1) * 4; ++i)
+            {
+                if (region[j * width * 4 + i] != page[(y + j) * pageWidth * 4 + x * 4 + i])
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    std::string get_mixed_score_source()
+    {
+        //score with shapes of different line widths and colors: beams, ties, slurs,
+        //texts, ledger lines, chords and thick barlines
+        return "(lenmusdoc (vers 0.0) (content "
+            "(para (txt \"Mixed shapes\")) "
+            "(score (vers 2.0) (instrument (musicData (clef G)(key D)(time 2 4)"
+            "(n c4 e g+ (tie 1 start))(n c4 e g- (tie 1 stop))(n a5 s g+)(n g5 s)(n f5 s)(n e5 s g-)"
+            "(barline double)"
+            "(chord (n c4 q)(n e4 q)(n g4 q))(n b5 e g+ (slur 1 start))"
+            "(n c6 e g- (slur 1 stop))(barline)"
+            "(n e4 h (text \"dolce\") (dyn \"p\"))(barline end)"
+            ")))))";
+    }
+
+    std::string get_long_score_source()
+    {
+        //small pages: a long score, several pages
+        stringstream src;
+        src << "(lenmusdoc (vers 0.0) "
+            << "(pageLayout (pageSize 21000 6000)(pageMargins 1000 1000 1000 1000 0) portrait) "
+            << "(content (score (vers 2.0)(instrument (musicData (clef G)";
+        for (int i=0; i < 60; ++i)
+            src << "(n c4 q)(n e4 q)(barline)";
+        src << ")))))";
+        return src.str();
+    }
+
+    std::string get_long_score_with_lyrics_source(const std::string& font)
+    {
+        //small pages: a long score with lyrics, several pages. Lyrics use the given
+        //font, e.g. "\"Liberation Sans\" 14pt bold"
+        stringstream src;
+        src << "(lenmusdoc (vers 0.0) "
+            << "(pageLayout (pageSize 21000 6000)(pageMargins 1000 1000 1000 1000 0) portrait) "
+            << "(content (para (txt \"Lyrics\")) "
+            << "(score (vers 2.0)"
+            << "(defineStyle \"Lyrics\" (font " << font << "))"
+            << "(instrument (musicData (clef G)(time 2 4)";
+        for (int i=0; i < 40; ++i)
+        {
+            src << "(n c4 q (lyric \"la" << i << "\"))(n e4 q (lyric \"li\") "
+                << "(text \"dolce\"))(barline)";
+        }
+        src << ")))))";
+        return src.str();
+    }
+
+    std::string dump_pages(GraphicModel* pGModel)
+    {
+        stringstream ss;
+        int numPages = pGModel->get_num_pages();
+        for (int i=0; i < numPages; ++i)
+            pGModel->dump_page(i, ss);
+        return ss.str();
+    }
 };
 
 
@@ -551,6 +730,544 @@ SUITE(GraphicViewTest)
         rectangles.clear();
     }
 
+    //-- culling ------------------------------------------------------------------------
+
+    TEST_FIXTURE(GraphicViewTestFixture, culling_objects_out_of_viewport)
+    {
+        MyDoorway platform;
+        LibraryScope libraryScope(cout, &platform);
+        SpDocument spDoc( new Document(libraryScope) );
+        spDoc->from_string("(lenmusdoc (vers 0.0) (content (score (vers 1.6) "
+            "(instrument (musicData (clef G)(key e)(n c4 q)(r q)(barline simple)"
+            "(n e4 q)(n g4 q)(barline simple)(n c5 h)(barline simple))))))" );
+        VerticalBookView* pView = (VerticalBookView*)Injector::inject_View(libraryScope, k_view_vertical_book);
+        Interactor* pIntor = Injector::inject_Interactor(libraryScope, spDoc, pView, nullptr);
+        pView->set_interactor(pIntor);
+
+        //whole page visible
+        std::vector<unsigned char> buf(1200 * 1600 * 4);
+        pView->set_rendering_buffer(&buf[0], 1200, 1600);
+        pView->redraw_bitmap();
+        int numObjects = pView->get_num_drawn_objects();
+        CHECK( numObjects > 0 );
+        CHECK( pView->get_num_culled_objects() == 0 );
+
+        //only page top-left corner visible
+        pView->set_rendering_buffer(&buf[0], 20, 20);
+        pView->redraw_bitmap();
+        CHECK( pView->get_num_drawn_objects() < numObjects );
+        CHECK( pView->get_num_culled_objects() > 0 );
+
+        delete pIntor;
+    }
+
+    TEST_FIXTURE(GraphicViewTestFixture, culling_does_not_change_rendering)
+    {
+        //shapes in the visible region are rendered identically when other shapes
+        //are culled, as drawer attributes are not inherited from previous shapes
+        MyDoorway platform;
+        LibraryScope libraryScope(cout, &platform);
+        SpDocument spDoc( new Document(libraryScope) );
+        spDoc->from_string( get_mixed_score_source() );
+        VerticalBookView* pView = (VerticalBookView*)Injector::inject_View(libraryScope, k_view_vertical_book);
+        Interactor* pIntor = Injector::inject_Interactor(libraryScope, spDoc, pView, nullptr);
+        pView->set_interactor(pIntor);
+        GraphicModel* pGModel = pIntor->get_graphic_model();
+
+        const int width = 600;
+        const int height = 300;
+        const double scale = 0.05;      //pixels per LUnit
+        BitmapDrawer* pDrawer = Injector::inject_BitmapDrawer(libraryScope);
+        std::vector<unsigned char> full(width * height * 4);
+        std::vector<unsigned char> culled(width * height * 4);
+        pDrawer->set_rendering_buffer(&full[0], width, height);
+        TransAffine mtx;
+        pDrawer->set_affine_transformation(mtx);
+        double userScale = scale * pDrawer->device_units_to_model(1.0);
+        mtx.reset();
+        mtx.scale(userScale);
+        UPoint origin(0.0f, 0.0f);
+
+        //whole page
+        RenderOptions opt;
+        pDrawer->set_rendering_buffer(&full[0], width, height);
+        pDrawer->set_affine_transformation(mtx);
+        pGModel->draw_page(0, origin, pDrawer, opt);
+        pDrawer->render();
+        CHECK( opt.num_culled == 0 );
+
+        //only shapes in clip rectangle
+        bool fSame = true;
+        int numCulled = 0;
+        for (LUnits y = 1500.0f; y < 5500.0f; y += 1000.0f)
+        {
+            for (LUnits x = 1000.0f; x < 11000.0f; x += 1000.0f)
+            {
+                URect clip(x, y, 1500.0f, 1000.0f);
+                opt.reset_draw_counters();
+                opt.set_clip_rect(clip);
+                pDrawer->set_rendering_buffer(&culled[0], width, height);
+                pDrawer->set_affine_transformation(mtx);
+                pGModel->draw_page(0, origin, pDrawer, opt);
+                pDrawer->render();
+                numCulled += opt.num_culled;
+
+                //compare pixels in clip rectangle, but the anti-aliased border
+                int xStart = int(x * scale) + 2;
+                int xEnd = int((x + clip.width) * scale) - 2;
+                int yStart = int(y * scale) + 2;
+                int yEnd = int((y + clip.height) * scale) - 2;
+                for (int row = yStart; row < yEnd; ++row)
+                {
+                    int i = (row * width + xStart) * 4;
+                    int n = (xEnd - xStart) * 4;
+                    fSame &= std::equal(&full[i], &full[i] + n, &culled[i]);
+                }
+            }
+        }
+        CHECK( numCulled > 0 );
+        CHECK( fSame == true );
+
+        delete pDrawer;
+        delete pIntor;
+    }
+
+    TEST_FIXTURE(GraphicViewTestFixture, culling_does_not_change_rendering_of_next_shape)
+    {
+        //a fill-only shape does not inherit the stroke of the previous shape, so its
+        //rendering does not change when the previous shape is culled
+        MyDoorway platform;
+        LibraryScope libraryScope(cout, &platform);
+        Document doc(libraryScope);
+        ImoStaffInfo* pInfo = static_cast<ImoStaffInfo*>(
+                                    ImFactory::inject(k_imo_staff_info, &doc));
+        GmoBoxDocPage page(nullptr);
+        page.set_width(12000.0f);
+        page.set_height(6000.0f);
+        GmoBoxDocPageContent* pDPC = LOMSE_NEW GmoBoxDocPageContent(nullptr);
+        pDPC->set_width(12000.0f);
+        pDPC->set_height(6000.0f);
+        page.add_child_box(pDPC);
+
+        //thick staff lines, followed by a filled square
+        pInfo->set_line_thickness(100.0f);
+        GmoShapeStaff* pStaff = LOMSE_NEW GmoShapeStaff(pInfo, 0, pInfo, 0, 4000.0f,
+                                                        Color(0,0,0));
+        pDPC->add_shape(pStaff, GmoShape::k_layer_staff);
+        pStaff->set_origin(1000.0f, 1000.0f);
+        GmoShapeDebug* pSquare = LOMSE_NEW GmoShapeDebug(Color(255,0,0),
+                                                         UPoint(7000.0f, 2000.0f),
+                                                         USize(2000.0f, 2000.0f));
+        pSquare->add_vertex('M', 7000.0f, 2000.0f);
+        pSquare->add_vertex('L', 9000.0f, 2000.0f);
+        pSquare->add_vertex('L', 9000.0f, 4000.0f);
+        pSquare->add_vertex('L', 7000.0f, 4000.0f);
+        pSquare->add_vertex('Z', 0.0f, 0.0f);
+        pSquare->close_vertex_list();
+        pDPC->add_shape(pSquare, GmoShape::k_layer_notes);
+
+        const int width = 600;
+        const int height = 300;
+        const double scale = 0.05;      //pixels per LUnit
+        BitmapDrawer* pDrawer = Injector::inject_BitmapDrawer(libraryScope);
+        std::vector<unsigned char> full(width * height * 4);
+        std::vector<unsigned char> culled(width * height * 4);
+        pDrawer->set_rendering_buffer(&full[0], width, height);
+        TransAffine mtx;
+        pDrawer->set_affine_transformation(mtx);
+        double userScale = scale * pDrawer->device_units_to_model(1.0);
+        mtx.reset();
+        mtx.scale(userScale);
+
+        //whole page
+        RenderOptions opt;
+        pDrawer->set_rendering_buffer(&full[0], width, height);
+        pDrawer->set_affine_transformation(mtx);
+        page.on_draw(pDrawer, opt);
+        pDrawer->render();
+        CHECK( opt.num_culled == 0 );
+
+        //only the square
+        URect clip(6000.0f, 1500.0f, 4000.0f, 3000.0f);
+        opt.reset_draw_counters();
+        opt.set_clip_rect(clip);
+        pDrawer->set_rendering_buffer(&culled[0], width, height);
+        pDrawer->set_affine_transformation(mtx);
+        page.on_draw(pDrawer, opt);
+        pDrawer->render();
+        CHECK( opt.num_culled == 1 );
+
+        bool fSame = true;
+        for (int row = int(clip.y * scale) + 2; row < int(clip.bottom() * scale) - 2; ++row)
+        {
+            int i = (row * width + int(clip.x * scale) + 2) * 4;
+            int n = (int(clip.width * scale) - 4) * 4;
+            fSame &= std::equal(&full[i], &full[i] + n, &culled[i]);
+        }
+        CHECK( fSame == true );
+
+        delete pDrawer;
+        delete pInfo;
+    }
+
+    //-- tile cache ---------------------------------------------------------------------
+
+    TEST_FIXTURE(GraphicViewTestFixture, tile_cache_same_bitmap)
+    {
+        //rendering from tiles produces the same bitmap than direct rendering
+        MyDoorway platform;
+        LibraryScope libraryScope(cout, &platform);
+        SpDocument spDoc( new Document(libraryScope) );
+        spDoc->from_string( get_mixed_score_source() );
+        VerticalBookView* pView = (VerticalBookView*)Injector::inject_View(libraryScope, k_view_vertical_book);
+        Interactor* pIntor = Injector::inject_Interactor(libraryScope, spDoc, pView, nullptr);
+        pView->set_interactor(pIntor);
+
+        std::vector<unsigned char> buf1(600 * 400 * 4);
+        pView->set_rendering_buffer(&buf1[0], 600, 400);
+        pView->new_viewport(-30, 20);
+        pView->redraw_bitmap();
+
+        std::vector<unsigned char> buf2(600 * 400 * 4);
+        pIntor->enable_tile_cache(true);
+        pView->set_rendering_buffer(&buf2[0], 600, 400);
+        pView->new_viewport(-30, 20);
+        pView->redraw_bitmap();
+
+        CHECK( pIntor->get_tile_cache_misses() == 8 );  //cols -1..2, rows 0..1
+        CHECK( pIntor->get_tile_cache_hits() == 0 );
+        CHECK( same_bitmap(buf1, buf2, 600, 400) );
+
+        delete pIntor;
+    }
+
+    TEST_FIXTURE(GraphicViewTestFixture, tile_cache_scrolling)
+    {
+        //when scrolling, only tiles not previously rendered are rendered
+        MyDoorway platform;
+        LibraryScope libraryScope(cout, &platform);
+        SpDocument spDoc( new Document(libraryScope) );
+        load_score(spDoc);
+        VerticalBookView* pView = (VerticalBookView*)Injector::inject_View(libraryScope, k_view_vertical_book);
+        Interactor* pIntor = Injector::inject_Interactor(libraryScope, spDoc, pView, nullptr);
+        pView->set_interactor(pIntor);
+        pIntor->enable_tile_cache(true);
+
+        std::vector<unsigned char> buf(512 * 512 * 4);
+        pView->set_rendering_buffer(&buf[0], 512, 512);
+        pView->new_viewport(0, 0);
+        pView->redraw_bitmap();
+        CHECK( pIntor->get_tile_cache_misses() == 4 );
+        CHECK( pIntor->get_tile_cache_hits() == 0 );
+        CHECK( pIntor->get_tile_cache_memory() == 4 * 257 * 257 * 4 );
+
+        pIntor->reset_tile_cache_statistics();
+        pView->new_viewport(0, 256);
+        pView->redraw_bitmap();
+        CHECK( pIntor->get_tile_cache_misses() == 2 );
+        CHECK( pIntor->get_tile_cache_hits() == 2 );
+
+        //the bitmap is the same than when rendering directly
+        std::vector<unsigned char> cached = buf;
+        pIntor->enable_tile_cache(false);
+        pView->redraw_bitmap();
+        CHECK( same_bitmap(cached, buf, 512, 512) );
+
+        delete pIntor;
+    }
+
+    TEST_FIXTURE(GraphicViewTestFixture, tile_cache_invalidated)
+    {
+        //tiles are discarded when rendering options or the graphic model change
+        MyDoorway platform;
+        LibraryScope libraryScope(cout, &platform);
+        SpDocument spDoc( new Document(libraryScope) );
+        load_score(spDoc);
+        VerticalBookView* pView = (VerticalBookView*)Injector::inject_View(libraryScope, k_view_vertical_book);
+        Interactor* pIntor = Injector::inject_Interactor(libraryScope, spDoc, pView, nullptr);
+        pView->set_interactor(pIntor);
+        pIntor->enable_tile_cache(true);
+
+        std::vector<unsigned char> buf(256 * 256 * 4);
+        pView->set_rendering_buffer(&buf[0], 256, 256);
+        pView->redraw_bitmap();
+        pView->redraw_bitmap();
+        CHECK( pIntor->get_tile_cache_misses() == 1 );
+        CHECK( pIntor->get_tile_cache_hits() == 1 );
+
+        pIntor->set_view_background(Color(255, 255, 255));
+        pView->redraw_bitmap();
+        CHECK( pIntor->get_tile_cache_misses() == 2 );
+
+        pIntor->get_graphic_model()->set_modified(true);
+        pView->redraw_bitmap();
+        CHECK( pIntor->get_tile_cache_misses() == 3 );
+
+        pIntor->invalidate_tile_cache(0, URect(0.0f, 0.0f, 100.0f, 100.0f));
+        pView->redraw_bitmap();
+        CHECK( pIntor->get_tile_cache_misses() == 4 );
+        CHECK( pIntor->get_tile_cache_hits() == 1 );
+
+        delete pIntor;
+    }
+
+    //-- lazy layout --------------------------------------------------------------------
+
+    TEST_FIXTURE(GraphicViewTestFixture, lazy_layout_renders_first_page)
+    {
+        //only the pages needed for rendering are laid out
+        MyDoorway platform;
+        LibraryScope libraryScope(cout, &platform);
+        SpDocument spDoc( new Document(libraryScope) );
+        spDoc->from_string( get_long_score_source() );
+        VerticalBookView* pView = (VerticalBookView*)Injector::inject_View(libraryScope, k_view_vertical_book);
+        Interactor* pIntor = Injector::inject_Interactor(libraryScope, spDoc, pView, nullptr);
+        pView->set_interactor(pIntor);
+        pIntor->enable_lazy_layout(true);
+
+        std::vector<unsigned char> buf(400 * 200 * 4);
+        pView->set_rendering_buffer(&buf[0], 400, 200);
+        pView->new_viewport(0, 0);
+        pView->redraw_bitmap();
+
+        GraphicModel* pGModel = pIntor->get_graphic_model();
+        CHECK( pGModel->is_layout_finished() == false );
+        CHECK( pGModel->get_num_laid_out_pages() == 1 );
+        CHECK( pGModel->get_estimated_num_pages() > 1 );
+
+        int numPages = pIntor->get_num_pages();
+        CHECK( numPages > 1 );
+        CHECK( pGModel->is_layout_finished() == true );
+        CHECK( pGModel->get_num_laid_out_pages() == numPages );
+
+        delete pIntor;
+    }
+
+#if (LOMSE_ENABLE_THREADS == 1)
+    //-- background layout --------------------------------------------------------------
+
+    TEST_FIXTURE(GraphicViewTestFixture, background_layout_publishes_pages)
+    {
+        //pages are laid out in a worker thread and each new page is notified
+        MyDoorway platform;
+        LibraryScope libraryScope(cout, &platform);
+        SpDocument spDoc( new Document(libraryScope) );
+        spDoc->from_string( get_long_score_source() );
+        VerticalBookView* pView = (VerticalBookView*)Injector::inject_View(libraryScope, k_view_vertical_book);
+        SpInteractor spIntor( Injector::inject_Interactor(libraryScope, spDoc, pView, nullptr) );
+        pView->set_interactor(spIntor.get());
+        spIntor->enable_background_layout(true);
+        PagesAvailableHandler handler;
+        spIntor->add_event_handler(k_pages_available_event, &handler,
+                                   PagesAvailableHandler::wrapper_on_pages_available);
+
+        std::vector<unsigned char> buf(400 * 200 * 4);
+        pView->set_rendering_buffer(&buf[0], 400, 200);
+        pView->new_viewport(0, 0);
+        pView->redraw_bitmap();     //pages not yet laid out are blank pages
+
+        GraphicModel* pGModel = spIntor->get_graphic_model();
+        pGModel->finish_layout();   //waits for the layout thread
+        CHECK( pGModel->is_layout_finished() == true );
+        CHECK( pGModel->is_background_layout_running() == false );
+
+        int numPages = pGModel->get_num_pages();
+        CHECK( numPages > 1 );
+        CHECK( handler.m_events.size() == size_t(numPages - 1) );
+        CHECK( handler.m_events.back()->is_layout_finished() == true );
+        CHECK( handler.m_events.back()->get_num_pages() == numPages );
+        CHECK( handler.m_events.back()->get_progress() == 1.0f );
+        for (size_t i=1; i < handler.m_events.size(); ++i)
+        {
+            CHECK( handler.m_events[i]->get_num_pages()
+                   == handler.m_events[i-1]->get_num_pages() + 1 );
+            CHECK( handler.m_events[i]->get_progress()
+                   >= handler.m_events[i-1]->get_progress() );
+        }
+    }
+
+#if (LOMSE_DIRECT_INVOCATION == 1)
+    //the handler must run in the layout thread for pausing the layout
+    TEST_FIXTURE(GraphicViewTestFixture, tile_cache_invalidated_when_pages_laid_out)
+    {
+        //tiles rendered while pages were not yet laid out are discarded when the
+        //pages are laid out, although the document has not been modified
+        MyDoorway platform;
+        LibraryScope libraryScope(cout, &platform);
+        SpDocument spDoc( new Document(libraryScope) );
+        spDoc->from_string( get_long_score_source() );
+        VerticalBookView* pView = (VerticalBookView*)Injector::inject_View(libraryScope, k_view_vertical_book);
+        SpInteractor spIntor( Injector::inject_Interactor(libraryScope, spDoc, pView, nullptr) );
+        pView->set_interactor(spIntor.get());
+        spIntor->enable_background_layout(true);
+        spIntor->enable_tile_cache(true);
+        BlockingPagesHandler handler;
+        spIntor->add_event_handler(k_pages_available_event, &handler,
+                                   BlockingPagesHandler::wrapper_on_pages_available);
+
+        //pages not yet laid out are rendered as blank pages
+        std::vector<unsigned char> blank(800 * 1200 * 4);
+        pView->set_rendering_buffer(&blank[0], 800, 1200);
+        pView->new_viewport(0, 0);
+        GraphicModel* pGModel = spIntor->get_graphic_model();
+        handler.wait_until_blocked();
+        int numPages = pGModel->get_num_laid_out_pages();
+        pView->redraw_bitmap();
+
+        handler.m_fReleased = true;
+        pGModel->finish_layout();
+        CHECK( pGModel->get_num_laid_out_pages() > numPages );
+
+        std::vector<unsigned char> cached(800 * 1200 * 4);
+        pView->set_rendering_buffer(&cached[0], 800, 1200);
+        pView->redraw_bitmap();
+        CHECK( spIntor->get_tile_cache_misses() > 0 );
+
+        std::vector<unsigned char> direct(800 * 1200 * 4);
+        spIntor->enable_tile_cache(false);
+        pView->set_rendering_buffer(&direct[0], 800, 1200);
+        pView->redraw_bitmap();
+        CHECK( same_bitmap(cached, direct, 800, 1200) );
+        CHECK( !same_bitmap(blank, direct, 800, 1200) );
+    }
+#endif
+
+    TEST_FIXTURE(GraphicViewTestFixture, background_layout_cancelled)
+    {
+        //the graphic model can be deleted while pages are being laid out
+        MyDoorway platform;
+        LibraryScope libraryScope(cout, &platform);
+        SpDocument spDoc( new Document(libraryScope) );
+        spDoc->from_string( get_long_score_source() );
+        VerticalBookView* pView = (VerticalBookView*)Injector::inject_View(libraryScope, k_view_vertical_book);
+        SpInteractor spIntor( Injector::inject_Interactor(libraryScope, spDoc, pView, nullptr) );
+        pView->set_interactor(spIntor.get());
+        spIntor->enable_background_layout(true);
+
+        GraphicModel* pGModel = spIntor->get_graphic_model();
+        CHECK( pGModel->get_num_laid_out_pages() >= 1 );
+
+        spIntor->on_document_updated();     //cancels the layout and starts a new one
+        pGModel = spIntor->get_graphic_model();
+        CHECK( pGModel->get_num_pages() > 1 );
+    }
+
+#if (LOMSE_DIRECT_INVOCATION == 1)
+    //the handler must run in the layout thread
+    TEST_FIXTURE(GraphicViewTestFixture, background_layout_model_deleted_by_handler)
+    {
+        //an EventPagesAvailable handler deletes the graphic model being laid out.
+        //The layout thread finishes without accessing it
+        MyDoorway platform;
+        LibraryScope libraryScope(cout, &platform);
+        SpDocument spDoc( new Document(libraryScope) );
+        spDoc->from_string( get_long_score_source() );
+        VerticalBookView* pView = (VerticalBookView*)Injector::inject_View(libraryScope, k_view_vertical_book);
+        SpInteractor spIntor( Injector::inject_Interactor(libraryScope, spDoc, pView, nullptr) );
+        pView->set_interactor(spIntor.get());
+        spIntor->enable_background_layout(true);
+        UpdatingPagesHandler handler(spIntor.get());
+        spIntor->add_event_handler(k_pages_available_event, &handler,
+                                   UpdatingPagesHandler::wrapper_on_pages_available);
+
+        spIntor->get_graphic_model();       //starts the layout thread
+        for (int i=0; i < 5000 && !handler.m_fUpdated; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        CHECK( handler.m_fUpdated == true );
+
+        //the model created by the handler is laid out
+        GraphicModel* pGModel = spIntor->get_graphic_model();
+        pGModel->finish_layout();
+        CHECK( pGModel->is_layout_finished() == true );
+        CHECK( pGModel->get_num_pages() > 1 );
+    }
+#endif
+
+    TEST_FIXTURE(GraphicViewTestFixture, background_layout_of_two_documents)
+    {
+        //two documents laid out at the same time in their layout threads, while the
+        //views are rendered, share the library fonts. The result is the same than
+        //when they are laid out one after the other
+        MyDoorway platform;
+        LibraryScope libraryScope(cout, &platform);
+        std::string sources[2] = {
+            get_long_score_with_lyrics_source("\"Liberation Serif\" 12pt italic"),
+            get_long_score_with_lyrics_source("\"Liberation Sans\" 20pt bold") };
+
+        //expected result: layout without layout threads
+        std::string expected[2];
+        for (int i=0; i < 2; ++i)
+        {
+            SpDocument spDoc( new Document(libraryScope) );
+            spDoc->from_string(sources[i]);
+            VerticalBookView* pView = (VerticalBookView*)Injector::inject_View(libraryScope, k_view_vertical_book);
+            SpInteractor spIntor( Injector::inject_Interactor(libraryScope, spDoc, pView, nullptr) );
+            pView->set_interactor(spIntor.get());
+            expected[i] = dump_pages(spIntor->get_graphic_model());
+        }
+
+        SpDocument spDoc[2];
+        VerticalBookView* pView[2];
+        SpInteractor spIntor[2];
+        std::vector<unsigned char> buf[2];
+        for (int i=0; i < 2; ++i)
+        {
+            spDoc[i] = SpDocument( new Document(libraryScope) );
+            spDoc[i]->from_string(sources[i]);
+            pView[i] = (VerticalBookView*)Injector::inject_View(libraryScope, k_view_vertical_book);
+            spIntor[i] = SpInteractor( Injector::inject_Interactor(libraryScope, spDoc[i], pView[i], nullptr) );
+            pView[i]->set_interactor(spIntor[i].get());
+            spIntor[i]->enable_background_layout(true);
+            buf[i].resize(400 * 300 * 4);
+            pView[i]->set_rendering_buffer(&buf[i][0], 400, 300);
+            pView[i]->new_viewport(0, 0);
+        }
+
+        //both layout threads are running
+        GraphicModel* pGModel[2];
+        for (int i=0; i < 2; ++i)
+            pGModel[i] = spIntor[i]->get_graphic_model();
+
+        //render while pages are being laid out
+        while (pGModel[0]->is_background_layout_running()
+               || pGModel[1]->is_background_layout_running())
+        {
+            pView[0]->redraw_bitmap();
+            pView[1]->redraw_bitmap();
+        }
+
+        for (int i=0; i < 2; ++i)
+        {
+            pGModel[i]->finish_layout();
+            CHECK( pGModel[i]->get_num_pages() > 1 );
+            CHECK( dump_pages(pGModel[i]) == expected[i] );
+        }
+    }
+#endif  //LOMSE_ENABLE_THREADS == 1
+
+    TEST_FIXTURE(GraphicViewTestFixture, tile_cache_memory_limit)
+    {
+        //least recently used tiles are discarded
+        MyDoorway platform;
+        LibraryScope libraryScope(cout, &platform);
+        size_t tileBytes = 257 * 257 * 4;
+        TileCache cache(libraryScope, 2 * tileBytes);
+
+        cache.create_tile(1.0, 0, 0);
+        cache.create_tile(1.0, 1, 0);
+        CHECK( cache.find_tile(1.0, 0, 0) != nullptr );     //now 0,0 is most recent
+        cache.create_tile(1.0, 2, 0);
+
+        CHECK( cache.get_num_tiles() == 2 );
+        CHECK( cache.get_memory_used() == 2 * tileBytes );
+        CHECK( cache.find_tile(1.0, 1, 0) == nullptr );
+        CHECK( cache.find_tile(1.0, 0, 0) != nullptr );
+        CHECK( cache.find_tile(1.0, 2, 0) != nullptr );
+        CHECK( cache.find_tile(2.0, 2, 0) == nullptr );     //other scale
+        CHECK( cache.get_num_hits() == 3 );
+        CHECK( cache.get_num_misses() == 2 );
+    }
+
     //TEST_FIXTURE(GraphicViewTestFixture, EditView_UpdateWindow)
     //{
     //    MyDoorway platform;